@@ -89,6 +89,7 @@ find %{buildroot}%{_libdir} -name "*.la" -delete
 %doc doc/AUTHORS doc/TODO doc/LICENSE
 %{_bindir}/darktable
 %{_bindir}/darktable-cltest
+%{_bindir}/darktable-cputest
 %{_libdir}/darktable
 %{_datadir}/applications/darktable.desktop
 %{_datadir}/darktable
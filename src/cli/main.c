@@ -25,6 +25,7 @@
  *  - profit
  */
 
+#include "common/benchmark.h"
 #include "common/collection.h"
 #include "common/darktable.h"
 #include "common/debug.h"
@@ -37,6 +38,7 @@
 #include "common/imageio.h"
 #include "common/imageio_jpeg.h"
 #include "common/imageio_module.h"
+#include "common/mipmap_cache.h"
 #include "common/points.h"
 #include "control/conf.h"
 #include "develop/imageop.h"
@@ -46,6 +48,11 @@
 #include <sys/time.h>
 #include <unistd.h>
 
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
 #ifdef __APPLE__
 #include "osx/osx.h"
 #endif
@@ -63,6 +70,8 @@ static void usage(const char *progname)
 {
   fprintf(stderr, "usage: %s [<input file or dir>] [<xmp file>] <output destination> [options] [--core <darktable options>]\n", progname);
   fprintf(stderr, "\n");
+  fprintf(stderr, "use '-' as input file to read the image from stdin and as output destination to write to stdout\n");
+  fprintf(stderr, "\n");
   fprintf(stderr, "options:\n");
   fprintf(stderr, "   --width <max width> default: 0 = full resolution\n");
   fprintf(stderr, "   --height <max height> default: 0 = full resolution\n");
@@ -76,6 +85,8 @@ static void usage(const char *progname)
   fprintf(stderr, "                          disable for multiple instances\n");
   fprintf(stderr, "   --out-ext <extension>, default from output destination or '.jpg'\n");
   fprintf(stderr, "                          if specified, takes preference over output\n");
+  fprintf(stderr, "   --in-ext <extension>, extension of the image read from stdin\n");
+  fprintf(stderr, "                          default: guessed from the data for jpeg, png, tiff, pfm and exr\n");
   fprintf(stderr, "   --import <file or dir> specify input file or dir, can be used'\n");
   fprintf(stderr, "                          multiple times instead of input file\n");
   fprintf(stderr, "   --icc-type <type> specify icc type, default to NONE\n");
@@ -83,6 +94,10 @@ static void usage(const char *progname)
   fprintf(stderr, "   --icc-file <file> specify icc filename, default to NONE\n");
   fprintf(stderr, "   --icc-intent <intent> specify icc intent, default to LAST\n");
   fprintf(stderr, "                     use --help icc-intent for list of supported intents\n");
+  fprintf(stderr, "   --benchmark <runs> export every image <runs> times, overwriting the output,\n");
+  fprintf(stderr, "                     and print per-module timings as JSON to stdout\n");
+  fprintf(stderr, "   --benchmark-cache <cold|warm>, default: cold\n");
+  fprintf(stderr, "                     cold drops the decoded input image before every run\n");
   fprintf(stderr, "   --verbose\n");
   fprintf(stderr, "   --help,-h [option]\n");
   fprintf(stderr, "   --version\n");
@@ -175,6 +190,136 @@ static dt_iop_color_intent_t get_icc_intent(const char* option)
 }
 #undef ICC_INTENT_FROM_STR
 
+// guess a file extension the loaders understand from the first bytes of an image
+static const char *_guess_extension(const guint8 *data, const size_t size)
+{
+  if(size >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff) return "jpg";
+  if(size >= 8 && !memcmp(data, "\x89PNG\r\n\x1a\n", 8)) return "png";
+  if(size >= 4 && !memcmp(data, "\x76\x2f\x31\x01", 4)) return "exr";
+  if(size >= 3 && (!memcmp(data, "PF\n", 3) || !memcmp(data, "Pf\n", 3))) return "pfm";
+  // tiff based raws need --in-ext, otherwise they are loaded as plain tiff
+  if(size >= 4 && (!memcmp(data, "II*\0", 4) || !memcmp(data, "MM\0*", 4))) return "tif";
+  return NULL;
+}
+
+// read all of stdin into memory and hand it to the loaders as a file in our private spool directory
+static gchar *_spool_stdin(const char *spooldir, const char *ext)
+{
+#ifdef _WIN32
+  _setmode(_fileno(stdin), _O_BINARY);
+#endif
+  GByteArray *data = g_byte_array_new();
+  guint8 chunk[65536];
+  size_t n;
+  while((n = fread(chunk, 1, sizeof(chunk), stdin)) > 0) g_byte_array_append(data, chunk, n);
+
+  if(ferror(stdin) || data->len == 0)
+  {
+    fprintf(stderr, "%s\n", _("error: can't read image from stdin"));
+    g_byte_array_free(data, TRUE);
+    return NULL;
+  }
+
+  if(!ext) ext = _guess_extension(data->data, data->len);
+  if(!ext)
+  {
+    fprintf(stderr, "%s\n", _("error: unknown image type on stdin, please specify --in-ext"));
+    g_byte_array_free(data, TRUE);
+    return NULL;
+  }
+
+  gchar *basename = g_strdup_printf("stdin.%s", ext);
+  gchar *filename = g_build_filename(spooldir, basename, NULL);
+  g_free(basename);
+
+  GError *error = NULL;
+  if(!g_file_set_contents(filename, (const gchar *)data->data, data->len, &error))
+  {
+    fprintf(stderr, _("error: can't write %s: %s\n"), filename, error->message);
+    g_error_free(error);
+    g_free(filename);
+    filename = NULL;
+  }
+  g_byte_array_free(data, TRUE);
+  return filename;
+}
+
+// copy the image exported into the spool directory to the real stdout
+static gboolean _stream_to_stdout(const char *spooldir, FILE *image_out)
+{
+  GDir *dir = g_dir_open(spooldir, 0, NULL);
+  if(!dir) return FALSE;
+
+  gboolean done = FALSE;
+  const gchar *name;
+  while(!done && (name = g_dir_read_name(dir)) != NULL)
+  {
+    if(!g_str_has_prefix(name, "stdout.")) continue;
+
+    gchar *filename = g_build_filename(spooldir, name, NULL);
+    FILE *f = g_fopen(filename, "rb");
+    g_free(filename);
+    if(!f) break;
+
+    guint8 chunk[65536];
+    size_t n;
+    done = TRUE;
+    while((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+      if(fwrite(chunk, 1, n, image_out) != n)
+      {
+        done = FALSE;
+        break;
+      }
+    fclose(f);
+    if(fflush(image_out)) done = FALSE;
+  }
+  g_dir_close(dir);
+  return done;
+}
+
+// keep a private handle on stdout for the image and send everything else printed to stdout, by us, dt_print()
+// or any of the libraries, to stderr instead
+static FILE *_reserve_stdout(void)
+{
+  fflush(stdout);
+  const int fd = dup(fileno(stdout));
+  if(fd < 0) return NULL;
+  FILE *image_out = fdopen(fd, "wb");
+  if(!image_out)
+  {
+    close(fd);
+    return NULL;
+  }
+  if(dup2(fileno(stderr), fileno(stdout)) < 0)
+  {
+    fclose(image_out);
+    return NULL;
+  }
+#ifdef _WIN32
+  _setmode(fd, _O_BINARY);
+#endif
+  return image_out;
+}
+
+static void _remove_spooldir(gchar *spooldir)
+{
+  if(!spooldir) return;
+  GDir *dir = g_dir_open(spooldir, 0, NULL);
+  if(dir)
+  {
+    const gchar *name;
+    while((name = g_dir_read_name(dir)) != NULL)
+    {
+      gchar *filename = g_build_filename(spooldir, name, NULL);
+      g_unlink(filename);
+      g_free(filename);
+    }
+    g_dir_close(dir);
+  }
+  g_rmdir(spooldir);
+  g_free(spooldir);
+}
+
 int main(int argc, char *arg[])
 {
 #ifdef __APPLE__
@@ -195,11 +340,14 @@ int main(int argc, char *arg[])
   gchar *output_filename = NULL;
   gchar *output_ext = NULL;
   char *style = NULL;
+  gchar *input_ext = NULL;
+  gchar *spooldir = NULL;
+  FILE *image_out = NULL;
   int file_counter = 0;
-  int width = 0, height = 0, bpp = 0;
+  int width = 0, height = 0, bpp = 0, benchmark_runs = 0;
   gboolean verbose = FALSE, high_quality = TRUE, upscale = FALSE,
            style_overwrite = FALSE, custom_presets = TRUE, export_masks = FALSE,
-           output_to_dir = FALSE;
+           output_to_dir = FALSE, benchmark_cold = TRUE, output_to_stdout = FALSE;
 
   GList* inputs = NULL;
 
@@ -210,7 +358,7 @@ int main(int argc, char *arg[])
   int k;
   for(k = 1; k < argc; k++)
   {
-    if(arg[k][0] == '-')
+    if(arg[k][0] == '-' && arg[k][1] != '\0')
     {
       if(!strcmp(arg[k], "--help") || !strcmp(arg[k], "-h"))
       {
@@ -335,6 +483,18 @@ int main(int argc, char *arg[])
         }
         output_ext = g_strdup(arg[k]);
       }
+      else if(!strcmp(arg[k], "--in-ext") && argc > k + 1)
+      {
+        k++;
+        if(strlen(arg[k]) > DT_MAX_OUTPUT_EXT_LENGTH)
+        {
+          fprintf(stderr, "%s: %s\n", _("too long ext for --in-ext"), arg[k]);
+          usage(arg[0]);
+          exit(1);
+        }
+        if(*arg[k] == '.') arg[k]++;
+        input_ext = g_ascii_strdown(arg[k], -1);
+      }
       else if(!strcmp(arg[k], "--import") && argc > k + 1)
       {
         k++;
@@ -381,6 +541,27 @@ int main(int argc, char *arg[])
           exit(1);
         }
       }
+      else if(!strcmp(arg[k], "--benchmark") && argc > k + 1)
+      {
+        k++;
+        benchmark_runs = MAX(atoi(arg[k]), 0);
+      }
+      else if(!strcmp(arg[k], "--benchmark-cache") && argc > k + 1)
+      {
+        k++;
+        gchar *str = g_ascii_strup(arg[k], -1);
+        if(!g_strcmp0(str, "COLD"))
+          benchmark_cold = TRUE;
+        else if(!g_strcmp0(str, "WARM"))
+          benchmark_cold = FALSE;
+        else
+        {
+          fprintf(stderr, "%s: %s\n", _("unknown option for --benchmark-cache"), arg[k]);
+          usage(arg[0]);
+          exit(1);
+        }
+        g_free(str);
+      }
       else if(!strcmp(arg[k], "-v") || !strcmp(arg[k], "--verbose"))
       {
         verbose = TRUE;
@@ -407,12 +588,18 @@ int main(int argc, char *arg[])
   }
 
   int m_argc = 0;
-  char **m_arg = malloc(sizeof(char *) * (5 + argc - k + 1));
+  char **m_arg = malloc(sizeof(char *) * (7 + argc - k + 1));
   m_arg[m_argc++] = "darktable-cli";
   m_arg[m_argc++] = "--library";
   m_arg[m_argc++] = ":memory:";
   m_arg[m_argc++] = "--conf";
   m_arg[m_argc++] = "write_sidecar_files=FALSE";
+  if(benchmark_runs)
+  {
+    // every run writes the same output file again
+    m_arg[m_argc++] = "--conf";
+    m_arg[m_argc++] = "plugins/imageio/storage/disk/overwrite=1";
+  }
   for(; k < argc; k++) m_arg[m_argc++] = arg[k];
   m_arg[m_argc] = NULL;
 
@@ -467,12 +654,67 @@ int main(int argc, char *arg[])
     xmp_filename = NULL;
   }
 
+  if((input_filename && !strcmp(input_filename, "-")) || !strcmp(output_filename, "-"))
+  {
+    spooldir = g_dir_make_tmp("darktable-cli-XXXXXX", NULL);
+    if(!spooldir)
+    {
+      fprintf(stderr, "%s\n", _("error: can't create a temporary directory"));
+      free(m_arg);
+      g_free(output_filename);
+      g_free(output_ext);
+      g_free(input_ext);
+      if(inputs)
+        g_list_free_full(inputs, g_free);
+      exit(1);
+    }
+  }
+
   if(!inputs && input_filename)
   {
     // input is present as param
-    inputs = g_list_prepend(inputs, g_strdup(input_filename));
+    if(!strcmp(input_filename, "-"))
+    {
+      gchar *spooled = _spool_stdin(spooldir, input_ext);
+      if(!spooled)
+      {
+        _remove_spooldir(spooldir);
+        free(m_arg);
+        g_free(output_filename);
+        g_free(output_ext);
+        g_free(input_ext);
+        exit(1);
+      }
+      inputs = g_list_prepend(inputs, spooled);
+    }
+    else
+      inputs = g_list_prepend(inputs, g_strdup(input_filename));
     input_filename = NULL;
   }
+  g_free(input_ext);
+  input_ext = NULL;
+
+  if(!strcmp(output_filename, "-"))
+  {
+    // export into the spool directory and copy the result to stdout once done
+    output_to_stdout = TRUE;
+    if(!output_ext) output_ext = g_strdup("jpg");
+    g_free(output_filename);
+    output_filename = g_build_filename(spooldir, "stdout", NULL);
+
+    image_out = _reserve_stdout();
+    if(!image_out)
+    {
+      fprintf(stderr, "%s\n", _("error: can't write the exported image to stdout"));
+      _remove_spooldir(spooldir);
+      free(m_arg);
+      g_free(output_filename);
+      g_free(output_ext);
+      if(inputs)
+        g_list_free_full(inputs, g_free);
+      exit(1);
+    }
+  }
 
   if(g_file_test(output_filename, G_FILE_TEST_IS_DIR))
   {
@@ -562,6 +804,7 @@ int main(int argc, char *arg[])
   if(total == 0)
   {
     fprintf(stderr, _("no images to export, aborting\n"));
+    _remove_spooldir(spooldir);
     free(m_arg);
     g_free(output_filename);
     if(output_ext)
@@ -569,6 +812,16 @@ int main(int argc, char *arg[])
     exit(1);
   }
 
+  if(output_to_stdout && total > 1)
+  {
+    fprintf(stderr, _("only a single image can be written to stdout, aborting\n"));
+    _remove_spooldir(spooldir);
+    free(m_arg);
+    g_free(output_filename);
+    g_free(output_ext);
+    exit(1);
+  }
+
   // attach xmp, if requested:
   if(xmp_filename)
   {
@@ -685,6 +938,7 @@ int main(int argc, char *arg[])
   {
     fprintf(stderr, _("unknown extension '.%s'"), output_ext);
     fprintf(stderr, "\n");
+    _remove_spooldir(spooldir);
     free(m_arg);
     g_free(output_filename);
     g_free(output_ext);
@@ -741,16 +995,56 @@ int main(int argc, char *arg[])
 
   // TODO: add a callback to set the bpp without going through the config
 
-  int num = 1;
-  for(GList *iter = id_list; iter; iter = g_list_next(iter), num++)
+  if(benchmark_runs) darktable.benchmark = dt_benchmark_new(benchmark_cold);
+
+  for(int run = 0; run < MAX(benchmark_runs, 1); run++)
+  {
+    int num = 1;
+    for(GList *iter = id_list; iter; iter = g_list_next(iter), num++)
+    {
+      const int id = GPOINTER_TO_INT(iter->data);
+      // TODO: have a parameter in command line to get the export presets
+      dt_export_metadata_t metadata;
+      metadata.flags = dt_lib_export_metadata_default_flags();
+      metadata.list = NULL;
+
+      // make sure the raw gets loaded and decoded again
+      if(darktable.benchmark && benchmark_cold)
+      {
+        dt_mipmap_cache_evict_at_size(darktable.mipmap_cache, id, DT_MIPMAP_FULL);
+        dt_mipmap_cache_evict_at_size(darktable.mipmap_cache, id, DT_MIPMAP_F);
+      }
+
+      dt_times_t start;
+      dt_get_times(&start);
+      storage->store(storage, sdata, id, format, fdata, num, total, high_quality, upscale, export_masks,
+                     icc_type, icc_filename, icc_intent, &metadata);
+
+      // the global init of the modules happens along with their first instance, so only the first image
+      // shows what startup really costs
+      if(run == 0 && num == 1)
+        dt_print(DT_DEBUG_PERF, "[darktable-cli] first image done %f seconds after start\n",
+                 dt_get_wtime() - darktable.start_wtime);
+
+      if(darktable.benchmark)
+      {
+        dt_times_t end;
+        dt_get_times(&end);
+        const dt_image_t *img = dt_image_cache_get(darktable.image_cache, id, 'r');
+        const uint32_t iw = img->width, ih = img->height;
+        dt_image_cache_read_release(darktable.image_cache, img);
+        dt_benchmark_record_run(darktable.benchmark, end.clock - start.clock, iw, ih);
+      }
+    }
+  }
+
+  if(darktable.benchmark)
   {
-    const int id = GPOINTER_TO_INT(iter->data);
-    // TODO: have a parameter in command line to get the export presets
-    dt_export_metadata_t metadata;
-    metadata.flags = dt_lib_export_metadata_default_flags();
-    metadata.list = NULL;
-    storage->store(storage, sdata, id, format, fdata, num, total, high_quality, upscale, export_masks,
-                   icc_type, icc_filename, icc_intent, &metadata);
+    gchar *json = dt_benchmark_to_json(darktable.benchmark);
+    printf("%s\n", json);
+    g_free(json);
+    dt_benchmark_free(darktable.benchmark);
+    darktable.benchmark = NULL;
   }
 
   // cleanup time
@@ -762,9 +1056,22 @@ int main(int argc, char *arg[])
   if(icc_filename)
     g_free(icc_filename);
 
+  int res = 0;
+  if(output_to_stdout)
+  {
+    if(!_stream_to_stdout(spooldir, image_out))
+    {
+      fprintf(stderr, "%s\n", _("error: can't write the exported image to stdout"));
+      res = 1;
+    }
+    fclose(image_out);
+  }
+
   dt_cleanup();
 
+  _remove_spooldir(spooldir);
   free(m_arg);
+  return res;
 }
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
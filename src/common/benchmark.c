@@ -0,0 +1,251 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/benchmark.h"
+#include "common/darktable.h"
+#include "common/opencl.h"
+
+#include <json-glib/json-glib.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+typedef struct dt_benchmark_module_t
+{
+  gchar *name;
+  dt_benchmark_path_t path;
+  GArray *wall; // double
+  GArray *user; // double
+} dt_benchmark_module_t;
+
+static const char *_path_to_str(const dt_benchmark_path_t path)
+{
+  switch(path)
+  {
+    case DT_BENCHMARK_PATH_CPU:
+      return "CPU";
+    case DT_BENCHMARK_PATH_CPU_TILED:
+      return "CPU tiled";
+    case DT_BENCHMARK_PATH_OPENCL:
+      return "OpenCL";
+    case DT_BENCHMARK_PATH_OPENCL_TILED:
+      return "OpenCL tiled";
+    default:
+      return "unknown";
+  }
+}
+
+static void _module_free(gpointer data)
+{
+  dt_benchmark_module_t *m = (dt_benchmark_module_t *)data;
+  g_free(m->name);
+  g_array_free(m->wall, TRUE);
+  g_array_free(m->user, TRUE);
+  free(m);
+}
+
+static int _cmp_double(const void *a, const void *b)
+{
+  const double da = *(const double *)a, db = *(const double *)b;
+  return (da > db) - (da < db);
+}
+
+// min/median/max of the samples, the array gets sorted in place
+static void _stats(GArray *samples, double *min, double *median, double *max, double *sum)
+{
+  *min = *median = *max = *sum = 0.0;
+  const guint n = samples->len;
+  if(n == 0) return;
+  g_array_sort(samples, _cmp_double);
+  const double *v = (const double *)samples->data;
+  *min = v[0];
+  *max = v[n - 1];
+  *median = (n & 1) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+  for(guint k = 0; k < n; k++) *sum += v[k];
+}
+
+dt_benchmark_t *dt_benchmark_new(const gboolean cold_cache)
+{
+  dt_benchmark_t *bench = (dt_benchmark_t *)calloc(1, sizeof(dt_benchmark_t));
+  dt_pthread_mutex_init(&bench->lock, NULL);
+  bench->modules = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _module_free);
+  bench->runs = g_array_new(FALSE, FALSE, sizeof(double));
+  bench->cold_cache = cold_cache;
+  return bench;
+}
+
+void dt_benchmark_free(dt_benchmark_t *bench)
+{
+  if(!bench) return;
+  // the keys are owned by the hash table
+  g_list_free(bench->module_order);
+  g_hash_table_destroy(bench->modules);
+  g_array_free(bench->runs, TRUE);
+  dt_pthread_mutex_destroy(&bench->lock);
+  free(bench);
+}
+
+void dt_benchmark_record_module(dt_benchmark_t *bench, const char *module, const dt_benchmark_path_t path,
+                                const double wall, const double user)
+{
+  if(!bench || !module) return;
+
+  gchar *key = g_strdup_printf("%s|%d", module, path);
+
+  dt_pthread_mutex_lock(&bench->lock);
+  dt_benchmark_module_t *m = (dt_benchmark_module_t *)g_hash_table_lookup(bench->modules, key);
+  if(!m)
+  {
+    m = (dt_benchmark_module_t *)calloc(1, sizeof(dt_benchmark_module_t));
+    m->name = g_strdup(module);
+    m->path = path;
+    m->wall = g_array_new(FALSE, FALSE, sizeof(double));
+    m->user = g_array_new(FALSE, FALSE, sizeof(double));
+    g_hash_table_insert(bench->modules, key, m);
+    bench->module_order = g_list_append(bench->module_order, key);
+  }
+  else
+    g_free(key);
+
+  g_array_append_val(m->wall, wall);
+  g_array_append_val(m->user, user);
+  dt_pthread_mutex_unlock(&bench->lock);
+}
+
+void dt_benchmark_record_run(dt_benchmark_t *bench, const double wall, const uint32_t width,
+                             const uint32_t height)
+{
+  if(!bench) return;
+
+  dt_pthread_mutex_lock(&bench->lock);
+  g_array_append_val(bench->runs, wall);
+  bench->megapixels += (double)width * height / 1.0e6;
+  dt_pthread_mutex_unlock(&bench->lock);
+}
+
+size_t dt_benchmark_peak_rss()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if(GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return pmc.PeakWorkingSetSize;
+  return 0;
+#else
+  struct rusage ru;
+  if(getrusage(RUSAGE_SELF, &ru)) return 0;
+#ifdef __APPLE__
+  // bytes on macOS
+  return (size_t)ru.ru_maxrss;
+#else
+  // kilobytes everywhere else
+  return (size_t)ru.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+static void _add_stats(JsonBuilder *builder, const char *name, GArray *samples)
+{
+  double min, median, max, sum;
+  _stats(samples, &min, &median, &max, &sum);
+
+  json_builder_set_member_name(builder, name);
+  json_builder_begin_object(builder);
+  json_builder_set_member_name(builder, "min");
+  json_builder_add_double_value(builder, min);
+  json_builder_set_member_name(builder, "median");
+  json_builder_add_double_value(builder, median);
+  json_builder_set_member_name(builder, "max");
+  json_builder_add_double_value(builder, max);
+  json_builder_set_member_name(builder, "total");
+  json_builder_add_double_value(builder, sum);
+  json_builder_end_object(builder);
+}
+
+gchar *dt_benchmark_to_json(dt_benchmark_t *bench)
+{
+  if(!bench) return NULL;
+
+  dt_pthread_mutex_lock(&bench->lock);
+
+  JsonBuilder *builder = json_builder_new();
+  json_builder_begin_object(builder);
+
+  json_builder_set_member_name(builder, "version");
+  json_builder_add_string_value(builder, darktable_package_version);
+  json_builder_set_member_name(builder, "threads");
+  json_builder_add_int_value(builder, dt_get_num_threads());
+  json_builder_set_member_name(builder, "opencl");
+  json_builder_add_boolean_value(builder, dt_opencl_is_inited() && dt_opencl_is_enabled());
+  json_builder_set_member_name(builder, "cache");
+  json_builder_add_string_value(builder, bench->cold_cache ? "cold" : "warm");
+  json_builder_set_member_name(builder, "runs");
+  json_builder_add_int_value(builder, bench->runs->len);
+
+  double min, median, max, sum;
+  _add_stats(builder, "run_seconds", bench->runs);
+  _stats(bench->runs, &min, &median, &max, &sum);
+
+  json_builder_set_member_name(builder, "megapixels");
+  json_builder_add_double_value(builder, bench->megapixels);
+  json_builder_set_member_name(builder, "megapixels_per_second");
+  json_builder_add_double_value(builder, sum > 0.0 ? bench->megapixels / sum : 0.0);
+  json_builder_set_member_name(builder, "peak_rss_bytes");
+  json_builder_add_int_value(builder, dt_benchmark_peak_rss());
+
+  json_builder_set_member_name(builder, "modules");
+  json_builder_begin_array(builder);
+  for(GList *iter = bench->module_order; iter; iter = g_list_next(iter))
+  {
+    dt_benchmark_module_t *m = (dt_benchmark_module_t *)g_hash_table_lookup(bench->modules, iter->data);
+    if(!m) continue;
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "module");
+    json_builder_add_string_value(builder, m->name);
+    json_builder_set_member_name(builder, "path");
+    json_builder_add_string_value(builder, _path_to_str(m->path));
+    json_builder_set_member_name(builder, "samples");
+    json_builder_add_int_value(builder, m->wall->len);
+    _add_stats(builder, "wall_seconds", m->wall);
+    _add_stats(builder, "cpu_seconds", m->user);
+    json_builder_end_object(builder);
+  }
+  json_builder_end_array(builder);
+
+  json_builder_end_object(builder);
+
+  dt_pthread_mutex_unlock(&bench->lock);
+
+  JsonNode *root = json_builder_get_root(builder);
+  JsonGenerator *generator = json_generator_new();
+  json_generator_set_pretty(generator, TRUE);
+  json_generator_set_root(generator, root);
+  gchar *json = json_generator_to_data(generator, NULL);
+
+  json_node_free(root);
+  g_object_unref(generator);
+  g_object_unref(builder);
+
+  return json;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
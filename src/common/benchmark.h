@@ -0,0 +1,67 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/dtpthread.h"
+
+#include <glib.h>
+#include <stdint.h>
+
+/** the code path a module was processed on, as reported by the pixelpipe */
+typedef enum dt_benchmark_path_t
+{
+  DT_BENCHMARK_PATH_CPU = 0,
+  DT_BENCHMARK_PATH_CPU_TILED = 1,
+  DT_BENCHMARK_PATH_OPENCL = 2,
+  DT_BENCHMARK_PATH_OPENCL_TILED = 3,
+  DT_BENCHMARK_PATH_LAST
+} dt_benchmark_path_t;
+
+/** collects timings of repeated export runs. when darktable.benchmark is set, the export pixelpipe
+ *  reports the time spent in every module to it. */
+typedef struct dt_benchmark_t
+{
+  dt_pthread_mutex_t lock;
+  GHashTable *modules; // "module label|path" -> dt_benchmark_module_t
+  GList *module_order; // keys of modules, in the order they were first processed
+  GArray *runs;        // wall clock seconds of each complete run (double)
+  double megapixels;   // sum of processed input megapixels over all runs
+  gboolean cold_cache;
+} dt_benchmark_t;
+
+dt_benchmark_t *dt_benchmark_new(const gboolean cold_cache);
+void dt_benchmark_free(dt_benchmark_t *bench);
+
+/** record the time a single module took in the pixelpipe */
+void dt_benchmark_record_module(dt_benchmark_t *bench, const char *module, const dt_benchmark_path_t path,
+                                const double wall, const double user);
+
+/** record a complete export of an image with the given input size */
+void dt_benchmark_record_run(dt_benchmark_t *bench, const double wall, const uint32_t width,
+                             const uint32_t height);
+
+/** peak resident set size of the process in bytes */
+size_t dt_benchmark_peak_rss();
+
+/** serialize the collected statistics, to be freed with g_free() */
+gchar *dt_benchmark_to_json(dt_benchmark_t *bench);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
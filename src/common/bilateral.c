@@ -70,7 +70,7 @@ size_t dt_bilateral_memory_use(const int width,     // width of input image
   // OpenCL path needs two buffers
   return 2 * grid_size * sizeof(float);
 #else
-  return (grid_size + 3 * darktable.num_openmp_threads * b.size_x * b.size_z) * sizeof(float);
+  return grid_size * sizeof(float);
 #endif /* HAVE_OPENCL */
 }
 
@@ -94,7 +94,7 @@ size_t dt_bilateral_singlebuffer_size(const int width,     // width of input ima
   dt_bilateral_t b;
   dt_bilateral_grid_size(&b,width,height,100.0f,sigma_s,sigma_r);
   size_t grid_size = b.size_x * b.size_y * b.size_z;
-  return (grid_size + 3 * darktable.num_openmp_threads * b.size_x * b.size_z) * sizeof(float);
+  return grid_size * sizeof(float);
 }
 
 #ifndef HAVE_OPENCL
@@ -145,13 +145,10 @@ dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
   dt_bilateral_grid_size(b,width,height,100.0f,sigma_s,sigma_r);
   b->width = width;
   b->height = height;
-  b->numslices = darktable.num_openmp_threads;
-  b->sliceheight = (height + b->numslices - 1) / b->numslices;
-  b->slicerows = (b->size_y + b->numslices - 1) / b->numslices + 2;
-  b->buf = dt_alloc_align_float(b->size_x * b->size_z * b->numslices * b->slicerows);
+  b->buf = dt_alloc_align_float(b->size_x * b->size_y * b->size_z);
   if (b->buf)
   {
-    memset(b->buf, 0, sizeof(float) * b->size_x * b->size_z * b->numslices * b->slicerows);
+    memset(b->buf, 0, sizeof(float) * b->size_x * b->size_y * b->size_z);
   }
   else
   {
@@ -162,9 +159,21 @@ dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
   return b;
 }
 
-#ifdef _OPENMP
-#pragma omp declare simd aligned(in:64)
-#endif
+// first[g] is the first image row (or column) whose pixels splat into grid cells g and g+1, with the same
+// clamping as image_to_grid(). first[size - 1] is one past the last row.
+static void grid_first_pixel(int *const first, const int size, const int n, const float sigma_s)
+{
+  int g = 0;
+  first[0] = 0;
+  for(int i = 0; i < n; i++)
+  {
+    const float x = CLAMPS(i / sigma_s, 0, size - 1);
+    const int xi = MIN((int)x, size - 2);
+    while(g < xi) first[++g] = i;
+  }
+  while(g < size - 1) first[++g] = n;
+}
+
 void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
 {
   const int ox = b->size_z;
@@ -175,7 +184,6 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
 
   if (!buf) return;
   // splat into downsampled grid
-  const int nthreads = darktable.num_openmp_threads;
   const size_t offsets[8] =
   {
     0,
@@ -188,160 +196,157 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
     oz + oy + ox
   };
 
+  // every pixel splats into the 2x2 cells below and right of its grid position. cut the grid into tiles, one
+  // row of cells high and as wide as possible, and let one thread splat all pixels whose grid position lies in
+  // a tile. tiles of the same parity in x and y never touch the same cells, so going through the four parities
+  // one after the other, all threads can add to the grid directly, without atomics or per-thread copies of it.
+  const int cells_x = b->size_x - 1, cells_y = b->size_y - 1;
+  int *const first_x = malloc(sizeof(int) * b->size_x);
+  int *const first_y = malloc(sizeof(int) * b->size_y);
+  if(!first_x || !first_y)
+  {
+    free(first_x);
+    free(first_y);
+    return;
+  }
+  grid_first_pixel(first_x, b->size_x, b->width, b->sigma_s);
+  grid_first_pixel(first_y, b->size_y, b->height, b->sigma_s);
+
+  // only split the rows if there are too few of them to keep all threads busy
+  int tiles_x = 1;
+  while(tiles_x < cells_x && ((tiles_x + 1) / 2) * ((cells_y + 1) / 2) < 2 * darktable.num_openmp_threads)
+    tiles_x *= 2;
+  const int ts = (cells_x + tiles_x - 1) / tiles_x;
+  tiles_x = (cells_x + ts - 1) / ts;
+
+  for(int parity = 0; parity < 4; parity++)
+  {
+    const int px = parity & 1, py = parity >> 1;
+    const int ntx = (tiles_x - px + 1) / 2, nty = (cells_y - py + 1) / 2;
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, oy, oz, ox, sigma_s, buf, offsets) \
-  shared(b)
+  dt_omp_firstprivate(in, oy, sigma_s, buf, offsets, first_x, first_y, ts, cells_x, px, py, ntx, nty) \
+  shared(b) schedule(static)
 #endif
-  for(int slice = 0; slice < b->numslices; slice++)
-  {
-    const int firstrow = slice * b->sliceheight;
-    const int lastrow = MIN((slice+1)*b->sliceheight,b->height);
-    // compute the first row of the final grid which this slice splats, and subtract that from the first
-    // row the current thread should use to get an offset
-    const int slice_offset = slice * b->slicerows - (int)(firstrow / b->sigma_s);
-    // now iterate over the rows of the current horizontal slice
-    for(int j = firstrow; j < lastrow; j++)
+    for(int t = 0; t < ntx * nty; t++)
     {
-      float y = CLAMPS(j / b->sigma_s, 0, b->size_y - 1);
-      const int yi = MIN((int)y, b->size_y - 2);
-      const float yf = y - yi;
-      const size_t base = (yi + slice_offset) * oy;
-      for(int i = 0; i < b->width; i++)
+      const int tx = px + 2 * (t % ntx), ty = py + 2 * (t / ntx);
+      const int firstcol = first_x[tx * ts], lastcol = first_x[MIN((tx + 1) * ts, cells_x)];
+      const int firstrow = first_y[ty], lastrow = first_y[ty + 1];
+      for(int j = firstrow; j < lastrow; j++)
       {
-        size_t index = 4 * (j * b->width + i);
-        float xf, zf;
-        const float L = in[index];
-        // nearest neighbour splatting:
-        const size_t grid_index = base + image_to_relgrid(b, i, L, &xf, &zf);
-        // sum up payload here
-        const float contrib[4] =
+        float y = CLAMPS(j / b->sigma_s, 0, b->size_y - 1);
+        const int yi = MIN((int)y, b->size_y - 2);
+        const float yf = y - yi;
+        const size_t base = (size_t)yi * oy;
+        for(int i = firstcol; i < lastcol; i++)
         {
-          (1.0f - xf) * (1.0f - yf) * 100.0f / sigma_s,	// precompute the contributions along the first two dimensions
-          xf * (1.0f - yf) * 100.0f / sigma_s,
-          (1.0f - xf) * yf * 100.0f / sigma_s,
-          xf * yf * 100.0f / sigma_s
-        };
+          size_t index = 4 * ((size_t)j * b->width + i);
+          float xf, zf;
+          const float L = in[index];
+          // nearest neighbour splatting:
+          const size_t grid_index = base + image_to_relgrid(b, i, L, &xf, &zf);
+          // sum up payload here
+          const float contrib[4] =
+          {
+            (1.0f - xf) * (1.0f - yf) * 100.0f / sigma_s,	// precompute the contributions along the first two dimensions
+            xf * (1.0f - yf) * 100.0f / sigma_s,
+            (1.0f - xf) * yf * 100.0f / sigma_s,
+            xf * yf * 100.0f / sigma_s
+          };
 #ifdef _OPENMP
 #pragma omp simd aligned(buf:64)
 #endif
-        for(int k = 0; k < 4; k++)
-        {
-          buf[grid_index + offsets[k]] += (contrib[k] * (1.0f - zf));
-          buf[grid_index + offsets[k+4]] += (contrib[k] * zf);
+          for(int k = 0; k < 4; k++)
+          {
+            buf[grid_index + offsets[k]] += (contrib[k] * (1.0f - zf));
+            buf[grid_index + offsets[k+4]] += (contrib[k] * zf);
+          }
         }
       }
     }
   }
-
-  // merge the per-thread results into the final result
-  for (int slice = 1 ; slice < nthreads; slice++)
-  {
-    // compute the first row of the final grid which this slice splats
-    const int destrow = (int)(slice * b->sliceheight / b->sigma_s);
-    float *dest = buf + destrow * oy;
-    // now iterate over the grid rows splatted for this slice
-    for(int j = slice * b->slicerows; j < (slice+1)*b->slicerows; j++)
-    {
-      float *src = buf + j * oy;
-      for(int i = 0; i < oy; i++)
-      {
-        dest[i] += src[i];
-      }
-      dest += oy;
-      // clear elements in the part of the buffer which holds the final result now that we've read the partial result,
-      // since we'll be adding to those locations later
-      if (j < b->size_y)
-        memset(buf + j*oy, '\0', sizeof(float) * oy);
-    }
-  }
+  free(first_x);
+  free(first_y);
 }
 
-#ifdef _OPENMP
-#pragma omp declare simd aligned(buf:64)
-#endif
-static void blur_line_z(float *buf, const int offset1, const int offset2, const int offset3, const int size1,
-                        const int size2, const int size3)
+// the grid is at most this deep along z, see dt_bilateral_grid_size()
+#define DT_COMMON_BILATERAL_MAX_Z (DT_COMMON_BILATERAL_MAX_RES_R + 2)
+
+// derivative of the gaussian along z, which is the contiguous axis: blur a zero padded copy of each line.
+static void blur_line_z(float *buf, const int offset1, const int offset2, const int size1, const int size2,
+                        const int size3)
 {
   const float w1 = 4.f / 16.f;
   const float w2 = 2.f / 16.f;
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(size1, size2, size3, offset1, offset2, offset3, w1, w2) \
-    shared(buf)
+  dt_omp_firstprivate(size1, size2, size3, offset1, offset2, w1, w2) \
+    shared(buf) collapse(2)
 #endif
   for(int k = 0; k < size1; k++)
   {
-    size_t index = (size_t)k * offset1;
     for(int j = 0; j < size2; j++)
     {
-      float tmp1 = buf[index];
-      buf[index] = w1 * buf[index + offset3] + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      float tmp2 = buf[index];
-      buf[index] = w1 * (buf[index + offset3] - tmp1) + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      for(int i = 2; i < size3 - 2; i++)
-      {
-        const float tmp3 = buf[index];
-        buf[index] = +w1 * (buf[index + offset3] - tmp2) + w2 * (buf[index + 2 * offset3] - tmp1);
-        index += offset3;
-        tmp1 = tmp2;
-        tmp2 = tmp3;
-      }
-      const float tmp3 = buf[index];
-      buf[index] = w1 * (buf[index + offset3] - tmp2) - w2 * tmp1;
-      index += offset3;
-      buf[index] = -w1 * tmp3 - w2 * tmp2;
-      index += offset3;
-      index += offset2 - offset3 * size3;
+      float *const line = buf + (size_t)k * offset1 + (size_t)j * offset2;
+      float tmp[DT_COMMON_BILATERAL_MAX_Z + 4] = { 0.0f };
+      memcpy(tmp + 2, line, sizeof(float) * size3);
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int i = 0; i < size3; i++)
+        line[i] = w1 * (tmp[i + 3] - tmp[i + 1]) + w2 * (tmp[i + 4] - tmp[i]);
     }
   }
 }
 
-#ifdef _OPENMP
-#pragma omp declare simd aligned(buf:64)
-#endif
-static void blur_line(float *buf, const int offset1, const int offset2, const int offset3, const int size1,
-                      const int size2, const int size3)
+// gaussian along x or y. the size1 lines starting at consecutive floats (offset1 = 1) are blurred together in
+// chunks, so the inner loop runs along the contiguous axis and vectorizes. the two previous entries of the
+// lines are kept unblurred for the next ones.
+#define DT_COMMON_BILATERAL_CHUNK 256
+static void blur_line(float *buf, const int offset2, const int offset3, const int size1, const int size2,
+                      const int size3)
 {
   const float w0 = 6.f / 16.f;
   const float w1 = 4.f / 16.f;
   const float w2 = 1.f / 16.f;
+  const int chunks = (size1 + DT_COMMON_BILATERAL_CHUNK - 1) / DT_COMMON_BILATERAL_CHUNK;
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(size1, size2, size3, offset1, offset2, offset3, w0, w1, w2) \
-    shared(buf)
+  dt_omp_firstprivate(size1, size2, size3, offset2, offset3, w0, w1, w2, chunks) \
+    shared(buf) collapse(2)
 #endif
-  for(int k = 0; k < size1; k++)
+  for(int j = 0; j < size2; j++)
   {
-    size_t index = (size_t)k * offset1;
-    for(int j = 0; j < size2; j++)
+    for(int c = 0; c < chunks; c++)
     {
-      float tmp1 = buf[index];
-      buf[index] = buf[index] * w0 + w1 * buf[index + offset3] + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      float tmp2 = buf[index];
-      buf[index] = buf[index] * w0 + w1 * (buf[index + offset3] + tmp1) + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      for(int i = 2; i < size3 - 2; i++)
+      const int k0 = c * DT_COMMON_BILATERAL_CHUNK;
+      const int n = MIN(DT_COMMON_BILATERAL_CHUNK, size1 - k0);
+      const float zero[DT_COMMON_BILATERAL_CHUNK] = { 0.0f };
+      float prev[2][DT_COMMON_BILATERAL_CHUNK] = { { 0.0f } };
+      float *tmp1 = prev[0], *tmp2 = prev[1];
+      for(int i = 0; i < size3; i++)
       {
-        const float tmp3 = buf[index];
-        buf[index]
-            = buf[index] * w0 + w1 * (buf[index + offset3] + tmp2) + w2 * (buf[index + 2 * offset3] + tmp1);
-        index += offset3;
+        float *const line = buf + (size_t)j * offset2 + (size_t)i * offset3 + k0;
+        const float *const next1 = i + 1 < size3 ? line + offset3 : zero;
+        const float *const next2 = i + 2 < size3 ? line + 2 * offset3 : zero;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+        for(int k = 0; k < n; k++)
+        {
+          const float tmp3 = line[k];
+          line[k] = line[k] * w0 + w1 * (next1[k] + tmp2[k]) + w2 * (next2[k] + tmp1[k]);
+          tmp1[k] = tmp3;
+        }
+        float *const t = tmp1;
         tmp1 = tmp2;
-        tmp2 = tmp3;
+        tmp2 = t;
       }
-      const float tmp3 = buf[index];
-      buf[index] = buf[index] * w0 + w1 * (buf[index + offset3] + tmp2) + w2 * tmp1;
-      index += offset3;
-      buf[index] = buf[index] * w0 + w1 * tmp3 + w2 * tmp2;
-      index += offset3;
-      index += offset2 - offset3 * size3;
     }
   }
 }
+#undef DT_COMMON_BILATERAL_CHUNK
 
 
 void dt_bilateral_blur(const dt_bilateral_t *b)
@@ -350,15 +355,16 @@ void dt_bilateral_blur(const dt_bilateral_t *b)
     return;
   const int ox = b->size_z;
   const int oy = b->size_x * b->size_z;
-  const int oz = 1;
-  // gaussian up to 3 sigma
-  blur_line(b->buf, oz, oy, ox, b->size_z, b->size_y, b->size_x);
-  // gaussian up to 3 sigma
-  blur_line(b->buf, oz, ox, oy, b->size_z, b->size_x, b->size_y);
+  // gaussian up to 3 sigma, along x for each slice of constant y
+  blur_line(b->buf, oy, ox, b->size_z, b->size_y, b->size_x);
+  // gaussian up to 3 sigma, along y for all x and z at once
+  blur_line(b->buf, 0, oy, oy, 1, b->size_y);
   // -2 derivative of the gaussian up to 3 sigma: x*exp(-x*x)
-  blur_line_z(b->buf, ox, oy, oz, b->size_x, b->size_y, b->size_z);
+  blur_line_z(b->buf, ox, oy, b->size_x, b->size_y, b->size_z);
 }
 
+#undef DT_COMMON_BILATERAL_MAX_Z
+
 
 #ifdef _OPENMP
 #pragma omp declare simd aligned(out, in :64)
@@ -19,870 +19,409 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
-#include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "common/box_filters.h"
 #include "common/darktable.h"
-#include "develop/imageop.h"
-#include "develop/imageop_math.h"
-#if defined(__SSE__)
-#include <xmmintrin.h>
-#endif
+#include "common/dispatch.h"
+
+// all filters run on lines of samples with BOX_LANES floats each, which are processed side by side so that the
+// innermost loops vectorize: the horizontal pass interleaves the pixels of BOX_LANES/ch rows, the vertical pass
+// takes blocks of columns one cache line wide.  with more than BOX_LANES channels, a sample is one pixel.
+#define BOX_LANES 16
 
-static void blur_horizontal_1ch(float *const restrict buf, const int height, const int width, const int radius,
-                                float *const restrict scanlines)
+// compensated addition of `add' to the running sum
+static inline void kahan_add(float *const restrict sum, float *const restrict comp, const float add)
 {
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(radius, height, width) \
-  dt_omp_sharedconst(buf, scanlines) \
-  schedule(static)
-#endif
-  for(int y = 0; y < height; y++)
-  {
-    float L = 0;
-    int hits = 0;
-    const size_t index = (size_t)y * width;
-    float *const restrict scanline = scanlines + dt_get_thread_num() * width;
-    // add up the left half of the window
-    for (int x = 0; x < radius && x < width ; x++)
-    {
-      L += buf[index+x];
-      hits++;
-    }
-    // process the blur up to the point where we start removing values
-    int x;
-    for (x = 0; x <= radius && x < width; x++)
-    {
-      const int np = x + radius;
-      if(np < width)
-      {
-        L += buf[index + np];
-        hits++;
-      }
-      scanline[x] = L / hits;
-    }
-    // process the blur for the bulk of the scan line
-    for(; x + radius < width; x++)
-    {
-      const int op = x - radius - 1;
-      const int np = x + radius;
-      L -= buf[index + op];
-      L += buf[index + np];
-      scanline[x] = L / hits;
-    }
-    // process the right end where we have no more values to add to the running sum
-    for(; x < width; x++)
-    {
-      const int op = x - radius - 1;
-      L -= buf[index + op];
-      hits--;
-      scanline[x] = L / hits;
-    }
-    // copy blurred values back to original location in buffer
-    for(x = 0; x < width; x++)
-      buf[index + x] = scanline[x];
-  }
-  return;
+  const float t1 = add - *comp;
+  const float t2 = *sum + t1;
+  *comp = (t2 - *sum) - t1;
+  *sum = t2;
 }
 
-static void blur_horizontal_2ch(float *const restrict buf, const int height, const int width, const int radius,
-                                float *const restrict scanlines)
+// moving average over a window of 2*radius+1 samples along a line of N samples.  input x holds the `lanes'
+// floats of each sample contiguously, output y has the samples y_stride floats apart.
+static inline __attribute__((always_inline)) void
+box_mean_line(const float *const restrict x, float *const restrict y, const size_t y_stride, const int N,
+              const int lanes, const int radius, float *const restrict sum)
 {
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(radius, height, width) \
-  dt_omp_sharedconst(buf, scanlines) \
-  schedule(static)
-#endif
-  for(int y = 0; y < height; y++)
+  for(int j = 0; j < lanes; j++) sum[j] = 0.0f;
+  int hits = 0;
+  // add up the leading half of the window
+  for(int i = 0; i < radius && i < N; i++)
   {
-    float *const restrict scanline = scanlines + 2 * dt_get_thread_num() * width;
-    float L1 = 0.0f, L2 = 0.0f;
-    int hits = 0;
-    const size_t index = (size_t)2 * y * width;
-    // add up the left half of the window
-    for (int x = 0; x < radius && x < width ; x++)
-    {
-      hits++;
-      L1 += buf[index + 2*x];
-      L2 += buf[index + 2*x + 1];
-    }
-    // process the blur up to the point where we start removing values
-    int x;
-    for (x = 0; x <= radius && x < width; x++)
-    {
-      const int np = x + radius;
-      if(np < width)
-      {
-        hits++;
-        L1 += buf[index + 2*np];
-        L2 += buf[index + 2*np + 1];
-      }
-      scanline[2*x] = L1 / hits;
-      scanline[2*x+1] = L2 / hits;
-    }
-    // process the blur for the bulk of the scan line
-    for(; x + radius < width; x++)
-    {
-      const int op = x - radius - 1;
-      const int np = x + radius;
-      L1 = L1 - buf[index + 2*op] + buf[index + 2*np];
-      L2 = L2 - buf[index + 2*op + 1] + buf[index + 2*np + 1];
-      scanline[2*x] = L1 / hits;
-      scanline[2*x+1] = L2 / hits;
-    }
-    // process the right end where we have no more values to add to the running sum
-    for(; x < width; x++)
-    {
-      const int op = x - radius - 1;
-      hits--;
-      L1 -= buf[index + 2*op];
-      L2 -= buf[index + 2*op + 1];
-      scanline[2*x] = L1 / hits;
-      scanline[2*x+1] = L2 / hits;
-    }
-    // copy blurred values back to original location in buffer
-    for(x = 0; x < 2*width; x++)
-    {
-      buf[index + x] = scanline[x];
-    }
+    for(int j = 0; j < lanes; j++) sum[j] += x[(size_t)i * lanes + j];
+    hits++;
   }
-  return;
-}
-
-static void blur_horizontal_4ch(float *const restrict buf, const int height, const int width, const int radius,
-                                float *const restrict scanlines)
-{
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(radius, height, width) \
-  dt_omp_sharedconst(buf, scanlines) \
-  schedule(static)
-#endif
-  for(int y = 0; y < height; y++)
+  for(int i = 0; i < N; i++)
   {
-    float *const restrict scanline = scanlines + 4 * dt_get_thread_num() * width;
-    float DT_ALIGNED_PIXEL L[4] = { 0, 0, 0, 0 };
-    int hits = 0;
-    const size_t index = (size_t)4 * y * width;
-    // add up the left half of the window
-    for (int x = 0; x < radius && x < width ; x++)
-    {
-      hits++;
-#ifdef _OPENMP
-#pragma omp simd aligned(buf)
-#endif
-      for (int c = 0; c < 4; c++)
-        L[c] += buf[index+4*x + c];
-    }
-    // process the blur up to the point where we start removing values
-    int x;
-    for (x = 0; x <= radius && x < width; x++)
-    {
-      const int np = x + radius;
-      if(np < width)
-      {
-        hits++;
-#ifdef _OPENMP
-#pragma omp simd aligned(buf)
-#endif
-        for (int c = 0; c < 4; c++)
-          L[c] += buf[index + 4*np + c];
-      }
-#ifdef _OPENMP
-#pragma omp simd aligned(scanline)
-#endif
-      for (int c = 0; c < 4; c++)
-        scanline[4*x + c] = L[c] / hits;
-    }
-    // process the blur for the bulk of the scan line
-    for(; x + radius < width; x++)
-    {
-      const int op = x - radius - 1;
-      const int np = x + radius;
-#ifdef _OPENMP
-#pragma omp simd aligned(buf, scanline)
-#endif
-      for (int c = 0; c < 4; c++)
-      {
-        L[c] -= buf[index + 4*op + c];
-        L[c] += buf[index + 4*np + c];
-        scanline[4*x + c] = L[c] / hits;
-      }
-    }
-    // process the right end where we have no more values to add to the running sum
-    for(; x < width; x++)
+    const int op = i - radius - 1;
+    const int np = i + radius;
+    // remove the sample leaving the window, then add the one entering it
+    if(op >= 0)
     {
-      const int op = x - radius - 1;
+      for(int j = 0; j < lanes; j++) sum[j] -= x[(size_t)op * lanes + j];
       hits--;
-#ifdef _OPENMP
-#pragma omp simd aligned(buf, scanline)
-#endif
-      for (int c = 0; c < 4; c++)
-      {
-        L[c] -= buf[index + 4*op + c];
-        scanline[4*x + c] = L[c] / hits;
-      }
     }
-    // copy blurred values back to original location in buffer
-    for(x = 0; x < width; x++)
+    if(np < N)
     {
-#ifdef _OPENMP
-#pragma omp simd aligned(buf, scanline)
-#endif
-      for (int c = 0; c < 4; c++)
-        buf[index + 4*x + c] = scanline[4*x + c];
+      for(int j = 0; j < lanes; j++) sum[j] += x[(size_t)np * lanes + j];
+      hits++;
     }
+    for(int j = 0; j < lanes; j++) y[i * y_stride + j] = sum[j] / hits;
   }
-  return;
 }
 
-#ifdef __SSE2__
-static void blur_vertical_1ch_sse(float *const restrict buf, const int height, const int width, const int radius,
-                                  float *const restrict scanline)
+// as box_mean_line(), but with Kahan summation to avoid the loss of precision of a running sum of large values
+static inline __attribute__((always_inline)) void
+box_mean_kahan_line(const float *const restrict x, float *const restrict y, const size_t y_stride, const int N,
+                    const int lanes, const int radius, float *const restrict sum, float *const restrict comp)
 {
-  __m128 L = { 0, 0, 0, 0 };
-  __m128 hits = { 0, 0, 0, 0 };
-  const __m128 one = { 1.0f, 1.0f, 1.0f, 1.0f };
-  // add up the top half of the window
-  for (size_t y = 0; y < radius && y < height; y++)
+  for(int j = 0; j < lanes; j++) sum[j] = comp[j] = 0.0f;
+  float n_box = 0.0f;
+  for(int i = 0; i <= radius && i < N; i++)
   {
-    size_t index = y * width;
-    L += _mm_loadu_ps(buf + index);	// use unaligned load since width is not necessarily a multiple of 4
-    hits += one;
+    for(int j = 0; j < lanes; j++) kahan_add(sum + j, comp + j, x[(size_t)i * lanes + j]);
+    n_box++;
   }
-  // process the blur up to the point where we start removing values
-  for (size_t y = 0; y <= radius && y < height; y++)
+  for(int i = 0; i < N; i++)
   {
-    const int np = y + radius;
-    if(np < height)
+    for(int j = 0; j < lanes; j++) y[i * y_stride + j] = sum[j] / n_box;
+    const int np = i + radius + 1;
+    const int op = i - radius;
+    // add the sample entering the window, then remove the one leaving it
+    if(np < N)
     {
-      L += _mm_loadu_ps(buf+np*width);
-      hits += one;
+      for(int j = 0; j < lanes; j++) kahan_add(sum + j, comp + j, x[(size_t)np * lanes + j]);
+      n_box++;
     }
-    _mm_store_ps(scanline+4*y, L / hits);
-  }
-  // process the blur for the rest of the scan line
-  for (size_t y = radius+1 ; y < height; y++)
-  {
-    const int op = y - radius - 1;
-    const int np = y + radius;
-    L -= _mm_loadu_ps(buf+op*width);
-    hits -= one;
-    if(np < height)
+    if(op >= 0)
     {
-      L += _mm_loadu_ps(buf+np*width);
-      hits += one;
+      for(int j = 0; j < lanes; j++) kahan_add(sum + j, comp + j, -x[(size_t)op * lanes + j]);
+      n_box--;
     }
-    _mm_store_ps(scanline+4*y, L / hits);
   }
-
-  // copy blurred values back to original location in buffer
-  for (size_t y = 0; y < height; y++)
-  {
-    // use unaligned store since width is not necessarily a multiple of four
-    // use the faster aligned load since we've ensured that scanline is aligned
-    _mm_storeu_ps(buf + y*width, _mm_load_ps(scanline + 4*y));
-  }
-  return;
 }
-#endif /* __SSE2__ */
 
-#ifdef __SSE2__
-static void blur_vertical_4ch_sse(float *const restrict buf, const int height, const int width, const int radius,
-                                  __m128 *const restrict scanline)
+static inline __attribute__((always_inline)) float box_pick(const float a, const float b, const int want_max)
 {
-  __m128 L[4] = { _mm_set1_ps(0), _mm_set1_ps(0), _mm_set1_ps(0), _mm_set1_ps(0) };
-  __m128 hits = _mm_set1_ps(0);
-  const __m128 one = { 1.0f, 1.0f, 1.0f, 1.0f };
-  // add up the top half of the window
-  for (size_t y = 0; y < radius && y < height; y++)
-  {
-    size_t index = y * width;
-    for (int c = 0; c < 4; c++)
-      L[c] += _mm_loadu_ps(buf + 4 * (index + c)); // use unaligned load since width is not necessarily a multiple of 4
-    hits += one;
-  }
-  // process the blur up to the point where we start removing values
-  for (size_t y = 0; y <= radius && y < height; y++)
-  {
-    const int np = y + radius;
-    if(np < height)
-    {
-      for (int c = 0; c < 4; c++)
-        L[c] += _mm_loadu_ps(buf + 4 * (np*width + c));
-      hits += one;
-    }
-    for (int c = 0; c < 4; c++)
-      scanline[4*y+c] = L[c] / hits;
-  }
-  // process the blur for the rest of the scan line
-  for (size_t y = radius+1 ; y < height; y++)
-  {
-    const int op = y - radius - 1;
-    const int np = y + radius;
-    for (int c = 0; c < 4; c++)
-      L[c] -= _mm_loadu_ps(buf + 4 * (op*width + c));
-    hits -= one;
-    if(np < height)
-    {
-      for (int c = 0; c < 4; c++)
-        L[c] += _mm_loadu_ps(buf + 4 * (np*width + c));
-      hits += one;
-    }
-    for (int c = 0; c < 4; c++)
-      scanline[4*y+c] = L[c] / hits;
-  }
-
-  // copy blurred values back to original location in buffer
-  for (size_t y = 0; y < height; y++)
-  {
-    // use unaligned store since width is not necessarily a multiple of four
-    // use the faster aligned load since we've ensured that scanline is aligned
-    for (int c = 0; c < 4; c++)
-      _mm_storeu_ps(buf + 4 * (y*width+c), scanline[4*y+c]);
-  }
-  return;
+  return want_max ? MAX(a, b) : MIN(a, b);
 }
-#endif /* __SSE2__ */
 
-// invoked inside an OpenMP parallel for, so no need to parallelize
-static void blur_vertical_4wide(float *const restrict buf, const int height, const int width, const int radius,
-                                float *const restrict scanline)
+// moving minimum or maximum over a window of k = 2*radius+1 samples along a line of N samples, using the
+// algorithm of van Herk and Gil-Werman: the line, padded with `radius' neutral samples on both ends, is cut
+// into blocks of k samples.  each window covers the tail of one block and the head of the next, so its extremum
+// is that of the suffix of the former and of the prefix of the latter.  this needs three comparisons per sample
+// regardless of the radius.  `suffix' holds k samples, `prefix' and `neutral' one.
+static inline __attribute__((always_inline)) void
+box_minmax_line(const float *const restrict x, float *const restrict y, const size_t y_stride, const int N,
+                const int lanes, const int radius, const int want_max, float *const restrict suffix,
+                float *const restrict prefix, const float *const restrict neutral)
 {
-#ifdef __SSE2__
-  if (darktable.codepath.SSE2)
-  {
-    blur_vertical_1ch_sse(buf, height, width, radius, scanline);
-    return;
-  }
-#endif /* __SSE2__ */
-
-  float DT_ALIGNED_PIXEL L[4] = { 0, 0, 0, 0 };
-  int hits = 0;
-  // add up the left half of the window
-  for (size_t y = 0; y < radius && y < height; y++)
-  {
-    size_t index = y * width;
-    hits++;
-#ifdef _OPENMP
-#pragma omp simd aligned(buf : 16)
-#endif
-    for (int c = 0; c < 4; c++)
-    {
-      L[c] += buf[index+c];
-    }
-  }
-  // process the blur up to the point where we start removing values
-  for (size_t y = 0; y <= radius && y < height; y++)
-  {
-    const int np = y + radius;
-    const int npoffset = np * width;
-    if(np < height)
-    {
-      hits++;
-#ifdef _OPENMP
-#pragma omp simd aligned(buf : 16)
-#endif
-      for (int c = 0; c < 4; c++)
-        L[c] += buf[npoffset+c];
-    }
-#ifdef _OPENMP
-#pragma omp simd aligned(scanline : 16)
-#endif
-    for (int c = 0; c < 4; c++)
-    {
-      scanline[4*y + c] = L[c] / hits;
-    }
-  }
-  // process the blur for the rest of the scan line
-  for (size_t y = radius+1; y < height; y++)
-  {
-    const int op = y - radius - 1;
-    const int np = y + radius;
-    const int opoffset = op * width;
-    const int npoffset = np * width;
-    if(op >= 0)
-    {
-      hits--;
-#ifdef _OPENMP
-#pragma omp simd aligned(buf : 16)
-#endif
-      for (int c = 0; c < 4; c++)
-        L[c] -= buf[opoffset + c];
-    }
-    if(np < height)
-    {
-      hits++;
-#ifdef _OPENMP
-#pragma omp simd aligned(buf : 16)
-#endif
-      for (int c = 0; c < 4; c++)
-        L[c] += buf[npoffset + c];
+  const int k = 2 * radius + 1;
+  for(int start = 0; start < N; start += k)
+  {
+    // suffix extrema of the block starting at padded sample `start', which is the window of output `start'
+    for(int t = k - 1; t >= 0; t--)
+    {
+      const int i = start + t - radius;
+      const float *const px = (i >= 0 && i < N) ? x + (size_t)i * lanes : neutral;
+      if(t == k - 1)
+        for(int j = 0; j < lanes; j++) suffix[(size_t)t * lanes + j] = px[j];
+      else
+        for(int j = 0; j < lanes; j++)
+          suffix[(size_t)t * lanes + j] = box_pick(px[j], suffix[(size_t)(t + 1) * lanes + j], want_max);
+    }
+    for(int j = 0; j < lanes; j++) y[start * y_stride + j] = suffix[j];
+    // the following windows combine the rest of the suffix with a growing prefix of the next block
+    for(int j = 0; j < lanes; j++) prefix[j] = neutral[j];
+    for(int t = 1; t < k && start + t < N; t++)
+    {
+      const int i = start + k + t - 1 - radius;
+      const float *const px = i < N ? x + (size_t)i * lanes : neutral;
+      for(int j = 0; j < lanes; j++)
+      {
+        prefix[j] = box_pick(prefix[j], px[j], want_max);
+        y[(start + t) * y_stride + j] = box_pick(suffix[(size_t)t * lanes + j], prefix[j], want_max);
+      }
     }
-#ifdef _OPENMP
-#pragma omp simd aligned(scanline : 16)
-#endif
-    for (int c = 0; c < 4; c++)
-      scanline[4*y + c] = L[c] / hits;
-  }
-
-  // copy blurred values back to original location in buffer
-  for (size_t y = 0; y < height; y++)
-  {
-#ifdef _OPENMP
-#pragma omp simd aligned(buf, scanline : 16)
-#endif
-    for (int c = 0; c < 4; c++)
-      buf[y * width + c] = scanline[4*y + c];
   }
-  return;
 }
 
-static void blur_vertical_1ch(float *const restrict buf, const int height, const int width, const int radius,
-                              float *const restrict scanlines)
+// per-thread work space of a line filter besides the line itself: running sums and compensations, the neutral
+// element and prefix for min/max, and the block suffix for min/max
+static size_t box_work_size(const int radius, const int ch)
 {
-  /* vertical pass on L channel */
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(radius, height, width) \
-  dt_omp_sharedconst(buf, scanlines) \
-  schedule(static)
-#endif
-  for(int x = 0; x < (width & ~3); x += 4)
-  {
-    float *const restrict scanline = scanlines + 4 * dt_get_thread_num() * height;
-    blur_vertical_4wide(buf + x, height, width, radius, scanline);
-  }
-  const int opoffs = -(radius + 1) * width;
-  const int npoffs = radius*width;
-  for(int x = width & ~3; x < width; x++)
-  {
-    float L = 0.0f;
-    int hits = 0;
-    size_t index = (size_t)x - radius * width;
-    float *const restrict scanline = scanlines;
-    for(int y = -radius; y < height; y++)
-    {
-      const int op = y - radius - 1;
-      const int np = y + radius;
-      if(op >= 0)
-      {
-        L -= buf[index + opoffs];
-        hits--;
-      }
-      if(np < height)
-      {
-        L += buf[index + npoffs];
-        hits++;
-      }
-      if(y >= 0) scanline[y] = L / hits;
-      index += width;
-    }
+  const size_t lanes = MAX(BOX_LANES, ch);
+  return lanes * (2 * radius + 5);
+}
 
-    for(int y = 0; y < height; y++)
-      buf[(size_t)y * width + x] = scanline[y];
+static inline __attribute__((always_inline)) void
+box_filter_line_lanes(const float *const restrict x, float *const restrict y, const size_t y_stride, const int N,
+                      const int lanes, const int radius, const dt_box_filter_t filter, float *const restrict work)
+{
+  const size_t max_lanes = MAX(BOX_LANES, lanes);
+  float *const restrict sum = work;
+  float *const restrict comp = work + max_lanes;
+  float *const restrict neutral = work + 2 * max_lanes;
+  float *const restrict prefix = work + 3 * max_lanes;
+  float *const restrict suffix = work + 4 * max_lanes;
+  switch(filter)
+  {
+    case DT_BOX_MEAN:
+      box_mean_line(x, y, y_stride, N, lanes, radius, sum);
+      break;
+    case DT_BOX_MEAN_KAHAN:
+      box_mean_kahan_line(x, y, y_stride, N, lanes, radius, sum, comp);
+      break;
+    case DT_BOX_MIN:
+      for(int j = 0; j < lanes; j++) neutral[j] = INFINITY;
+      box_minmax_line(x, y, y_stride, N, lanes, radius, FALSE, suffix, prefix, neutral);
+      break;
+    case DT_BOX_MAX:
+      for(int j = 0; j < lanes; j++) neutral[j] = -INFINITY;
+      box_minmax_line(x, y, y_stride, N, lanes, radius, TRUE, suffix, prefix, neutral);
+      break;
   }
-  return;
 }
 
-static void dt_box_mean_1ch(float *const buf, const int height, const int width, const int radius,
-                            const int iterations)
+static inline __attribute__((always_inline)) void
+box_filter_line(const float *const restrict x, float *const restrict y, const size_t y_stride, const int N,
+                const int lanes, const int radius, const dt_box_filter_t filter, float *const restrict work)
 {
-  const int size = MAX(width,height);
-  float *const restrict scanlines = dt_alloc_align_float(dt_get_num_threads() * size * 4);
-
-  for(int iteration = 0; iteration < iterations; iteration++)
-  {
-    blur_horizontal_1ch(buf, height, width, radius, scanlines);
-    blur_vertical_1ch(buf, height, width, radius, scanlines);
-  }
+  // let the compiler fully unroll the lane loops for the common case of full-width samples
+  if(lanes == BOX_LANES)
+    box_filter_line_lanes(x, y, y_stride, N, BOX_LANES, radius, filter, work);
+  else
+    box_filter_line_lanes(x, y, y_stride, N, lanes, radius, filter, work);
+}
 
-  dt_free_align(scanlines);
+// copy `rows' rows of `in' starting at `row0' into a line whose samples hold the same column of every row
+static inline __attribute__((always_inline)) void
+box_gather_rows(const float *const restrict in, float *const restrict line, const int row0, const int rows,
+                const int width, const int ch)
+{
+  const int lanes = rows * ch;
+  const float *const restrict src = in + (size_t)row0 * width * ch;
+  for(int col = 0; col < width; col++)
+    for(int r = 0; r < rows; r++)
+      for(int c = 0; c < ch; c++)
+        line[(size_t)col * lanes + r * ch + c] = src[((size_t)r * width + col) * ch + c];
 }
 
-static void dt_box_mean_4ch(float *const buf, const int height, const int width, const int radius,
-                            const int iterations)
+// the reverse of box_gather_rows()
+static inline __attribute__((always_inline)) void
+box_scatter_rows(const float *const restrict line, float *const restrict out, const int row0, const int rows,
+                 const int width, const int ch)
 {
-  const int size = MAX(width,height);
-  float *const restrict scanlines = dt_alloc_align_float(dt_get_num_threads() * size * 4);
+  const int lanes = rows * ch;
+  float *const restrict dest = out + (size_t)row0 * width * ch;
+  for(int col = 0; col < width; col++)
+    for(int r = 0; r < rows; r++)
+      for(int c = 0; c < ch; c++)
+        dest[((size_t)r * width + col) * ch + c] = line[(size_t)col * lanes + r * ch + c];
+}
 
-  for(int iteration = 0; iteration < iterations; iteration++)
-  {
-    blur_horizontal_4ch(buf, height, width, radius, scanlines);
+// filter along the rows of `in' into `out' (which may be the same buffer).  groups of rows are transposed into
+// a line whose samples hold the same column of every row in the group, filtered into a second line and
+// transposed back.
+static inline __attribute__((always_inline)) void
+box_filter_rows(const float *const in, float *const out, const int height, const int width, const int ch,
+                const int radius, const dt_box_filter_t filter, float *const scratch, const size_t scratch_size,
+                const size_t line_size)
+{
+  const int group = MAX(1, BOX_LANES / ch);
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(width, height, radius)  \
-  dt_omp_sharedconst(buf, scanlines) \
+  dt_omp_firstprivate(in, out, height, width, ch, radius, filter, scratch, scratch_size, line_size, group) \
   schedule(static)
 #endif
-    for (int col = 0; col < width; col++)
-    {
-      float *const restrict scanline = scanlines + 4 * dt_get_thread_num() * height;
-      // we need to multiply width by 4 to get the correct stride for the vertical blur
-      blur_vertical_4wide(buf + 4 * col, height, 4*width, radius, scanline);
-    }
+  for(int row0 = 0; row0 < height; row0 += group)
+  {
+    const int rows = MIN(group, height - row0);
+    float *const restrict line = scratch + dt_get_thread_num() * scratch_size;
+    float *const restrict result = line + line_size;
+    float *const restrict work = result + line_size;
+    // the transposition costs as much as the filter itself unless the compiler knows the shape of the group
+    if(ch == 1 && rows == BOX_LANES)
+      box_gather_rows(in, line, row0, BOX_LANES, width, 1);
+    else if(ch == 4 && rows == BOX_LANES / 4)
+      box_gather_rows(in, line, row0, BOX_LANES / 4, width, 4);
+    else
+      box_gather_rows(in, line, row0, rows, width, ch);
+    box_filter_line(line, result, rows * ch, width, rows * ch, radius, filter, work);
+    if(ch == 1 && rows == BOX_LANES)
+      box_scatter_rows(result, out, row0, BOX_LANES, width, 1);
+    else if(ch == 4 && rows == BOX_LANES / 4)
+      box_scatter_rows(result, out, row0, BOX_LANES / 4, width, 4);
+    else
+      box_scatter_rows(result, out, row0, rows, width, ch);
   }
-
-  dt_free_align(scanlines);
 }
 
-#ifdef __SSE2__
-static void dt_box_mean_4ch_sse(float *const buf, const int height, const int width, const int radius,
-                                const int iterations)
+// filter along the columns of `buf' in place.  each block of columns is copied into a line and filtered back
+// into the image.
+static inline __attribute__((always_inline)) void
+box_filter_columns(float *const buf, const int height, const int width, const int ch, const int radius,
+                   const dt_box_filter_t filter, float *const scratch, const size_t scratch_size,
+                   const size_t line_size)
 {
-  const int size = MAX(width,height);
-
-  __m128 *const scanline_buf = dt_alloc_align(64, sizeof(__m128) * dt_get_num_threads() * size * 4);
-
-  for(int iteration = 0; iteration < BOX_ITERATIONS; iteration++)
-  {
-    blur_horizontal_4ch(buf, height, width, radius, (float*)scanline_buf);
-
-    /* vertical pass; start by doing four columns of pixels at a time */
+  const int block = MAX(1, BOX_LANES / ch);
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(width, height, radius)  \
-  dt_omp_sharedconst(buf, scanline_buf) \
+  dt_omp_firstprivate(buf, height, width, ch, radius, filter, scratch, scratch_size, line_size, block) \
   schedule(static)
 #endif
-    for (int col = 0; col < (width & ~3); col += 4)
-    {
-      __m128 *const restrict scanline = scanline_buf + 4 * dt_get_thread_num() * height;
-      blur_vertical_4ch_sse(buf + 4 * col, height, width, radius, scanline);
-    }
-    // finish up the leftover 0-3 columns of pixels
-    const int opoffs = -(radius + 1) * width;
-    const int npoffs = (radius)*width;
-    for(int x = (width & ~3); x < width; x++)
-    {
-      __m128 *scanline = scanline_buf + size * dt_get_thread_num();
-      __m128 L = _mm_setzero_ps();
-      int hits = 0;
-      size_t index = (size_t)x - radius * width;
-      for(int y = -radius; y < height; y++)
-      {
-        int op = y - radius - 1;
-        int np = y + radius;
-
-        if(op >= 0)
-        {
-          L = L - _mm_load_ps(&buf[(index + opoffs) * 4]);
-          hits--;
-        }
-        if(np < height)
-        {
-          L = L + _mm_load_ps(&buf[(index + npoffs) * 4]);
-          hits++;
-        }
-        if(y >= 0) scanline[y] = L / _mm_set_ps1(hits);
-        index += width;
-      }
-
-      for(int y = 0; y < height; y++)
-        _mm_store_ps(&buf[((size_t)y * width + x) * 4], scanline[y]);
-    }
-  }
-
-  dt_free_align(scanline_buf);
-}
-#endif /* __SSE2__ */
-
-static inline void box_mean_2ch(float *const restrict in, const size_t height, const size_t width,
-                                const int radius, const int iterations)
-{
-  // Compute in-place a box average (filter) on a multi-channel image over a window of size 2*radius + 1
-  // We make use of the separable nature of the filter kernel to speed-up the computation
-  // by convolving along columns and rows separately (complexity O(2 × radius) instead of O(radius²)).
-
-  const size_t Ndim = MAX(width,height) * 2 * 2;
-  float *const restrict temp = dt_alloc_align_float(Ndim * dt_get_num_threads());
-  if (temp == NULL) return;
-
-  for (int iteration = 0; iteration < iterations; iteration++)
+  for(int col0 = 0; col0 < width; col0 += block)
   {
-    blur_horizontal_2ch(in, height, width, radius, temp);
-    blur_vertical_1ch(in, height, 2*width, radius, temp);
+    const int lanes = MIN(block, width - col0) * ch;
+    float *const restrict line = scratch + dt_get_thread_num() * scratch_size;
+    float *const restrict work = line + 2 * line_size;
+    for(int row = 0; row < height; row++)
+      memcpy(line + (size_t)row * lanes, buf + ((size_t)row * width + col0) * ch, sizeof(float) * lanes);
+    box_filter_line(line, buf + (size_t)col0 * ch, (size_t)width * ch, height, lanes, radius, filter, work);
   }
-  dt_free_align(temp);
 }
 
-void dt_box_mean(float *const buf, const int height, const int width, const int ch,
-                 const int radius, const int iterations)
+static inline __attribute__((always_inline)) void
+box_filter(const float *const in, float *const out, const int height, const int width, const int ch,
+           const int radius, const dt_box_filter_t filter, const int iterations)
 {
-  if (ch == 1)
+  if(iterations < 1)
   {
-    dt_box_mean_1ch(buf,height,width,radius,iterations);
+    if(in != out) memcpy(out, in, sizeof(float) * width * height * ch);
+    return;
   }
-  else if (ch == 4)
+  const size_t line_size = 16 * ((MAX(BOX_LANES, ch) * MAX(width, height) + 15) / 16);
+  const size_t scratch_size = 2 * line_size + 16 * ((box_work_size(radius, ch) + 15) / 16);
+  float *const scratch = dt_alloc_align_float(scratch_size * dt_get_num_threads());
+  if(scratch == NULL)
   {
-#ifdef __SSE__
-    if (darktable.codepath.SSE2)
-    {
-      dt_box_mean_4ch_sse(buf,height,width,radius,iterations);
-    }
-    else
-#endif
-      dt_box_mean_4ch(buf,height,width,radius,iterations);
+    // leave the image unfiltered rather than leaving an out-of-place output uninitialized
+    fprintf(stderr, "[box_filter] unable to allocate %zu bytes of scratch space, image not filtered\n",
+            sizeof(float) * scratch_size * dt_get_num_threads());
+    if(in != out) memcpy(out, in, sizeof(float) * width * height * ch);
+    return;
   }
-  else if (ch == 2) // used by fast_guided_filter.h
+
+  const float *src = in;
+  for(int iteration = 0; iteration < iterations; iteration++)
   {
-    box_mean_2ch(buf,height,width,radius,iterations);
+    box_filter_rows(src, out, height, width, ch, radius, filter, scratch, scratch_size, line_size);
+    box_filter_columns(out, height, width, ch, radius, filter, scratch, scratch_size, line_size);
+    src = out;
   }
+  dt_free_align(scratch);
 }
 
-
-// calculate the one-dimensional moving maximum over a window of size 2*w+1
-// input array x has stride 1, output array y has stride stride_y
-static inline void box_max_1d(int N, const float *const restrict x, float *const restrict y, size_t stride_y, int w)
+static void box_filter_plain(const float *const in, float *const out, const int height, const int width,
+                             const int ch, const int radius, const dt_box_filter_t filter, const int iterations)
 {
-  float m = -(INFINITY);
-  for(int i = 0; i < MIN(w + 1, N); i++)
-    m = MAX(x[i], m);
-  for(int i = 0; i < N; i++)
-  {
-    // store maximum of current window at center position
-    y[i * stride_y] = m;
-    // if the earliest member of the current window is the max, we need to
-    // rescan the window to determine the new maximum
-    if(i - w >= 0 && x[i - w] == m)
-    {
-      m = -(INFINITY);
-      for(int j = i - w + 1; j < MIN(i + w + 2, N); j++)
-        m = MAX(x[j], m);
-    }
-    // if the window has not yet exceeded the end of the row/column, update the maximum value
-    if(i + w + 1 < N)
-      m = MAX(x[i + w + 1], m);
-  }
+  box_filter(in, out, height, width, ch, radius, filter, iterations);
 }
 
-// calculate the one-dimensional moving maximum on four adjacent columns over a window of size 2*w+1
-// input array x has stride 16, output array y has stride stride_y and we will write 16 consecutive elements
-//  every stride_y elements (thus processing a cache line at a time)
-static inline void box_max_vert_16wide(const int N, const float *const restrict x, float *const restrict y,
-                                      const int stride_y, const int w)
+#ifdef DT_HAVE_TARGET_AVX2
+static DT_TARGET_AVX2 void box_filter_avx2(const float *const in, float *const out, const int height,
+                                           const int width, const int ch, const int radius,
+                                           const dt_box_filter_t filter, const int iterations)
 {
-  float DT_ALIGNED_PIXEL m[16] = { -(INFINITY), -(INFINITY), -(INFINITY), -(INFINITY),
-                                  -(INFINITY), -(INFINITY), -(INFINITY), -(INFINITY),
-                                  -(INFINITY), -(INFINITY), -(INFINITY), -(INFINITY),
-                                  -(INFINITY), -(INFINITY), -(INFINITY), -(INFINITY) };
-  for(int i = 0; i < MIN(w + 1, N); i++)
-#ifdef _OPENMP
-#pragma omp simd aligned(m, x)
-#endif
-    for (int c = 0; c < 16; c++)
-      m[c] = MAX(x[16*i + c], m[c]);
-  for(int i = 0; i < N; i++)
-  {
-    // store maximum of current window at center position
-#ifdef _OPENMP
-#pragma omp simd aligned(m, y)
+  box_filter(in, out, height, width, ch, radius, filter, iterations);
+}
 #endif
-    for (int c = 0; c < 16; c++)
-      y[i * stride_y + c] = m[c];
-    // If the earliest member of the current window is the max, we need to
-    // rescan the window to determine the new maximum
-    if (i >= w)
-    {
-#ifdef _OPENMP
-#pragma omp simd aligned(m, x)
+
+typedef void (*box_filter_fn_t)(const float *const in, float *const out, const int height, const int width,
+                                const int ch, const int radius, const dt_box_filter_t filter,
+                                const int iterations);
+
+static size_t box_filter_bench(const void *variant, float **out);
+
+static dt_dispatch_kernel_t box_filter_kernel = {
+  .name = "box filter",
+  .variants = { [DT_ISA_SCALAR] = box_filter_plain,
+#ifdef DT_HAVE_TARGET_AVX2
+                [DT_ISA_AVX2] = box_filter_avx2,
 #endif
-      for (int c = 0; c < 16; c++)
+              },
+  .bench = box_filter_bench,
+  .selected = box_filter_plain
+};
+
+// a synthetic 512x256 image with one and four channels, run through each filter at several radii, for
+// darktable-cputest.  the throughput per filter and radius is printed with -d perf.
+static size_t box_filter_bench(const void *variant, float **out)
+{
+  const int width = 512, height = 256;
+  const size_t npixels = (size_t)width * height;
+  const int channels[] = { 1, 4 };
+  const int radii[] = { 1, 4, 16, 64 };
+  const dt_box_filter_t filters[] = { DT_BOX_MEAN, DT_BOX_MEAN_KAHAN, DT_BOX_MIN, DT_BOX_MAX };
+  const char *const filter_names[] = { "mean", "kahan mean", "min", "max" };
+  const int nradii = sizeof(radii) / sizeof(radii[0]);
+  const int nfilters = sizeof(filters) / sizeof(filters[0]);
+
+  const char *isa_name = "unknown";
+  for(int isa = 0; isa < DT_ISA_LAST; isa++)
+    if(box_filter_kernel.variants[isa] == variant) isa_name = dt_isa_name(isa);
+
+  float *const in = dt_alloc_align_float(4 * npixels);
+  *out = dt_alloc_align_float(npixels * (1 + 4) * nradii * nfilters);
+  for(size_t k = 0; k < 4 * npixels; k++)
+  {
+    const size_t row = k / (4 * width), col = (k / 4) % width;
+    in[k] = 0.5f + 0.4f * sinf(0.021f * col + 1.3f * (k % 4)) * cosf(0.017f * row - 0.005f * col);
+  }
+
+  // the one-channel runs read the first quarter of the four-channel input as a single channel
+  float *res = *out;
+  for(int c = 0; c < 2; c++)
+    for(int f = 0; f < nfilters; f++)
+      for(int r = 0; r < nradii; r++)
       {
-//        if(x[16 * (i - w) + c] == m[c]) //prevents vectorization
-        {
-          m[c] = -(INFINITY);
-          for(int j = i - w + 1; j < MIN(i + w + 2, N); j++)
-            m[c] = MAX(x[16*j+c], m[c]);
-        }
+        const int ch = channels[c];
+        const double start = dt_get_wtime();
+        ((box_filter_fn_t)variant)(in, res, height, width, ch, radii[r], filters[f], 1);
+        const double elapsed = dt_get_wtime() - start;
+        dt_print(DT_DEBUG_PERF, "[box filter] %s variant, %s, %d channel(s), radius %d: %.1f Mpix/s\n", isa_name,
+                 filter_names[f], ch, radii[r], npixels / fmax(elapsed, 1e-9) * 1e-6);
+        res += npixels * ch;
       }
-    }
-    // if the window has not yet exceeded the end of the row/column, update the maximum value
-    if(i + w + 1 < N)
-    {
-#ifdef _OPENMP
-#pragma omp simd aligned(m, x)
-#endif
-      for (int c = 0; c < 16; c++)
-        m[c] = MAX(x[16 * (i + w + 1) + c], m[c]);
-    }
-  }
+  dt_free_align(in);
+  return npixels * (1 + 4) * nradii * nfilters;
 }
 
-// calculate the two-dimensional moving maximum over a box of size (2*w+1) x (2*w+1)
-// does the calculation in-place if input and output images are identical
-static void box_max_1ch(float *const buf, const int height, const int width, const int w)
+void dt_box_filters_init(void)
 {
-  float *const restrict scratch_buffers = dt_alloc_align_float(dt_get_num_threads() * MAX(width,16*height));
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(w, width, height, buf)    \
-  dt_omp_sharedconst(scratch_buffers) \
-  schedule(static)
-#endif
-  for(size_t row = 0; row < height; row++)
-  {
-    float *const restrict scratch = scratch_buffers + width * dt_get_thread_num();
-    memcpy(scratch, buf + row * width, sizeof(float) * width);
-    box_max_1d(width, scratch, buf + row * width, 1, w);
-  }
-#ifdef _OPENMP
-#pragma omp parallel for default(none)           \
-  dt_omp_firstprivate(w, width, height, buf) \
-  dt_omp_sharedconst(scratch_buffers) \
-  schedule(static)
-#endif
-  for(int col = 0; col < (width & ~15); col += 16)
-  {
-    float *const restrict scratch = scratch_buffers + 16 * height * dt_get_thread_num();
-    for (size_t row = 0; row < height; row++)
-      for (size_t c = 0; c < 16; c++)
-        scratch[16*row+c] = buf[row * width + col + c];
-    box_max_vert_16wide(height, scratch, buf + col, width, w);
-  }
-  for (size_t col = width & ~15 ; col < width; col++)
-  {
-    float *const restrict scratch = scratch_buffers;
-    for(size_t row = 0; row < height; row++)
-      scratch[row] = buf[row * width + col];
-    box_max_1d(height, scratch, buf + col, width, w);
-  }
-  dt_free_align(scratch_buffers);
+  dt_dispatch_register(&box_filter_kernel);
 }
 
-
-// in-place calculate the two-dimensional moving maximum over a box of size (2*radius+1) x (2*radius+1)
-void dt_box_max(float *const buf, const int height, const int width, const int ch, const int radius)
+void dt_box_filters_cleanup(void)
 {
-  if (ch == 1)
-    box_max_1ch(buf, height, width, radius);
-  //TODO: 4ch version if needed
+  dt_dispatch_unregister(&box_filter_kernel);
 }
 
-// calculate the one-dimensional moving minimum over a window of size 2*w+1
-// input array x has stride 1, output array y has stride stride_y
-static inline void box_min_1d(int N, const float *x, float *y, size_t stride_y, int w)
+void dt_box_filter(const float *const in, float *const out, const int height, const int width, const int ch,
+                   const int radius, const dt_box_filter_t filter, const int iterations)
 {
-  float m = INFINITY;
-  for(int i = 0; i < MIN(w + 1, N); i++)
-    m = MIN(x[i], m);
-  for(int i = 0; i < N; i++)
-  {
-    y[i * stride_y] = m;
-    if(i - w >= 0 && x[i - w] == m)
-    {
-      m = INFINITY;
-      for(int j = i - w + 1; j < MIN(i + w + 2, N); j++)
-        m = MIN(x[j], m);
-    }
-    if(i + w + 1 < N)
-      m = MIN(x[i + w + 1], m);
-  }
+  ((box_filter_fn_t)box_filter_kernel.selected)(in, out, height, width, ch, radius, filter, iterations);
 }
 
-// calculate the one-dimensional moving minimum on four adjacent columns over a window of size 2*w+1
-// input array x has stride 16, output array y has stride stride_y and we will write 16 consecutive elements
-//  every stride_y elements (thus processing a cache line at a time)
-static inline void box_min_vert_16wide(const int N, const float *const restrict x, float *const restrict y,
-                                      const int stride_y, const int w)
+void dt_box_mean(float *const buf, const int height, const int width, const int ch,
+                 const int radius, const int iterations)
 {
-  float DT_ALIGNED_PIXEL m[16] = { INFINITY, INFINITY, INFINITY, INFINITY,
-                                   INFINITY, INFINITY, INFINITY, INFINITY,
-                                   INFINITY, INFINITY, INFINITY, INFINITY,
-                                   INFINITY, INFINITY, INFINITY, INFINITY };
-  for(int i = 0; i < MIN(w + 1, N); i++)
-#ifdef _OPENMP
-#pragma omp simd aligned(m, x)
-#endif
-    for (int c = 0; c < 16; c++)
-      m[c] = MIN(x[16*i + c], m[c]);
-  for(int i = 0; i < N; i++)
-  {
-    // store minimum of current window at center position
-#ifdef _OPENMP
-#pragma omp simd aligned(m, y)
-#endif
-    for (int c = 0; c < 16; c++)
-      y[i * stride_y + c] = m[c];
-    // If the earliest member of the current window is the min, we need to
-    // rescan the window to determine the new minimum
-    if (i >= w)
-    {
-#ifdef _OPENMP
-#pragma omp simd aligned(m, x)
-#endif
-      for (int c = 0; c < 16; c++)
-      {
-//        if(x[16 * (i - w) + c] == m[c]) //prevents vectorization
-        {
-          m[c] = INFINITY;
-          for(int j = i - w + 1; j < MIN(i + w + 2, N); j++)
-            m[c] = MIN(x[16*j+c], m[c]);
-        }
-      }
-    }
-    // if the window has not yet exceeded the end of the row/column, update the minimum value
-    if(i + w + 1 < N)
-    {
-#ifdef _OPENMP
-#pragma omp simd aligned(m, x)
-#endif
-      for (int c = 0; c < 16; c++)
-        m[c] = MIN(x[16 * (i + w + 1) + c], m[c]);
-    }
-  }
+  dt_box_filter(buf, buf, height, width, ch, radius, DT_BOX_MEAN, iterations);
 }
 
-
-// calculate the two-dimensional moving minimum over a box of size (2*w+1) x (2*w+1)
-// does the calculation in-place if input and output images are identical
-static void box_min_1ch(float *const buf, const int height, const int width, const int w)
+// in-place calculate the two-dimensional moving maximum over a box of size (2*radius+1) x (2*radius+1)
+void dt_box_max(float *const buf, const int height, const int width, const int ch, const int radius)
 {
-  float *const restrict scratch_buffers = dt_alloc_align_float(dt_get_num_threads() * MAX(width,16*height));
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(w, width, height, buf)    \
-  dt_omp_sharedconst(scratch_buffers) \
-  schedule(static)
-#endif
-  for(size_t row = 0; row < height; row++)
-  {
-    float *const restrict scratch = scratch_buffers + width * dt_get_thread_num();
-    memcpy(scratch, buf + row * width, sizeof(float) * width);
-    box_min_1d(width, scratch, buf + row * width, 1, w);
-  }
-#ifdef _OPENMP
-#pragma omp parallel for default(none)           \
-  dt_omp_firstprivate(w, width, height, buf) \
-  dt_omp_sharedconst(scratch_buffers) \
-  schedule(static)
-#endif
-  for(int col = 0; col < (width & ~15); col += 16)
-  {
-    float *const restrict scratch = scratch_buffers + 16 * height * dt_get_thread_num();
-    for (size_t row = 0; row < height; row++)
-      for (size_t c = 0; c < 16; c++)
-        scratch[16*row+c] = buf[row * width + col + c];
-    box_min_vert_16wide(height, scratch, buf + col, width, w);
-  }
-  for (size_t col = width & ~15 ; col < width; col++)
-  {
-    float *const restrict scratch = scratch_buffers;
-    for(size_t row = 0; row < height; row++)
-      scratch[row] = buf[row * width + col];
-    box_min_1d(height, scratch, buf + col, width, w);
-  }
-
-  dt_free_align(scratch_buffers);
+  dt_box_filter(buf, buf, height, width, ch, radius, DT_BOX_MAX, 1);
 }
 
+// in-place calculate the two-dimensional moving minimum over a box of size (2*radius+1) x (2*radius+1)
 void dt_box_min(float *const buf, const int height, const int width, const int ch, const int radius)
 {
-  if (ch == 1)
-    box_min_1ch(buf, height, width, radius);
-  //TODO: 4ch version if needed
+  dt_box_filter(buf, buf, height, width, ch, radius, DT_BOX_MIN, 1);
 }
+
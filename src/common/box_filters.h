@@ -21,10 +21,29 @@
 // default number of iterations to run for dt_box_mean
 #define BOX_ITERATIONS 8
 
-// ch = number of channels per pixel.  Supported values: 1 and 4
+typedef enum dt_box_filter_t
+{
+  DT_BOX_MEAN = 0,       // running-sum average
+  DT_BOX_MEAN_KAHAN = 1, // running-sum average with compensated summation, for values far from zero
+  DT_BOX_MIN = 2,        // moving minimum (van Herk/Gil-Werman, three comparisons per pixel for any radius)
+  DT_BOX_MAX = 3         // moving maximum (van Herk/Gil-Werman)
+} dt_box_filter_t;
+
+// apply a separable box filter over a window of (2*radius+1) x (2*radius+1) pixels, clipped at the image
+// borders, `iterations' times.  ch = number of channels per pixel, any value >= 1, each channel is filtered
+// independently.  in and out may point to the same buffer.  if the scratch space can't be allocated, the
+// filter is skipped (out gets a copy of in) and an error is printed.
+void dt_box_filter(const float *const in, float *const out, const int height, const int width, const int ch,
+                   const int radius, const dt_box_filter_t filter, const int iterations);
+
+// in-place shorthands for dt_box_filter()
 void dt_box_mean(float *const buf, const int height, const int width, const int ch,
                  const int radius, const int interations);
 
 void dt_box_min(float *const buf, const int height, const int width, const int ch, const int radius);
 void dt_box_max(float *const buf, const int height, const int width, const int ch, const int radius);
 
+// select the fastest variant of the filter engine, called from dt_init() once the codepaths are known
+void dt_box_filters_init(void);
+void dt_box_filters_cleanup(void);
+
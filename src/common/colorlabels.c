@@ -54,6 +54,7 @@ int dt_colorlabels_get_labels(const int imgid)
 
 static void _pop_undo_execute(const int imgid, const uint8_t before, const uint8_t after)
 {
+  dt_database_start_transaction(darktable.db);
   for(int color=0; color<5; color++)
   {
     if(after & (1<<color))
@@ -64,6 +65,7 @@ static void _pop_undo_execute(const int imgid, const uint8_t before, const uint8
     else if (before & (1<<color))
       dt_colorlabels_remove_label(imgid, color);
   }
+  dt_database_release_transaction(darktable.db);
 }
 
 static void _pop_undo(gpointer user_data, dt_undo_type_t type, dt_undo_data_t data, dt_undo_action_t action, GList **imgs)
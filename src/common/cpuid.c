@@ -34,7 +34,7 @@
 #include <cpuid.h>
 #endif
 
-#if defined(HAVE___GET_GPUID)
+#if defined(HAVE___GET_CPUID)
 dt_cpu_flags_t dt_detect_cpu_features()
 {
   guint32 ax, bx, cx, dx;
@@ -57,7 +57,26 @@ dt_cpu_flags_t dt_detect_cpu_features()
       if(cx & 0x00040000) cpuflags |= CPU_FLAG_SSE4_1;
       if(cx & 0x00080000) cpuflags |= CPU_FLAG_SSE4_2;
 
-      if(cx & 0x08000000) cpuflags |= CPU_FLAG_AVX;
+      if(cx & 0x00001000) cpuflags |= CPU_FLAG_FMA;
+
+      // avx needs support from the os for saving the ymm (and zmm) registers, too
+      if((cx & 0x18000000) == 0x18000000)
+      {
+        guint32 xcr0_lo, xcr0_hi;
+        __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        if((xcr0_lo & 0x06) == 0x06)
+        {
+          cpuflags |= CPU_FLAG_AVX;
+
+          /* Request for extended features */
+          if(__get_cpuid_count(0x00000007, 0, &ax, &bx, &cx, &dx))
+          {
+            if(bx & 0x00000020) cpuflags |= CPU_FLAG_AVX2;
+            if((bx & 0x00010000) && (xcr0_lo & 0xe0) == 0xe0) cpuflags |= CPU_FLAG_AVX512F;
+          }
+        }
+      }
+      if(!(cpuflags & CPU_FLAG_AVX)) cpuflags &= ~CPU_FLAG_FMA;
     }
 
     /* Are there extensions? */
@@ -71,7 +90,7 @@ dt_cpu_flags_t dt_detect_cpu_features()
         if(dx & 0x00400000) cpuflags |= CPU_FLAG_AMD_ISSE;
       }
     }
-    fprintf(stderr,"\nfound cpuid instruction, dtflags %x",cpuflags);
+    dt_print(DT_DEBUG_PERF, "[cpuid] found cpuid instruction, dtflags %x\n", cpuflags);
   }
   g_mutex_unlock(&lock);
   return cpuflags;
@@ -28,6 +28,7 @@
 #include <sys/malloc.h>
 #endif
 
+#include "common/box_filters.h"
 #include "common/collection.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
@@ -49,6 +50,7 @@
 #include "common/iop_order.h"
 #include "common/l10n.h"
 #include "common/mipmap_cache.h"
+#include "common/nlmeans_core.h"
 #include "common/noiseprofiles.h"
 #include "common/opencl.h"
 #include "common/points.h"
@@ -176,6 +178,18 @@ gboolean dt_supported_image(const gchar *filename)
   return supported;
 }
 
+// report the time spent in one phase of the startup with -d perf and start timing the next one
+static void _init_phase_done(dt_times_t *phase, const char *name)
+{
+  dt_show_times_f(phase, "[init]", "%s", name);
+  dt_get_times(phase);
+}
+
+static void *_colorspaces_init_thread(void *arg)
+{
+  return dt_colorspaces_init();
+}
+
 static void strip_semicolons_from_keymap(const char *path)
 {
   char pathtmp[PATH_MAX] = { 0 };
@@ -311,15 +325,24 @@ static void dt_codepaths_init()
   {
 #ifdef HAVE_BUILTIN_CPU_SUPPORTS
     darktable.codepath.SSE2 = (__builtin_cpu_supports("sse") && __builtin_cpu_supports("sse2"));
+    darktable.codepath.AVX2 = (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"));
+    darktable.codepath.AVX512 = !!__builtin_cpu_supports("avx512f");
 #else
     dt_cpu_flags_t flags = dt_detect_cpu_features();
     darktable.codepath.SSE2 = ((flags & (CPU_FLAG_SSE)) && (flags & (CPU_FLAG_SSE2)));
+    darktable.codepath.AVX2 = ((flags & (CPU_FLAG_AVX2)) && (flags & (CPU_FLAG_FMA)));
+    darktable.codepath.AVX512 = !!(flags & (CPU_FLAG_AVX512F));
 #endif
+    // the wider sets are only used as an upgrade of the sse2 ones
+    darktable.codepath.AVX2 &= darktable.codepath.SSE2;
+    darktable.codepath.AVX512 &= darktable.codepath.AVX2;
   }
 
   // second, apply overrides from conf
   // NOTE: all intrinsics sets can only be overridden to OFF
   if(!dt_conf_get_bool("codepaths/sse2")) darktable.codepath.SSE2 = 0;
+  if(!dt_conf_get_bool("codepaths/sse2") || !dt_conf_get_bool("codepaths/avx2")) darktable.codepath.AVX2 = 0;
+  if(!darktable.codepath.AVX2 || !dt_conf_get_bool("codepaths/avx512")) darktable.codepath.AVX512 = 0;
 
   // last: do we have any intrinsics sets enabled?
   darktable.codepath._no_intrinsics = !(darktable.codepath.SSE2);
@@ -349,6 +372,8 @@ static void dt_codepaths_init()
 int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load_data, lua_State *L)
 {
   double start_wtime = dt_get_wtime();
+  dt_times_t phase;
+  dt_get_times(&phase);
 
 #ifndef _WIN32
   if(getuid() == 0 || geteuid() == 0)
@@ -872,8 +897,11 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   dt_lua_init_early(L);
 #endif
 
+  _init_phase_done(&phase, "parsing options");
+
   // thread-safe init:
   dt_exif_init();
+  _init_phase_done(&phase, "exiv2");
   char datadir[PATH_MAX] = { 0 };
   dt_loc_get_user_config_dir(datadir, sizeof(datadir));
   char darktablerc[PATH_MAX] = { 0 };
@@ -922,12 +950,30 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   // detect cpu features and decide which codepaths to enable
   dt_codepaths_init();
-
-  // get the list of color profiles
-  darktable.color_profiles = dt_colorspaces_init();
+  dt_box_filters_init();
+  dt_nlmeans_denoise_init();
+  dt_develop_blendif_rgb_hsl_init();
+  dt_develop_blendif_rgb_jzczhz_init();
+  _init_phase_done(&phase, "config and gtk");
+
+  // get the list of color profiles. scanning and parsing the icc files doesn't depend on the database,
+  // so do it in the background while the database gets opened and checked.
+  pthread_t colorspaces_thread;
+  const gboolean colorspaces_async
+      = !dt_pthread_create(&colorspaces_thread, _colorspaces_init_thread, NULL);
+  if(!colorspaces_async) darktable.color_profiles = dt_colorspaces_init();
 
   // initialize the database
   darktable.db = dt_database_init(dbfilename_from_command, load_data, init_gui);
+
+  if(colorspaces_async)
+  {
+    void *color_profiles = NULL;
+    pthread_join(colorspaces_thread, &color_profiles);
+    darktable.color_profiles = (dt_colorspaces_t *)color_profiles;
+  }
+  _init_phase_done(&phase, "database and color profiles");
+
   if(darktable.db == NULL)
   {
     printf("ERROR : cannot open database\n");
@@ -975,14 +1021,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   // Initialize the signal system
   darktable.signals = dt_control_signal_init();
 
-  // Make sure that the database and xmp files are in sync
-  // We need conf and db to be up and running for that which is the case here.
-  // FIXME: is this also useful in non-gui mode?
-  GList *changed_xmp_files = NULL;
-  if(init_gui && dt_conf_get_bool("run_crawler_on_start"))
-  {
-    changed_xmp_files = dt_control_crawler_run();
-  }
+  _init_phase_done(&phase, "database maintenance");
 
   if(init_gui)
   {
@@ -1025,14 +1064,17 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 #endif
 
   darktable.opencl = (dt_opencl_t *)calloc(1, sizeof(dt_opencl_t));
+  _init_phase_done(&phase, "control and collection");
+
 #ifdef HAVE_OPENCL
   dt_opencl_init(darktable.opencl, exclude_opencl, print_statistics);
 #endif
+  _init_phase_done(&phase, "opencl");
 
   darktable.points = (dt_points_t *)calloc(1, sizeof(dt_points_t));
   dt_points_init(darktable.points, dt_get_num_threads());
 
-  darktable.noiseprofile_parser = dt_noiseprofile_init(noiseprofiles_from_command);
+  dt_noiseprofile_init(noiseprofiles_from_command);
 
   // must come before mipmap_cache, because that one will need to access
   // image dimensions stored in here:
@@ -1041,6 +1083,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   darktable.mipmap_cache = (dt_mipmap_cache_t *)calloc(1, sizeof(dt_mipmap_cache_t));
   dt_mipmap_cache_init(darktable.mipmap_cache);
+  _init_phase_done(&phase, "image caches");
 
   // The GUI must be initialized before the views, because the init()
   // functions of the views depend on darktable.control->accels_* to register
@@ -1059,8 +1102,11 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   else
     darktable.gui = NULL;
 
+  _init_phase_done(&phase, "gui");
+
   darktable.view_manager = (dt_view_manager_t *)calloc(1, sizeof(dt_view_manager_t));
   dt_view_manager_init(darktable.view_manager);
+  _init_phase_done(&phase, "views");
 
   // check whether we were able to load darkroom view. if we failed, we'll crash everywhere later on.
   if(!darktable.develop)
@@ -1076,8 +1122,11 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   darktable.iop_order_list = dt_ioppr_get_iop_order_list(0, FALSE);
   // load iop order rules
   darktable.iop_order_rules = dt_ioppr_get_iop_order_rules();
+  _init_phase_done(&phase, "imageio and iop order");
+
   // load the darkroom mode plugins once:
   dt_iop_load_modules_so();
+  _init_phase_done(&phase, "iop modules");
   // check if all modules have a iop order assigned
   if(dt_ioppr_check_so_iop_order(darktable.iop, darktable.iop_order_list))
   {
@@ -1088,9 +1137,6 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   // set up memory.darktable_iop_names table
   dt_iop_set_darktable_iop_table();
 
-  // set up the list of exiv2 metadata
-  dt_exif_set_exiv2_taglist();
-
   // init metadata flags
   dt_metadata_init();
 
@@ -1128,6 +1174,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
     // initialize undo struct
     darktable.undo = dt_undo_init();
+    _init_phase_done(&phase, "libs and key accels");
   }
 
   if(darktable.unmuted & DT_DEBUG_MEMORY)
@@ -1141,6 +1188,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 /* init lua last, since it's user made stuff it must be in the real environment */
 #ifdef USE_LUA
   dt_lua_init(darktable.lua_state.state, lua_command);
+  _init_phase_done(&phase, "lua");
 #endif
 
   if(init_gui)
@@ -1197,14 +1245,18 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 #endif
   }
 
-  // last but not least construct the popup that asks the user about images whose xmp files are newer than the
-  // db entry
-  if(init_gui && changed_xmp_files)
+  // last but not least make sure that the database and xmp files are in sync. the crawler runs in the
+  // background and pops up a dialog asking the user about images whose xmp files changed behind our back.
+  // FIXME: is this also useful in non-gui mode?
+  if(init_gui)
   {
-    dt_control_crawler_show_image_list(changed_xmp_files);
+    if(dt_conf_get_bool("run_crawler_on_start")) dt_control_crawler_run_job(NULL);
+    dt_control_crawler_watch_init();
   }
 
-  dt_print(DT_DEBUG_CONTROL, "[init] startup took %f seconds\n", dt_get_wtime() - start_wtime);
+  _init_phase_done(&phase, "initial view and images");
+
+  dt_print(DT_DEBUG_CONTROL | DT_DEBUG_PERF, "[init] startup took %f seconds\n", dt_get_wtime() - start_wtime);
 
   return 0;
 }
@@ -1241,6 +1293,7 @@ void dt_cleanup()
     dt_ctl_switch_mode_to("");
     dt_dbus_destroy(darktable.dbus);
 
+    dt_control_crawler_watch_cleanup();
     dt_control_shutdown(darktable.control);
 
     dt_lib_cleanup(darktable.lib);
@@ -1273,6 +1326,10 @@ void dt_cleanup()
   dt_points_cleanup(darktable.points);
   free(darktable.points);
   dt_iop_unload_modules_so();
+  dt_box_filters_cleanup();
+  dt_nlmeans_denoise_cleanup();
+  dt_develop_blendif_rgb_hsl_cleanup();
+  dt_develop_blendif_rgb_jzczhz_cleanup();
   g_list_free_full(darktable.iop_order_list, free);
   darktable.iop_order_list = NULL;
   g_list_free_full(darktable.iop_order_rules, free);
@@ -1327,11 +1384,7 @@ void dt_cleanup()
     dt_bauhaus_cleanup();
   }
 
-  if (darktable.noiseprofile_parser)
-  {
-    g_object_unref(darktable.noiseprofile_parser);
-    darktable.noiseprofile_parser = NULL;
-  }
+  dt_noiseprofile_cleanup();
 
   dt_capabilities_cleanup();
 
@@ -250,6 +250,8 @@ typedef enum dt_debug_thread_t
 typedef struct dt_codepath_t
 {
   unsigned int SSE2 : 1;
+  unsigned int AVX2 : 1;   // including fma, only used through common/dispatch.h
+  unsigned int AVX512 : 1; // avx512f, only used through common/dispatch.h
   unsigned int _no_intrinsics : 1;
   unsigned int OPENMP_SIMD : 1; // always stays the last one
 } dt_codepath_t;
@@ -287,6 +289,7 @@ typedef struct darktable_t
   struct dt_undo_t *undo;
   struct dt_colorspaces_t *color_profiles;
   struct dt_l10n_t *l10n;
+  struct dt_benchmark_t *benchmark;
   dt_pthread_mutex_t db_image[DT_IMAGE_DBLOCKS];
   dt_pthread_mutex_t dev_threadsafe;
   dt_pthread_mutex_t plugin_threadsafe;
@@ -47,7 +47,7 @@
 
 // whenever _create_*_schema() gets changed you HAVE to bump this version and add an update path to
 // _upgrade_*_schema_step()!
-#define CURRENT_DATABASE_VERSION_LIBRARY 30
+#define CURRENT_DATABASE_VERSION_LIBRARY 31
 #define CURRENT_DATABASE_VERSION_DATA     8
 
 typedef struct dt_database_t
@@ -65,6 +65,11 @@ typedef struct dt_database_t
 
   gchar *error_message, *error_dbfilename;
   int error_other_pid;
+
+  /* transactions started through dt_database_start_transaction() */
+  GRecMutex transaction_lock;
+  int transaction_depth;
+  gboolean transaction_open;
 } dt_database_t;
 
 
@@ -1675,6 +1680,19 @@ static int _upgrade_library_schema_step(dt_database_t *db, int version)
     sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
     new_version = 30;
   }
+  else if(version == 30)
+  {
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+    // remember what the xmp sidecar looked like when we wrote it, so the crawler can spot external edits
+    TRY_EXEC("ALTER TABLE main.images ADD COLUMN xmp_mtime INTEGER",
+             "[init] can't add `xmp_mtime' column to images table in database\n");
+    TRY_EXEC("ALTER TABLE main.images ADD COLUMN xmp_size INTEGER",
+             "[init] can't add `xmp_size' column to images table in database\n");
+
+    sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
+    new_version = 31;
+  }
   else
     new_version = version; // should be the fallback so that calling code sees that we are in an infinite loop
 
@@ -1960,7 +1978,8 @@ static void _create_library_schema(dt_database_t *db)
       "max_version INTEGER, write_timestamp INTEGER, history_end INTEGER, position INTEGER, "
       "aspect_ratio REAL, exposure_bias REAL, "
       "import_timestamp INTEGER DEFAULT -1, change_timestamp INTEGER DEFAULT -1, "
-      "export_timestamp INTEGER DEFAULT -1, print_timestamp INTEGER DEFAULT -1)",
+      "export_timestamp INTEGER DEFAULT -1, print_timestamp INTEGER DEFAULT -1, "
+      "xmp_mtime INTEGER, xmp_size INTEGER)",
       NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.images_group_id_index ON images (group_id)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.images_film_id_index ON images (film_id)", NULL, NULL, NULL);
@@ -2552,6 +2571,7 @@ start:
 
   /* create database */
   dt_database_t *db = (dt_database_t *)g_malloc0(sizeof(dt_database_t));
+  g_rec_mutex_init(&db->transaction_lock);
   db->dbfilename_data = g_strdup(dbfilename_data);
   db->dbfilename_library = g_strdup(dbfilename_library);
 
@@ -3081,11 +3101,50 @@ void dt_database_destroy(const dt_database_t *db)
   }
   g_free(db->dbfilename_data);
   g_free(db->dbfilename_library);
+  g_rec_mutex_clear(&((dt_database_t *)db)->transaction_lock);
   g_free((dt_database_t *)db);
 
   sqlite3_shutdown();
 }
 
+void dt_database_start_transaction(const struct dt_database_t *db)
+{
+  dt_database_t *d = (dt_database_t *)db;
+  g_rec_mutex_lock(&d->transaction_lock);
+  if(d->transaction_depth++ == 0)
+  {
+    d->transaction_open = sqlite3_exec(d->handle, "BEGIN TRANSACTION", NULL, NULL, NULL) == SQLITE_OK;
+    // the statements still get executed, just without a transaction around them
+    if(!d->transaction_open)
+      fprintf(stderr, "[db] failed to begin transaction: %s\n", sqlite3_errmsg(d->handle));
+  }
+}
+
+static void _database_end_transaction(dt_database_t *d, const char *query)
+{
+  if(--d->transaction_depth == 0 && d->transaction_open)
+  {
+    if(sqlite3_exec(d->handle, query, NULL, NULL, NULL) != SQLITE_OK)
+    {
+      fprintf(stderr, "[db] failed to %s transaction: %s\n", query, sqlite3_errmsg(d->handle));
+      // don't leave the connection inside a transaction everybody else would end up in
+      if(sqlite3_get_autocommit(d->handle) == 0) sqlite3_exec(d->handle, "ROLLBACK", NULL, NULL, NULL);
+    }
+    d->transaction_open = FALSE;
+  }
+  g_rec_mutex_unlock(&d->transaction_lock);
+}
+
+void dt_database_release_transaction(const struct dt_database_t *db)
+{
+  _database_end_transaction((dt_database_t *)db, "COMMIT");
+}
+
+void dt_database_rollback_transaction(const struct dt_database_t *db)
+{
+  _database_end_transaction((dt_database_t *)db, "ROLLBACK");
+}
+
 sqlite3 *dt_database_get(const dt_database_t *db)
 {
   return db ? db->handle : NULL;
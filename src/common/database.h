@@ -49,6 +49,15 @@ gboolean dt_database_maybe_snapshot(const struct dt_database_t *db);
 char **dt_database_snaps_to_remove(const struct dt_database_t *db);
 /** get possibly the freshest snapshot to restore */
 gchar *dt_database_get_most_recent_snap(const char* db_filename);
+/** transactions on the connection shared by the gui and all jobs. the transaction belongs to the calling
+ * thread until released, others wait in dt_database_start_transaction(). nested calls only begin and
+ * commit the outermost transaction. errors are reported and leave the connection in autocommit mode.
+ * writes that don't go through these end up in whatever transaction another thread has open, and are
+ * lost if that one rolls back. so writers use them even for a few statements, keep the transaction
+ * short, and start it before taking any image cache write lock. */
+void dt_database_start_transaction(const struct dt_database_t *db);
+void dt_database_release_transaction(const struct dt_database_t *db);
+void dt_database_rollback_transaction(const struct dt_database_t *db);
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -0,0 +1,178 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/dispatch.h"
+#include "common/darktable.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// number of timed runs per variant, we report the fastest one
+#define DT_DISPATCH_BENCH_RUNS 5
+
+static GList *_kernels = NULL;
+static GMutex _kernels_lock;
+
+const char *dt_isa_name(const dt_isa_t isa)
+{
+  switch(isa)
+  {
+    case DT_ISA_SCALAR:
+      return "scalar";
+    case DT_ISA_SSE2:
+      return "sse2";
+    case DT_ISA_AVX2:
+      return "avx2";
+    case DT_ISA_AVX512:
+      return "avx512";
+    default:
+      return "unknown";
+  }
+}
+
+gboolean dt_isa_enabled(const dt_isa_t isa)
+{
+  switch(isa)
+  {
+    case DT_ISA_SCALAR:
+      return TRUE;
+    case DT_ISA_SSE2:
+      return darktable.codepath.SSE2;
+    case DT_ISA_AVX2:
+      return darktable.codepath.AVX2;
+    case DT_ISA_AVX512:
+      return darktable.codepath.AVX512;
+    default:
+      return FALSE;
+  }
+}
+
+void dt_dispatch_register(dt_dispatch_kernel_t *kernel)
+{
+  kernel->selected = kernel->variants[DT_ISA_SCALAR];
+  kernel->selected_isa = DT_ISA_SCALAR;
+  for(int isa = DT_ISA_LAST - 1; isa > DT_ISA_SCALAR; isa--)
+  {
+    if(kernel->variants[isa] && dt_isa_enabled(isa))
+    {
+      kernel->selected = kernel->variants[isa];
+      kernel->selected_isa = isa;
+      break;
+    }
+  }
+
+  dt_print(DT_DEBUG_PERF, "[dispatch] using %s variant of `%s'\n", dt_isa_name(kernel->selected_isa),
+           kernel->name);
+
+  g_mutex_lock(&_kernels_lock);
+  if(!g_list_find(_kernels, kernel)) _kernels = g_list_append(_kernels, kernel);
+  g_mutex_unlock(&_kernels_lock);
+}
+
+void dt_dispatch_unregister(dt_dispatch_kernel_t *kernel)
+{
+  g_mutex_lock(&_kernels_lock);
+  _kernels = g_list_remove(_kernels, kernel);
+  g_mutex_unlock(&_kernels_lock);
+}
+
+gboolean dt_dispatch_is_registered(const char *name)
+{
+  gboolean found = FALSE;
+  g_mutex_lock(&_kernels_lock);
+  for(const GList *k = _kernels; k && !found; k = g_list_next(k))
+    found = !strcmp(((dt_dispatch_kernel_t *)k->data)->name, name);
+  g_mutex_unlock(&_kernels_lock);
+  return found;
+}
+
+static double _bench_variant(const dt_dispatch_kernel_t *kernel, const void *variant, float **out, size_t *len)
+{
+  double best = INFINITY;
+  for(int run = 0; run < DT_DISPATCH_BENCH_RUNS; run++)
+  {
+    float *buf = NULL;
+    const double start = dt_get_wtime();
+    const size_t n = kernel->bench(variant, &buf);
+    const double elapsed = dt_get_wtime() - start;
+    best = fmin(best, elapsed);
+    // keep the output of the last run for the comparison
+    if(run < DT_DISPATCH_BENCH_RUNS - 1)
+      dt_free_align(buf);
+    else
+    {
+      *out = buf;
+      *len = n;
+    }
+  }
+  return best;
+}
+
+int dt_dispatch_benchmark(const float tolerance)
+{
+  int failed = 0;
+  g_mutex_lock(&_kernels_lock);
+  GList *kernels = g_list_copy(_kernels);
+  g_mutex_unlock(&_kernels_lock);
+
+  printf("[dispatch] %-24s %-8s %12s %8s %14s\n", "kernel", "variant", "time [ms]", "speedup", "max abs error");
+  for(const GList *k = kernels; k; k = g_list_next(k))
+  {
+    const dt_dispatch_kernel_t *kernel = (dt_dispatch_kernel_t *)k->data;
+    if(!kernel->bench || !kernel->variants[DT_ISA_SCALAR]) continue;
+
+    float *ref = NULL;
+    size_t ref_len = 0;
+    const double ref_time = _bench_variant(kernel, kernel->variants[DT_ISA_SCALAR], &ref, &ref_len);
+    printf("[dispatch] %-24s %-8s %12.3f %8.2f %14s\n", kernel->name, dt_isa_name(DT_ISA_SCALAR),
+           1000.0 * ref_time, 1.0, "-");
+
+    for(int isa = DT_ISA_SCALAR + 1; isa < DT_ISA_LAST; isa++)
+    {
+      if(!kernel->variants[isa] || !dt_isa_enabled(isa)) continue;
+
+      float *out = NULL;
+      size_t len = 0;
+      const double time = _bench_variant(kernel, kernel->variants[isa], &out, &len);
+
+      float err = len == ref_len ? 0.0f : INFINITY;
+      for(size_t i = 0; i < len && len == ref_len; i++)
+      {
+        // a NaN in only one of both counts as a mismatch, too
+        if(isnan(out[i]) != isnan(ref[i]))
+          err = INFINITY;
+        else if(!isnan(ref[i]))
+          err = fmaxf(err, fabsf(out[i] - ref[i]));
+      }
+      dt_free_align(out);
+
+      const gboolean ok = err <= tolerance;
+      if(!ok) failed++;
+      printf("[dispatch] %-24s %-8s %12.3f %8.2f %14g%s\n", kernel->name, dt_isa_name(isa), 1000.0 * time,
+             ref_time / fmax(time, 1e-9), err, ok ? "" : "  FAILED");
+    }
+    dt_free_align(ref);
+  }
+  g_list_free(kernels);
+  return failed;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,94 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <stddef.h>
+
+/*
+ * runtime selection of hand written kernel variants.
+ *
+ * a kernel is a static dt_dispatch_kernel_t holding one function pointer per instruction set. the scalar
+ * variant is mandatory, all others are optional. once registered (usually from init_global() of an iop),
+ * `selected' points to the best variant the cpu supports and the user didn't disable through the
+ * codepaths/ config keys:
+ *
+ *   static dt_dispatch_kernel_t _foo_kernel = { .name = "foo", .variants = {
+ *     [DT_ISA_SCALAR] = foo_plain, [DT_ISA_AVX2] = foo_avx2 } };
+ *   dt_dispatch_register(&_foo_kernel);
+ *   ((foo_fn_t)_foo_kernel.selected)(...);
+ *
+ * variants for instruction sets beyond the build baseline are compiled with DT_TARGET_AVX2 and
+ * DT_TARGET_AVX512 on the function, and guarded by DT_HAVE_TARGET_AVX2 / DT_HAVE_TARGET_AVX512.
+ */
+
+typedef enum dt_isa_t
+{
+  DT_ISA_SCALAR = 0,
+  DT_ISA_SSE2,
+  DT_ISA_AVX2,   // avx2 + fma
+  DT_ISA_AVX512, // avx512f
+  DT_ISA_LAST
+} dt_isa_t;
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(_WIN32)
+#include <immintrin.h>
+#define DT_HAVE_TARGET_AVX2 1
+#define DT_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define DT_HAVE_TARGET_AVX512 1
+#define DT_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#else
+#define DT_TARGET_AVX2
+#define DT_TARGET_AVX512
+#endif
+
+typedef struct dt_dispatch_kernel_t
+{
+  const char *name;
+  void *variants[DT_ISA_LAST];
+
+  // optional, for dt_dispatch_benchmark(): run `variant' over a synthetic input and return the number
+  // of floats written to *out, which is allocated with dt_alloc_align() and freed by the caller.
+  // the scalar variant's output is the reference all others are compared to.
+  size_t (*bench)(const void *variant, float **out);
+
+  // filled in by dt_dispatch_register()
+  void *selected;
+  dt_isa_t selected_isa;
+} dt_dispatch_kernel_t;
+
+const char *dt_isa_name(const dt_isa_t isa);
+
+// can variants for this instruction set be used, i.e. does the cpu support it and is it enabled in darktablerc?
+gboolean dt_isa_enabled(const dt_isa_t isa);
+
+// pick the best variant of the kernel and remember it for dt_dispatch_benchmark()
+void dt_dispatch_register(dt_dispatch_kernel_t *kernel);
+void dt_dispatch_unregister(dt_dispatch_kernel_t *kernel);
+
+// is a kernel of this name registered? kernels of iops only are once their init_global() ran.
+gboolean dt_dispatch_is_registered(const char *name);
+
+// time every usable variant of every registered kernel which has a bench callback, and report its
+// maximum deviation from the scalar reference. returns the number of kernels exceeding `tolerance'.
+int dt_dispatch_benchmark(const float tolerance);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -79,8 +79,9 @@ extern "C" {
 
 #define DT_XMP_EXIF_VERSION 4
 
-// persistent list of exiv2 tags. set up in dt_init()
+// persistent list of exiv2 tags. set up on first use
 static GList *exiv2_taglist = NULL;
+static GMutex exiv2_taglist_lock;
 
 static const char *_get_exiv2_type(const int type)
 {
@@ -162,7 +163,12 @@ static void _get_xmp_tags(const char *prefix, GList **taglist)
 
 void dt_exif_set_exiv2_taglist()
 {
-  if(exiv2_taglist) return;
+  g_mutex_lock(&exiv2_taglist_lock);
+  if(exiv2_taglist)
+  {
+    g_mutex_unlock(&exiv2_taglist_lock);
+    return;
+  }
 
   try
   {
@@ -248,19 +254,19 @@ void dt_exif_set_exiv2_taglist()
     std::string s(e.what());
     std::cerr << "[exiv2 taglist] " << s << std::endl;
   }
+  g_mutex_unlock(&exiv2_taglist_lock);
 }
 
 const GList * const dt_exif_get_exiv2_taglist()
 {
-  if(!exiv2_taglist)
-    dt_exif_set_exiv2_taglist();
+  dt_exif_set_exiv2_taglist();
   return exiv2_taglist;
 }
 
 static const char *_exif_get_exiv2_tag_type(const char *tagname)
 {
   if(!tagname) return NULL;
-  GList *tag = exiv2_taglist;
+  const GList *tag = dt_exif_get_exiv2_taglist();
   while(tag)
   {
     char *t = (char *)tag->data;
@@ -1422,7 +1428,39 @@ int dt_exif_get_thumbnail(const char *path, uint8_t **buffer, size_t *size, char
 /** read the metadata of an image.
  * XMP data trumps IPTC data trumps EXIF data
  */
-int dt_exif_read(dt_image_t *img, const char *path)
+typedef struct dt_exif_preload_t
+{
+  std::unique_ptr<Exiv2::Image> image;
+  int mono_preview; // -1 if not checked
+} dt_exif_preload_t;
+
+void *dt_exif_preload(const char *path)
+{
+  dt_exif_preload_t *preload = new dt_exif_preload_t;
+  preload->mono_preview = -1;
+  try
+  {
+    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
+    assert(image.get() != 0);
+    read_metadata_threadsafe(image);
+    if(!image->exifData().empty() && dt_conf_get_bool("ui/detect_mono_exif"))
+      preload->mono_preview = dt_imageio_has_mono_preview(path) ? 1 : 0;
+    preload->image = std::move(image);
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    // dt_exif_read() will try again and report the error
+    preload->image.reset();
+  }
+  return preload;
+}
+
+void dt_exif_preload_free(void *preload)
+{
+  delete (dt_exif_preload_t *)preload;
+}
+
+static int _exif_read(dt_image_t *img, const char *path, dt_exif_preload_t *preload)
 {
   // at least set datetime taken to something useful in case there is no exif data in this file (pfm, png,
   // ...)
@@ -1436,9 +1474,16 @@ int dt_exif_read(dt_image_t *img, const char *path)
 
   try
   {
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
-    assert(image.get() != 0);
-    read_metadata_threadsafe(image);
+    std::unique_ptr<Exiv2::Image> image;
+    if(preload && preload->image)
+      image = std::move(preload->image);
+    else
+    {
+      std::unique_ptr<Exiv2::Image> opened(Exiv2::ImageFactory::open(WIDEN(path)));
+      assert(opened.get() != 0);
+      read_metadata_threadsafe(opened);
+      image = std::move(opened);
+    }
     bool res = true;
 
     // EXIF metadata
@@ -1449,7 +1494,9 @@ int dt_exif_read(dt_image_t *img, const char *path)
       if(dt_conf_get_bool("ui/detect_mono_exif"))
       {
         const int oldflags = dt_image_monochrome_flags(img) | (img->flags & DT_IMAGE_MONOCHROME_WORKFLOW);
-        if(dt_imageio_has_mono_preview(path))
+        const gboolean mono = (preload && preload->mono_preview >= 0) ? preload->mono_preview
+                                                                       : dt_imageio_has_mono_preview(path);
+        if(mono)
           img->flags |= (DT_IMAGE_MONOCHROME_PREVIEW | DT_IMAGE_MONOCHROME_WORKFLOW);
         else
           img->flags &= ~(DT_IMAGE_MONOCHROME_PREVIEW | DT_IMAGE_MONOCHROME_WORKFLOW);
@@ -1489,6 +1536,16 @@ int dt_exif_read(dt_image_t *img, const char *path)
   }
 }
 
+int dt_exif_read(dt_image_t *img, const char *path)
+{
+  return _exif_read(img, path, NULL);
+}
+
+int dt_exif_read_preloaded(dt_image_t *img, const char *path, void *preload)
+{
+  return _exif_read(img, path, (dt_exif_preload_t *)preload);
+}
+
 int dt_exif_write_blob(uint8_t *blob, uint32_t size, const char *path, const int compressed)
 {
   try
@@ -2731,6 +2788,8 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
   // exclude pfm to avoid stupid errors on the console
   const char *c = filename + strlen(filename) - 4;
   if(c >= filename && !strcmp(c, ".pfm")) return 1;
+  // the history transaction has to be rolled back if exiv2 throws in between
+  gboolean in_transaction = FALSE;
   try
   {
     // read xmp sidecar
@@ -2849,7 +2908,7 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
 
     // now add all masks that are not used for cloning. keeping them might be useful.
     // TODO: make this configurable? or remove it altogether?
-    sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+    dt_database_start_transaction(darktable.db);
     if(version < 3)
     {
       g_hash_table_foreach(mask_entries, add_non_clone_mask_entries_to_db, &img->id);
@@ -2866,7 +2925,7 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
         m_entries = g_list_next(m_entries);
       }
     }
-    sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+    dt_database_release_transaction(darktable.db);
 
     // history
     int num = 0;
@@ -2889,7 +2948,8 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
       return 1;
     }
 
-    sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+    dt_database_start_transaction(darktable.db);
+    in_transaction = TRUE;
 
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "DELETE FROM main.history WHERE imgid = ?1", -1,
                                 &stmt, NULL);
@@ -3126,9 +3186,10 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
     g_list_free_full(mask_entries_v3, free_mask_entry);
     if(mask_entries) g_hash_table_destroy(mask_entries);
 
+    in_transaction = FALSE;
     if(all_ok)
     {
-      sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+      dt_database_release_transaction(darktable.db);
 
       // history_hash
       dt_history_hash_values_t hash = {NULL, 0, NULL, 0, NULL, 0};
@@ -3164,13 +3225,14 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
     else
     {
       std::cerr << "[exif] error reading history from '" << filename << "'" << std::endl;
-      sqlite3_exec(dt_database_get(darktable.db), "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+      dt_database_rollback_transaction(darktable.db);
       return 1;
     }
 
   }
   catch(Exiv2::AnyError &e)
   {
+    if(in_transaction) dt_database_rollback_transaction(darktable.db);
     // actually nobody's interested in that if the file doesn't exist:
     // std::string s(e.what());
     // std::cerr << "[exiv2] " << filename << ": " << s << std::endl;
@@ -37,6 +37,13 @@ const GList * const dt_exif_get_exiv2_taglist();
  * struct. returns 0 on success. */
 int dt_exif_read(dt_image_t *img, const char *path);
 
+/** parse the metadata of path ahead of time, this can be done on any thread. the result has to be passed to
+ * dt_exif_read_preloaded() for the same file and freed with dt_exif_preload_free(). */
+void *dt_exif_preload(const char *path);
+/** same as dt_exif_read() but uses what dt_exif_preload() already parsed. */
+int dt_exif_read_preloaded(dt_image_t *img, const char *path, void *preload);
+void dt_exif_preload_free(void *preload);
+
 /** read exif data to image struct from given data blob, wherever you got it from. */
 int dt_exif_read_from_blob(dt_image_t *img, uint8_t *blob, const int size);
 
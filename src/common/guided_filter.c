@@ -28,6 +28,7 @@
 
 */
 
+#include "common/box_filters.h"
 #include "common/guided_filter.h"
 #include "common/opencl.h"
 #include <assert.h>
@@ -39,17 +40,6 @@
 // width, if greater) to keep memory use under control.
 #define GF_TILE_SIZE 512
 
-// some shorthand to make code more legible
-// if we have OpenMP simd enabled, declare a vectorizable for loop;
-// otherwise, just leave it a plain for()
-#if defined(_OPENMP) && defined(OPENMP_SIMD_)
-#define SIMD_FOR \
-  _Pragma("omp simd") \
-  for
-#else
-#define SIMD_FOR for
-#endif
-
 // avoid cluttering the scalar codepath with #ifdefs by hiding the dependency on SSE2
 #ifndef __SSE2__
 # define _mm_prefetch(where,hint)
@@ -87,200 +77,6 @@ static inline float *get_color_pixel(color_image img, size_t i)
   return img.data + i * img.stride;
 }
 
-// calculate the one-dimensional moving average over a window of size 2*w+1 independently for each of four channels
-// input array x has stride 4, output array y has stride stride_y
-static inline void box_mean_1d_4ch(int N, const float *x, float *y, size_t stride_y, int w)
-{
-  float n_box = 0.f, m[4] = { 0.f, 0.f, 0.f, 0.f }, c[4] = { 0.f, 0.f, 0.f, 0.f };
-  if(N > 2 * w)
-  {
-    for(int i = 0, i_end = w + 1; i < i_end; i++)
-    {
-      SIMD_FOR (int k = 0; k < 4; k++)
-        m[k] = Kahan_sum(m[k], &c[k], x[4*i+k]);
-      n_box++;
-    }
-    for(int i = 0, i_end = w; i < i_end; i++)
-    {
-      SIMD_FOR (int k = 0; k < 4; k++)
-      {
-        y[i * stride_y + k] = m[k] / n_box;
-        m[k] = Kahan_sum(m[k], &c[k], x[4*(i + w + 1) + k]);
-      }
-      n_box++;
-    }
-    for(int i = w, i_end = N - w - 1; i < i_end; i++)
-    {
-      SIMD_FOR (int k = 0; k < 4; k++)
-      {
-        y[i * stride_y + k] = m[k] / n_box;
-        m[k] = Kahan_sum(m[k], &c[k], x[4*(i + w + 1) + k]);
-        m[k] = Kahan_sum(m[k], &c[k], -x[4*(i - w) + k]);
-      }
-    }
-    for(int i = N - w - 1, i_end = N; i < i_end; i++)
-    {
-      SIMD_FOR (int k = 0; k < 4; k++)
-      {
-        y[i * stride_y + k] = m[k] / n_box;
-        m[k] = Kahan_sum(m[k], &c[k], -x[4*(i - w) + k]);
-      }
-      n_box--;
-    }
-  }
-  else
-  {
-    for(int i = 0, i_end = min_i(w + 1, N); i < i_end; i++)
-    {
-      SIMD_FOR (int k = 0; k < 4; k++)
-      {
-        m[k] = Kahan_sum(m[k], &c[k], x[4*i + k]);
-      }
-      n_box++;
-    }
-    for(int i = 0; i < N; i++)
-    {
-      SIMD_FOR (int k = 0; k < 4; k++)
-        y[i * stride_y + k] = m[k] / n_box;
-      if(i - w >= 0)
-      {
-        SIMD_FOR (int k = 0; k < 4; k++)
-          m[k] = Kahan_sum(m[k], &c[k], -x[4*(i - w)+k]);
-        n_box--;
-      }
-      if(i + w + 1 < N)
-      {
-        SIMD_FOR (int k = 0; k < 4; k++)
-          m[k] = Kahan_sum(m[k], &c[k], x[4*(i + w + 1)+k]);
-        n_box++;
-      }
-    }
-  }
-}
-
-// calculate the one-dimensional moving average over a window of size 2*w+1 independently for each of eight channels
-// input array x has stride 9, output array y has stride stride_y
-static inline void box_mean_1d_9ch(int N, const float *x, float *y, size_t stride_y, int w)
-{
-  float n_box = 0.f, m[9] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
-  float c[9] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
-  if(N > 2 * w)
-  {
-    for(int i = 0, i_end = w + 1; i < i_end; i++)
-    {
-      SIMD_FOR (int k = 0; k < 9; k++)
-        m[k] = Kahan_sum(m[k], &c[k], x[9*i+k]);
-      n_box++;
-    }
-    for(int i = 0, i_end = w; i < i_end; i++)
-    {
-      SIMD_FOR (int k = 0; k < 9; k++)
-      {
-        y[i * stride_y + k] = m[k] / n_box;
-        m[k] = Kahan_sum(m[k], &c[k], x[9*(i + w + 1) + k]);
-      }
-      n_box++;
-    }
-    for(int i = w, i_end = N - w - 1; i < i_end; i++)
-    {
-      SIMD_FOR (int k = 0; k < 9; k++)
-      {
-        y[i * stride_y + k] = m[k] / n_box;
-        m[k] = Kahan_sum(m[k], &c[k], x[9*(i + w + 1) + k]);
-        m[k] = Kahan_sum(m[k], &c[k], -x[9*(i - w) + k]);
-      }
-    }
-    for(int i = N - w - 1, i_end = N; i < i_end; i++)
-    {
-      SIMD_FOR (int k = 0; k < 9; k++)
-      {
-        y[i * stride_y + k] = m[k] / n_box;
-        m[k] = Kahan_sum(m[k], &c[k], -x[9*(i - w) + k]);
-      }
-      n_box--;
-    }
-  }
-  else
-  {
-    for(int i = 0, i_end = min_i(w + 1, N); i < i_end; i++)
-    {
-      SIMD_FOR (int k = 0; k < 9; k++)
-      {
-        m[k] = Kahan_sum(m[k], &c[k], x[9*i + k]);
-      }
-      n_box++;
-    }
-    for(int i = 0; i < N; i++)
-    {
-      SIMD_FOR (int k = 0; k < 9; k++)
-        y[i * stride_y + k] = m[k] / n_box;
-      if(i - w >= 0)
-      {
-        SIMD_FOR (int k = 0; k < 9; k++)
-          m[k] = Kahan_sum(m[k], &c[k], -x[9*(i - w)+k]);
-        n_box--;
-      }
-      if(i + w + 1 < N)
-      {
-        SIMD_FOR (int k = 0; k < 9; k++)
-          m[k] = Kahan_sum(m[k], &c[k], x[9*(i + w + 1)+k]);
-        n_box++;
-      }
-    }
-  }
-}
-
-// in-place calculate the two-dimensional moving average of a four-channel image over a box of size (2*w+1) x (2*w+1)
-static void box_mean_4ch(color_image img, int w)
-{
-  const size_t size = 4 * max_i(img.width, img.height);
-  float *img_bak = dt_alloc_align_float(dt_get_num_threads() * size);
-  const size_t width = 4 * img.width;
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static) default(none) dt_omp_firstprivate(w, size, width, img_bak) shared(img)
-#endif
-  for(int i1 = 0; i1 < img.height; i1++)
-  {
-    float *buf = img_bak + dt_get_thread_num() * size;
-    memcpy(buf, img.data + (size_t)i1 * width, sizeof(float) * width);
-    box_mean_1d_4ch(img.width, buf, img.data + (size_t)i1 * width, 4, w);
-  }
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static) default(none) dt_omp_firstprivate(w, size, width, img_bak) shared(img)
-#endif
-  for(int i0 = 0; i0 < img.width; i0++)
-  {
-    float *buf = img_bak + dt_get_thread_num() * size;
-    for(int i1 = 0; i1 < img.height; i1++)
-      SIMD_FOR (int k = 0; k < 4; k++)
-        buf[4*i1+k] = img.data[4*(i0 + (size_t)i1 * img.width)+k];
-    box_mean_1d_4ch(img.height, buf, img.data + 4*i0, width, w);
-  }
-  dt_free_align(img_bak);
-}
-
-// in-place calculate the two-dimensional moving average of a four-channel image over a box of size (2*w+1) x (2*w+1)
-static void box_means_vert(float *img_bak, int w, color_image mean, color_image var)
-{
-  const size_t size = 9 * max_i(mean.width, mean.height);
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static) default(none) dt_omp_firstprivate(w, size, img_bak) \
-  shared(mean, var)
-#endif
-  for(int i0 = 0; i0 < mean.width; i0++)
-  {
-    float *buf = img_bak + dt_get_thread_num() * size;
-    for(int i1 = 0; i1 < mean.height; i1++)
-      SIMD_FOR (int k = 0; k < 4; k++)
-        buf[4*i1+k] = mean.data[4*(i0 + (size_t)i1 * mean.width)+k];
-    box_mean_1d_4ch(mean.height, buf, mean.data + 4*i0, 4 * mean.width, w);
-    for(int i1 = 0; i1 < var.height; i1++)
-      SIMD_FOR (int k = 0; k < 9; k++)
-        buf[9*i1+k] = var.data[9*(i0 + (size_t)i1 * var.width)+k];
-    box_mean_1d_9ch(var.height, buf, var.data + 9*i0, 9 * var.width, w);
-  }
-}
-
 // apply guided filter to single-component image img using the 3-components image imgg as a guide
 // the filtering applies a monochrome box filter to a total of 13 image channels:
 //    1 monochrome input image
@@ -314,19 +110,15 @@ static void guided_filter_tiling(color_image imgg, gray_image img, gray_image im
 #define VAR_GB 7
   color_image mean = new_color_image(width, height, 4);
   color_image variance = new_color_image(width, height, 9);
-  const size_t img_dimen = max_i(mean.width, mean.height);
-  const size_t img_bak_sz = 13 * img_dimen;
-  float *img_bak = dt_alloc_align_float(dt_get_num_threads() * img_bak_sz);
 #ifdef _OPENMP
-#pragma omp parallel for schedule(static) default(none) shared(img, imgg, mean, variance, img_bak) \
-  dt_omp_firstprivate(img_bak_sz, img_dimen, w, guide_weight) dt_omp_sharedconst(source)
+#pragma omp parallel for schedule(static) default(none) shared(img, imgg, mean, variance) \
+  dt_omp_firstprivate(guide_weight) dt_omp_sharedconst(source)
 #endif
   for(int j_imgg = source.lower; j_imgg < source.upper; j_imgg++)
   {
     int j = j_imgg - source.lower;
-    // put values directly into temp buffer to avoid a memcpy for the horizontal box mean pass
-    float *const meanpx = img_bak + dt_get_thread_num() * img_bak_sz;
-    float *const varpx = meanpx + 4*img_dimen;
+    float *const meanpx = mean.data + 4 * (size_t)j * mean.width;
+    float *const varpx = variance.data + 9 * (size_t)j * variance.width;
     for(int i_imgg = source.left; i_imgg < source.right; i_imgg++)
     {
       size_t i = i_imgg - source.left;
@@ -347,12 +139,10 @@ static void guided_filter_tiling(color_image imgg, gray_image img, gray_image im
       varpx[9*i+VAR_GB] = pixel[1] * pixel[2];
       varpx[9*i+VAR_BB] = pixel[2] * pixel[2];
     }
-    // apply horizontal pass of box mean filter while the cache is still hot
-    box_mean_1d_4ch(mean.width, meanpx, mean.data + 4 * j * mean.width, 4, w);
-    box_mean_1d_9ch(variance.width, varpx, variance.data + 9 * j * variance.width, 9, w);
   }
-  box_means_vert(img_bak, w, mean, variance);
-  dt_free_align(img_bak);
+  // the sums of squares and products are far from zero, so use compensated summation
+  dt_box_filter(mean.data, mean.data, height, width, 4, w, DT_BOX_MEAN_KAHAN, 1);
+  dt_box_filter(variance.data, variance.data, height, width, 9, w, DT_BOX_MEAN_KAHAN, 1);
   // we will recycle memory of 'mean' for the new coefficient arrays a_? and b to reduce memory foot print
   color_image a_b = mean;
   #define A_RED 0
@@ -417,7 +207,7 @@ static void guided_filter_tiling(color_image imgg, gray_image img, gray_image im
     a_b.data[4*i+B] = b_;
   }
   free_color_image(&variance);
-  box_mean_4ch(a_b, w);
+  dt_box_filter(a_b.data, a_b.data, height, width, 4, w, DT_BOX_MEAN_KAHAN, 1);
 #ifdef _OPENMP
 #pragma omp parallel for schedule(static) default(none) \
   shared(target, imgg, a_b, img_out) dt_omp_sharedconst(source) dt_omp_firstprivate(min, max, width, guide_weight)
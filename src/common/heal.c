@@ -36,9 +36,12 @@
  * but subtract them I2 = I0 - I1, where I0 is the sample image to be
  * corrected, I1 is the reference pattern. Then we solve DeltaI=0
  * (Laplace) with I2 Dirichlet conditions at the borders of the
- * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation.
- * It could benefit from a multi-grid evaluation of an initial solution
- * before the main iteration loop.
+ * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation
+ * for small masks, and a multigrid V-cycle for larger ones: a few red/black
+ * sweeps smooth the error, the residual is restricted to a grid of half the
+ * resolution where the correction is solved recursively, and the bilinearly
+ * interpolated correction is added back before smoothing again. The coarsest
+ * grid is solved with the over-relaxed iteration.
  *
  * I reduced the convergence criteria to 0.1% (0.001) as we are
  * dealing here with RGB integer components, more is overkill.
@@ -78,14 +81,15 @@ static void dt_heal_add(const float *const first_buffer, const float *const seco
 }
 
 #if defined(__SSE__)
-static float dt_heal_laplace_iteration_sse(float *pixels, const float *const Adiag, const int *const Aidx,
-                                           const float w, const int nmask_from, const int nmask_to)
+static float dt_heal_laplace_iteration_sse(float *pixels, const float *const rhs, const float *const Adiag,
+                                           const int *const Aidx, const float w, const int nmask_from,
+                                           const int nmask_to)
 {
   float err = 0.f;
 
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(Adiag, Aidx, w, nmask_from, nmask_to) \
+  dt_omp_firstprivate(rhs, Adiag, Aidx, w, nmask_from, nmask_to) \
   shared(pixels) \
   schedule(static) \
   reduction(+ : err)
@@ -107,15 +111,15 @@ static float dt_heal_laplace_iteration_sse(float *pixels, const float *const Adi
     __m128 valb_j2 = _mm_load_ps(pixels + j2); // S
     __m128 valb_j3 = _mm_load_ps(pixels + j3); // W
     __m128 valb_j4 = _mm_load_ps(pixels + j4); // N
+    __m128 valb_f = rhs ? _mm_load_ps(rhs + j0) : _mm_setzero_ps();
 
     /*  float diff = w * (a * pixels[j0 + k] -
                             (pixels[j1 + k] +
                              pixels[j2 + k] +
                              pixels[j3 + k] +
-                             pixels[j4 + k]));*/
-    __m128 valb_diff
-        = _mm_mul_ps(valb_w, _mm_sub_ps(_mm_mul_ps(valb_a, valb_j0),
-                                        _mm_add_ps(valb_j1, _mm_add_ps(valb_j2, _mm_add_ps(valb_j3, valb_j4)))));
+                             pixels[j4 + k]) - rhs[j0 + k]);*/
+    const __m128 valb_nb = _mm_add_ps(valb_j1, _mm_add_ps(valb_j2, _mm_add_ps(valb_j3, valb_j4)));
+    __m128 valb_diff = _mm_mul_ps(valb_w, _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(valb_a, valb_j0), valb_nb), valb_f));
 
     /*  pixels[j0 + k] -= diff;*/
     _mm_store_ps(pixels + j0, _mm_sub_ps(valb_j0, valb_diff));
@@ -133,12 +137,14 @@ static float dt_heal_laplace_iteration_sse(float *pixels, const float *const Adi
 #endif
 
 // Perform one iteration of Gauss-Seidel, and return the sum squared residual.
-static float dt_heal_laplace_iteration(float *pixels, const float *const Adiag, const int *const Aidx,
-                                       const float w, const int nmask_from, const int nmask_to, const int ch,
-                                       const int use_sse)
+// rhs is the right hand side of the equations, in the layout of pixels, or NULL if it is zero.
+static float dt_heal_laplace_iteration(float *pixels, const float *const rhs, const float *const Adiag,
+                                       const int *const Aidx, const float w, const int nmask_from,
+                                       const int nmask_to, const int ch, const int use_sse)
 {
 #if defined(__SSE__)
-  if(ch == 4 && use_sse) return dt_heal_laplace_iteration_sse(pixels, Adiag, Aidx, w, nmask_from, nmask_to);
+  if(ch == 4 && use_sse)
+    return dt_heal_laplace_iteration_sse(pixels, rhs, Adiag, Aidx, w, nmask_from, nmask_to);
 #endif
 
   float err = 0.f;
@@ -146,7 +152,7 @@ static float dt_heal_laplace_iteration(float *pixels, const float *const Adiag,
 
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(Adiag, Aidx, w, nmask_from, nmask_to, ch1) \
+  dt_omp_firstprivate(rhs, Adiag, Aidx, w, nmask_from, nmask_to, ch1) \
   shared(pixels) \
   schedule(static) \
   reduction(+ : err)
@@ -162,8 +168,9 @@ static float dt_heal_laplace_iteration(float *pixels, const float *const Adiag,
 
     for(int k = 0; k < ch1; k++)
     {
+      const float f = rhs ? rhs[j0 + k] : 0.f;
       const float diff
-          = w * (a * pixels[j0 + k] - (pixels[j1 + k] + pixels[j2 + k] + pixels[j3 + k] + pixels[j4 + k]));
+          = w * (a * pixels[j0 + k] - (pixels[j1 + k] + pixels[j2 + k] + pixels[j3 + k] + pixels[j4 + k]) - f);
 
       pixels[j0 + k] -= diff;
       err += diff * diff;
@@ -173,20 +180,54 @@ static float dt_heal_laplace_iteration(float *pixels, const float *const Adiag,
   return err;
 }
 
-// Solve the laplace equation for pixels and store the result in-place.
-static void dt_heal_laplace_loop(float *pixels, const int width, const int height, const int ch,
-                                 const float *const mask, const int use_sse)
+// the number of channels the iterations solve for: the sse code updates alpha as well
+static inline int dt_heal_solved_channels(const int ch, const int use_sse)
 {
+#if defined(__SSE__)
+  if(ch == 4 && use_sse) return ch;
+#endif
+  return (ch == 4) ? ch - 1 : ch;
+}
+
+/* One level of the multigrid hierarchy. The finest level holds the
+ * differences to be healed, the coarser ones the corrections to the level
+ * above, which are zero at the known pixels.
+ */
+typedef struct dt_heal_level_t
+{
+  int width, height;
+  float *pixels;  // ch * (width * height + 1) floats, the last pixel stays zero
+  float *rhs;     // right hand side of the equations, NULL on the finest level where it is zero
+  float *mask;    // != 0.f for the unknown pixels
+  float *Adiag;
+  int *Aidx;
+  int nmask, nmask2;
+} dt_heal_level_t;
+
+// heal areas with fewer unknowns than this are solved by SOR alone, larger ones get a coarser level
+#define HEAL_COARSE_MIN_PIXELS 256
+#define HEAL_MAX_LEVELS 16
+// smoothing sweeps before and after the coarse grid correction
+#define HEAL_SMOOTH_SWEEPS 2
+
+// Set up the system of equations of a level.
+static int dt_heal_laplace_setup(dt_heal_level_t *l, const int ch)
+{
+  const int width = l->width;
+  const int height = l->height;
+  const float *const mask = l->mask;
   int nmask = 0;
   int nmask2 = 0;
 
-  float *Adiag = dt_alloc_align_float((size_t)width * height);
-  int *Aidx = dt_alloc_align(64, sizeof(int) * 5 * width * height);
+  l->Adiag = dt_alloc_align_float((size_t)width * height);
+  l->Aidx = dt_alloc_align(64, sizeof(int) * 5 * width * height);
+  float *const Adiag = l->Adiag;
+  int *const Aidx = l->Aidx;
 
   if((Adiag == NULL) || (Aidx == NULL))
   {
-    fprintf(stderr, "dt_heal_laplace_loop: error allocating memory for healing\n");
-    goto cleanup;
+    fprintf(stderr, "dt_heal_laplace_setup: error allocating memory for healing\n");
+    return 0;
   }
 
   /* All off-diagonal elements of A are either -1 or 0. We could store it as a
@@ -196,7 +237,7 @@ static void dt_heal_laplace_loop(float *pixels, const int width, const int heigh
    * coefs can put them in a dummy column to be multiplied by an empty pixel.
    */
   const int zero = ch * width * height;
-  memset(pixels + zero, 0, sizeof(float) * ch);
+  memset(l->pixels + zero, 0, sizeof(float) * ch);
 
   /* Construct the system of equations.
    * Arrange Aidx in checkerboard order, so that a single linear pass over that
@@ -235,11 +276,19 @@ static void dt_heal_laplace_loop(float *pixels, const int width, const int heigh
 
 #undef A_NEIGHBOR
 
+  l->nmask = nmask;
+  l->nmask2 = nmask2;
+  return 1;
+}
+
+// Solve the equations of a level with Gauss-Seidel and successive over-relaxation.
+static void dt_heal_laplace_sor(dt_heal_level_t *l, const int ch, const int use_sse)
+{
   /* Empirically optimal over-relaxation factor. (Benchmarked on
    * round brushes, at least. I don't know whether aspect ratio
    * affects it.)
    */
-  float w = ((2.0f - 1.0f / (0.1575f * sqrtf(nmask) + 0.8f)) * .25f);
+  float w = ((2.0f - 1.0f / (0.1575f * sqrtf(l->nmask) + 0.8f)) * .25f);
 
   const int max_iter = 1000;
   const float epsilon = (0.1 / 255);
@@ -249,15 +298,221 @@ static void dt_heal_laplace_loop(float *pixels, const int width, const int heigh
   for(int iter = 0; iter < max_iter; iter++)
   {
     // process red/black cells separate
-    float err = dt_heal_laplace_iteration(pixels, Adiag, Aidx, w, 0, nmask2, ch, use_sse);
-    err += dt_heal_laplace_iteration(pixels, Adiag, Aidx, w, nmask2, nmask, ch, use_sse);
+    float err = dt_heal_laplace_iteration(l->pixels, l->rhs, l->Adiag, l->Aidx, w, 0, l->nmask2, ch, use_sse);
+    err += dt_heal_laplace_iteration(l->pixels, l->rhs, l->Adiag, l->Aidx, w, l->nmask2, l->nmask, ch, use_sse);
 
     if(err < err_exit) break;
   }
+}
+
+// Plain red/black Gauss-Seidel sweeps, which quickly damp the high frequency part of the error.
+// Returns the sum squared residual of the last sweep, scaled by 1/16.
+static float dt_heal_laplace_smooth(dt_heal_level_t *l, const int ch, const int use_sse, const int sweeps)
+{
+  float err = 0.f;
+  for(int sweep = 0; sweep < sweeps; sweep++)
+  {
+    err = dt_heal_laplace_iteration(l->pixels, l->rhs, l->Adiag, l->Aidx, .25f, 0, l->nmask2, ch, use_sse);
+    err += dt_heal_laplace_iteration(l->pixels, l->rhs, l->Adiag, l->Aidx, .25f, l->nmask2, l->nmask, ch, use_sse);
+  }
+  return err;
+}
+
+// Sum up the residuals of each 2x2 block of the fine level into the right hand side of the coarse one, and
+// reset the coarse correction.
+static void dt_heal_laplace_restrict(const dt_heal_level_t *fine, dt_heal_level_t *coarse, const int ch,
+                                     const int use_sse)
+{
+  const int width = fine->width;
+  const int height = fine->height;
+  const int cwidth = coarse->width;
+  const int cheight = coarse->height;
+  const float *const pixels = fine->pixels;
+  const float *const rhs = fine->rhs;
+  const float *const mask = fine->mask;
+  float *const cpixels = coarse->pixels;
+  float *const crhs = coarse->rhs;
+  const int nch = dt_heal_solved_channels(ch, use_sse);
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(pixels, rhs, mask, width, height, cwidth, cheight, cpixels, crhs, ch, nch) \
+  schedule(static)
+#endif
+  for(int ci = 0; ci < cheight; ci++)
+  {
+    for(int cj = 0; cj < cwidth; cj++)
+    {
+      const size_t c = ((size_t)ci * cwidth + cj) * ch;
+      for(int k = 0; k < ch; k++) cpixels[c + k] = crhs[c + k] = 0.f;
+      for(int i = 2 * ci; i < MIN(2 * ci + 2, height); i++)
+        for(int j = 2 * cj; j < MIN(2 * cj + 2, width); j++)
+        {
+          if(!mask[(size_t)i * width + j]) continue;
+          const size_t p = ((size_t)i * width + j) * ch;
+          const float a = 4 - (i == 0) - (j == 0) - (i == height - 1) - (j == width - 1);
+          for(int k = 0; k < nch; k++)
+          {
+            float sum = 0.f;
+            if(j < width - 1) sum += pixels[p + ch + k];
+            if(i < height - 1) sum += pixels[p + (size_t)width * ch + k];
+            if(j > 0) sum += pixels[p - ch + k];
+            if(i > 0) sum += pixels[p - (size_t)width * ch + k];
+            crhs[c + k] += (rhs ? rhs[p + k] : 0.f) - (a * pixels[p + k] - sum);
+          }
+        }
+    }
+  }
+}
+
+/* Add the bilinear interpolation of the coarse correction to the unknown
+ * pixels of the fine level. The centre of fine pixel j lies at j / 2 - 1/4 in
+ * coarse pixel coordinates.
+ */
+static void dt_heal_laplace_prolong(const dt_heal_level_t *coarse, dt_heal_level_t *fine, const int ch,
+                                    const int use_sse)
+{
+  const int width = fine->width;
+  const int height = fine->height;
+  const int cwidth = coarse->width;
+  const int cheight = coarse->height;
+  float *const pixels = fine->pixels;
+  const float *const mask = fine->mask;
+  const float *const cpixels = coarse->pixels;
+  const int nch = dt_heal_solved_channels(ch, use_sse);
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(pixels, mask, width, height, cwidth, cheight, cpixels, ch, nch) \
+  schedule(static)
+#endif
+  for(int i = 0; i < height; i++)
+  {
+    const float y = CLAMPS(0.5f * i - 0.25f, 0.f, cheight - 1);
+    const int y0 = (int)y;
+    const int y1 = MIN(y0 + 1, cheight - 1);
+    const float fy = y - y0;
+    for(int j = 0; j < width; j++)
+    {
+      if(!mask[(size_t)i * width + j]) continue;
+      const float x = CLAMPS(0.5f * j - 0.25f, 0.f, cwidth - 1);
+      const int x0 = (int)x;
+      const int x1 = MIN(x0 + 1, cwidth - 1);
+      const float fx = x - x0;
+      const float *const c00 = cpixels + ((size_t)y0 * cwidth + x0) * ch;
+      const float *const c01 = cpixels + ((size_t)y0 * cwidth + x1) * ch;
+      const float *const c10 = cpixels + ((size_t)y1 * cwidth + x0) * ch;
+      const float *const c11 = cpixels + ((size_t)y1 * cwidth + x1) * ch;
+      float *const px = pixels + ((size_t)i * width + j) * ch;
+      for(int k = 0; k < nch; k++)
+        px[k] += (1.f - fy) * ((1.f - fx) * c00[k] + fx * c01[k]) + fy * ((1.f - fx) * c10[k] + fx * c11[k]);
+    }
+  }
+}
+
+// One multigrid V-cycle from level l down. Returns the error of the last smoothing sweep on level l.
+static float dt_heal_laplace_vcycle(dt_heal_level_t *levels, const int l, const int nlevels, const int ch,
+                                    const int use_sse)
+{
+  if(l == nlevels - 1)
+  {
+    dt_heal_laplace_sor(levels + l, ch, use_sse);
+    return 0.f;
+  }
+  dt_heal_laplace_smooth(levels + l, ch, use_sse, HEAL_SMOOTH_SWEEPS);
+  dt_heal_laplace_restrict(levels + l, levels + l + 1, ch, use_sse);
+  dt_heal_laplace_vcycle(levels, l + 1, nlevels, ch, use_sse);
+  dt_heal_laplace_prolong(levels + l + 1, levels + l, ch, use_sse);
+  return dt_heal_laplace_smooth(levels + l, ch, use_sse, HEAL_SMOOTH_SWEEPS);
+}
+
+static void dt_heal_level_free(dt_heal_level_t *l, const gboolean owns_buffers)
+{
+  if(l->Adiag) dt_free_align(l->Adiag);
+  if(l->Aidx) dt_free_align(l->Aidx);
+  if(owns_buffers)
+  {
+    if(l->pixels) dt_free_align(l->pixels);
+    if(l->rhs) dt_free_align(l->rhs);
+    if(l->mask) dt_free_align(l->mask);
+  }
+  memset(l, 0, sizeof(*l));
+}
+
+// Solve the laplace equation for pixels and store the result in-place.
+static void dt_heal_laplace_loop(float *pixels, const int width, const int height, const int ch,
+                                 const float *const mask, const int use_sse)
+{
+  dt_heal_level_t levels[HEAL_MAX_LEVELS] = { { 0 } };
+  int nlevels = 1;
+
+  levels[0] = (dt_heal_level_t){ .width = width, .height = height, .pixels = pixels, .mask = (float *)mask };
+  if(!dt_heal_laplace_setup(levels, ch)) goto cleanup;
+
+  /* Build coarser levels by halving the resolution as long as there are
+   * enough unknowns left. A coarse pixel is unknown only if all the fine
+   * pixels it covers are: the coarse domain must not grow past the fine one,
+   * or the correction it computes near the mask border diverges.
+   */
+  while(nlevels < HEAL_MAX_LEVELS)
+  {
+    const dt_heal_level_t *fine = levels + nlevels - 1;
+    if(fine->nmask < HEAL_COARSE_MIN_PIXELS || fine->width < 3 || fine->height < 3) break;
+
+    dt_heal_level_t *coarse = levels + nlevels;
+    coarse->width = (fine->width + 1) / 2;
+    coarse->height = (fine->height + 1) / 2;
+    const size_t csize = (size_t)coarse->width * coarse->height;
+    coarse->pixels = dt_alloc_align_float(ch * (csize + 1));
+    coarse->rhs = dt_alloc_align_float(ch * csize);
+    coarse->mask = dt_alloc_align_float(csize);
+    // without memory for another level, solve with the ones we have, down to plain SOR on the finest one
+    if((coarse->pixels == NULL) || (coarse->rhs == NULL) || (coarse->mask == NULL))
+    {
+      fprintf(stderr, "dt_heal_laplace_loop: error allocating memory for healing, using %d level(s)\n", nlevels);
+      dt_heal_level_free(coarse, TRUE);
+      break;
+    }
+
+    for(int ci = 0; ci < coarse->height; ci++)
+      for(int cj = 0; cj < coarse->width; cj++)
+      {
+        int masked = 0, n = 0;
+        for(int i = 2 * ci; i < MIN(2 * ci + 2, fine->height); i++)
+          for(int j = 2 * cj; j < MIN(2 * cj + 2, fine->width); j++)
+          {
+            masked += (fine->mask[(size_t)i * fine->width + j] != 0.f);
+            n++;
+          }
+        coarse->mask[(size_t)ci * coarse->width + cj] = (masked == n) ? 1.f : 0.f;
+      }
+    if(!dt_heal_laplace_setup(coarse, ch))
+    {
+      dt_heal_level_free(coarse, TRUE);
+      break;
+    }
+    nlevels++;
+  }
+
+  if(nlevels == 1)
+  {
+    dt_heal_laplace_sor(levels, ch, use_sse);
+  }
+  else
+  {
+    /* V-cycles until the residual is well below the one SOR stops at: SOR
+     * creeps towards the solution, so its error at exit is much smaller than
+     * the residual bound suggests, and we don't want to heal any worse.
+     */
+    const int max_cycles = 100;
+    const float epsilon = (0.1 / 255);
+    const float err_exit = epsilon * epsilon * .05f * .05f;
+    for(int cycle = 0; cycle < max_cycles; cycle++)
+      if(dt_heal_laplace_vcycle(levels, 0, nlevels, ch, use_sse) < err_exit) break;
+  }
 
 cleanup:
-  if(Adiag) dt_free_align(Adiag);
-  if(Aidx) dt_free_align(Aidx);
+  for(int l = 0; l < nlevels; l++) dt_heal_level_free(levels + l, l > 0);
 }
 
 
@@ -71,6 +71,8 @@ void dt_history_delete_on_image_ext(int32_t imgid, gboolean undo)
 
   sqlite3_stmt *stmt;
 
+  dt_database_start_transaction(darktable.db);
+
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "DELETE FROM main.history WHERE imgid = ?1",
                               -1, &stmt, NULL);
@@ -108,6 +110,8 @@ void dt_history_delete_on_image_ext(int32_t imgid, gboolean undo)
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 
+  dt_database_release_transaction(darktable.db);
+
   _remove_preset_flag(imgid);
 
   /* if current image in develop reload history */
@@ -609,6 +613,8 @@ static int _history_copy_and_paste_on_image_overwrite(const int32_t imgid, const
   int ret_val = 0;
   sqlite3_stmt *stmt;
 
+  dt_database_start_transaction(darktable.db);
+
   // replace history stack
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "DELETE FROM main.history WHERE imgid = ?1",
@@ -752,11 +758,11 @@ static int _history_copy_and_paste_on_image_overwrite(const int32_t imgid, const
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
   }
-  else
-  {
-    // since the history and masks where deleted we can do a merge
-    ret_val = _history_copy_and_paste_on_image_merge(imgid, dest_imgid, ops, copy_full);
-  }
+
+  dt_database_release_transaction(darktable.db);
+
+  // since the history and masks where deleted we can do a merge
+  if(ops) ret_val = _history_copy_and_paste_on_image_merge(imgid, dest_imgid, ops, copy_full);
 
   return ret_val;
 }
@@ -1004,7 +1010,7 @@ void dt_history_compress_on_image(const int32_t imgid)
   const char *op_mask_manager = "mask_manager";
   gboolean manager_position = FALSE;
 
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "BEGIN", NULL, NULL, NULL);
+  dt_database_start_transaction(darktable.db);
 
   // We must know for sure whether there is a mask manager at slot 0 in history
   // because only if this is **not** true history nums and history_end must be increased
@@ -1098,7 +1104,7 @@ void dt_history_compress_on_image(const int32_t imgid)
   dt_unlock_image(imgid);
   dt_history_hash_write_from_history(imgid, DT_HISTORY_HASH_CURRENT);
 
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+  dt_database_release_transaction(darktable.db);
 
   DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals, DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, imgid);
 }
@@ -1119,7 +1125,7 @@ void dt_history_truncate_on_image(const int32_t imgid, const int32_t history_end
     return;
   }
 
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "BEGIN", NULL, NULL, NULL);
+  dt_database_start_transaction(darktable.db);
 
   // delete end of history
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
@@ -1153,7 +1159,7 @@ void dt_history_truncate_on_image(const int32_t imgid, const int32_t history_end
   dt_unlock_image(imgid);
   dt_history_hash_write_from_history(imgid, DT_HISTORY_HASH_CURRENT);
 
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+  dt_database_release_transaction(darktable.db);
 
   DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals, DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, imgid);
 }
@@ -1181,6 +1187,8 @@ int dt_history_compress_on_list(const GList *imgs)
 
       sqlite3_stmt *stmt2;
 
+      dt_database_start_transaction(darktable.db);
+
       // get highest num in history
       DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
         "SELECT MAX(num) FROM main.history WHERE imgid=?1", -1, &stmt2, NULL);
@@ -1231,6 +1239,8 @@ int dt_history_compress_on_list(const GList *imgs)
       sqlite3_step(stmt2);
       sqlite3_finalize(stmt2);
 
+      dt_database_release_transaction(darktable.db);
+
       dt_image_write_sidecar_file(imgid);
     }
     if (test == 0) // no compression as history_end is right in the middle of history
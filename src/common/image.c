@@ -1277,7 +1277,7 @@ static void _image_read_duplicates(const uint32_t id, const char *filename)
 }
 
 static uint32_t _image_import_internal(const int32_t film_id, const char *filename,
-                                       gboolean override_ignore_jpegs, gboolean lua_locking)
+                                       gboolean override_ignore_jpegs, gboolean lua_locking, void *exif_preload)
 {
   char *normalized_filename = dt_util_normalize_path(filename);
   if(!normalized_filename
@@ -1492,7 +1492,10 @@ static uint32_t _image_import_internal(const int32_t film_id, const char *filena
   img->group_id = group_id;
 
   // read dttags and exif for database queries!
-  (void)dt_exif_read(img, normalized_filename);
+  if(exif_preload)
+    (void)dt_exif_read_preloaded(img, normalized_filename, exif_preload);
+  else
+    (void)dt_exif_read(img, normalized_filename);
   char dtfilename[PATH_MAX] = { 0 };
   g_strlcpy(dtfilename, normalized_filename, sizeof(dtfilename));
   // dt_image_path_append_version(id, dtfilename, sizeof(dtfilename));
@@ -1562,12 +1565,18 @@ static uint32_t _image_import_internal(const int32_t film_id, const char *filena
 
 uint32_t dt_image_import(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs)
 {
-  return _image_import_internal(film_id, filename, override_ignore_jpegs, TRUE);
+  return _image_import_internal(film_id, filename, override_ignore_jpegs, TRUE, NULL);
+}
+
+uint32_t dt_image_import_preloaded(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs,
+                                   void *exif_preload)
+{
+  return _image_import_internal(film_id, filename, override_ignore_jpegs, TRUE, exif_preload);
 }
 
 uint32_t dt_image_import_lua(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs)
 {
-  return _image_import_internal(film_id, filename, override_ignore_jpegs, FALSE);
+  return _image_import_internal(film_id, filename, override_ignore_jpegs, FALSE, NULL);
 }
 
 void dt_image_init(dt_image_t *img)
@@ -2299,10 +2308,27 @@ void dt_image_write_sidecar_file(const int32_t imgid)
       DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
       sqlite3_step(stmt);
       sqlite3_finalize(stmt);
+      dt_image_store_xmp_stat(imgid, filename);
     }
   }
 }
 
+void dt_image_store_xmp_stat(const int32_t imgid, const char *xmp_filename)
+{
+  GStatBuf statbuf;
+  if(g_stat(xmp_filename, &statbuf)) return;
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "UPDATE main.images SET xmp_mtime = ?2, xmp_size = ?3 WHERE id = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 2, statbuf.st_mtime);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 3, statbuf.st_size);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
 void dt_image_synch_xmps(const GList *img)
 {
   if(!img) return;
@@ -274,6 +274,9 @@ int dt_image_get_xmp_rating_from_flags(const int flags);
 GList* dt_image_find_duplicates(const char* filename);
 /** imports a new image from raw/etc file and adds it to the data base and image cache. Use from threads other than lua.*/
 uint32_t dt_image_import(int32_t film_id, const char *filename, gboolean override_ignore_jpegs);
+/** same as dt_image_import() with exif data already parsed by dt_exif_preload(). the caller still owns it.*/
+uint32_t dt_image_import_preloaded(int32_t film_id, const char *filename, gboolean override_ignore_jpegs,
+                                   void *exif_preload);
 /** imports a new image from raw/etc file and adds it to the data base and image cache. Use from lua thread.*/
 uint32_t dt_image_import_lua(int32_t film_id, const char *filename, gboolean override_ignore_jpegs);
 /** removes the given image from the database. */
@@ -368,6 +371,8 @@ gboolean dt_image_safe_remove(const int32_t imgid);
 void dt_image_local_copy_synch(void);
 // xmp functions:
 void dt_image_write_sidecar_file(const int32_t imgid);
+/** remember mtime and size of the xmp sidecar as written by us, used by the crawler to detect external changes */
+void dt_image_store_xmp_stat(const int32_t imgid, const char *xmp_filename);
 void dt_image_synch_xmp(const int selected);
 void dt_image_synch_xmps(const GList *img);
 void dt_image_synch_all_xmp(const gchar *pathname);
@@ -44,6 +44,9 @@ typedef struct dt_imageio_jpeg_t
 
 /** reads the header and fills width/height in jpg struct. */
 int dt_imageio_jpeg_decompress_header(const void *in, size_t length, dt_imageio_jpeg_t *jpg);
+/** after reading the header: let libjpeg decode at 1/2, 1/4 or 1/8 size as long as the result still covers
+ * max_width x max_height (in either orientation). updates width/height in jpg struct. */
+void dt_imageio_jpeg_set_scale(dt_imageio_jpeg_t *jpg, const uint32_t max_width, const uint32_t max_height);
 /** reads the whole image to the out buffer, which has to be large enough. */
 int dt_imageio_jpeg_decompress(dt_imageio_jpeg_t *jpg, uint8_t *out);
 /** compresses in to out buffer with given quality (0..100). out buffer must be large enough. returns actual
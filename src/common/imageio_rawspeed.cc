@@ -24,6 +24,18 @@
 
 #include <memory>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#else
+#include <sys/mount.h>
+#endif
+#endif
+
 #define __STDC_LIMIT_MACROS
 
 extern "C" {
@@ -103,6 +115,100 @@ void dt_rawspeed_lookup_makermodel(const char *maker, const char *model,
   }
 }
 
+// read-only mapping of a raw file. rawspeed decodes straight from the page cache instead of from a
+// heap copy of the whole file, and the kernel reads ahead while the decoder works its way through it.
+// accessing a page that isn't backed by the file anymore raises SIGBUS, so this is only done on fixed local
+// filesystems. network shares and removable media, where the file can go away or get truncated while we
+// decode it, are read into memory as before.
+class dt_rawspeed_mapped_file_t
+{
+public:
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+
+  dt_rawspeed_mapped_file_t() = default;
+  dt_rawspeed_mapped_file_t(const dt_rawspeed_mapped_file_t &) = delete;
+  dt_rawspeed_mapped_file_t &operator=(const dt_rawspeed_mapped_file_t &) = delete;
+  ~dt_rawspeed_mapped_file_t() { unmap(); }
+
+  bool map(const char *filename)
+  {
+#ifndef _WIN32
+    const int fd = open(filename, O_RDONLY);
+    if(fd < 0) return false;
+
+    struct stat st;
+    // rawspeed buffers are limited to 32 bit sizes, let FileReader report anything bigger
+    if(fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size <= 0 || (uint64_t)st.st_size > UINT32_MAX
+       || !is_local(fd))
+    {
+      close(fd);
+      return false;
+    }
+
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after closing the descriptor
+    close(fd);
+    if(addr == MAP_FAILED) return false;
+
+#ifdef MADV_SEQUENTIAL
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_WILLNEED
+    madvise(addr, st.st_size, MADV_WILLNEED);
+#endif
+
+    data = (const uint8_t *)addr;
+    size = st.st_size;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  void unmap()
+  {
+#ifndef _WIN32
+    if(data) munmap((void *)data, size);
+#endif
+    data = nullptr;
+    size = 0;
+  }
+
+private:
+  static bool is_local(const int fd)
+  {
+#if defined(__linux__)
+    struct statfs sfs;
+    if(fstatfs(fd, &sfs)) return false;
+    switch((uint32_t)sfs.f_type)
+    {
+      case 0xEF53:     // ext2/3/4
+      case 0x58465342: // xfs
+      case 0x9123683E: // btrfs
+      case 0xF2F52010: // f2fs
+      case 0x2FC12FC1: // zfs
+      case 0x3153464A: // jfs
+      case 0x52654973: // reiserfs
+      case 0xCA451A4E: // bcachefs
+      case 0x01021994: // tmpfs
+        return true;
+      default:
+        return false;
+    }
+#elif defined(MNT_LOCAL)
+    struct statfs sfs;
+    if(fstatfs(fd, &sfs)) return false;
+#ifdef MNT_REMOVABLE
+    if(sfs.f_flags & MNT_REMOVABLE) return false;
+#endif
+    return (sfs.f_flags & MNT_LOCAL) != 0;
+#else
+    return false;
+#endif
+  }
+};
+
 uint32_t dt_rawspeed_crop_dcraw_filters(uint32_t filters, uint32_t crop_x, uint32_t crop_y)
 {
   if(!filters || filters == 9u) return filters;
@@ -119,6 +225,8 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
   snprintf(filen, sizeof(filen), "%s", filename);
   FileReader f(filen);
 
+  // has to outlive the decoder and the buffer referencing it
+  dt_rawspeed_mapped_file_t mapped;
   std::unique_ptr<RawDecoder> d;
   std::unique_ptr<const Buffer> m;
 
@@ -127,7 +235,10 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
     dt_rawspeed_load_meta();
 
     dt_pthread_mutex_lock(&darktable.readFile_mutex);
-    m = f.readFile();
+    if(mapped.map(filen))
+      m.reset(new Buffer(mapped.data, (Buffer::size_type)mapped.size));
+    else
+      m = f.readFile();
     dt_pthread_mutex_unlock(&darktable.readFile_mutex);
 
     RawParser t(m.get());
@@ -223,6 +334,7 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
     /* free auto pointers on spot */
     d.reset();
     m.reset();
+    mapped.unmap();
 
     // Grab the WB
     for(int i = 0; i < 4; i++) img->wb_coeffs[i] = r->metadata.wbCoeffs[i];
@@ -189,6 +189,42 @@ static inline __m128 convolve14641_vert(const float *in, const int wd)
 #endif
 
 #if defined(__SSE2__)
+// one row of gauss_reduce_sse2(), without the boundary columns.
+// fine points to the first of the five input rows the row is blurred from.
+static inline void gauss_reduce_row_sse2(
+    const float *const fine,  // fine input rows
+    float *const coarse,      // coarse output row
+    const int wd)             // fine width
+{
+  const int cw = (wd-1)/2+1;
+  const float *base = fine;
+  float *const out = coarse + 1;
+  // prime the vertical axis
+  const __m128 kernel = _mm_setr_ps(1.f, 4.f, 6.f, 4.f);
+  __m128 left = convolve14641_vert(base,wd);
+  for(int col=0; col<cw-3; col+=2)
+  {
+    // convolve the next four pixel wide vertical slice
+    base += 4;
+    __m128 right = convolve14641_vert(base,wd);
+    // horizontal pass, generate two output values from convolving with 1 4 6 4 1
+    // the first uses pixels 0-4, the second uses 2-6
+    __m128 conv = _mm_mul_ps(left,kernel);
+    out[col] = (conv[0] + conv[1] + conv[2] + conv[3] + right[0]) / 256.f;
+    out[col+1] = (left[2] + 4*(left[3]+right[1]) + 6*right[0] + right[2]) / 256.f;
+    // shift to next pair of output columns (four input columns)
+    left = right;
+  }
+  // handle the left-over pixel if the output size is odd
+  if (cw % 2)
+  {
+    base += 4;
+    float right = base[0] + 4*(base[wd]+base[3*wd]) + 6*base[2*wd] + base[4*wd];
+    __m128 conv = _mm_mul_ps(left,kernel);
+    out[cw-3] = (conv[0] + conv[1] + conv[2] + conv[3] + right) / 256.f;
+  }
+}
+
 static inline void gauss_reduce_sse2(
     const float *const input, // fine input buffer
     float *const coarse,      // coarse scale, blurred input buf
@@ -206,38 +242,30 @@ static inline void gauss_reduce_sse2(
       schedule(static)
 #endif
   for(int j=1;j<ch-1;j++)
-  {
-    const float *base = input + 2*(j-1)*wd;
-    float *const out = coarse + j*cw + 1;
-    // prime the vertical axis
-    const __m128 kernel = _mm_setr_ps(1.f, 4.f, 6.f, 4.f);
-    __m128 left = convolve14641_vert(base,wd);
-    for(int col=0; col<cw-3; col+=2)
-    {
-      // convolve the next four pixel wide vertical slice
-      base += 4;
-      __m128 right = convolve14641_vert(base,wd);
-      // horizontal pass, generate two output values from convolving with 1 4 6 4 1
-      // the first uses pixels 0-4, the second uses 2-6
-      __m128 conv = _mm_mul_ps(left,kernel);
-      out[col] = (conv[0] + conv[1] + conv[2] + conv[3] + right[0]) / 256.f;
-      out[col+1] = (left[2] + 4*(left[3]+right[1]) + 6*right[0] + right[2]) / 256.f;
-      // shift to next pair of output columns (four input columns)
-      left = right;
-    }
-    // handle the left-over pixel if the output size is odd
-    if (cw % 2)
-    {
-      base += 4;
-      float right = base[0] + 4*(base[wd]+base[3*wd]) + 6*base[2*wd] + base[4*wd];
-      __m128 conv = _mm_mul_ps(left,kernel);
-      out[cw-3] = (conv[0] + conv[1] + conv[2] + conv[3] + right) / 256.f;
-    }
-  }
+    gauss_reduce_row_sse2(input + 2*(j-1)*wd, coarse + j*cw, wd);
   ll_fill_boundary1(coarse, cw, ch);
 }
 #endif
 
+// one row of gauss_reduce(), without the boundary columns.
+// fine points to the first of the five input rows the row is blurred from.
+static inline void gauss_reduce_row(
+    const float *const fine,  // fine input rows
+    float *const coarse,      // coarse output row
+    const int wd)             // fine width
+{
+  const int cw = (wd-1)/2+1;
+  const float w[5] = { 1.f/16.f, 4.f/16.f, 6.f/16.f, 4.f/16.f, 1.f/16.f };
+  for(int i=1;i<cw-1;i++)
+  {
+    float sum = 0.0f;
+    for(int jj=0;jj<5;jj++)
+      for(int ii=-2;ii<=2;ii++)
+        sum += fine[jj*wd+2*i+ii] * w[ii+2] * w[jj];
+    coarse[i] = sum;
+  }
+}
+
 static inline void gauss_reduce(
     const float *const input, // fine input buffer
     float *const coarse,      // coarse scale, blurred input buf
@@ -247,25 +275,16 @@ static inline void gauss_reduce(
   // blur, store only coarse res
   const int cw = (wd-1)/2+1, ch = (ht-1)/2+1;
 
-  // this is the scalar (non-simd) code:
-  const float w[5] = { 1.f/16.f, 4.f/16.f, 6.f/16.f, 4.f/16.f, 1.f/16.f };
-  memset(coarse, 0, sizeof(float)*cw*ch);
-  // direct 5x5 stencil only on required pixels:
+  // this is the scalar (non-simd) code, direct 5x5 stencil only on required pixels:
 #ifdef _OPENMP
   // DON'T parallelize the very smallest levels of the pyramid, as the threading overhead
   // is greater than the time needed to do it sequentially
 #pragma omp parallel for default(none) if (ch*cw>500)  \
-  dt_omp_firstprivate(coarse, cw, ch, input, w, wd) \
-  schedule(static) \
-  collapse(2)
+  dt_omp_firstprivate(coarse, cw, ch, input, wd) \
+  schedule(static)
 #endif
   for(int j=1;j<ch-1;j++)
-    for(int i=1;i<cw-1;i++)
-    {
-      for(int jj=-2;jj<=2;jj++)
-        for(int ii=-2;ii<=2;ii++)
-          coarse[j*cw+i] += input[(2*j+jj)*wd+2*i+ii] * w[ii+2] * w[jj+2];
-    }
+    gauss_reduce_row(input + 2*(j-1)*wd, coarse + j*cw, wd);
   ll_fill_boundary1(coarse, cw, ch);
 }
 
@@ -428,6 +447,24 @@ static inline float curve_scalar(
   return val;
 }
 
+// one row of apply_curve(), including the replicated padding columns
+static inline void ll_curve_row(
+    float *const out,
+    const float *const in,
+    const int w,
+    const int padding,
+    const float g,
+    const float sigma,
+    const float shadows,
+    const float highlights,
+    const float clarity)
+{
+  for(int i=padding;i<w-padding;i++)
+    out[i] = curve_scalar(in[i], g, sigma, shadows, highlights, clarity);
+  for(int i=0;i<padding;i++)   out[i] = out[padding];
+  for(int i=w-padding;i<w;i++) out[i] = out[w-padding-1];
+}
+
 #if defined(__SSE2__)
 static inline __m128 curve_vec4(
     const __m128 x,
@@ -548,16 +585,383 @@ void apply_curve(
   schedule(static)
 #endif
   for(uint32_t j=padding;j<h-padding;j++)
+    ll_curve_row(out + j*w, in + j*w, w, padding, g, sigma, shadows, highlights, clarity);
+  pad_by_replication(out, w, h, padding);
+}
+
+// without a boundary from the preview, the finest levels are processed in horizontal bands of this many rows
+// of the finest level, so only the bands and the coarse levels need to be in memory at once
+#define band_height 128
+// the number of levels processed in bands, all coarser ones are kept in full
+#define band_levels 3
+
+// rows [*f0,*f1) of a level of height ht are blurred into rows [c0,c1) of the next coarser level
+static inline void ll_reduce_rows(const int c0, const int c1, const int ht, int *f0, int *f1)
+{
+  const int ch = (ht-1)/2+1;
+  *f0 = 2*CLAMPS(c0, 1, ch-2) - 2;
+  *f1 = 2*CLAMPS(c1-1, 1, ch-2) + 3;
+}
+
+// rows [*c0,*c1) of the next coarser level are upsampled into rows [f0,f1) of a level of height ht
+static inline void ll_expand_rows(const int f0, const int f1, const int ht, int *c0, int *c1)
+{
+  const int last = ((ht-1)&~1)-1;
+  *c0 = (CLAMPS(f0, 1, last)-1)/2;
+  *c1 = CLAMPS(f1-1, 1, last)/2 + 2;
+}
+
+// first pass: rows [rb0,rb1) of the banded levels needed to compute rows [c0,c1) of the first full level
+static void ll_reduce_band(const int h, const int levels, const int c0, const int c1, int *rb0, int *rb1)
+{
+  rb0[levels] = c0;
+  rb1[levels] = c1;
+  for(int l=levels-1;l>=0;l--)
+    ll_reduce_rows(rb0[l+1], rb1[l+1], dl(h,l), rb0+l, rb1+l);
+}
+
+// second pass: rows [ro0,ro1) of the output and [rb0,rb1) of the input and curve pyramids on the banded
+// levels needed to assemble rows [a,b) of the finest output level
+static void ll_assemble_band(const int h, const int levels, const int a, const int b,
+                             int *ro0, int *ro1, int *rb0, int *rb1)
+{
+  ro0[0] = a;
+  ro1[0] = b;
+  for(int l=0;l<levels;l++)
+    ll_expand_rows(ro0[l], ro1[l], dl(h,l), ro0+l+1, ro1+l+1);
+  rb0[levels-1] = ro0[levels-1];
+  rb1[levels-1] = ro1[levels-1];
+  for(int l=levels-2;l>=0;l--)
   {
-    const float *in2  = in  + j*w + padding;
-    float *out2 = out + j*w + padding;
-    for(uint32_t i=padding;i<w-padding;i++)
-      (*out2++) = curve_scalar(*(in2++), g, sigma, shadows, highlights, clarity);
-    out2 = out + j*w;
-    for(int i=0;i<padding;i++)   out2[i] = out2[padding];
-    for(int i=w-padding;i<w;i++) out2[i] = out2[w-padding-1];
+    int f0, f1;
+    ll_reduce_rows(rb0[l+1], rb1[l+1], dl(h,l), &f0, &f1);
+    rb0[l] = MIN(ro0[l], f0);
+    rb1[l] = MAX(ro1[l], f1);
+  }
+}
+
+// largest number of rows any band of either pass needs on each banded level,
+// for the output (rows_o) and the input and curve pyramids (rows_b)
+static void ll_band_rows(const int h, const int ht, const int max_supp, const int levels,
+                         int *rows_o, int *rows_b)
+{
+  int ro0[max_levels], ro1[max_levels], rb0[max_levels], rb1[max_levels];
+  for(int l=0;l<levels;l++) rows_o[l] = rows_b[l] = 0;
+  if(!levels) return;
+
+  const int ch = dl(h,levels), cband = band_height >> levels;
+  for(int c=0;c<ch;c+=cband)
+  {
+    ll_reduce_band(h, levels, c, MIN(c+cband, ch), rb0, rb1);
+    for(int l=0;l<levels;l++) rows_b[l] = MAX(rows_b[l], rb1[l]-rb0[l]);
+  }
+  for(int a=max_supp;a<max_supp+ht;a+=band_height)
+  {
+    ll_assemble_band(h, levels, a, MIN(a+band_height, max_supp+ht), ro0, ro1, rb0, rb1);
+    for(int l=0;l<levels;l++)
+    {
+      rows_o[l] = MAX(rows_o[l], ro1[l]-ro0[l]);
+      rows_b[l] = MAX(rows_b[l], rb1[l]-rb0[l]);
+    }
+  }
+}
+
+// one row of ll_pad_input() without a boundary from the preview
+static inline void ll_pad_row(
+    float *const out,
+    const float *const input,
+    const int wd,
+    const int ht,
+    const int max_supp,
+    const int j)
+{
+  const int stride = 4;
+  const float *const in = input + (size_t)stride*wd*CLAMPS(j-max_supp, 0, ht-1);
+  for(int i=0;i<max_supp;i++)
+    out[i] = in[0] * 0.01f; // L -> [0,1]
+  for(int i=0;i<wd;i++)
+    out[i+max_supp] = in[stride*i] * 0.01f;
+  for(int i=wd+max_supp;i<wd+2*max_supp;i++)
+    out[i] = in[stride*(wd-1)] * 0.01f;
+}
+
+// one row of gauss_reduce() or gauss_reduce_sse2(), including the boundary columns
+static inline void ll_reduce_row(
+    const float *const fine,
+    float *const coarse,
+    const int wd,
+    const int use_sse2)
+{
+  const int cw = (wd-1)/2+1;
+#if defined(__SSE2__)
+  if(use_sse2)
+    gauss_reduce_row_sse2(fine, coarse, wd);
+  else
+#endif
+    gauss_reduce_row(fine, coarse, wd);
+  coarse[0] = coarse[1];
+  coarse[cw-1] = coarse[cw-2];
+}
+
+// fill rows [rb0[l],rb1[l]) of levels 0..top of the padded input pyramid and of all curve pyramids.
+// row j of level l is stored in row j-off[l] of pad[l] and buf[k][l].
+static void ll_fill_band(
+    const float *const input,
+    const int wd,
+    const int ht,
+    const int max_supp,
+    const int w,
+    const int h,
+    const int top,
+    const int *const rb0,
+    const int *const rb1,
+    const int *const off,
+    float *const *const pad,
+    float *(*const buf)[max_levels],
+    const float *const gamma,
+    const float sigma,
+    const float shadows,
+    const float highlights,
+    const float clarity,
+    const int use_sse2)
+{
+  const int r0 = rb0[0], r1 = rb1[0], off0 = off[0];
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(input, wd, ht, max_supp, w, r0, r1, off0, pad, buf, gamma) \
+  dt_omp_firstprivate(sigma, shadows, highlights, clarity) \
+  schedule(static)
+#endif
+  for(int j=r0;j<r1;j++)
+  {
+    float *const row = pad[0] + (size_t)(j-off0)*w;
+    ll_pad_row(row, input, wd, ht, max_supp, j);
+    for(int k=0;k<num_gamma;k++)
+      ll_curve_row(buf[k][0] + (size_t)(j-off0)*w, row, w, max_supp, gamma[k], sigma, shadows, highlights,
+                   clarity);
+  }
+
+  for(int l=1;l<=top;l++)
+  {
+    const int fw = dl(w,l-1), cw = dl(w,l), ch = dl(h,l);
+    const int c0 = rb0[l], c1 = rb1[l], foff = off[l-1], coff = off[l];
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(fw, cw, ch, c0, c1, foff, coff, l, pad, buf, use_sse2) \
+    schedule(static)
+#endif
+    for(int j=c0;j<c1;j++)
+    {
+      // the boundary rows are copies of their neighbours
+      const size_t fine = (size_t)(2*CLAMPS(j, 1, ch-2)-2-foff)*fw;
+      const size_t coarse = (size_t)(j-coff)*cw;
+      ll_reduce_row(pad[l-1] + fine, pad[l] + coarse, fw, use_sse2);
+      for(int k=0;k<num_gamma;k++)
+        ll_reduce_row(buf[k][l-1] + fine, buf[k][l] + coarse, fw, use_sse2);
+    }
+  }
+}
+
+// rows [j0,j1) and columns [i0,i1) of one output level: the upsampled coarser output level plus the laplacians
+// of the two curves closest to the input brightness. row j of each buffer is stored in row j minus its offset.
+static void ll_assemble_rows(
+    float *const output,              // output level
+    const int out_off,
+    const float *const coarse,        // next coarser output level
+    const int coarse_off,
+    const float *const padded,        // padded input at this level
+    const float *const *const fine,   // curve pyramids at this level, same offset as padded
+    const int fine_off,
+    const float *const *const cbuf,   // curve pyramids at the next coarser level
+    const int cbuf_off,
+    const float *const gamma,
+    const int pw,
+    const int ph,
+    const int j0,
+    const int j1,
+    const int i0,
+    const int i1)
+{
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(output, out_off, coarse, coarse_off, padded, fine, fine_off, cbuf, cbuf_off, gamma) \
+  dt_omp_firstprivate(pw, ph, j0, j1, i0, i1) \
+  schedule(static)
+#endif
+  for(int j=j0;j<j1;j++)
+  {
+    // same clamping as gauss_expand() and ll_laplacian()
+    const int jc = CLAMPS(j, 1, ((ph-1)&~1)-1);
+    const float *const v_row = padded + (size_t)(j-fine_off)*pw;
+    float *const out_row = output + (size_t)(j-out_off)*pw;
+    for(int i=i0;i<i1;i++)
+    {
+      const int ic = CLAMPS(i, 1, ((pw-1)&~1)-1);
+      const float v = v_row[i];
+      int hi = 1;
+      for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
+      int lo = hi-1;
+      const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
+      const float l0 = fine[lo][(size_t)(j-fine_off)*pw+i]
+                       - ll_expand_gaussian(cbuf[lo], ic, jc-2*cbuf_off, pw, ph);
+      const float l1 = fine[hi][(size_t)(j-fine_off)*pw+i]
+                       - ll_expand_gaussian(cbuf[hi], ic, jc-2*cbuf_off, pw, ph);
+      out_row[i] = ll_expand_gaussian(coarse, ic, jc-2*coarse_off, pw, ph) + (l0 * (1.0f-a) + l1 * a);
+    }
+  }
+}
+
+// local_laplacian_internal() without boundary: instead of all pyramids in full, keep only the coarse levels
+// in full and process the finest band_levels levels in bands of rows with enough overlap. the first pass
+// streams over the image to compute the first full level, the second pass recomputes the fine levels of
+// each band and assembles the output. the results are the same as with full pyramids.
+static void local_laplacian_banded(
+    const float *const input,
+    float *const out,
+    const int wd,
+    const int ht,
+    const float sigma,
+    const float shadows,
+    const float highlights,
+    const float clarity,
+    const int use_sse2)
+{
+  const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(wd,ht)));
+  const int last_level = num_levels-1;
+  const int max_supp = 1<<last_level;
+  const int w = wd + 2*max_supp, h = ht + 2*max_supp;
+  const int levels = MIN(band_levels, last_level);
+
+  // evenly sample brightness [0,1]:
+  float gamma[num_gamma] = {0.0f};
+  for(int k=0;k<num_gamma;k++) gamma[k] = (k+.5f)/(float)num_gamma;
+
+  // full coarse levels. as in local_laplacian_internal(), the coarsest level of the input pyramid
+  // goes directly to the output.
+  float *padded[max_levels] = {0};
+  float *output[max_levels] = {0};
+  float *buf[num_gamma][max_levels] = {{0}};
+  for(int l=levels;l<=last_level;l++)
+  {
+    if(l < last_level) padded[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
+    output[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
+    for(int k=0;k<num_gamma;k++) buf[k][l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
+  }
+
+  // bands of the fine levels
+  int rows_o[max_levels], rows_b[max_levels];
+  ll_band_rows(h, ht, max_supp, levels, rows_o, rows_b);
+  float *bpad[max_levels] = {0};
+  float *bout[max_levels] = {0};
+  float *bbuf[num_gamma][max_levels] = {{0}};
+  for(int l=0;l<levels;l++)
+  {
+    bpad[l] = dt_alloc_align_float((size_t)dl(w,l) * rows_b[l]);
+    bout[l] = dt_alloc_align_float((size_t)dl(w,l) * rows_o[l]);
+    for(int k=0;k<num_gamma;k++) bbuf[k][l] = dt_alloc_align_float((size_t)dl(w,l) * rows_b[l]);
+  }
+
+  int rb0[max_levels], rb1[max_levels], ro0[max_levels], ro1[max_levels], off[max_levels];
+
+  // first pass: stream over the image to fill the first full level
+  bpad[levels] = levels < last_level ? padded[levels] : output[last_level];
+  for(int k=0;k<num_gamma;k++) bbuf[k][levels] = buf[k][levels];
+  const int ch = dl(h,levels), cband = band_height >> levels;
+  for(int c=0;c<ch;c+=cband)
+  {
+    ll_reduce_band(h, levels, c, MIN(c+cband, ch), rb0, rb1);
+    for(int l=0;l<levels;l++) off[l] = rb0[l];
+    off[levels] = 0;
+    ll_fill_band(input, wd, ht, max_supp, w, h, levels, rb0, rb1, off, bpad, bbuf, gamma, sigma, shadows,
+                 highlights, clarity, use_sse2);
+  }
+
+  // create the remaining coarse levels of the gauss pyramids
+  for(int l=levels+1;l<=last_level;l++)
+  {
+    float *const dst = l < last_level ? padded[l] : output[last_level];
+#if defined(__SSE2__)
+    if(use_sse2)
+    {
+      gauss_reduce_sse2(padded[l-1], dst, dl(w,l-1), dl(h,l-1));
+      for(int k=0;k<num_gamma;k++) gauss_reduce_sse2(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
+    }
+    else
+#endif
+    {
+      gauss_reduce(padded[l-1], dst, dl(w,l-1), dl(h,l-1));
+      for(int k=0;k<num_gamma;k++) gauss_reduce(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
+    }
+  }
+
+  // assemble the full output levels coarse to fine
+  for(int l=last_level-1;l>=levels;l--)
+  {
+    const float *fine[num_gamma], *cbuf[num_gamma];
+    for(int k=0;k<num_gamma;k++)
+    {
+      fine[k] = buf[k][l];
+      cbuf[k] = buf[k][l+1];
+    }
+    ll_assemble_rows(output[l], 0, output[l+1], 0, padded[l], fine, 0, cbuf, 0, gamma, dl(w,l), dl(h,l),
+                     0, dl(h,l), 0, dl(w,l));
+  }
+
+  // second pass: recompute the fine levels band by band and assemble the output from them.
+  // on the finest level only the unpadded image is needed.
+  for(int a=max_supp;a<max_supp+ht;a+=band_height)
+  {
+    const int b = MIN(a+band_height, max_supp+ht);
+    ll_assemble_band(h, levels, a, b, ro0, ro1, rb0, rb1);
+    for(int l=0;l<levels;l++) off[l] = rb0[l];
+    ll_fill_band(input, wd, ht, max_supp, w, h, levels-1, rb0, rb1, off, bpad, bbuf, gamma, sigma, shadows,
+                 highlights, clarity, use_sse2);
+
+    for(int l=levels-1;l>=0;l--)
+    {
+      const int full = l+1 == levels;
+      const float *fine[num_gamma], *cbuf[num_gamma];
+      for(int k=0;k<num_gamma;k++)
+      {
+        fine[k] = bbuf[k][l];
+        cbuf[k] = full ? buf[k][l+1] : bbuf[k][l+1];
+      }
+      ll_assemble_rows(bout[l], ro0[l], full ? output[l+1] : bout[l+1], full ? 0 : ro0[l+1], bpad[l], fine,
+                       rb0[l], cbuf, full ? 0 : rb0[l+1], gamma, dl(w,l), dl(h,l), ro0[l], ro1[l],
+                       l ? 0 : max_supp, l ? dl(w,l) : max_supp+wd);
+    }
+
+    const float *const out0 = bout[0];
+    const int o0 = ro0[0];
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(input, out, out0, o0, a, b, wd, w, max_supp) \
+    schedule(static)
+#endif
+    for(int j=a;j<b;j++)
+    {
+      const size_t k = (size_t)(j-max_supp)*wd;
+      for(int i=0;i<wd;i++)
+      {
+        out[4*(k+i)+0] = 100.0f * out0[(size_t)(j-o0)*w+max_supp+i]; // [0,1] -> L
+        out[4*(k+i)+1] = input[4*(k+i)+1]; // copy original colour channels
+        out[4*(k+i)+2] = input[4*(k+i)+2];
+      }
+    }
+  }
+
+  for(int l=0;l<max_levels;l++)
+  {
+    dt_free_align(padded[l]);
+    dt_free_align(output[l]);
+    for(int k=0;k<num_gamma;k++) dt_free_align(buf[k][l]);
+    if(l < levels)
+    {
+      dt_free_align(bpad[l]);
+      dt_free_align(bout[l]);
+      for(int k=0;k<num_gamma;k++) dt_free_align(bbuf[k][l]);
+    }
   }
-  pad_by_replication(out, w, h, padding);
 }
 
 void local_laplacian_internal(
@@ -574,6 +978,12 @@ void local_laplacian_internal(
 {
   if(wd <= 1 || ht <= 1) return;
 
+  if((!b || b->mode == 0) && MIN(wd,ht) >= 4)
+  {
+    local_laplacian_banded(input, out, wd, ht, sigma, shadows, highlights, clarity, use_sse2);
+    return;
+  }
+
   // don't divide by 2 more often than we can:
   const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(wd,ht)));
   int last_level = num_levels-1;
@@ -768,6 +1178,49 @@ void local_laplacian_internal(
 
 size_t local_laplacian_memory_use(const int width,     // width of input image
                                   const int height)    // height of input image
+{
+  const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(width,height)));
+  const int last_level = num_levels-1;
+  const int max_supp = 1<<last_level;
+  const int paddwd = width  + 2*max_supp;
+  const int paddht = height + 2*max_supp;
+  const int levels = MIN(band_levels, last_level);
+
+  size_t memory_use = 0;
+
+  // full coarse levels, see local_laplacian_banded()
+  for(int l=levels;l<=last_level;l++)
+    memory_use += sizeof(float) * ((l < last_level) + 1 + num_gamma) * dl(paddwd, l) * dl(paddht, l);
+
+  // bands of the fine levels
+  int rows_o[max_levels], rows_b[max_levels];
+  ll_band_rows(paddht, height, max_supp, levels, rows_o, rows_b);
+  for(int l=0;l<levels;l++)
+    memory_use += sizeof(float) * dl(paddwd, l) * ((size_t)rows_o[l] + (size_t)(1 + num_gamma) * rows_b[l]);
+
+  return memory_use;
+}
+
+size_t local_laplacian_singlebuffer_size(const int width,     // width of input image
+                                         const int height)    // height of input image
+{
+  const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(width,height)));
+  const int last_level = num_levels-1;
+  const int max_supp = 1<<last_level;
+  const int paddwd = width  + 2*max_supp;
+  const int paddht = height + 2*max_supp;
+  const int levels = MIN(band_levels, last_level);
+
+  int rows_o[max_levels], rows_b[max_levels];
+  ll_band_rows(paddht, height, max_supp, levels, rows_o, rows_b);
+  const size_t band = levels ? (size_t)paddwd * MAX(rows_o[0], rows_b[0]) : 0;
+
+  return sizeof(float) * MAX(band, (size_t)dl(paddwd, levels) * dl(paddht, levels));
+}
+
+// the opencl code path and local_laplacian_internal() with a preview boundary keep all levels in full
+size_t local_laplacian_memory_use_full(const int width,     // width of input image
+                                       const int height)    // height of input image
 {
   const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(width,height)));
   const int max_supp = 1<<(num_levels-1);
@@ -782,8 +1235,8 @@ size_t local_laplacian_memory_use(const int width,     // width of input image
   return memory_use;
 }
 
-size_t local_laplacian_singlebuffer_size(const int width,     // width of input image
-                                         const int height)    // height of input image
+size_t local_laplacian_singlebuffer_size_full(const int width,     // width of input image
+                                              const int height)    // height of input image
 {
   const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(width,height)));
   const int max_supp = 1<<(num_levels-1);
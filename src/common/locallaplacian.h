@@ -79,6 +79,13 @@ size_t local_laplacian_memory_use(const int width,      // width of input image
 size_t local_laplacian_singlebuffer_size(const int width,       // width of input image
                                          const int height);     // height of input image
 
+// same for the full pyramids of the opencl code path
+size_t local_laplacian_memory_use_full(const int width,      // width of input image
+                                       const int height);    // height of input image
+
+size_t local_laplacian_singlebuffer_size_full(const int width,       // width of input image
+                                              const int height);     // height of input image
+
 
 #if defined(__SSE2__)
 void local_laplacian_sse2(
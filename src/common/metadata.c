@@ -287,8 +287,10 @@ static void _pop_undo_execute(const int imgid, GList *before, GList *after)
   gchar *tobe_removed_list = _get_tb_removed_metadata_string_values(before, after);
   gchar *tobe_added_list = _get_tb_added_metadata_string_values(imgid, before, after);
 
+  dt_database_start_transaction(darktable.db);
   _bulk_remove_metadata(imgid, tobe_removed_list);
   _bulk_add_metadata(tobe_added_list);
+  dt_database_release_transaction(darktable.db);
 
   g_free(tobe_removed_list);
   g_free(tobe_added_list);
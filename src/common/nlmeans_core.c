@@ -812,6 +812,433 @@ void nlmeans_denoise_sse2(const float *const inbuf, float *const outbuf,
 }
 #endif /* __SSE2__ */
 
+#ifdef DT_HAVE_TARGET_AVX2
+// compute the channel-normed squared differences between eight consecutive pixels and the pixels 'offset'
+//   floats further on.  The channels are summed in the same order as in pixel_difference(), so the result
+//   is bit-identical to the scalar code.  'norm' must have zeros in the alpha lanes.
+static inline __attribute__((always_inline)) DT_TARGET_AVX2 __m256
+pixel_difference8_avx2(const float *const pix, const int offset, const __m256 norm)
+{
+  // an alpha of inf or NaN would poison the sums even with a zero norm, so mask it out instead
+  const __m256 alpha_mask = _mm256_castsi256_ps(_mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0));
+  __m256 ssd[4];
+  for(int k = 0; k < 4; k++)
+  {
+    const __m256 dif = _mm256_loadu_ps(pix + 8*k) - _mm256_loadu_ps(pix + 8*k + offset);
+    ssd[k] = _mm256_and_ps(dif * dif * norm, alpha_mask);
+  }
+  // two horizontal adds give ((c0+c1)+(c2+0)) for pixels 0 2 4 6 in the lower and 1 3 5 7 in the upper lane
+  const __m256 sums = _mm256_hadd_ps(_mm256_hadd_ps(ssd[0], ssd[1]), _mm256_hadd_ps(ssd[2], ssd[3]));
+  return _mm256_permutevar8x32_ps(sums, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+// gh() for eight values at once, bit-identical to dt_fast_mexp2f()
+static inline __attribute__((always_inline)) DT_TARGET_AVX2 __m256 gh_avx2(const __m256 f)
+{
+  const __m256i k0 = _mm256_add_epi32(_mm256_set1_epi32(0x3f800000),
+                                      _mm256_cvttps_epi32(f * _mm256_set1_ps(0x3f000000 - 0x3f800000)));
+  const __m256i normal = _mm256_cmpgt_epi32(k0, _mm256_set1_epi32(0x800000 - 1));
+  return _mm256_castsi256_ps(_mm256_and_si256(k0, normal));
+}
+
+// inclusive prefix sum over the eight lanes
+static inline __attribute__((always_inline)) DT_TARGET_AVX2 __m256 prefix_sum8_avx2(__m256 x)
+{
+  x += _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 4));
+  x += _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 8));
+  // carry the total of the lower four lanes into the upper four
+  const __m256 low = _mm256_permute2f128_ps(x, x, 0x08);
+  return x + _mm256_permute_ps(low, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// add eight weighted patch-center pixels (with alpha forced to one) into the output
+static inline __attribute__((always_inline)) DT_TARGET_AVX2 void
+accumulate8_avx2(float *const out, const float *const in, const __m256 wt)
+{
+  const __m256 one = _mm256_set1_ps(1.0f);
+  for(int k = 0; k < 4; k++)
+  {
+    const __m256 w = _mm256_permutevar8x32_ps(wt, _mm256_setr_epi32(2*k, 2*k, 2*k, 2*k,
+                                                                     2*k+1, 2*k+1, 2*k+1, 2*k+1));
+    const __m256 pixel = _mm256_blend_ps(_mm256_loadu_ps(in + 8*k), one, 0x88);
+    _mm256_storeu_ps(out + 8*k, _mm256_fmadd_ps(pixel, w, _mm256_loadu_ps(out + 8*k)));
+  }
+}
+
+// the AVX2 code keeps the channel-summed squared differences of the 2*radius+1 rows currently inside the
+//   patch window in a ring buffer, so that each of them is computed only once per patch offset and then
+//   reused when it slides out of the window again.  With eight pixels per instruction the cached value is
+//   much cheaper than the recomputation, unlike for the scalar and SSE2 code (see CACHE_PIXDIFFS above).
+// The ring slot of the row leaving the window is the one the new row goes into.
+static inline float *ring_row(float *const ring, const size_t row_len, const int radius, const int row)
+{
+  return ring + row_len * (row % (2*radius+1));
+}
+
+static DT_TARGET_AVX2 void init_column_sums_avx2(float *const col_sums, float *const ring, const size_t row_len,
+                                                 const patch_t *const patch, const float *const in,
+                                                 const int row, const int chunk_left, const int chunk_right,
+                                                 const int height, const int width, const int stride,
+                                                 const int radius, const __m256 norm)
+{
+  // same column and row bounds as init_column_sums()
+  const int scol = patch->cols;
+  const int col_min = chunk_left - MIN(radius,MIN(chunk_left,chunk_left+scol));
+  const int col_max = chunk_right + MIN(radius,MIN(width-chunk_right,width-(chunk_right+scol)));
+  const int srow = patch->rows;
+  const int rmin = row - MIN(radius,MIN(row,row+srow));
+  const int rmax = row + MIN(radius,MIN(height-1-row,height-1-(row+srow)));
+  for (int col = chunk_left-radius-1; col < MIN(col_min,chunk_right+radius); col++)
+    col_sums[col] = 0;
+  int col = col_min;
+  for (; col + 8 <= col_max; col += 8)
+  {
+    __m256 sum = _mm256_setzero_ps();
+    for (int r = rmin; r <= rmax; r++)
+    {
+      const __m256 diff = pixel_difference8_avx2(in + r*stride + 4*col, patch->offset, norm);
+      _mm256_storeu_ps(ring_row(ring, row_len, radius, r) + col, diff);
+      sum += diff;
+    }
+    _mm256_storeu_ps(col_sums + col, sum);
+  }
+  for (; col < col_max; col++)
+  {
+    float sum = 0;
+    for (int r = rmin; r <= rmax; r++)
+    {
+      const float *pixel = in + r*stride + 4*col;
+      const float diff = pixel_difference(pixel,pixel+patch->offset,(const float *)&norm);
+      ring_row(ring, row_len, radius, r)[col] = diff;
+      sum += diff;
+    }
+    col_sums[col] = sum;
+  }
+  for (col = MAX(col_min,col_max); col < chunk_right + radius; col++)
+    col_sums[col] = 0;
+}
+
+DT_TARGET_AVX2 void nlmeans_denoise_avx2(const float *const inbuf, float *const outbuf,
+                                         const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                                         const dt_nlmeans_param_t *const params)
+{
+  // define the factors for applying blending between the original image and the denoised version
+  // if running in RGB space, 'luma' should equal 'chroma'
+  const __m256 weight = _mm256_setr_ps(params->luma, params->chroma, params->chroma, 1.0f,
+                                       params->luma, params->chroma, params->chroma, 1.0f);
+  const __m256 invert = _mm256_setr_ps(1.0f - params->luma, 1.0f - params->chroma, 1.0f - params->chroma, 0.0f,
+                                       1.0f - params->luma, 1.0f - params->chroma, 1.0f - params->chroma, 0.0f);
+  const bool skip_blend = (params->luma == 1.0 && params->chroma == 1.0);
+
+  // define the normalization to convert central pixel differences into central pixel weights
+  const float cp_norm = compute_center_pixel_norm(params->center_weight,params->patch_radius);
+  const __m256 center_norm = _mm256_setr_ps(cp_norm, cp_norm, cp_norm, 0.0f, cp_norm, cp_norm, cp_norm, 0.0f);
+  const __m256 norm = _mm256_setr_ps(params->norm[0], params->norm[1], params->norm[2], 0.0f,
+                                     params->norm[0], params->norm[1], params->norm[2], 0.0f);
+
+  // define the patches to be compared when denoising a pixel
+  const size_t stride = 4 * roi_in->width;
+  int num_patches;
+  int max_shift;
+  struct patch_t* patches = define_patches(params,stride,&num_patches,&max_shift);
+  // allocate scratch space: the column sums followed by the ring of per-row differences, each row with an
+  // overrun area on both ends so we don't need a boundary check on every access
+  const int radius = params->patch_radius;
+  const size_t row_len = 16*((SLICE_WIDTH + 2*radius + 1 + 15)/16); // round up to a full cache line
+  const size_t padded_scratch_size = (2*radius + 2) * row_len + 16; // one more line against false sharing
+  const size_t numthreads = dt_get_num_threads() ;
+  float *scratch_buf = dt_alloc_align_float(numthreads * padded_scratch_size);
+  const int chk_height = compute_slice_height(roi_out->height);
+  const int chk_width = compute_slice_width(roi_out->width);
+#ifdef _OPENMP
+#pragma omp parallel for default(none) num_threads(darktable.num_openmp_threads) \
+      dt_omp_firstprivate(patches, num_patches, scratch_buf, chk_height, chk_width, radius, row_len) \
+      dt_omp_sharedconst(params, padded_scratch_size, roi_out, outbuf, inbuf, stride, center_norm, norm, \
+                         skip_blend, weight, invert) \
+      schedule(static) \
+      collapse(2)
+#endif
+  for (int chunk_top = 0 ; chunk_top < roi_out->height; chunk_top += chk_height)
+  {
+    for (int chunk_left = 0; chunk_left < roi_out->width; chunk_left += chk_width)
+    {
+      // locate our scratch space within the big buffer allocated above
+      // we'll offset by chunk_left so that we don't have to subtract on every access
+      size_t tnum = dt_get_thread_num();
+      float *const col_sums = scratch_buf + tnum * padded_scratch_size + (radius+1) - chunk_left;
+      float *const ring = col_sums + row_len;
+      // determine which horizontal slice of the image to process
+      const int chunk_bot = MIN(chunk_top + chk_height, roi_out->height);
+      // determine which vertical slice of the image to process
+      const int chunk_right = MIN(chunk_left + chk_width, roi_out->width);
+      // we want to incrementally sum results (especially weights in col[3]), so clear the output buffer to zeros
+      for (int i = chunk_top; i < chunk_bot; i++)
+      {
+        memset(outbuf + 4*(i*roi_out->width+chunk_left), '\0', sizeof(float) * 4 * (chunk_right-chunk_left));
+      }
+      // cycle through all of the patches over our slice of the image
+      for (int p = 0; p < num_patches; p++)
+      {
+        // retrieve info about the current patch
+        const patch_t *patch = &patches[p];
+        // skip any rows where the patch center would be above top of RoI or below bottom of RoI
+        const int height = roi_out->height;
+        const int row_min = MAX(chunk_top,MAX(0,-patch->rows));
+        const int row_max = MIN(chunk_bot,height - MAX(0,patch->rows));
+        // figure out which rows at top and bottom result in patches extending outside the RoI, even though the
+        // center pixel is inside
+        const int row_top = MAX(row_min,MAX(radius,radius-patch->rows));
+        const int row_bot = MIN(row_max,height-1-MAX(radius,radius+patch->rows));
+        // skip any columns where the patch center would be to the left or the right of the RoI
+        const int width = roi_out->width;
+        const int scol = patch->cols;
+        const int col_min = MAX(chunk_left,-scol);
+        const int col_max = MIN(chunk_right,roi_out->width - scol);
+
+        init_column_sums_avx2(col_sums,ring,row_len,patch,inbuf,row_min,chunk_left,chunk_right,height,width,
+                              stride,radius,norm);
+        for (int row = row_min; row < row_max; row++)
+        {
+          // add up the initial columns of the sliding window of total patch distortion
+          float distortion = 0.0;
+          for (int i = col_min - radius; i < col_min+radius; i++)
+          {
+            distortion += col_sums[i];
+          }
+          // now proceed down the current row of the image, eight pixels at a time; the sliding window
+          // becomes a prefix sum over the changes of the window total
+          const float *in = inbuf + stride * row;
+          float *const out = outbuf + (size_t)4 * width * row;
+          const int offset = patch->offset;
+          const float sharpness = params->sharpness;
+          const __m256 vsharp = _mm256_set1_ps(sharpness);
+          int col = col_min;
+          if (params->center_weight < 0)
+          {
+            // computation as used by denoise(non-local) iop
+            for (; col + 8 <= col_max; col += 8)
+            {
+              const __m256 dist = _mm256_set1_ps(distortion)
+                + prefix_sum8_avx2(_mm256_loadu_ps(col_sums+col+radius) - _mm256_loadu_ps(col_sums+col-radius-1));
+              distortion = dist[7];
+              accumulate8_avx2(out + 4*col, in + 4*col + offset, gh_avx2(dist * vsharp));
+              _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
+              _mm_prefetch(in+4*col+offset+stride+16,_MM_HINT_T0);
+            }
+            for (; col < col_max; col++)
+            {
+              distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
+              const __m128 wt = _mm_set1_ps(gh(distortion * sharpness));
+              __m128 pixel = _mm_loadu_ps(in+4*col+offset);
+              pixel[3] = 1.0f;
+              _mm_storeu_ps(out+4*col, _mm_loadu_ps(out+4*col) + pixel * wt);
+            }
+          }
+          else
+          {
+            // computation as used by denoiseprofiled iop with non-local means
+            const __m256 center_scale = _mm256_set1_ps(1.0f + params->center_weight);
+            const __m256 two = _mm256_set1_ps(2.0f);
+            for (; col + 8 <= col_max; col += 8)
+            {
+              const __m256 dist = _mm256_set1_ps(distortion)
+                + prefix_sum8_avx2(_mm256_loadu_ps(col_sums+col+radius) - _mm256_loadu_ps(col_sums+col-radius-1));
+              distortion = dist[7];
+              const __m256 dissimilarity = (dist + pixel_difference8_avx2(in+4*col, offset, center_norm))
+                                           / center_scale;
+              const __m256 wt = gh_avx2(_mm256_max_ps(_mm256_setzero_ps(), dissimilarity * vsharp - two));
+              accumulate8_avx2(out + 4*col, in + 4*col + offset, wt);
+              _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0); // try to ensure next row is ready in time
+              _mm_prefetch(in+4*col+offset+stride+16,_MM_HINT_T0);
+            }
+            for (; col < col_max; col++)
+            {
+              distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
+              const float dissimilarity = (distortion + pixel_difference(in+4*col,in+4*col+offset,
+                                                                         (const float *)&center_norm))
+                                           / (1.0f + params->center_weight);
+              const __m128 wt = _mm_set1_ps(gh(fmaxf(0.0f, dissimilarity * sharpness - 2.0f)));
+              __m128 pixel = _mm_loadu_ps(in+4*col+offset);
+              pixel[3] = 1.0f;
+              _mm_storeu_ps(out+4*col, _mm_loadu_ps(out+4*col) + pixel * wt);
+            }
+          }
+          const int pcol_min = chunk_left - MIN(radius,MIN(chunk_left,chunk_left+scol));
+          const int pcol_max = chunk_right + MIN(radius,MIN(width-chunk_right,width-(chunk_right+scol)));
+          if (row < row_top)
+          {
+            // top edge of patch was above top of RoI, so it had a value of zero; just add in the new row
+            const float *bot_row = inbuf + (row+1+radius)*stride;
+            float *const new_diffs = ring_row(ring, row_len, radius, row+1+radius);
+            for (col = pcol_min; col + 8 <= pcol_max; col += 8)
+            {
+              const __m256 diff = pixel_difference8_avx2(bot_row + 4*col, offset, norm);
+              _mm256_storeu_ps(new_diffs + col, diff);
+              _mm256_storeu_ps(col_sums + col, _mm256_loadu_ps(col_sums + col) + diff);
+            }
+            for (; col < pcol_max; col++)
+            {
+              const float *const bot_px = bot_row + 4*col;
+              const float diff = pixel_difference(bot_px,bot_px+offset,params->norm);
+              new_diffs[col] = diff;
+              col_sums[col] += diff;
+            }
+          }
+          else if (row < row_bot)
+          {
+            const float *const bot_row = inbuf + (row+1+radius)*stride ;
+            // both prior and new positions are entirely within the RoI, so subtract the old row and add the new
+            // one; the old row's differences are in the ring slot the new ones replace
+            float *const diffs = ring_row(ring, row_len, radius, row+1+radius);
+            for (col = pcol_min; col + 8 <= pcol_max; col += 8)
+            {
+              const __m256 diff = pixel_difference8_avx2(bot_row + 4*col, offset, norm);
+              const __m256 old_diff = _mm256_loadu_ps(diffs + col);
+              _mm256_storeu_ps(diffs + col, diff);
+              _mm256_storeu_ps(col_sums + col, _mm256_loadu_ps(col_sums + col) + (diff - old_diff));
+              _mm_prefetch(bot_row + 4*col + stride, _MM_HINT_T0);
+              _mm_prefetch(bot_row + 4*col + offset + stride, _MM_HINT_T0);
+            }
+            for (; col < pcol_max; col++)
+            {
+              const float *const bot_px = bot_row + 4*col;
+              const float diff = pixel_difference(bot_px,bot_px+offset,params->norm);
+              col_sums[col] += diff - diffs[col];
+              diffs[col] = diff;
+            }
+          }
+          else if (row + 1 < row_max) // don't bother updating if last iteration
+          {
+            // new row of the patch is below the bottom of RoI, so its value is zero; just subtract the old row
+            const float *const old_diffs = ring_row(ring, row_len, radius, row-radius);
+            for (col = pcol_min; col + 8 <= pcol_max; col += 8)
+            {
+              _mm256_storeu_ps(col_sums + col, _mm256_loadu_ps(col_sums + col) - _mm256_loadu_ps(old_diffs + col));
+            }
+            for (; col < pcol_max; col++)
+            {
+              col_sums[col] -= old_diffs[col];
+            }
+          }
+        }
+      }
+      // normalize and (unless luma and chroma are both 1) apply chroma/luma blending, two pixels at a time
+      for (int row = chunk_top; row < chunk_bot; row++)
+      {
+        const float *const in = inbuf + row * stride;
+        float *const out = outbuf + 4 * row * roi_out->width;
+        int col = chunk_left;
+        for (; col + 2 <= chunk_right; col += 2)
+        {
+          const __m256 outpx = _mm256_loadu_ps(out + 4*col);
+          __m256 scaled = outpx / _mm256_permute_ps(outpx, _MM_SHUFFLE(3, 3, 3, 3));
+          if (!skip_blend)
+            scaled = _mm256_loadu_ps(in + 4*col) * invert + scaled * weight;
+          _mm256_storeu_ps(out + 4*col, scaled);
+        }
+        for (; col < chunk_right; col++)
+        {
+          const __m128 outpx = _mm_loadu_ps(out + 4*col);
+          __m128 scaled = outpx / _mm_set1_ps(outpx[3]);
+          if (!skip_blend)
+            scaled = _mm_loadu_ps(in + 4*col) * _mm256_castps256_ps128(invert)
+                     + scaled * _mm256_castps256_ps128(weight);
+          _mm_storeu_ps(out + 4*col, scaled);
+        }
+      }
+    }
+  }
+
+  // clean up: free the work space
+  dt_free_align(patches);
+  dt_free_align(scratch_buf);
+  return;
+}
+#endif /* DT_HAVE_TARGET_AVX2 */
+
+static size_t nlmeans_denoise_bench(const void *variant, float **out);
+
+static dt_dispatch_kernel_t nlmeans_denoise_kernel = {
+  .name = "nlmeans",
+  .variants = { [DT_ISA_SCALAR] = nlmeans_denoise,
+#if defined(__SSE2__)
+                [DT_ISA_SSE2] = nlmeans_denoise_sse2,
+#endif
+#ifdef DT_HAVE_TARGET_AVX2
+                [DT_ISA_AVX2] = nlmeans_denoise_avx2,
+#endif
+              },
+  .bench = nlmeans_denoise_bench,
+  .selected = nlmeans_denoise
+};
+
+// a synthetic 256x160 image denoised with both the nlmeans and the denoiseprofile parameters for each search
+// radius from 3 to 10, for darktable-cputest.  the time per search radius is printed with -d perf.
+static size_t nlmeans_denoise_bench(const void *variant, float **out)
+{
+  const int width = 256, height = 160;
+  const int min_radius = 3, max_radius = 10;
+  const size_t npixels = (size_t)width * height;
+  const size_t nruns = 2 * (max_radius - min_radius + 1);
+  const dt_iop_roi_t roi = { .x = 0, .y = 0, .width = width, .height = height, .scale = 1.0f };
+  float *const in = dt_alloc_align_float(4 * npixels);
+  *out = dt_alloc_align_float(4 * npixels * nruns);
+  for(int row = 0; row < height; row++)
+    for(int col = 0; col < width; col++)
+    {
+      float *const px = in + 4 * ((size_t)row * width + col);
+      // smooth structure plus deterministic pseudo-random noise
+      const unsigned int hash = (row * 1103515245u + col * 12345u) ^ (col * 2654435761u);
+      const float noise = (float)((hash >> 8) & 0xffff) / 65535.0f - 0.5f;
+      px[0] = 0.5f + 0.3f * sinf(0.05f * col) * cosf(0.07f * row) + 0.04f * noise;
+      px[1] = 0.2f * sinf(0.031f * (row + col)) + 0.03f * noise;
+      px[2] = -0.15f * cosf(0.043f * row) - 0.03f * noise;
+      px[3] = 0.0f;
+    }
+
+  const char *isa_name = "unknown";
+  for(int isa = 0; isa < DT_ISA_LAST; isa++)
+    if(nlmeans_denoise_kernel.variants[isa] == variant) isa_name = dt_isa_name(isa);
+
+  // the normalizations as set up by the denoise (non-local means) and denoiseprofile iops, scaled along with
+  // the image values (by 1/100) so that the absolute error reported by the benchmark stays meaningful
+  const float nL = 100.0f / 120.0f, nC = 100.0f / 512.0f;
+  const float norm_nlmeans[4] = { nL * nL, nC * nC, nC * nC, 1.0f };
+  const float norm_profile[4] = { 100.0f, 100.0f, 100.0f, 1.0f };
+  for(int radius = min_radius; radius <= max_radius; radius++)
+  {
+    const dt_nlmeans_param_t nlmeans = { .scattering = 0, .scale = 1.0f, .luma = 0.5f, .chroma = 1.0f,
+                                         .center_weight = -1, .sharpness = 3000.0f / 1.5f, .patch_radius = 2,
+                                         .search_radius = radius, .decimate = 0, .norm = norm_nlmeans };
+    const dt_nlmeans_param_t profile = { .scattering = 0, .scale = 1.0f, .luma = 1.0f, .chroma = 1.0f,
+                                         .center_weight = 0.1f, .sharpness = 0.2f, .patch_radius = 1,
+                                         .search_radius = radius, .decimate = 0, .norm = norm_profile };
+    float *const res = *out + 8 * npixels * (radius - min_radius);
+    const double start = dt_get_wtime();
+    ((nlmeans_denoise_t)variant)(in, res, &roi, &roi, &nlmeans);
+    ((nlmeans_denoise_t)variant)(in, res + 4 * npixels, &roi, &roi, &profile);
+    dt_print(DT_DEBUG_PERF, "[nlmeans] %s variant, search radius %d: %.3f ms\n", isa_name, radius,
+             1000.0 * (dt_get_wtime() - start));
+  }
+  dt_free_align(in);
+  return 4 * npixels * nruns;
+}
+
+void dt_nlmeans_denoise_init(void)
+{
+  dt_dispatch_register(&nlmeans_denoise_kernel);
+}
+
+void dt_nlmeans_denoise_cleanup(void)
+{
+  dt_dispatch_unregister(&nlmeans_denoise_kernel);
+}
+
+nlmeans_denoise_t dt_nlmeans_denoise_selected(void)
+{
+  return (nlmeans_denoise_t)nlmeans_denoise_kernel.selected;
+}
+
 /**************************************************************/
 /**************************************************************/
 /*      Everything from here to end of file is WIP!!          */
@@ -17,6 +17,7 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "common/dispatch.h"
 #include "iop/iop_api.h"
 
 struct dt_nlmeans_param_t
@@ -48,6 +49,23 @@ void nlmeans_denoise_sse2(const float *const inbuf, float *const outbuf,
                           const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
                           const dt_nlmeans_param_t *const params);
 
+#ifdef DT_HAVE_TARGET_AVX2
+void nlmeans_denoise_avx2(const float *const inbuf, float *const outbuf,
+                          const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                          const dt_nlmeans_param_t *const params);
+#endif
+
+typedef void (*nlmeans_denoise_t)(const float *const inbuf, float *const outbuf,
+                                  const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                                  const dt_nlmeans_param_t *const params);
+
+// the fastest cpu variant of nlmeans_denoise() for this machine
+nlmeans_denoise_t dt_nlmeans_denoise_selected(void);
+
+// select the fastest variant of nlmeans_denoise(), called from dt_init() once the codepaths are known
+void dt_nlmeans_denoise_init(void);
+void dt_nlmeans_denoise_cleanup(void);
+
 #ifdef HAVE_OPENCL
 int nlmeans_denoise_cl(const dt_nlmeans_param_t *const params, const int devid,
                        cl_mem dev_in, cl_mem dev_out, const dt_iop_roi_t *const roi_in);
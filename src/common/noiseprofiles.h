@@ -35,8 +35,11 @@ dt_noiseprofile_t;
 
 extern const dt_noiseprofile_t dt_noiseprofile_generic;
 
-/** read the noiseprofile file once on startup (kind of)*/
-JsonParser *dt_noiseprofile_init(const char *alternative);
+/** remember which noiseprofile file to use, it gets read once on first use */
+void dt_noiseprofile_init(const char *alternative);
+
+/** free the parsed noiseprofiles */
+void dt_noiseprofile_cleanup();
 
 /*
  * returns the noiseprofiles matching the image's exif data.
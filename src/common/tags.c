@@ -110,8 +110,10 @@ static void _pop_undo_execute(const int imgid, GList *before, GList *after)
   gchar *tobe_removed_list = _get_tb_removed_tag_string_values(before, after);
   gchar *tobe_added_list = _get_tb_added_tag_string_values(imgid, before, after);
 
+  dt_database_start_transaction(darktable.db);
   _bulk_remove_tags(imgid, tobe_removed_list);
   _bulk_add_tags(tobe_added_list);
+  dt_database_release_transaction(darktable.db);
 
   g_free(tobe_removed_list);
   g_free(tobe_added_list);
@@ -220,6 +222,7 @@ guint dt_tag_remove(const guint tagid, gboolean final)
   if(final == TRUE)
   {
     // let's actually remove the tag
+    dt_database_start_transaction(darktable.db);
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "DELETE FROM data.tags WHERE id=?1", -1, &stmt,
                                 NULL);
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, tagid);
@@ -231,6 +234,7 @@ guint dt_tag_remove(const guint tagid, gboolean final)
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, tagid);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+    dt_database_release_transaction(darktable.db);
   }
 
   return count;
@@ -240,6 +244,8 @@ void dt_tag_delete_tag_batch(const char *flatlist)
 {
   sqlite3_stmt *stmt;
 
+  dt_database_start_transaction(darktable.db);
+
   char *query = NULL;
   query = dt_util_dstrcat(query, "DELETE FROM data.tags WHERE id IN (%s)", flatlist);
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
@@ -253,6 +259,8 @@ void dt_tag_delete_tag_batch(const char *flatlist)
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
   g_free(query);
+
+  dt_database_release_transaction(darktable.db);
 }
 
 guint dt_tag_remove_list(GList *tag_list)
@@ -16,18 +16,23 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <gio/gio.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <sqlite3.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "common/collection.h"
 #include "common/darktable.h"
 #include "common/debug.h"
 #include "common/database.h"
 #include "common/history.h"
 #include "common/image.h"
 #include "control/conf.h"
+#include "control/control.h"
+#include "control/jobs.h"
+#include "control/signal.h"
 #include "crawler.h"
 #include "gui/gtk.h"
 #ifdef GDK_WINDOWING_QUARTZ
@@ -56,143 +61,342 @@ typedef struct dt_control_crawler_result_t
 } dt_control_crawler_result_t;
 
 
-GList *dt_control_crawler_run()
+typedef struct dt_control_crawler_entry_t
+{
+  // from the database
+  int id, version, flags;
+  time_t timestamp;
+  gint64 xmp_mtime, xmp_size; // -1 if we never stored them
+  gchar *image_path;
+  // filled in by the checks on disk
+  gboolean missing, xmp_changed;
+  time_t xmp_st_mtime;
+  gchar *xmp_path;
+  int new_flags;
+} dt_control_crawler_entry_t;
+
+static gboolean _extra_file_exists(const gchar *image_path, const char *lower, const char *upper)
+{
+  size_t len = strlen(image_path);
+  const char *c = image_path + len;
+  while((c > image_path) && (*c != '.')) c--;
+  len = c - image_path + 1;
+
+  char *extra_path = (char *)calloc(len + 3 + 1, sizeof(char));
+  g_strlcpy(extra_path, image_path, len + 1);
+
+  memcpy(extra_path + len, lower, 3);
+  gboolean exists = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+  if(!exists)
+  {
+    memcpy(extra_path + len, upper, 3);
+    exists = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+  }
+  free(extra_path);
+  return exists;
+}
+
+// everything that touches the disk for one image. doesn't use the database so it can run in parallel.
+static void _crawler_check_entry(dt_control_crawler_entry_t *entry, const gboolean look_for_xmp)
+{
+  // if the image is missing we ignore it.
+  if(!g_file_test(entry->image_path, G_FILE_TEST_EXISTS))
+  {
+    entry->missing = TRUE;
+    return;
+  }
+
+  // no need to look for xmp files if none get written anyway.
+  if(look_for_xmp)
+  {
+    // construct the xmp filename for this image
+    gchar xmp_path[PATH_MAX] = { 0 };
+    g_strlcpy(xmp_path, entry->image_path, sizeof(xmp_path));
+    dt_image_path_append_version_no_db(entry->version, xmp_path, sizeof(xmp_path));
+    if(strlen(xmp_path) + 4 < PATH_MAX)
+    {
+      g_strlcat(xmp_path, ".xmp", sizeof(xmp_path));
+
+      GStatBuf statbuf;
+      if(!g_stat(xmp_path, &statbuf))
+      {
+        // if we know what the xmp looked like when we wrote it, any difference is an external edit.
+        // otherwise fall back to checking if the xmp is newer than our db entry.
+        // FIXME: allow for a few seconds difference?
+        if(entry->xmp_mtime >= 0 && entry->xmp_size >= 0)
+          entry->xmp_changed = statbuf.st_mtime != entry->xmp_mtime || statbuf.st_size != entry->xmp_size;
+        else
+          entry->xmp_changed = entry->timestamp < statbuf.st_mtime;
+        // older timestamps are the case for all images after the db upgrade. better not report these
+        entry->xmp_st_mtime = statbuf.st_mtime;
+        entry->xmp_path = g_strdup(xmp_path);
+      }
+      // TODO: shall we report missing xmp files?
+    }
+  }
+
+  // check if the image has associated files (.txt, .wav)
+  // TODO: decide if we want to remove the flag for images that lost their extra file. currently we do (the
+  // else cases)
+  entry->new_flags = entry->flags;
+  if(_extra_file_exists(entry->image_path, "txt", "TXT"))
+    entry->new_flags |= DT_IMAGE_HAS_TXT;
+  else
+    entry->new_flags &= ~DT_IMAGE_HAS_TXT;
+  if(_extra_file_exists(entry->image_path, "wav", "WAV"))
+    entry->new_flags |= DT_IMAGE_HAS_WAV;
+  else
+    entry->new_flags &= ~DT_IMAGE_HAS_WAV;
+}
+
+static GList *_crawler_run(const gchar *folder)
 {
   sqlite3_stmt *stmt, *inner_stmt;
   GList *result = NULL;
-  gboolean look_for_xmp = dt_conf_get_bool("write_sidecar_files");
+  const gboolean look_for_xmp = dt_conf_get_bool("write_sidecar_files");
 
   sqlite3_prepare_v2(dt_database_get(darktable.db),
-                     "SELECT i.id, write_timestamp, version, folder || '" G_DIR_SEPARATOR_S "' || filename, flags "
-                     "FROM main.images i, main.film_rolls f ON i.film_id = f.id ORDER BY f.id, filename",
+                     "SELECT i.id, write_timestamp, version, folder || '" G_DIR_SEPARATOR_S "' || filename, "
+                     "       flags, IFNULL(xmp_mtime, -1), IFNULL(xmp_size, -1) "
+                     "FROM main.images i, main.film_rolls f ON i.film_id = f.id "
+                     "WHERE ?1 IS NULL OR f.folder = ?1 "
+                     "ORDER BY f.id, filename",
                      -1, &stmt, NULL);
+  sqlite3_bind_text(stmt, 1, folder, -1, SQLITE_TRANSIENT);
+
+  GArray *entries = g_array_new(FALSE, TRUE, sizeof(dt_control_crawler_entry_t));
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    dt_control_crawler_entry_t entry = { 0 };
+    entry.id = sqlite3_column_int(stmt, 0);
+    entry.timestamp = sqlite3_column_int(stmt, 1);
+    entry.version = sqlite3_column_int(stmt, 2);
+    entry.image_path = g_strdup((char *)sqlite3_column_text(stmt, 3));
+    entry.flags = sqlite3_column_int(stmt, 4);
+    entry.xmp_mtime = sqlite3_column_int64(stmt, 5);
+    entry.xmp_size = sqlite3_column_int64(stmt, 6);
+    g_array_append_val(entries, entry);
+  }
+  sqlite3_finalize(stmt);
+
+  // stat() is what makes this slow, especially on network shares, so do it for many images at once
+  dt_control_crawler_entry_t *e = (dt_control_crawler_entry_t *)entries->data;
+  const int count = entries->len;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) dt_omp_firstprivate(e, count, look_for_xmp) schedule(dynamic, 16)
+#endif
+  for(int k = 0; k < count; k++) _crawler_check_entry(&e[k], look_for_xmp);
+
   sqlite3_prepare_v2(dt_database_get(darktable.db), "UPDATE main.images SET flags = ?1 WHERE id = ?2", -1,
                      &inner_stmt, NULL);
 
   // let's wrap this into a transaction, it might make it a little faster.
-  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+  dt_database_start_transaction(darktable.db);
 
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  for(int k = 0; k < count; k++)
   {
-    const int id = sqlite3_column_int(stmt, 0);
-    const time_t timestamp = sqlite3_column_int(stmt, 1);
-    const int version = sqlite3_column_int(stmt, 2);
-    const gchar *image_path = (char *)sqlite3_column_text(stmt, 3);
-    int flags = sqlite3_column_int(stmt, 4);
-
-    // if the image is missing we ignore it.
-    if(!g_file_test(image_path, G_FILE_TEST_EXISTS))
+    dt_control_crawler_entry_t *entry = &e[k];
+    if(entry->missing)
     {
-      dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is missing.\n", image_path, id);
-      continue;
+      dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is missing.\n", entry->image_path, entry->id);
     }
-
-    // no need to look for xmp files if none get written anyway.
-    if(look_for_xmp)
+    else
     {
-      // construct the xmp filename for this image
-      gchar xmp_path[PATH_MAX] = { 0 };
-      g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
-      dt_image_path_append_version_no_db(version, xmp_path, sizeof(xmp_path));
-      size_t len = strlen(xmp_path);
-      if(len + 4 >= PATH_MAX) continue;
-      xmp_path[len++] = '.';
-      xmp_path[len++] = 'x';
-      xmp_path[len++] = 'm';
-      xmp_path[len++] = 'p';
-      xmp_path[len] = '\0';
-
-      struct stat statbuf;
-      // on Windows the encoding might not be UTF8
-      gchar *xmp_path_locale = g_locale_from_utf8(xmp_path, -1, NULL, NULL, NULL);
-      const int stat_res = stat(xmp_path_locale, &statbuf);
-      g_free(xmp_path_locale);
-      if(stat_res == -1) continue; // TODO: shall we report these?
-
-      // step 1: check if the xmp is newer than our db entry
-      // FIXME: allow for a few seconds difference?
-      if(timestamp < statbuf.st_mtime)
+      if(entry->xmp_changed)
       {
         dt_control_crawler_result_t *item
             = (dt_control_crawler_result_t *)malloc(sizeof(dt_control_crawler_result_t));
-        item->id = id;
-        item->timestamp_xmp = statbuf.st_mtime;
-        item->timestamp_db = timestamp;
-        item->image_path = g_strdup(image_path);
-        item->xmp_path = g_strdup(xmp_path);
-
-        result = g_list_append(result, item);
-        dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is a newer xmp file.\n", xmp_path, id);
+        item->id = entry->id;
+        item->timestamp_xmp = entry->xmp_st_mtime;
+        item->timestamp_db = entry->timestamp;
+        item->image_path = entry->image_path;
+        item->xmp_path = entry->xmp_path;
+        entry->image_path = entry->xmp_path = NULL;
+
+        result = g_list_prepend(result, item);
+        dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is a changed xmp file.\n", item->xmp_path, item->id);
+      }
+
+      if(entry->flags != entry->new_flags)
+      {
+        sqlite3_bind_int(inner_stmt, 1, entry->new_flags);
+        sqlite3_bind_int(inner_stmt, 2, entry->id);
+        sqlite3_step(inner_stmt);
+        sqlite3_reset(inner_stmt);
+        sqlite3_clear_bindings(inner_stmt);
       }
-      // older timestamps are the case for all images after the db upgrade. better not report these
-      //       else if(timestamp > statbuf.st_mtime)
-      //         printf("`%s' (%d) has an older xmp file.\n", image_path, id);
     }
+    g_free(entry->image_path);
+    g_free(entry->xmp_path);
+  }
 
-    // step 2: check if the image has associated files (.txt, .wav)
-    size_t len = strlen(image_path);
-    const char *c = image_path + len;
-    while((c > image_path) && (*c != '.')) c--;
-    len = c - image_path + 1;
+  dt_database_release_transaction(darktable.db);
 
-    char *extra_path = (char *)calloc(len + 3 + 1, sizeof(char));
-    g_strlcpy(extra_path, image_path, len + 1);
+  sqlite3_finalize(inner_stmt);
+  g_array_free(entries, TRUE);
 
-    extra_path[len] = 't';
-    extra_path[len + 1] = 'x';
-    extra_path[len + 2] = 't';
-    gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+  return g_list_reverse(result);
+}
 
-    if(!has_txt)
-    {
-      extra_path[len] = 'T';
-      extra_path[len + 1] = 'X';
-      extra_path[len + 2] = 'T';
-      has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-    }
+GList *dt_control_crawler_run()
+{
+  return _crawler_run(NULL);
+}
 
-    extra_path[len] = 'w';
-    extra_path[len + 1] = 'a';
-    extra_path[len + 2] = 'v';
-    gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+static gboolean _crawler_show_image_list_idle(gpointer user_data)
+{
+  dt_control_crawler_show_image_list((GList *)user_data);
+  return G_SOURCE_REMOVE;
+}
 
-    if(!has_wav)
-    {
-      extra_path[len] = 'W';
-      extra_path[len + 1] = 'A';
-      extra_path[len + 2] = 'V';
-      has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-    }
+typedef struct dt_control_crawler_job_t
+{
+  GList *folders; // NULL for all of the library
+} dt_control_crawler_job_t;
 
-    // TODO: decide if we want to remove the flag for images that lost their extra file. currently we do (the
-    // else cases)
-    int new_flags = flags;
-    if(has_txt)
-      new_flags |= DT_IMAGE_HAS_TXT;
-    else
-      new_flags &= ~DT_IMAGE_HAS_TXT;
-    if(has_wav)
-      new_flags |= DT_IMAGE_HAS_WAV;
-    else
-      new_flags &= ~DT_IMAGE_HAS_WAV;
-    if(flags != new_flags)
-    {
-      sqlite3_bind_int(inner_stmt, 1, new_flags);
-      sqlite3_bind_int(inner_stmt, 2, id);
-      sqlite3_step(inner_stmt);
-      sqlite3_reset(inner_stmt);
-      sqlite3_clear_bindings(inner_stmt);
-    }
+static int32_t _crawler_job_run(dt_job_t *job)
+{
+  dt_control_crawler_job_t *params = dt_control_job_get_params(job);
+  GList *result = NULL;
+  if(!params->folders)
+    result = _crawler_run(NULL);
+  for(GList *f = params->folders; f; f = g_list_next(f))
+    result = g_list_concat(result, _crawler_run((const gchar *)f->data));
+
+  // the dialog has to be built in the gui thread
+  if(result) g_main_context_invoke(NULL, _crawler_show_image_list_idle, result);
+  return 0;
+}
+
+static void _crawler_job_cleanup(void *p)
+{
+  dt_control_crawler_job_t *params = (dt_control_crawler_job_t *)p;
+  g_list_free_full(params->folders, g_free);
+  free(params);
+}
 
-    free(extra_path);
+void dt_control_crawler_run_job(GList *folders)
+{
+  dt_job_t *job = dt_control_job_create(&_crawler_job_run, "crawl xmp sidecar files");
+  if(!job)
+  {
+    g_list_free_full(folders, g_free);
+    return;
   }
+  dt_control_crawler_job_t *params = (dt_control_crawler_job_t *)calloc(1, sizeof(dt_control_crawler_job_t));
+  params->folders = folders;
+  dt_control_job_set_params(job, params, _crawler_job_cleanup);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_BG, job);
+}
+
+/********************* watching film rolls *********************/
+
+// xmp files written by other applications while we run. we wait for things to settle
+// before crawling the folders they are in.
+#define DT_CONTROL_CRAWLER_WATCH_DELAY 2000
+
+typedef struct dt_control_crawler_watch_t
+{
+  GHashTable *monitors;        // folder -> GFileMonitor
+  GHashTable *pending_folders; // folders with changed xmp files, waiting to be crawled
+  guint timeout_id;
+} dt_control_crawler_watch_t;
 
-  sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+static dt_control_crawler_watch_t _watch = { NULL, NULL, 0 };
 
+static gboolean _crawler_watch_flush(gpointer user_data)
+{
+  GList *folders = NULL;
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, _watch.pending_folders);
+  while(g_hash_table_iter_next(&iter, &key, NULL)) folders = g_list_prepend(folders, g_strdup((gchar *)key));
+  g_hash_table_remove_all(_watch.pending_folders);
+  _watch.timeout_id = 0;
+
+  if(folders) dt_control_crawler_run_job(folders);
+  return G_SOURCE_REMOVE;
+}
+
+static void _crawler_watch_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+                                   GFileMonitorEvent event_type, gpointer user_data)
+{
+  if(event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT && event_type != G_FILE_MONITOR_EVENT_CREATED
+     && event_type != G_FILE_MONITOR_EVENT_MOVED_IN && event_type != G_FILE_MONITOR_EVENT_RENAMED)
+    return;
+
+  GFile *target = (event_type == G_FILE_MONITOR_EVENT_RENAMED && other_file) ? other_file : file;
+  gchar *path = g_file_get_path(target);
+  if(path && g_str_has_suffix(path, ".xmp"))
+  {
+    g_hash_table_add(_watch.pending_folders, g_strdup((const gchar *)user_data));
+    if(_watch.timeout_id) g_source_remove(_watch.timeout_id);
+    _watch.timeout_id = g_timeout_add(DT_CONTROL_CRAWLER_WATCH_DELAY, _crawler_watch_flush, NULL);
+  }
+  g_free(path);
+}
+
+// watch the folders of the film rolls in the current collection
+static void _crawler_watch_update(gpointer instance, dt_collection_change_t query_change, gpointer imgs,
+                                  int next, gpointer user_data)
+{
+  if(!dt_conf_get_bool("write_sidecar_files")) return;
+
+  GHashTable *folders = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT DISTINCT f.folder"
+                              " FROM main.film_rolls AS f, main.images AS i, memory.collected_images AS c"
+                              " WHERE f.id = i.film_id AND i.id = c.imgid",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    g_hash_table_add(folders, g_strdup((const gchar *)sqlite3_column_text(stmt, 0)));
   sqlite3_finalize(stmt);
-  sqlite3_finalize(inner_stmt);
 
-  return result;
+  // stop watching folders which are gone from the collection
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, _watch.monitors);
+  while(g_hash_table_iter_next(&iter, &key, NULL))
+    if(!g_hash_table_contains(folders, key)) g_hash_table_iter_remove(&iter);
+
+  // and start watching the new ones
+  g_hash_table_iter_init(&iter, folders);
+  while(g_hash_table_iter_next(&iter, &key, NULL))
+  {
+    if(g_hash_table_contains(_watch.monitors, key)) continue;
+    GFile *dir = g_file_new_for_path((const gchar *)key);
+    GFileMonitor *monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+    g_object_unref(dir);
+    if(!monitor) continue;
+    gchar *folder = g_strdup((const gchar *)key);
+    g_signal_connect_data(monitor, "changed", G_CALLBACK(_crawler_watch_changed), folder,
+                          (GClosureNotify)g_free, 0);
+    g_hash_table_insert(_watch.monitors, g_strdup(folder), monitor);
+  }
+
+  g_hash_table_destroy(folders);
+}
+
+void dt_control_crawler_watch_init()
+{
+  _watch.monitors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+  _watch.pending_folders = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  _watch.timeout_id = 0;
+  DT_DEBUG_CONTROL_SIGNAL_CONNECT(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED,
+                                  G_CALLBACK(_crawler_watch_update), NULL);
+  _crawler_watch_update(NULL, DT_COLLECTION_CHANGE_NONE, NULL, -1, NULL);
+}
+
+void dt_control_crawler_watch_cleanup()
+{
+  if(!_watch.monitors) return;
+  DT_DEBUG_CONTROL_SIGNAL_DISCONNECT(darktable.signals, G_CALLBACK(_crawler_watch_update), NULL);
+  if(_watch.timeout_id) g_source_remove(_watch.timeout_id);
+  g_hash_table_destroy(_watch.monitors);
+  g_hash_table_destroy(_watch.pending_folders);
+  _watch.monitors = _watch.pending_folders = NULL;
+  _watch.timeout_id = 0;
 }
 
 
@@ -289,6 +493,8 @@ static void _reload_button_clicked(GtkButton *button, gpointer user_data)
       sqlite3_finalize(stmt);
 
       dt_history_load_and_apply(id, xmp_path, 0);
+      // remember the xmp as it is now so we don't report it again
+      dt_image_store_xmp_stat(id, xmp_path);
       valid = gtk_list_store_remove(GTK_LIST_STORE(gui->model), &iter);
     }
     else
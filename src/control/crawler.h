@@ -20,19 +20,23 @@
 
 #include <glib.h>
 
-/** this isn't a background job on purpose. it has to be really fast so it shouldn't
- *  require locking from image cache or anything like that.
- *  should we find out that we want to have a background job that crawls over all images
- *  we can maybe refactor this, but for now it's good the way it is.
- */
-
 // this function iterates over ALL images from the database and checks whether
-// - the XMP file on disk is newer than the timestamp from db
+// - the XMP file on disk differs from the mtime/size we stored when writing it, or, for images
+//   without a stored xmp stat, is newer than the timestamp from db
 // - there is a .txt or .wav file associated with the image and mark so in the db
 //   or if such a file no longer exists
 // it returns the list of images with a (supposedly) updated xmp file to let the user decide
 GList *dt_control_crawler_run();
 
+// run the crawler as a background job over the given folders (all of the library if NULL) and show
+// the popup from the gui thread if anything changed. takes ownership of the list and its strings.
+void dt_control_crawler_run_job(GList *folders);
+
+// watch the folders of the current collection for xmp files changed by other applications
+// and crawl them once they settle.
+void dt_control_crawler_watch_init();
+void dt_control_crawler_watch_cleanup();
+
 // show a popup with the images, let the user decide what to do and free the list afterwards
 void dt_control_crawler_show_image_list(GList *images);
 
@@ -237,6 +237,7 @@ static int32_t dt_control_write_sidecar_files_job_run(dt_job_t *job)
       sqlite3_step(stmt);
       sqlite3_reset(stmt);
       sqlite3_clear_bindings(stmt);
+      dt_image_store_xmp_stat(imgid, dtfilename);
     }
     dt_image_cache_read_release(darktable.image_cache, img);
     t = g_list_next(t);
@@ -260,6 +261,11 @@ typedef struct dt_control_merge_hdr_t
   float whitelevel;
   float epsw;
 
+  // the previous frame is merged in the background while the next one runs through the pipe
+  GThread *worker;
+  float *frame;
+  float frame_cal, frame_photoncnt, frame_whitelevel;
+
   // 0 - ok; 1 - errors, abort
   gboolean abort;
 } dt_control_merge_hdr_t;
@@ -305,6 +311,122 @@ static float envelope(const float xx)
   }
 }
 
+// merge one frame into the accumulators. the 3x3 min/max around each 2x2 pattern block is the same for
+// all four of its pixels, so we go through the image in bands of two rows and do it once per block,
+// from column-wise min/max of the three rows which the compiler can vectorize.
+static void _merge_hdr_accumulate(dt_control_merge_hdr_t *d, const float *const in, const float cal,
+                                  const float photoncnt, const float whitelevel)
+{
+  const int wd = d->wd;
+  const int ht = d->ht;
+  const float epsw = d->epsw;
+  float *const pixels = d->pixels;
+  float *const weight = d->weight;
+  const float saturation = 1.0f;
+  // need some safety margin due to upsampling and 16-bit quantization + dithering?
+  const float offset = 3000.0f / (float)UINT16_MAX;
+
+  size_t padded_size;
+  float *const colbuf = dt_alloc_perthread_float(2 * wd, &padded_size);
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(in, pixels, weight, colbuf, padded_size, wd, ht, cal, photoncnt, whitelevel, epsw, \
+                      saturation, offset) \
+  schedule(static)
+#endif
+  for(int yy = 0; yy < ht; yy += 2)
+  {
+    float *const colmax = dt_get_perthread(colbuf, padded_size);
+    float *const colmin = colmax + wd;
+    // cannot do an envelope based on single pixel values here, need to get
+    // maximum value of all color channels. to find that, go through the
+    // pattern block (we conservatively do a 3x3 for bayer or xtrans):
+    const gboolean inner_rows = yy < ht - 2;
+    if(inner_rows)
+    {
+      const float *const r0 = in + (size_t)wd * yy;
+      const float *const r1 = r0 + wd;
+      const float *const r2 = r1 + wd;
+      for(int x = 0; x < wd; x++)
+      {
+        colmax[x] = fmaxf(r0[x], fmaxf(r1[x], r2[x]));
+        colmin[x] = fminf(r0[x], fminf(r1[x], r2[x]));
+      }
+    }
+
+    for(int xx = 0; xx < wd; xx += 2)
+    {
+      // weights based on siggraph 12 poster
+      // zijian zhu, zhengguo li, susanto rahardja, pasi fraenti
+      // 2d denoising factor for high dynamic range imaging
+      float w = photoncnt;
+      float M = 0.0f, m = FLT_MAX;
+      if(inner_rows && xx < wd - 2)
+      {
+        M = fmaxf(colmax[xx], fmaxf(colmax[xx + 1], colmax[xx + 2]));
+        m = fminf(colmin[xx], fminf(colmin[xx + 1], colmin[xx + 2]));
+        // move envelope a little to allow non-zero weight even for clipped regions.
+        // this is because even if the 2x2 block is clipped somewhere, the other channels
+        // might still prove useful. we'll check for individual channel saturation below.
+        w *= epsw + envelope((M + offset) / saturation);
+      }
+      const gboolean clipped = M + offset >= saturation;
+
+      for(int y = yy; y < MIN(yy + 2, ht); y++)
+        for(int x = xx; x < MIN(xx + 2, wd); x++)
+        {
+          const size_t k = (size_t)wd * y + x;
+          // read unclamped raw value with subtracted black and rescaled to 1.0 saturation.
+          // this is the output of the rawprepare iop.
+          const float v = in[k];
+          if(clipped)
+          {
+            if(weight[k] <= 0.0f)
+            { // only consider saturated pixels in case we have nothing better:
+              if(weight[k] == 0 || m < -weight[k])
+              {
+                if(m + offset >= saturation)
+                  pixels[k] = 1.0f; // let's admit we were completely clipped, too
+                else
+                  pixels[k] = v * cal / whitelevel;
+                weight[k] = -m; // could use -cal here, but m is per pixel and safer for varying illumination
+                                // conditions
+              }
+            }
+            // else silently ignore, others have filled in a better color here already
+          }
+          else
+          {
+            if(weight[k] <= 0.0)
+            { // cleanup potentially blown highlights from earlier images
+              pixels[k] = 0.0f;
+              weight[k] = 0.0f;
+            }
+            pixels[k] += w * v * cal;
+            weight[k] += w;
+          }
+        }
+    }
+  }
+
+  dt_free_align(colbuf);
+}
+
+static gpointer _merge_hdr_worker(gpointer user_data)
+{
+  dt_control_merge_hdr_t *d = (dt_control_merge_hdr_t *)user_data;
+  _merge_hdr_accumulate(d, d->frame, d->frame_cal, d->frame_photoncnt, d->frame_whitelevel);
+  return NULL;
+}
+
+static void _merge_hdr_join(dt_control_merge_hdr_t *d)
+{
+  if(!d->worker) return;
+  g_thread_join(d->worker);
+  d->worker = NULL;
+}
+
 static int dt_control_merge_hdr_process(dt_imageio_module_data_t *datai, const char *filename,
                                         const void *const ivoid,
                                         dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
@@ -365,74 +487,25 @@ static int dt_control_merge_hdr_process(dt_imageio_module_data_t *datai, const c
   const float cal = 100.0f / (aperture * exp * iso);
   // about proportional to how many photons we can expect from this shot:
   const float photoncnt = 100.0f * aperture * exp / iso;
-  float saturation = 1.0f;
+  const float saturation = 1.0f;
   d->whitelevel = fmaxf(d->whitelevel, saturation * cal);
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(ivoid, cal, photoncnt) \
-  shared(d, saturation) \
-  schedule(static) collapse(2)
-#endif
-  for(int y = 0; y < d->ht; y++)
-    for(int x = 0; x < d->wd; x++)
-    {
-      // read unclamped raw value with subtracted black and rescaled to 1.0 saturation.
-      // this is the output of the rawprepare iop.
-      const float in = ((float *)ivoid)[x + d->wd * y];
-      // weights based on siggraph 12 poster
-      // zijian zhu, zhengguo li, susanto rahardja, pasi fraenti
-      // 2d denoising factor for high dynamic range imaging
-      float w = photoncnt;
-
-      // need some safety margin due to upsampling and 16-bit quantization + dithering?
-      float offset = 3000.0f / (float)UINT16_MAX;
-
-      // cannot do an envelope based on single pixel values here, need to get
-      // maximum value of all color channels. to find that, go through the
-      // pattern block (we conservatively do a 3x3 for bayer or xtrans):
-      int xx = x & ~1, yy = y & ~1;
-      float M = 0.0f, m = FLT_MAX;
-      if(xx < d->wd - 2 && yy < d->ht - 2)
-      {
-        for(int i = 0; i < 3; i++)
-          for(int j = 0; j < 3; j++)
-          {
-            M = MAX(M, ((float *)ivoid)[xx + i + d->wd * (yy + j)]);
-            m = MIN(m, ((float *)ivoid)[xx + i + d->wd * (yy + j)]);
-          }
-        // move envelope a little to allow non-zero weight even for clipped regions.
-        // this is because even if the 2x2 block is clipped somewhere, the other channels
-        // might still prove useful. we'll check for individual channel saturation below.
-        w *= d->epsw + envelope((M + offset) / saturation);
-      }
 
-      if(M + offset >= saturation)
-      {
-        if(d->weight[x + d->wd * y] <= 0.0f)
-        { // only consider saturated pixels in case we have nothing better:
-          if(d->weight[x + d->wd * y] == 0 || m < -d->weight[x + d->wd * y])
-          {
-            if(m + offset >= saturation)
-              d->pixels[x + d->wd * y] = 1.0f; // let's admit we were completely clipped, too
-            else
-              d->pixels[x + d->wd * y] = in * cal / d->whitelevel;
-            d->weight[x + d->wd * y]
-                = -m; // could use -cal here, but m is per pixel and safer for varying illumination conditions
-          }
-        }
-        // else silently ignore, others have filled in a better color here already
-      }
-      else
-      {
-        if(d->weight[x + d->wd * y] <= 0.0)
-        { // cleanup potentially blown highlights from earlier images
-          d->pixels[x + d->wd * y] = 0.0f;
-          d->weight[x + d->wd * y] = 0.0f;
-        }
-        d->pixels[x + d->wd * y] += w * in * cal;
-        d->weight[x + d->wd * y] += w;
-      }
-    }
+  // the input buffer is gone once we return, so keep a copy for the worker. it only ever
+  // works on one frame, so wait for it to be done with the previous one first.
+  _merge_hdr_join(d);
+  const size_t npixels = (size_t)d->wd * d->ht;
+  if(!d->frame) d->frame = dt_alloc_align(64, npixels * sizeof(float));
+  if(!d->frame)
+  {
+    dt_control_log(_("out of memory while merging hdr images"));
+    d->abort = TRUE;
+    return 1;
+  }
+  memcpy(d->frame, ivoid, npixels * sizeof(float));
+  d->frame_cal = cal;
+  d->frame_photoncnt = photoncnt;
+  d->frame_whitelevel = d->whitelevel;
+  d->worker = g_thread_new("merge hdr", _merge_hdr_worker, d);
 
   return 0;
 }
@@ -476,6 +549,9 @@ static int32_t dt_control_merge_hdr_job_run(dt_job_t *job)
     num++;
   }
 
+  // wait for the last frame to be merged
+  _merge_hdr_join(&d);
+
   if(d.abort) goto end;
 
 // normalize by white level to make clipping at 1.0 work as expected
@@ -520,6 +596,8 @@ static int32_t dt_control_merge_hdr_job_run(dt_job_t *job)
   dt_control_queue_redraw_center();
 
 end:
+  _merge_hdr_join(&d);
+  dt_free_align(d.frame);
   free(d.pixels);
   free(d.weight);
 
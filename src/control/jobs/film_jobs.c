@@ -17,9 +17,18 @@
 */
 #include "control/jobs/film_jobs.h"
 #include "common/darktable.h"
+#include "common/database.h"
+#include "common/exif.h"
 #include "common/film.h"
+#include <sqlite3.h>
 #include <stdlib.h>
 
+// number of files whose metadata is parsed ahead of the one being imported
+#define DT_FILM_IMPORT_LOOKAHEAD 32
+// number of images written per database transaction. the transaction holds off every other writer, so
+// keep it short: the metadata of a batch is parsed before the transaction starts.
+#define DT_FILM_IMPORT_BATCH 8
+
 typedef struct dt_film_import1_t
 {
   dt_film_t *film;
@@ -133,6 +142,33 @@ int _film_filename_cmp(gchar *a, gchar *b)
   return ret;
 }
 
+typedef struct _film_import_file_t
+{
+  const gchar *filename;
+  void *exif; // parsed by dt_exif_preload()
+  gboolean done;
+} _film_import_file_t;
+
+typedef struct _film_import_preload_t
+{
+  GMutex lock;
+  GCond cond;
+} _film_import_preload_t;
+
+static void _film_import_preload(gpointer data, gpointer user_data)
+{
+  _film_import_file_t *file = (_film_import_file_t *)data;
+  _film_import_preload_t *preload = (_film_import_preload_t *)user_data;
+
+  void *exif = dt_exif_preload(file->filename);
+
+  g_mutex_lock(&preload->lock);
+  file->exif = exif;
+  file->done = TRUE;
+  g_cond_broadcast(&preload->cond);
+  g_mutex_unlock(&preload->lock);
+}
+
 static void dt_film_import1(dt_job_t *job, dt_film_t *film)
 {
   gboolean recursive = dt_conf_get_bool("ui_last/import_recursive");
@@ -200,12 +236,41 @@ static void dt_film_import1(dt_job_t *job, dt_film_t *film)
   dt_control_job_set_progress_message(job, message);
 
 
+  /* the metadata of the upcoming files is parsed by a few threads while this one
+     does the database work, in short batches of one transaction each */
+  _film_import_file_t *files = calloc(total, sizeof(_film_import_file_t));
+  guint k = 0;
+  for(GList *image = images; image; image = g_list_next(image))
+    files[k++].filename = (const gchar *)image->data;
+
+  _film_import_preload_t preload;
+  g_mutex_init(&preload.lock);
+  g_cond_init(&preload.cond);
+  GThreadPool *pool
+      = g_thread_pool_new(_film_import_preload, &preload, MIN(4, (int)dt_get_num_threads()), FALSE, NULL);
+  for(k = 0; k < MIN(total, DT_FILM_IMPORT_LOOKAHEAD); k++) g_thread_pool_push(pool, &files[k], NULL);
+
   /* loop thru the images and import to current film roll */
   dt_film_t *cfr = film;
-  GList *image = g_list_first(images);
-  do
+  for(guint i = 0; i < total; i++)
   {
-    gchar *cdn = g_path_get_dirname((const gchar *)image->data);
+    if(i % DT_FILM_IMPORT_BATCH == 0)
+    {
+      const guint last = MIN(i + DT_FILM_IMPORT_BATCH, total);
+      for(k = i; k < last; k++)
+        if(k + DT_FILM_IMPORT_LOOKAHEAD < total)
+          g_thread_pool_push(pool, &files[k + DT_FILM_IMPORT_LOOKAHEAD], NULL);
+
+      // wait for the whole batch, without holding up the other writers
+      g_mutex_lock(&preload.lock);
+      for(k = i; k < last; k++)
+        while(!files[k].done) g_cond_wait(&preload.cond, &preload.lock);
+      g_mutex_unlock(&preload.lock);
+
+      dt_database_start_transaction(darktable.db);
+    }
+
+    gchar *cdn = g_path_get_dirname(files[i].filename);
 
     /* check if we need to initialize a new filmroll */
     if(!cfr || g_strcmp0(cfr->dirname, cdn) != 0)
@@ -253,14 +318,21 @@ static void dt_film_import1(dt_job_t *job, dt_film_t *film)
     g_free(cdn);
 
     /* import image */
-    dt_image_import(cfr->id, (const gchar *)image->data, FALSE);
+    dt_image_import_preloaded(cfr->id, files[i].filename, FALSE, files[i].exif);
+    dt_exif_preload_free(files[i].exif);
+    files[i].exif = NULL;
+
+    if(i % DT_FILM_IMPORT_BATCH == DT_FILM_IMPORT_BATCH - 1 || i == total - 1)
+      dt_database_release_transaction(darktable.db);
 
     fraction += 1.0 / total;
     dt_control_job_set_progress(job, fraction);
+  }
 
-
-  } while((image = g_list_next(image)) != NULL);
-
+  g_thread_pool_free(pool, FALSE, TRUE);
+  g_cond_clear(&preload.cond);
+  g_mutex_clear(&preload.lock);
+  free(files);
   g_list_free_full(images, g_free);
 
   // only redraw at the end, to not spam the cpu with exposure events
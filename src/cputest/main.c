@@ -0,0 +1,89 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/darktable.h"
+#include "common/dispatch.h"
+#include "develop/imageop.h"
+
+#ifdef __APPLE__
+#include "osx/osx.h"
+#endif
+
+#ifdef _WIN32
+#include <conio.h>
+#include "win/main_wrapper.h"
+#endif
+
+// fma and different summation orders are fine, real bugs are way off
+#define DT_CPUTEST_TOLERANCE 1e-4f
+
+// kernels which have to be there, a missing one would silently never be compared to its reference
+static const char *_expected_kernels[] = { "box filter", "blend rgb display", "blend rgb scene", "nlmeans",
+                                           "ppg demosaic", "rcd demosaic", "amaze demosaic" };
+
+int main(int argc, char *arg[])
+{
+#ifdef __APPLE__
+  dt_osx_prepare_environment();
+#endif
+  int result = 1;
+  // we need the iops to be loaded, they register their kernels in init_global()
+  char *m_arg[] = { "--library", ":memory:", "--conf", "write_sidecar_files=false" };
+  const int m_argc = sizeof(m_arg) / sizeof(m_arg[0]);
+  char **argv = malloc(sizeof(arg[0]) * argc + sizeof(m_arg));
+  if(!argv) goto end;
+  for(int i = 0; i < argc; i++)
+    argv[i] = arg[i];
+  for(int i = 0; i < m_argc; i++)
+    argv[argc + i] = m_arg[i];
+  argc += m_argc;
+  if(dt_init(argc, argv, FALSE, TRUE, NULL)) goto end;
+
+  // without gui init_global() of the iops is deferred, but that's where they register their kernels
+  dt_iop_init_global_all();
+
+  int missing = 0;
+  for(int k = 0; k < sizeof(_expected_kernels) / sizeof(_expected_kernels[0]); k++)
+    if(!dt_dispatch_is_registered(_expected_kernels[k]))
+    {
+      fprintf(stderr, "[cputest] kernel `%s' is not registered\n", _expected_kernels[k]);
+      missing++;
+    }
+
+  int failed = dt_dispatch_benchmark(DT_CPUTEST_TOLERANCE);
+  if(failed) fprintf(stderr, "[cputest] %d kernel variant(s) differ from the scalar reference\n", failed);
+  failed += missing;
+
+  dt_cleanup();
+  free(argv);
+
+  result = failed ? 1 : 0;
+end:
+
+#ifdef _WIN32
+  printf("\npress any key to exit\n");
+  FlushConsoleInputBuffer(GetStdHandle(STD_INPUT_HANDLE));
+  getch();
+#endif
+
+  exit(result);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -219,6 +219,87 @@ int dt_develop_blendif_init_masking_profile(struct dt_dev_pixelpipe_iop_t *piece
   return 1;
 }
 
+static void _develop_blendif_make_mask(const dt_develop_blend_colorspace_t blend_csp,
+                                      struct dt_dev_pixelpipe_iop_t *piece, const float *const restrict a,
+                                      const float *const restrict b, const struct dt_iop_roi_t *const roi_in,
+                                      const struct dt_iop_roi_t *const roi_out, float *const restrict mask)
+{
+  switch(blend_csp)
+  {
+    case DEVELOP_BLEND_CS_LAB:
+      dt_develop_blendif_lab_make_mask(piece, a, b, roi_in, roi_out, mask);
+      break;
+    case DEVELOP_BLEND_CS_RGB_DISPLAY:
+      dt_develop_blendif_rgb_hsl_make_mask(piece, a, b, roi_in, roi_out, mask);
+      break;
+    case DEVELOP_BLEND_CS_RGB_SCENE:
+      dt_develop_blendif_rgb_jzczhz_make_mask(piece, a, b, roi_in, roi_out, mask);
+      break;
+    case DEVELOP_BLEND_CS_RAW:
+      dt_develop_blendif_raw_make_mask(piece, a, b, roi_in, roi_out, mask);
+      break;
+    default:
+      break;
+  }
+}
+
+static void _develop_blendif_blend(const dt_develop_blend_colorspace_t blend_csp,
+                                   struct dt_dev_pixelpipe_iop_t *piece, const float *const restrict a,
+                                   float *const restrict b, const struct dt_iop_roi_t *const roi_in,
+                                   const struct dt_iop_roi_t *const roi_out, const float *const restrict mask,
+                                   const dt_dev_pixelpipe_display_mask_t request_mask_display)
+{
+  switch(blend_csp)
+  {
+    case DEVELOP_BLEND_CS_LAB:
+      dt_develop_blendif_lab_blend(piece, a, b, roi_in, roi_out, mask, request_mask_display);
+      break;
+    case DEVELOP_BLEND_CS_RGB_DISPLAY:
+      dt_develop_blendif_rgb_hsl_blend(piece, a, b, roi_in, roi_out, mask, request_mask_display);
+      break;
+    case DEVELOP_BLEND_CS_RGB_SCENE:
+      dt_develop_blendif_rgb_jzczhz_blend(piece, a, b, roi_in, roi_out, mask, request_mask_display);
+      break;
+    case DEVELOP_BLEND_CS_RAW:
+      dt_develop_blendif_raw_blend(piece, a, b, roi_in, roi_out, mask, request_mask_display);
+      break;
+    default:
+      break;
+  }
+}
+
+// compute the parametric mask and blend through it a band of rows at a time, so that input, output and mask
+// of a band are still in cache for the blend. only possible if the mask doesn't get filtered in between.
+static void _develop_blendif_make_mask_and_blend(const dt_develop_blend_colorspace_t blend_csp,
+                                                 struct dt_dev_pixelpipe_iop_t *piece,
+                                                 const float *const restrict a, float *const restrict b,
+                                                 const struct dt_iop_roi_t *const roi_in,
+                                                 const struct dt_iop_roi_t *const roi_out,
+                                                 float *const restrict mask,
+                                                 const dt_dev_pixelpipe_display_mask_t request_mask_display)
+{
+  const int ch = piece->colors;
+  // a few rows per thread keep all of them busy while a band stays small enough for the caches
+  const int band = MAX(16, 4 * dt_get_num_threads());
+
+  for(int y = 0; y < roi_out->height; y += band)
+  {
+    // the band as a roi of its own, at the same offset between input and output
+    dt_iop_roi_t band_in = *roi_in, band_out = *roi_out;
+    band_in.y += y;
+    band_in.height -= y;
+    band_out.y += y;
+    band_out.height = MIN(band, roi_out->height - y);
+
+    const float *const band_a = a + (size_t)y * roi_in->width * ch;
+    float *const band_b = b + (size_t)y * roi_out->width * ch;
+    float *const band_mask = mask + (size_t)y * roi_out->width;
+    _develop_blendif_make_mask(blend_csp, piece, band_a, band_b, &band_in, &band_out, band_mask);
+    _develop_blendif_blend(blend_csp, piece, band_a, band_b, &band_in, &band_out, band_mask,
+                           request_mask_display);
+  }
+}
+
 void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                               const void *const ivoid, void *const ovoid, const struct dt_iop_roi_t *const roi_in,
                               const struct dt_iop_roi_t *const roi_out)
@@ -276,6 +357,9 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
   const _Bool mask_feather = d->feathering_radius > 0.1f;
   const _Bool mask_blur = d->blur_radius > 0.1f;
   const _Bool mask_tone_curve = fabsf(d->contrast) >= 0.01f || fabsf(d->brightness) >= 0.01f;
+  // the parametric mask only needs the pixel it applies to, unless it gets feathered, blurred or tone mapped
+  const _Bool fused = !(mask_mode == DEVELOP_MASK_ENABLED || suppress_mask) && !(mask_mode & DEVELOP_MASK_RASTER)
+                      && !mask_feather && !mask_blur && !mask_tone_curve;
 
   // get the clipped opacity value  0 - 1
   const float opacity = fminf(fmaxf(0.0f, (d->opacity / 100.0f)), 1.0f);
@@ -355,28 +439,11 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
       dt_iop_image_fill(mask,fill,owidth,oheight,1); //mask[k] = fill;
     }
 
-    // get parametric mask (if any) and apply global opacity
-    switch(blend_csp)
-    {
-      case DEVELOP_BLEND_CS_LAB:
-        dt_develop_blendif_lab_make_mask(piece, (const float *const restrict)ivoid,
-                                         (const float *const restrict)ovoid, roi_in, roi_out, mask);
-        break;
-      case DEVELOP_BLEND_CS_RGB_DISPLAY:
-        dt_develop_blendif_rgb_hsl_make_mask(piece, (const float *const restrict)ivoid,
-                                             (const float *const restrict)ovoid, roi_in, roi_out, mask);
-        break;
-      case DEVELOP_BLEND_CS_RGB_SCENE:
-        dt_develop_blendif_rgb_jzczhz_make_mask(piece, (const float *const restrict)ivoid,
-                                                (const float *const restrict)ovoid, roi_in, roi_out, mask);
-        break;
-      case DEVELOP_BLEND_CS_RAW:
-        dt_develop_blendif_raw_make_mask(piece, (const float *const restrict)ivoid,
-                                         (const float *const restrict)ovoid, roi_in, roi_out, mask);
-        break;
-      default:
-        break;
-    }
+    // get parametric mask (if any) and apply global opacity. unless the mask gets post-processed, this is
+    // done band by band along with the blending below.
+    if(!fused)
+      _develop_blendif_make_mask(blend_csp, piece, (const float *const restrict)ivoid,
+                                 (const float *const restrict)ovoid, roi_in, roi_out, mask);
 
     if(mask_feather)
     {
@@ -470,28 +537,13 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
   }
 
   // now apply blending with per-pixel opacity value as defined in mask
-  // select the blend operator
-  switch(blend_csp)
-  {
-    case DEVELOP_BLEND_CS_LAB:
-      dt_develop_blendif_lab_blend(piece, (const float *const restrict)ivoid, (float *const restrict)ovoid,
-                                   roi_in, roi_out, mask, request_mask_display);
-      break;
-    case DEVELOP_BLEND_CS_RGB_DISPLAY:
-      dt_develop_blendif_rgb_hsl_blend(piece, (const float *const restrict)ivoid, (float *const restrict)ovoid,
-                                       roi_in, roi_out, mask, request_mask_display);
-      break;
-    case DEVELOP_BLEND_CS_RGB_SCENE:
-      dt_develop_blendif_rgb_jzczhz_blend(piece, (const float *const restrict)ivoid, (float *const restrict)ovoid,
-                                          roi_in, roi_out, mask, request_mask_display);
-      break;
-    case DEVELOP_BLEND_CS_RAW:
-      dt_develop_blendif_raw_blend(piece, (const float *const restrict)ivoid, (float *const restrict)ovoid,
-                                   roi_in, roi_out, mask, request_mask_display);
-      break;
-    default:
-      break;
-  }
+  if(fused)
+    _develop_blendif_make_mask_and_blend(blend_csp, piece, (const float *const restrict)ivoid,
+                                         (float *const restrict)ovoid, roi_in, roi_out, mask,
+                                         request_mask_display);
+  else
+    _develop_blendif_blend(blend_csp, piece, (const float *const restrict)ivoid, (float *const restrict)ovoid,
+                           roi_in, roi_out, mask, request_mask_display);
 
   // register if _this_ module should expose mask or display channel
   if(request_mask_display & (DT_DEV_PIXELPIPE_DISPLAY_MASK | DT_DEV_PIXELPIPE_DISPLAY_CHANNEL))
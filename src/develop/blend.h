@@ -628,6 +628,12 @@ void dt_develop_blendif_rgb_jzczhz_blend(struct dt_dev_pixelpipe_iop_t *piece, c
                                          const struct dt_iop_roi_t *const roi_out, const float *const mask,
                                          const dt_dev_pixelpipe_display_mask_t request_mask_display);
 
+/** select the fastest variants of the blend operators, called from dt_init() once the codepaths are known */
+void dt_develop_blendif_rgb_hsl_init(void);
+void dt_develop_blendif_rgb_hsl_cleanup(void);
+void dt_develop_blendif_rgb_jzczhz_init(void);
+void dt_develop_blendif_rgb_jzczhz_cleanup(void);
+
 
 /** gui related stuff */
 void dt_iop_gui_init_blendif(GtkBox *blendw, dt_iop_module_t *module);
@@ -280,6 +280,32 @@ void dt_iop_default_init(dt_iop_module_t *module)
   }
 }
 
+// serializes deferred calls to init_global()
+static GMutex _iop_init_global_lock;
+
+static void _iop_init_global(dt_iop_module_so_t *module)
+{
+  g_mutex_lock(&_iop_init_global_lock);
+  if(!module->global_inited)
+  {
+    if(module->init_global) module->init_global(module);
+    module->global_inited = TRUE;
+  }
+  g_mutex_unlock(&_iop_init_global_lock);
+}
+
+void dt_iop_init_global_data(dt_iop_module_t *module)
+{
+  _iop_init_global(module->so);
+  module->global_data = module->so->data;
+}
+
+void dt_iop_init_global_all(void)
+{
+  for(const GList *l = darktable.iop; l; l = g_list_next(l))
+    _iop_init_global((dt_iop_module_so_t *)l->data);
+}
+
 int dt_iop_load_module_so(void *m, const char *libname, const char *op)
 {
   dt_iop_module_so_t *module = (dt_iop_module_so_t *)m;
@@ -443,7 +469,9 @@ int dt_iop_load_module_so(void *m, const char *libname, const char *op)
       fprintf(stderr, "[iop_load_module] failed to initialize introspection for operation `%s'\n", op);
   }
 
-  if(module->init_global) module->init_global(module);
+  // without gui (darktable-cli and friends) the global init (opencl kernels, lookup tables, databases) is
+  // deferred until the first instance of the module gets created, before its init() and reload_defaults().
+  if(darktable.gui) _iop_init_global(module);
   return 0;
 error:
   fprintf(stderr, "[iop_load_module] failed to open operation `%s': %s\n", op, g_module_error());
@@ -580,7 +608,8 @@ int dt_iop_load_module_by_so(dt_iop_module_t *module, dt_iop_module_so_t *so, dt
     dt_iop_gui_set_state(module, state);
   }
 
-  module->global_data = so->data;
+  // init() and reload_defaults() may already need the global data (lensfun database, dispatched kernels)
+  dt_iop_init_global_data(module);
 
   // now init the instance:
   module->init(module);
@@ -1759,7 +1788,6 @@ GList *dt_iop_load_modules_ext(dt_develop_t *dev, gboolean no_image)
       continue;
     }
     res = g_list_insert_sorted(res, module, dt_sort_iop_by_order);
-    module->global_data = module_so->data;
     module->so = module_so;
     iop = g_list_next(iop);
   }
@@ -1802,7 +1830,7 @@ void dt_iop_unload_modules_so()
   while(darktable.iop)
   {
     dt_iop_module_so_t *module = (dt_iop_module_so_t *)darktable.iop->data;
-    if(module->cleanup_global) module->cleanup_global(module);
+    if(module->global_inited && module->cleanup_global) module->cleanup_global(module);
     if(module->module) g_module_close(module->module);
     free(darktable.iop->data);
     darktable.iop = g_list_delete_link(darktable.iop, darktable.iop);
@@ -1974,6 +2002,7 @@ void dt_iop_commit_params(dt_iop_module_t *module, dt_iop_params_t *params,
                           dt_dev_pixelpipe_iop_t *piece)
 {
   piece->hash = 0;
+  piece->mask_hash = 0;
 
   if(piece->enabled)
   {
@@ -2013,6 +2042,14 @@ void dt_iop_commit_params(dt_iop_module_t *module, dt_iop_params_t *params,
     for(int i = 0; i < length; i++) hash = ((hash << 5) + hash) ^ str[i];
     piece->hash = hash;
 
+    /* the drawn masks alone, so that their rendering can be reused while other params change */
+    if(grp)
+    {
+      uint64_t mask_hash = 5381;
+      for(int i = pos; i < length; i++) mask_hash = ((mask_hash << 5) + mask_hash) ^ str[i];
+      piece->mask_hash = mask_hash;
+    }
+
     free(str);
 
     dt_print(DT_DEBUG_PARAMS, "[params] commit for %s in pipe %i with hash %lu\n", module->op, pipe->type, (long unsigned int)piece->hash);
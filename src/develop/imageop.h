@@ -166,6 +166,8 @@ typedef struct dt_iop_module_so_t
   GtkWidget *widget;
   /** button used to show/hide this module in the plugin list. */
   dt_iop_module_state_t state;
+  /** set once init_global() ran. without gui this is deferred until the first instance is created. */
+  gboolean global_inited;
 
   /** this initializes static, hardcoded presets for this module and is called only once per run of dt. */
   void (*init_presets)(struct dt_iop_module_so_t *self);
@@ -584,6 +586,10 @@ int dt_iop_load_module_by_so(dt_iop_module_t *module, dt_iop_module_so_t *so, st
 GList *dt_iop_load_modules_ext(struct dt_develop_t *dev, gboolean no_image);
 GList *dt_iop_load_modules(struct dt_develop_t *dev);
 int dt_iop_load_module(dt_iop_module_t *module, dt_iop_module_so_t *module_so, struct dt_develop_t *dev);
+/** make sure init_global() of the module ran and its global data is available to the instance */
+void dt_iop_init_global_data(dt_iop_module_t *module);
+/** run init_global() of all modules now, without gui it is otherwise deferred to their first instance */
+void dt_iop_init_global_all(void);
 /** calls module->cleanup and closes the dl connection. */
 void dt_iop_cleanup_module(dt_iop_module_t *module);
 /** initialize pipe. */
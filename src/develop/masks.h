@@ -354,6 +354,12 @@ GList *dt_masks_dup_forms_deep(GList *forms, dt_masks_form_t *form);
 /** utils functions */
 int dt_masks_point_in_form_exact(float x, float y, float *points, int points_start, int points_count);
 int dt_masks_point_in_form_near(float x, float y, float *points, int points_start, int points_count, float distance, int *near);
+/** sort segments covering the rows rows[2 * k] ... rows[2 * k + 1] into bands of *band_height rows, so that
+ *  they can be drawn band by band in parallel without two threads writing the same pixel. the segments touching
+ *  band b are index[start[b]] ... index[start[b + 1] - 1]. returns the number of bands, 0 if out of memory.
+ *  start and index are to be freed with dt_free_align(). */
+int dt_masks_bin_rows(const int *const rows, const int count, const int height, int *band_height, int **start,
+                      int **index);
 
 /** allow to select a shape inside an iop */
 void dt_masks_select_form(struct dt_iop_module_t *module, dt_masks_form_t *sel);
@@ -2731,8 +2731,9 @@ static int dt_brush_get_mask(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *pi
 }
 
 /** we write a falloff segment respecting limits of buffer */
-static inline void _brush_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int bh, float hardness,
-                                      float density)
+/** we write a falloff segment respecting limits of buffer, into rows y0 ... y1 - 1 only */
+static inline void _brush_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int bh, int y0, int y1,
+                                      float hardness, float density)
 {
   // segment length (increase by 1 to avoid division-by-zero special case handling)
   const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
@@ -2761,14 +2762,19 @@ static inline void _brush_falloff_roi(float *buffer, const int *p0, const int *p
     fy += ly;
     if(i > solid) op -= dop;
 
+    // the segment runs monotonically away from rows it has left behind
+    if((dy > 0 && y >= y1) || (dy < 0 && y < y0)) break;
     if(x < 0 || x >= bw || y < 0 || y >= bh) continue;
 
     float *buf = buffer + (size_t)y * bw + x;
 
-    *buf = MAX(*buf, op);
-    if(x + dx >= 0 && x + dx < bw)
-      buf[dpx] = MAX(buf[dpx], op); // this one is to avoid gaps due to int rounding
-    if(y + dy >= 0 && y + dy < bh)
+    if(y >= y0 && y < y1)
+    {
+      *buf = MAX(*buf, op);
+      if(x + dx >= 0 && x + dx < bw)
+        buf[dpx] = MAX(buf[dpx], op); // this one is to avoid gaps due to int rounding
+    }
+    if(y + dy >= 0 && y + dy < bh && y + dy >= y0 && y + dy < y1)
       buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gaps due to int rounding
   }
 }
@@ -2866,28 +2872,64 @@ static int dt_brush_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
     return 1;
   }
 
-  // now we fill the falloff
+  // now we fill the falloff. segments of neighbouring points overlap, so we draw them in bands of rows to keep
+  // threads from writing the same pixels
+  const int first = nb_corner * 3;
+  const int nseg = MAX(border_count - first, 0);
+  int *const rows = dt_alloc_align(64, sizeof(int) * 2 * MAX(nseg, 1));
+  int *bstart = NULL, *bindex = NULL;
+  int band_height = 0;
+  int nbands = 0;
+  if(rows)
+  {
+    for(int k = 0; k < nseg; k++)
+    {
+      const int i = first + k;
+      const int p0[] = { points[i * 2], points[i * 2 + 1] };
+      const int p1[] = { border[i * 2], border[i * 2 + 1] };
+      if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < 0
+         || MIN(p0[1], p1[1]) >= height)
+      {
+        // nothing to draw
+        rows[2 * k] = 0;
+        rows[2 * k + 1] = -1;
+        continue;
+      }
+      // the falloff sets the pixel below or above each point of the segment as well
+      rows[2 * k] = MIN(p0[1], p1[1]) - 2;
+      rows[2 * k + 1] = MAX(p0[1], p1[1]) + 2;
+    }
+    nbands = dt_masks_bin_rows(rows, nseg, height, &band_height, &bstart, &bindex);
+    dt_free_align(rows);
+  }
+  if(nbands == 0)
+  {
+    dt_free_align(points);
+    dt_free_align(border);
+    dt_free_align(payload);
+    return 0;
+  }
+
 #ifdef _OPENMP
-#if !defined(__SUNOS__) && !defined(__NetBSD__)
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(nb_corner, border_count, width, height) \
-  shared(buffer, points, border, payload)
-#else
-#pragma omp parallel for shared(buffer)
-#endif
+  dt_omp_firstprivate(buffer, points, border, payload, bstart, bindex, nbands, band_height, first, width, height) \
+  schedule(dynamic)
 #endif
-  for(int i = nb_corner * 3; i < border_count; i++)
+  for(int b = 0; b < nbands; b++)
   {
-    const int p0[] = { points[i * 2], points[i * 2 + 1] };
-    const int p1[] = { border[i * 2], border[i * 2 + 1] };
-
-    if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < 0
-       || MIN(p0[1], p1[1]) >= height)
-      continue;
-
-    _brush_falloff_roi(buffer, p0, p1, width, height, payload[i * 2], payload[i * 2 + 1]);
+    const int y0 = b * band_height;
+    const int y1 = MIN(y0 + band_height, height);
+    for(int k = bstart[b]; k < bstart[b + 1]; k++)
+    {
+      const int i = first + bindex[k];
+      const int p0[] = { points[i * 2], points[i * 2 + 1] };
+      const int p1[] = { border[i * 2], border[i * 2 + 1] };
+      _brush_falloff_roi(buffer, p0, p1, width, height, y0, y1, payload[i * 2], payload[i * 2 + 1]);
+    }
   }
 
+  dt_free_align(bstart);
+  dt_free_align(bindex);
   dt_free_align(points);
   dt_free_align(border);
   dt_free_align(payload);
@@ -711,14 +711,69 @@ static int dt_group_get_mask_roi(dt_iop_module_t *const restrict module,
   return nb_ok != 0;
 }
 
+// the identity of a rendered mask: the forms as hashed by dt_iop_commit_params(), the region of interest, and
+// everything the shapes go through on their way from image coordinates to the module. returns 0 if the mask
+// shouldn't be cached.
+static uint64_t _group_render_hash(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
+                                   const dt_iop_roi_t *roi)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  // exports and thumbnails render each mask once, and tiles are too many to keep around
+  if(!(pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_PREVIEW | DT_DEV_PIXELPIPE_PREVIEW2))
+     || pipe->tiling || piece->mask_hash == 0)
+    return 0;
+
+  uint64_t hash = piece->mask_hash;
+  hash = ((hash << 5) + hash) ^ form->formid;
+  hash = ((hash << 5) + hash) ^ pipe->image.id;
+  const int geometry[] = { pipe->iwidth, pipe->iheight, roi->x, roi->y, roi->width, roi->height };
+  for(int k = 0; k < 6; k++) hash = ((hash << 5) + hash) ^ geometry[k];
+  const float scales[] = { pipe->iscale, roi->scale };
+  const char *str = (const char *)scales;
+  for(size_t k = 0; k < sizeof(scales); k++) hash = ((hash << 5) + hash) ^ str[k];
+
+  // distortions of the modules up to this one, and which of them the focused module has switched off
+  dt_develop_t *dev = module->dev;
+  hash = ((hash << 5) + hash)
+         ^ dt_dev_hash_distort_plus(dev, pipe, module->iop_order, DT_DEV_TRANSFORM_DIR_BACK_INCL);
+  if(dev->gui_module) hash = ((hash << 5) + hash) ^ dev->gui_module->operation_tags_filter();
+
+  // 0 marks an empty cache
+  return hash ? hash : 1;
+}
+
 int dt_masks_group_render_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                               const dt_iop_roi_t *roi, float *buffer)
 {
   const double start = dt_get_wtime();
   if(!form) return 0;
 
+  const size_t size = sizeof(float) * roi->width * roi->height;
+  const uint64_t hash = _group_render_hash(module, piece, form, roi);
+  if(hash && piece->mask_cache && piece->mask_cache_hash == hash)
+  {
+    memcpy(buffer, piece->mask_cache, size);
+    if(darktable.unmuted & DT_DEBUG_PERF)
+      dt_print(DT_DEBUG_MASKS, "[masks] reusing rendered masks took %0.04f sec\n", dt_get_wtime() - start);
+    return 1;
+  }
+
   const int ok = dt_masks_get_mask_roi(module, piece, form, roi, buffer);
 
+  // keep a single mask per piece, which is all the module asks for as long as nothing changes
+  dt_free_align(piece->mask_cache);
+  piece->mask_cache = NULL;
+  piece->mask_cache_hash = 0;
+  if(ok && hash)
+  {
+    piece->mask_cache = dt_alloc_align(64, size);
+    if(piece->mask_cache)
+    {
+      memcpy(piece->mask_cache, buffer, size);
+      piece->mask_cache_hash = hash;
+    }
+  }
+
   if(darktable.unmuted & DT_DEBUG_PERF)
     dt_print(DT_DEBUG_MASKS, "[masks] render all masks took %0.04f sec\n", dt_get_wtime() - start);
   return ok;
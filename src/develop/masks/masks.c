@@ -2957,6 +2957,56 @@ int dt_masks_point_in_form_near(float x, float y, float *points, int points_star
   return 0;
 }
 
+int dt_masks_bin_rows(const int *const rows, const int count, const int height, int *band_height, int **start,
+                      int **index)
+{
+  // a few bands per thread, so that a dense part of the shape doesn't leave the other threads idle. segments
+  // crossing a band border are visited once per band, so don't split at all if there is nothing to share.
+  const int nthreads = dt_get_num_threads();
+  const int nbands = MAX(1, MIN(height, nthreads > 1 ? 4 * nthreads : 1));
+  const int bh = (height + nbands - 1) / nbands;
+
+  int *const bstart = dt_alloc_align(64, sizeof(int) * (nbands + 1));
+  if(bstart == NULL) return 0;
+  memset(bstart, 0, sizeof(int) * (nbands + 1));
+
+  // count the segments touching each band, then turn the counts into offsets
+  int total = 0;
+  for(int k = 0; k < count; k++)
+  {
+    const int y0 = MAX(rows[2 * k], 0);
+    const int y1 = MIN(rows[2 * k + 1], height - 1);
+    if(y0 > y1) continue;
+    for(int b = y0 / bh; b <= y1 / bh; b++) bstart[b + 1]++;
+    total += y1 / bh - y0 / bh + 1;
+  }
+  for(int b = 0; b < nbands; b++) bstart[b + 1] += bstart[b];
+
+  int *const bindex = dt_alloc_align(64, sizeof(int) * MAX(total, 1));
+  int *const pos = dt_alloc_align(64, sizeof(int) * nbands);
+  if(bindex == NULL || pos == NULL)
+  {
+    dt_free_align(bstart);
+    dt_free_align(bindex);
+    dt_free_align(pos);
+    return 0;
+  }
+  memcpy(pos, bstart, sizeof(int) * nbands);
+  for(int k = 0; k < count; k++)
+  {
+    const int y0 = MAX(rows[2 * k], 0);
+    const int y1 = MIN(rows[2 * k + 1], height - 1);
+    if(y0 > y1) continue;
+    for(int b = y0 / bh; b <= y1 / bh; b++) bindex[pos[b]++] = k;
+  }
+  dt_free_align(pos);
+
+  *band_height = bh;
+  *start = bstart;
+  *index = bindex;
+  return nbands;
+}
+
 // allow to select a shape inside an iop
 void dt_masks_select_form(struct dt_iop_module_t *module, dt_masks_form_t *sel)
 {
@@ -2572,8 +2572,8 @@ static int _path_crop_to_roi(float *path, const int point_count, float xmin, flo
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static void _path_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh)
+/** we write a falloff segment respecting limits of buffer, into rows y0 ... y1 - 1 only */
+static void _path_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int y0, int y1)
 {
   // segment length
   const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
@@ -2585,21 +2585,156 @@ static void _path_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh)
   const int dy = ly < 0 ? -1 : 1;
   const int dpy = dy * bw;
 
-  for(int i = 0; i < l; i++)
+  // only walk the part of the segment which reaches rows y0 - 1 ... y1
+  int i0 = 0, i1 = l;
+  if(ly != 0.0f)
+  {
+    const float ta = (y0 - 2 - p0[1]) * (float)l / ly;
+    const float tb = (y1 + 1 - p0[1]) * (float)l / ly;
+    i0 = MAX(0, (int)floorf(MIN(ta, tb)) - 1);
+    i1 = MIN(l, (int)ceilf(MAX(ta, tb)) + 2);
+  }
+  else if(p0[1] < y0 - 1 || p0[1] > y1)
+    return;
+
+  for(int i = i0; i < i1; i++)
   {
     // position
     const int x = (int)((float)i * lx / (float)l) + p0[0];
     const int y = (int)((float)i * ly / (float)l) + p0[1];
     const float op = 1.0f - (float)i / (float)l;
     float *buf = buffer + (size_t)y * bw + x;
-    if(x >= 0 && x < bw && y >= 0 && y < bh) buf[0] = MAX(buf[0], op);
-    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
+    if(x >= 0 && x < bw && y >= y0 && y < y1) buf[0] = MAX(buf[0], op);
+    if(x + dx >= 0 && x + dx < bw && y >= y0 && y < y1)
       buf[dx] = MAX(buf[dx], op); // this one is to avoid gap due to int rounding
-    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
+    if(x >= 0 && x < bw && y + dy >= y0 && y + dy < y1)
       buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gap due to int rounding
   }
 }
 
+/** find the crossings of the path edges with the centers of the buffer rows, the way the edge-flag fill always
+ *  did: at the pixel nearest to the crossing, and never on the upper end of an edge. if crossings is NULL, only
+ *  count them into pos[yy + 1], else store them at crossings[pos[yy]++]. */
+static void _path_crossings(const float *const cpoints, const int first, const int count, const int width,
+                            const int height, int *const pos, int *const crossings)
+{
+  float xlast = cpoints[(count - 1) * 2];
+  float ylast = cpoints[(count - 1) * 2 + 1];
+
+  for(int i = first; i < count; i++)
+  {
+    float xstart = xlast;
+    float ystart = ylast;
+
+    float xend = xlast = cpoints[i * 2];
+    float yend = ylast = cpoints[i * 2 + 1];
+
+    if(ystart > yend)
+    {
+      float tmp;
+      tmp = ystart, ystart = yend, yend = tmp;
+      tmp = xstart, xstart = xend, xend = tmp;
+    }
+
+    const float m = (xstart - xend) / (ystart - yend); // we don't need special handling of ystart==yend
+                                                       // as following loop will take care
+
+    for(int yy = (int)ceilf(ystart); (float)yy < yend; yy++)
+    {
+      const float xcross = xstart + m * (yy - ystart);
+
+      int xx = floorf(xcross);
+      if((float)xx + 0.5f <= xcross) xx++;
+
+      if(xx < 0 || xx >= width || yy < 0 || yy >= height)
+        continue; // sanity check just to be on the safe side
+
+      if(crossings)
+        crossings[pos[yy]++] = xx;
+      else
+        pos[yy + 1]++;
+    }
+  }
+}
+
+static int _path_cmp_int(const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+/** scanline fill of the path cropped to the roi. the crossings of the path with each row are collected into
+ *  a per-row edge table, then the rows are filled in parallel span by span between pairs of crossings. this
+ *  gives the same result as toggling a flag at each crossing and scanning the rows for the flags. */
+static int _path_fill_roi(float *const buffer, const float *const cpoints, const int first, const int count,
+                          const int width, const int height, const int xxmin, const int xxmax, const int yymin,
+                          const int yymax)
+{
+  int *const row_start = dt_alloc_align(64, sizeof(int) * (height + 1));
+  if(row_start == NULL) return 0;
+  memset(row_start, 0, sizeof(int) * (height + 1));
+
+  _path_crossings(cpoints, first, count, width, height, row_start, NULL);
+  for(int yy = 0; yy < height; yy++) row_start[yy + 1] += row_start[yy];
+
+  int *const crossings = dt_alloc_align(64, sizeof(int) * MAX(row_start[height], 1));
+  int *const row_pos = dt_alloc_align(64, sizeof(int) * height);
+  if(crossings == NULL || row_pos == NULL)
+  {
+    dt_free_align(row_start);
+    dt_free_align(crossings);
+    dt_free_align(row_pos);
+    return 0;
+  }
+  memcpy(row_pos, row_start, sizeof(int) * height);
+  _path_crossings(cpoints, first, count, width, height, row_pos, crossings);
+  dt_free_align(row_pos);
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(buffer, row_start, crossings, width, height, xxmin, xxmax, yymin, yymax) \
+  schedule(dynamic, 16)
+#endif
+  for(int yy = 0; yy < height; yy++)
+  {
+    int *const xs = crossings + row_start[yy];
+    const int n = row_start[yy + 1] - row_start[yy];
+    if(n == 0) continue;
+    qsort(xs, n, sizeof(int), _path_cmp_int);
+
+    // two crossings on the same pixel cancel out, as would their flags
+    int nflags = 0;
+    for(int k = 0; k < n; k++)
+    {
+      if(nflags > 0 && xs[nflags - 1] == xs[k])
+        nflags--;
+      else
+        xs[nflags++] = xs[k];
+    }
+
+    float *const row = buffer + (size_t)yy * width;
+    const int inside = (yy >= yymin && yy <= yymax);
+    int state = 0;
+    int from = xxmin;
+    for(int k = 0; k < nflags; k++)
+    {
+      const int x = xs[k];
+      // flags are always set, but only those within the bounding box switch the fill on and off
+      row[x] = 1.0f;
+      if(!inside || x < xxmin || x > xxmax) continue;
+      if(state)
+        for(int xx = from; xx < x; xx++) row[xx] = 1.0f;
+      state = !state;
+      from = x + 1;
+    }
+    if(state)
+      for(int xx = from; xx <= xxmax; xx++) row[xx] = 1.0f;
+  }
+
+  dt_free_align(row_start);
+  dt_free_align(crossings);
+  return 1;
+}
+
 static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                                 const dt_iop_roi_t *roi, float *buffer)
 {
@@ -2777,7 +2912,7 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
 
     // now we clip cpoints to roi -> catch special case when roi lies completely within path.
     // dirty trick: we allow path to extend one pixel beyond height-1. this avoids need of special handling
-    // of the last roi line in the following edge-flag polygon fill algorithm.
+    // of the last roi line in the following scanline fill.
     int crop_success = _path_crop_to_roi(cpoints + 2 * (nb_corner * 3), points_count - nb_corner * 3, 0,
                                          width - 1, 0, height);
     path_encircles_roi = path_encircles_roi || !crop_success;
@@ -2790,56 +2925,12 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
     if(path_encircles_roi)
     {
       // roi lies completely within path
-      for(size_t k = 0; k < (size_t)width * height; k++) buffer[k] = 1.0f;
+      dt_iop_image_fill(buffer, 1.0f, width, height, 1);
     }
     else
     {
       // all other cases
 
-      // edge-flag polygon fill: we write all the point around the path into the buffer
-      float xlast = cpoints[(points_count - 1) * 2];
-      float ylast = cpoints[(points_count - 1) * 2 + 1];
-
-      for(int i = nb_corner * 3; i < points_count; i++)
-      {
-        float xstart = xlast;
-        float ystart = ylast;
-
-        float xend = xlast = cpoints[i * 2];
-        float yend = ylast = cpoints[i * 2 + 1];
-
-        if(ystart > yend)
-        {
-          float tmp;
-          tmp = ystart, ystart = yend, yend = tmp;
-          tmp = xstart, xstart = xend, xend = tmp;
-        }
-
-        const float m = (xstart - xend) / (ystart - yend); // we don't need special handling of ystart==yend
-                                                           // as following loop will take care
-
-        for(int yy = (int)ceilf(ystart); (float)yy < yend;
-            yy++) // this would normally never touch the last roi line => see comment further above
-        {
-          const float xcross = xstart + m * (yy - ystart);
-
-          int xx = floorf(xcross);
-          if((float)xx + 0.5f <= xcross) xx++;
-
-          if(xx < 0 || xx >= width || yy < 0 || yy >= height)
-            continue; // sanity check just to be on the safe side
-
-          size_t index = (size_t)yy * width + xx;
-
-          buffer[index] = 1.0f - buffer[index];
-        }
-      }
-
-      if(darktable.unmuted & DT_DEBUG_PERF)
-        dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill draw path took %0.04f sec\n", form->name,
-                 dt_get_wtime() - start2);
-      start2 = dt_get_wtime();
-
       // we fill the inside plain
       // we don't need to deal with parts of shape outside of roi
       const int xxmin = MAX(xmin, 0);
@@ -2847,25 +2938,12 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
       const int yymin = MAX(ymin, 0);
       const int yymax = MIN(ymax, height - 1);
 
-#ifdef _OPENMP
-#if !defined(__SUNOS__) && !defined(__NetBSD__)
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(xxmin, xxmax, yymin, yymax, width) \
-  shared(buffer)
-#else
-#pragma omp parallel for shared(buffer)
-#endif
-#endif
-      for(int yy = yymin; yy <= yymax; yy++)
+      if(!_path_fill_roi(buffer, cpoints, nb_corner * 3, points_count, width, height, xxmin, xxmax, yymin, yymax))
       {
-        int state = 0;
-        for(int xx = xxmin; xx <= xxmax; xx++)
-        {
-          size_t index = (size_t)yy * width + xx;
-          float v = buffer[index];
-          if(v > 0.5f) state = !state;
-          if(state) buffer[index] = 1.0f;
-        }
+        dt_free_align(cpoints);
+        dt_free_align(points);
+        dt_free_align(border);
+        return 0;
       }
 
       if(darktable.unmuted & DT_DEBUG_PERF)
@@ -2936,18 +3014,49 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
       }
     }
 
+    // segments from neighbouring nodes overlap, so we draw them in bands of rows to keep threads apart
+    const int nseg = dindex / 4;
+    int *const rows = dt_alloc_align(64, sizeof(int) * 2 * MAX(nseg, 1));
+    int *bstart = NULL, *bindex = NULL;
+    int band_height = 0;
+    int nbands = 0;
+    if(rows)
+    {
+      for(int k = 0; k < nseg; k++)
+      {
+        // the falloff sets the pixel below or above each point of the segment as well
+        rows[2 * k] = MIN(dpoints[4 * k + 1], dpoints[4 * k + 3]) - 1;
+        rows[2 * k + 1] = MAX(dpoints[4 * k + 1], dpoints[4 * k + 3]) + 1;
+      }
+      nbands = dt_masks_bin_rows(rows, nseg, height, &band_height, &bstart, &bindex);
+      dt_free_align(rows);
+    }
+    if(nbands == 0)
+    {
+      dt_free_align(dpoints);
+      dt_free_align(points);
+      dt_free_align(border);
+      return 0;
+    }
+
 #ifdef _OPENMP
-#if !defined(__SUNOS__) && !defined(__NetBSD__)
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(width, height, dindex) \
-  shared(buffer, dpoints)
-#else
-#pragma omp parallel for shared(buffer)
+  dt_omp_firstprivate(buffer, dpoints, bstart, bindex, nbands, band_height, width, height) \
+  schedule(dynamic)
 #endif
-#endif
-    for(int n = 0; n < dindex; n += 4)
-      _path_falloff_roi(buffer, dpoints + n, dpoints + n + 2, width, height);
+    for(int b = 0; b < nbands; b++)
+    {
+      const int y0 = b * band_height;
+      const int y1 = MIN(y0 + band_height, height);
+      for(int k = bstart[b]; k < bstart[b + 1]; k++)
+      {
+        const int *const seg = dpoints + 4 * bindex[k];
+        _path_falloff_roi(buffer, seg, seg + 2, width, y0, y1);
+      }
+    }
 
+    dt_free_align(bstart);
+    dt_free_align(bindex);
     dt_free_align(dpoints);
 
     if(darktable.unmuted & DT_DEBUG_PERF)
@@ -21,6 +21,7 @@
 #include "develop/pixelpipe_hb.h"
 #include "libs/lib.h"
 #include <stdlib.h>
+#include <string.h>
 
 
 // TODO: make cache global (needs to be thread safe then)
@@ -32,8 +33,26 @@
 //   ping, pong, and priority buffer (focused plugin)
 // - drop read by the time another is requested (with priority, drop that, or alternating ping and pong?)
 
+static void _filter_cache_flush(dt_dev_pixelpipe_filter_cache_t *filters)
+{
+  for(int k = 0; k < filters->entries; k++)
+  {
+    filters->hash[k] = 0;
+    filters->used[k] = 0;
+  }
+}
+
 int dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_cache_t *cache, int entries, size_t size)
 {
+  // filter results are allocated on first use, pipes which never cache any don't pay for them. they count
+  // against the same budget as the cache lines. pipes with only a couple of lines (exports, thumbnails) run
+  // every module once and keep none.
+  memset(&cache->filters, 0, sizeof(cache->filters));
+  if(entries >= 2 * DT_DEV_PIXELPIPE_FILTER_CACHE_ENTRIES)
+  {
+    cache->filters.entries = DT_DEV_PIXELPIPE_FILTER_CACHE_ENTRIES;
+    entries -= DT_DEV_PIXELPIPE_FILTER_CACHE_ENTRIES;
+  }
   cache->entries = entries;
   cache->data = (void **)calloc(entries, sizeof(void *));
   cache->size = (size_t *)calloc(entries, sizeof(size_t));
@@ -82,6 +101,13 @@ alloc_memory_fail:
 void dt_dev_pixelpipe_cache_cleanup(dt_dev_pixelpipe_cache_t *cache)
 {
   for(int k = 0; k < cache->entries; k++) dt_free_align(cache->data[k]);
+  for(int k = 0; k < cache->filters.entries; k++)
+  {
+    dt_free_align(cache->filters.data[k]);
+    cache->filters.data[k] = NULL;
+    cache->filters.size[k] = 0;
+  }
+  _filter_cache_flush(&cache->filters);
   free(cache->data);
   free(cache->dsc);
   free(cache->basichash);
@@ -253,6 +279,7 @@ void dt_dev_pixelpipe_cache_flush(dt_dev_pixelpipe_cache_t *cache)
     cache->used[k] = 0;
     ASAN_POISON_MEMORY_REGION(cache->data[k], cache->size[k]);
   }
+  _filter_cache_flush(&cache->filters);
 }
 
 void dt_dev_pixelpipe_cache_flush_all_but(dt_dev_pixelpipe_cache_t *cache, uint64_t basichash)
@@ -292,6 +319,90 @@ void dt_dev_pixelpipe_cache_invalidate(dt_dev_pixelpipe_cache_t *cache, void *da
   }
 }
 
+uint64_t dt_dev_pixelpipe_cache_filter_hash(const dt_dev_pixelpipe_iop_t *piece, const dt_iop_roi_t *roi_in,
+                                            const char *filter, const void *params, const size_t params_size)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  // exports and thumbnails run each module once, and tiles are too many to keep around
+  if(!(pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_PREVIEW | DT_DEV_PIXELPIPE_PREVIEW2))
+     || pipe->tiling)
+    return 0;
+  const int pos = g_list_index(pipe->nodes, piece);
+  if(pos < 0) return 0;
+
+  // this is the hash under which the pipe caches the input of the module
+  uint64_t hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, roi_in, pipe, pos);
+  for(const char *str = filter; *str; str++) hash = ((hash << 5) + hash) ^ *str;
+  const char *str = (const char *)params;
+  for(size_t i = 0; i < params_size; i++) hash = ((hash << 5) + hash) ^ str[i];
+  // 0 marks unused entries
+  return hash ? hash : 1;
+}
+
+int dt_dev_pixelpipe_cache_filter_get(dt_dev_pixelpipe_cache_t *cache, const uint64_t hash, void *out,
+                                      const size_t size)
+{
+  if(hash == 0) return 0;
+  dt_dev_pixelpipe_filter_cache_t *filters = &cache->filters;
+  filters->queries++;
+  int found = 0;
+  for(int k = 0; k < filters->entries; k++)
+  {
+    filters->used[k]++; // age all entries
+    if(!found && filters->hash[k] == hash && filters->size[k] >= size)
+    {
+      memcpy(out, filters->data[k], size);
+      filters->used[k] = 0; // this is the MRU entry
+      found = 1;
+    }
+  }
+  if(!found) filters->misses++;
+  return found;
+}
+
+void dt_dev_pixelpipe_cache_filter_put(dt_dev_pixelpipe_cache_t *cache, const uint64_t hash, const void *data,
+                                       const size_t size)
+{
+  dt_dev_pixelpipe_filter_cache_t *filters = &cache->filters;
+  if(hash == 0 || filters->entries == 0) return;
+
+  // an entry takes the place of a cache line, so it mustn't hold more than one
+  size_t line_size = 0;
+  for(int k = 0; k < cache->entries; k++) line_size = MAX(line_size, cache->size[k]);
+  if(size > line_size) return;
+
+  int max_used = -1, max = 0;
+  for(int k = 0; k < filters->entries; k++)
+  {
+    if(filters->hash[k] == hash)
+    {
+      max = k;
+      break;
+    }
+    // prefer empty entries over the LRU one
+    const int32_t age = filters->hash[k] ? filters->used[k] : INT32_MAX;
+    if(age > max_used)
+    {
+      max_used = age;
+      max = k;
+    }
+  }
+  if(filters->size[max] < size)
+  {
+    dt_free_align(filters->data[max]);
+    filters->data[max] = dt_alloc_align(64, size);
+    filters->size[max] = filters->data[max] ? size : 0;
+    if(!filters->data[max])
+    {
+      filters->hash[max] = 0;
+      return;
+    }
+  }
+  memcpy(filters->data[max], data, size);
+  filters->hash[max] = hash;
+  filters->used[max] = 0;
+}
+
 void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache)
 {
   for(int k = 0; k < cache->entries; k++)
@@ -301,6 +412,9 @@ void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache)
     printf("\n");
   }
   printf("cache hit rate so far: %.3f\n", (cache->queries - cache->misses) / (float)cache->queries);
+  if(cache->filters.queries)
+    printf("filter cache hit rate so far: %.3f\n",
+           (cache->filters.queries - cache->filters.misses) / (float)cache->filters.queries);
 }
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
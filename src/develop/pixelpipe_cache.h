@@ -21,9 +21,28 @@
 #include <inttypes.h>
 
 struct dt_dev_pixelpipe_t;
+struct dt_dev_pixelpipe_iop_t;
 struct dt_iop_buffer_dsc_t;
 struct dt_iop_roi_t;
 
+// number of filter results remembered per pipe, they take the place of as many cache lines
+#define DT_DEV_PIXELPIPE_FILTER_CACHE_ENTRIES 2
+
+/** results of expensive filters (blurs, bilateral and guided filters) computed by modules from their input,
+ * so that running a module again on the same input, e.g. while its other parameters are being tweaked,
+ * doesn't need to compute them again. */
+typedef struct dt_dev_pixelpipe_filter_cache_t
+{
+  int32_t entries; // usable entries, 0 for pipes with too few cache lines to spare any
+  void *data[DT_DEV_PIXELPIPE_FILTER_CACHE_ENTRIES];
+  size_t size[DT_DEV_PIXELPIPE_FILTER_CACHE_ENTRIES];
+  uint64_t hash[DT_DEV_PIXELPIPE_FILTER_CACHE_ENTRIES];
+  int32_t used[DT_DEV_PIXELPIPE_FILTER_CACHE_ENTRIES];
+  // profiling:
+  uint64_t queries;
+  uint64_t misses;
+} dt_dev_pixelpipe_filter_cache_t;
+
 /**
  * implements a simple pixel cache suitable for caching float images
  * corresponding to history items and zoom/pan settings in the develop module.
@@ -45,9 +64,12 @@ typedef struct dt_dev_pixelpipe_cache_t
   // profiling:
   uint64_t queries;
   uint64_t misses;
+  // intermediate results of modules, flushed along with the cache lines
+  dt_dev_pixelpipe_filter_cache_t filters;
 } dt_dev_pixelpipe_cache_t;
 
 /** constructs a new cache with given cache line count (entries) and float buffer entry size in bytes.
+  pipes with enough entries use DT_DEV_PIXELPIPE_FILTER_CACHE_ENTRIES of them for filter results instead.
   \param[out] returns 0 if fail to allocate mem cache.
 */
 int dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_cache_t *cache, int entries, size_t size);
@@ -92,6 +114,22 @@ void dt_dev_pixelpipe_cache_reweight(dt_dev_pixelpipe_cache_t *cache, void *data
 /** mark the given cache line pointer as invalid. */
 void dt_dev_pixelpipe_cache_invalidate(dt_dev_pixelpipe_cache_t *cache, void *data);
 
+/** hash identifying the result of `filter' with the given parameters, applied by the module of `piece' to its
+ * input buffer: it combines the hash of the history up to that buffer with roi_in, the filter name and the
+ * parameters. returns 0 if such results shouldn't be cached in this pipe (exports, thumbnails, tiling). */
+uint64_t dt_dev_pixelpipe_cache_filter_hash(const struct dt_dev_pixelpipe_iop_t *piece,
+                                            const struct dt_iop_roi_t *roi_in, const char *filter,
+                                            const void *params, const size_t params_size);
+
+/** copy the cached filter result for `hash' into `out', which holds `size' bytes. returns 1 on a hit. */
+int dt_dev_pixelpipe_cache_filter_get(dt_dev_pixelpipe_cache_t *cache, const uint64_t hash, void *out,
+                                      const size_t size);
+
+/** remember a filter result of `size' bytes for `hash', replacing the least recently used one. results
+ * larger than the biggest cache line aren't kept. */
+void dt_dev_pixelpipe_cache_filter_put(dt_dev_pixelpipe_cache_t *cache, const uint64_t hash, const void *data,
+                                       const size_t size);
+
 /** print out cache lines/hashes (debug). */
 void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache);
 
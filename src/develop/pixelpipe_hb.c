@@ -15,6 +15,7 @@
     You should have received a copy of the GNU General Public License
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include "common/benchmark.h"
 #include "common/color_picker.h"
 #include "common/colorspaces.h"
 #include "common/histogram.h"
@@ -269,6 +270,8 @@ void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
     piece->histogram = NULL;
     g_hash_table_destroy(piece->raster_masks);
     piece->raster_masks = NULL;
+    dt_free_align(piece->mask_cache);
+    piece->mask_cache = NULL;
     free(piece);
     nodes = g_list_next(nodes);
   }
@@ -2026,6 +2029,18 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
             ? "GPU"
             : pixelpipe_flow & PIXELPIPE_FLOW_BLENDED_ON_CPU ? "CPU" : "",
         _pipe_type_to_str(pipe->type));
+
+    if(darktable.benchmark && (pipe->type & DT_DEV_PIXELPIPE_EXPORT))
+    {
+      dt_times_t end;
+      dt_get_times(&end);
+      const dt_benchmark_path_t path
+          = (pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_ON_GPU ? DT_BENCHMARK_PATH_OPENCL : DT_BENCHMARK_PATH_CPU)
+            + (pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_WITH_TILING ? 1 : 0);
+      dt_benchmark_record_module(darktable.benchmark, module_label, path, end.clock - start.clock,
+                                 end.user - start.user);
+    }
+
     g_free(module_label);
     module_label = NULL;
 
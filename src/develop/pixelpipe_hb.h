@@ -59,6 +59,7 @@ typedef struct dt_dev_pixelpipe_iop_t
   float iscale;        // input actually just downscaled buffer? iscale*iwidth = actual width
   int iwidth, iheight; // width and height of input buffer
   uint64_t hash;       // hash of params and enabled.
+  uint64_t mask_hash;  // hash of the drawn mask forms only, 0 if there are none.
   int bpc;             // bits per channel, 32 means float
   int colors;          // how many colors per pixel
   dt_iop_roi_t buf_in,
@@ -71,6 +72,11 @@ typedef struct dt_dev_pixelpipe_iop_t
   dt_iop_buffer_dsc_t dsc_in, dsc_out;
 
   GHashTable *raster_masks; // GList* of dt_dev_pixelpipe_raster_mask_t
+
+  // the last drawn mask rendered by dt_masks_group_render_roi(), reused as long as the forms, the roi and the
+  // distortions in front of the module don't change:
+  float *mask_cache;
+  uint64_t mask_cache_hash;
 } dt_dev_pixelpipe_iop_t;
 
 typedef enum dt_dev_pixelpipe_change_t
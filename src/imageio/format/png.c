@@ -117,6 +117,265 @@ static void PNGwriteRawProfile(png_struct *ping, png_info *ping_info, char *prof
   png_free(ping, text);
 }
 
+// images with at least this many pixels get their IDAT stream deflated in parallel
+#define DT_PNG_PARALLEL_MIN_PIXELS (4 * 1024 * 1024)
+// uncompressed (filtered) bytes per independently deflated chunk
+#define DT_PNG_CHUNK_BYTES (256 * 1024)
+// deflate window, used to prime every chunk with the tail of the previous one
+#define DT_PNG_WINDOW (32 * 1024)
+
+static void _png_write_chunk(FILE *f, const char *type, const uint8_t *data, const uint32_t len)
+{
+  const uint8_t hdr[8] = { len >> 24, len >> 16, len >> 8, len, type[0], type[1], type[2], type[3] };
+  uLong crc = crc32(0L, hdr + 4, 4);
+  if(len) crc = crc32(crc, data, len);
+  const uint8_t tail[4] = { crc >> 24, crc >> 16, crc >> 8, crc };
+  fwrite(hdr, 1, 8, f);
+  if(len) fwrite(data, 1, len, f);
+  fwrite(tail, 1, 4, f);
+}
+
+// convert one row of the rgba input to packed, big endian rgb as stored in the file
+static void _png_pack_row(const void *ivoid, uint8_t *out, const int width, const int bpp, const int y)
+{
+  if(bpp > 8)
+  {
+    const uint16_t *in = (const uint16_t *)ivoid + (size_t)4 * y * width;
+    for(int x = 0; x < width; x++, in += 4, out += 6)
+      for(int c = 0; c < 3; c++)
+      {
+        out[2 * c] = in[c] >> 8;
+        out[2 * c + 1] = in[c] & 0xff;
+      }
+  }
+  else
+  {
+    const uint8_t *in = (const uint8_t *)ivoid + (size_t)4 * y * width;
+    for(int x = 0; x < width; x++, in += 4, out += 3)
+      for(int c = 0; c < 3; c++) out[c] = in[c];
+  }
+}
+
+static inline uint8_t _png_paeth(const int a, const int b, const int c)
+{
+  const int p = a + b - c;
+  const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  if(pa <= pb && pa <= pc) return a;
+  if(pb <= pc) return b;
+  return c;
+}
+
+// filter one row, choosing the filter with the smallest sum of absolute differences like libpng does.
+// out has to hold 5 candidate rows of 1 + rowbytes, the chosen one is returned.
+static const uint8_t *_png_filter_row(const uint8_t *cur, const uint8_t *prev, uint8_t *out,
+                                      const size_t rowbytes, const int pixbytes)
+{
+  const size_t stride = rowbytes + 1;
+  const size_t bpx = pixbytes;
+  size_t best_sum = SIZE_MAX;
+  const uint8_t *best = out;
+  for(int filter = 0; filter < 5; filter++)
+  {
+    uint8_t *row = out + filter * stride;
+    row[0] = filter;
+    size_t sum = 0;
+    for(size_t i = 0; i < rowbytes; i++)
+    {
+      const int a = i >= bpx ? cur[i - bpx] : 0;
+      const int b = prev ? prev[i] : 0;
+      const int c = (prev && i >= bpx) ? prev[i - bpx] : 0;
+      uint8_t v = cur[i];
+      switch(filter)
+      {
+        case 1: v -= a; break;
+        case 2: v -= b; break;
+        case 3: v -= (a + b) >> 1; break;
+        case 4: v -= _png_paeth(a, b, c); break;
+        default: break;
+      }
+      row[i + 1] = v;
+      sum += v < 128 ? v : 256 - v;
+    }
+    if(sum < best_sum)
+    {
+      best_sum = sum;
+      best = row;
+    }
+  }
+  return best;
+}
+
+// pigz style parallel deflate of the IDAT stream: rows are filtered and deflated in chunks on all cores.
+// every chunk is primed with the last 32k of the preceding data and ends on a byte boundary by a sync
+// flush, so the concatenation of all chunks is one valid zlib stream. the pixels decode exactly the same
+// as with png_write_image().
+static int _png_write_idat_parallel(FILE *f, const void *ivoid, const int width, const int height, const int bpp,
+                                    const int level)
+{
+  dt_times_t start;
+  dt_get_times(&start);
+
+  const int pixbytes = bpp > 8 ? 6 : 3;
+  const size_t rowbytes = (size_t)width * pixbytes;
+  const size_t filtered_row = rowbytes + 1;
+  const int rows_per_chunk = CLAMP((int)(DT_PNG_CHUNK_BYTES / filtered_row), 1, height);
+  const size_t chunk_bytes = filtered_row * rows_per_chunk;
+  // room for the zlib header in front and the adler32 trailer at the end
+  const size_t chunk_bound = compressBound(chunk_bytes) + 64;
+  const int nchunks = (height + rows_per_chunk - 1) / rows_per_chunk;
+  const int batch = MIN(nchunks, 2 * (int)dt_get_num_threads());
+
+  uint8_t *raw = dt_alloc_align(64, chunk_bytes * batch);
+  uint8_t *packed = dt_alloc_align(64, chunk_bound * batch);
+  uint8_t *window = dt_alloc_align(64, DT_PNG_WINDOW);
+  size_t *packed_size = malloc(sizeof(size_t) * batch);
+  size_t *raw_size = malloc(sizeof(size_t) * batch);
+  uLong *adler = malloc(sizeof(uLong) * batch);
+  size_t window_len = 0;
+  uLong adler_total = adler32(0L, Z_NULL, 0);
+  int rc = 0;
+
+  if(!raw || !packed || !window || !packed_size || !raw_size || !adler)
+  {
+    rc = 1;
+    goto exit;
+  }
+
+  for(int first = 0; first < nchunks && !rc; first += batch)
+  {
+    const int count = MIN(batch, nchunks - first);
+    int failed = 0;
+
+    // filter all chunks of the batch first: deflating a chunk reads the tail of the previous one as its
+    // dictionary, which has to be complete by then
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(ivoid, width, height, bpp, pixbytes, rowbytes, filtered_row, rows_per_chunk, \
+                        chunk_bytes, first, count, raw, raw_size, adler) \
+    reduction(|:failed) schedule(dynamic)
+#endif
+    for(int k = 0; k < count; k++)
+    {
+      const int y0 = (first + k) * rows_per_chunk;
+      const int rows = MIN(rows_per_chunk, height - y0);
+      uint8_t *in = raw + k * chunk_bytes;
+      uint8_t *scratch = malloc(2 * rowbytes + 5 * filtered_row);
+      if(!scratch)
+      {
+        failed |= 1;
+        continue;
+      }
+      uint8_t *cur = scratch, *prev = scratch + rowbytes, *candidates = scratch + 2 * rowbytes;
+      if(y0 > 0) _png_pack_row(ivoid, prev, width, bpp, y0 - 1);
+      for(int y = y0; y < y0 + rows; y++)
+      {
+        _png_pack_row(ivoid, cur, width, bpp, y);
+        const uint8_t *filtered = _png_filter_row(cur, y > 0 ? prev : NULL, candidates, rowbytes, pixbytes);
+        memcpy(in + (size_t)(y - y0) * filtered_row, filtered, filtered_row);
+        uint8_t *tmp = prev;
+        prev = cur;
+        cur = tmp;
+      }
+      free(scratch);
+
+      raw_size[k] = (size_t)rows * filtered_row;
+      adler[k] = adler32(adler32(0L, Z_NULL, 0), in, raw_size[k]);
+    }
+
+    if(failed)
+    {
+      rc = 1;
+      break;
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(level, chunk_bytes, chunk_bound, nchunks, first, count, raw, packed, window, \
+                        window_len, packed_size, raw_size) \
+    reduction(|:failed) schedule(dynamic)
+#endif
+    for(int k = 0; k < count; k++)
+    {
+      uint8_t *in = raw + k * chunk_bytes;
+      const int is_first = first + k == 0;
+      const int is_last = first + k == nchunks - 1;
+      uint8_t *out = packed + k * chunk_bound + 2;
+
+      z_stream strm = { 0 };
+      if(deflateInit2(&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      {
+        failed |= 1;
+        continue;
+      }
+      if(k > 0)
+        deflateSetDictionary(&strm, in - MIN(DT_PNG_WINDOW, chunk_bytes), MIN(DT_PNG_WINDOW, chunk_bytes));
+      else if(!is_first)
+        deflateSetDictionary(&strm, window, window_len);
+      strm.next_in = in;
+      strm.avail_in = raw_size[k];
+      strm.next_out = out;
+      strm.avail_out = chunk_bound - 6;
+      const int ret = deflate(&strm, is_last ? Z_FINISH : Z_SYNC_FLUSH);
+      if((is_last ? ret != Z_STREAM_END : ret != Z_OK) || strm.avail_in || !strm.avail_out)
+        failed |= 1;
+      packed_size[k] = strm.total_out;
+      deflateEnd(&strm);
+    }
+
+    if(failed)
+    {
+      rc = 1;
+      break;
+    }
+
+    // keep the tail of this batch to prime the first chunk of the next one
+    const uint8_t *last = raw + (count - 1) * chunk_bytes;
+    window_len = MIN(DT_PNG_WINDOW, raw_size[count - 1]);
+    memcpy(window, last + raw_size[count - 1] - window_len, window_len);
+
+    for(int k = 0; k < count; k++)
+    {
+      uint8_t *out = packed + k * chunk_bound + 2;
+      size_t len = packed_size[k];
+      adler_total = adler32_combine(adler_total, adler[k], raw_size[k]);
+      if(first + k == 0)
+      {
+        // zlib header: deflate with 32k window and the compression level hint
+        const int flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+        out -= 2;
+        out[0] = 0x78;
+        out[1] = flevel << 6;
+        out[1] += 31 - (out[0] * 256 + out[1]) % 31;
+        len += 2;
+      }
+      if(first + k == nchunks - 1)
+      {
+        uint8_t *trailer = out + len;
+        trailer[0] = adler_total >> 24;
+        trailer[1] = adler_total >> 16;
+        trailer[2] = adler_total >> 8;
+        trailer[3] = adler_total;
+        len += 4;
+      }
+      _png_write_chunk(f, "IDAT", out, len);
+    }
+  }
+
+  if(!rc && ferror(f)) rc = 1;
+
+  dt_show_times_f(&start, "[png]", "deflated %d chunks (%.1f MB) at level %d", nchunks,
+                  (double)filtered_row * height / (1024.0 * 1024.0), level);
+
+exit:
+  dt_free_align(raw);
+  dt_free_align(packed);
+  dt_free_align(window);
+  free(packed_size);
+  free(raw_size);
+  free(adler);
+  return rc;
+}
+
 int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const void *ivoid,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
@@ -195,6 +454,20 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
 
   png_write_info(png_ptr, info_ptr);
 
+  if((size_t)width * height >= DT_PNG_PARALLEL_MIN_PIXELS && dt_get_num_threads() > 1)
+  {
+    // we write the IDAT chunks ourselves, so libpng can't finish the file for us
+    int res = _png_write_idat_parallel(f, ivoid, width, height, p->bpp, p->compression);
+    if(!res)
+    {
+      _png_write_chunk(f, "IEND", NULL, 0);
+      if(ferror(f)) res = 1;
+    }
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(f);
+    return res;
+  }
+
   /*
    * Get rid of filler (OR ALPHA) bytes, pack XRGB/RGBX/ARGB/RGBA into
    * RGB (4 channels -> 3 channels). The second parameter is not used.
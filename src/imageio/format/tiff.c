@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <tiffio.h>
+#include <zlib.h>
 
 // it would be nice to save space by storing the masks as single channel float data,
 // but at least GIMP can't open TIFF files where not all layers have the same format.
@@ -57,6 +58,127 @@ typedef struct dt_imageio_tiff_gui_t
 } dt_imageio_tiff_gui_t;
 
 
+// uncompressed size we aim for per strip when deflating strips in parallel
+#define DT_TIFF_STRIP_BYTES (512 * 1024)
+
+// apply the tiff predictor to one packed row, the same way libtiff's encoder does
+static void _tiff_predict_row(uint8_t *row, uint8_t *tmp, const size_t width, const int layers, const int bpp,
+                              const int predictor)
+{
+  const size_t samples = width * layers;
+  const size_t stride = layers;
+  if(predictor == PREDICTOR_HORIZONTAL)
+  {
+    if(bpp == 16)
+    {
+      uint16_t *p = (uint16_t *)row;
+      for(size_t i = samples - 1; i >= stride; i--) p[i] -= p[i - layers];
+    }
+    else
+    {
+      for(size_t i = samples - 1; i >= stride; i--) row[i] -= row[i - layers];
+    }
+  }
+  else if(predictor == PREDICTOR_FLOATINGPOINT)
+  {
+    // split the floats into byte planes, most significant byte first, then difference the bytes
+    const size_t bytes = samples * 4;
+    memcpy(tmp, row, bytes);
+    for(size_t s = 0; s < samples; s++)
+      for(int b = 0; b < 4; b++) row[(3 - b) * samples + s] = tmp[4 * s + b];
+    for(size_t i = bytes - 1; i >= stride; i--) row[i] -= row[i - layers];
+  }
+}
+
+// pack, predict and deflate the image strip by strip on all cores and hand the
+// compressed strips to libtiff in order. the result is the same kind of file
+// libtiff's zip codec writes, it just doesn't keep the other cores idle.
+static int _tiff_write_strips_deflate(TIFF *tif, const void *in_void, const int width, const int height,
+                                      const int layers, const int bpp, const int predictor, const int level)
+{
+  dt_times_t start;
+  dt_get_times(&start);
+
+  const size_t bytes_per_sample = bpp / 8;
+  const size_t rowsize = (size_t)width * layers * bytes_per_sample;
+  const int rows_per_strip = CLAMP((int)(DT_TIFF_STRIP_BYTES / rowsize), 1, height);
+  const size_t strip_bytes = rowsize * rows_per_strip;
+  const size_t strip_bound = compressBound(strip_bytes);
+  const int nstrips = (height + rows_per_strip - 1) / rows_per_strip;
+  // compress a few strips per thread at a time, so we don't need a second copy of the whole image
+  const int batch = MIN(nstrips, 2 * (int)dt_get_num_threads());
+
+  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32_t)rows_per_strip);
+
+  uint8_t *raw = dt_alloc_align(64, strip_bytes * batch);
+  uint8_t *packed = dt_alloc_align(64, strip_bound * batch);
+  uint8_t *scratch = dt_alloc_align(64, rowsize * batch);
+  uLongf *packed_size = malloc(sizeof(uLongf) * batch);
+  int rc = 0;
+
+  if(!raw || !packed || !scratch || !packed_size)
+  {
+    rc = 1;
+    goto exit;
+  }
+
+  for(int first = 0; first < nstrips && !rc; first += batch)
+  {
+    const int count = MIN(batch, nstrips - first);
+    int failed = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(in_void, width, height, layers, bpp, predictor, level, bytes_per_sample, rowsize, \
+                        rows_per_strip, strip_bytes, strip_bound, first, count, raw, packed, scratch, packed_size) \
+    reduction(|:failed) schedule(dynamic)
+#endif
+    for(int k = 0; k < count; k++)
+    {
+      const int y0 = (first + k) * rows_per_strip;
+      const int rows = MIN(rows_per_strip, height - y0);
+      uint8_t *strip = raw + k * strip_bytes;
+      for(int y = y0; y < y0 + rows; y++)
+      {
+        const uint8_t *in = (const uint8_t *)in_void + (size_t)4 * y * width * bytes_per_sample;
+        uint8_t *out = strip + (size_t)(y - y0) * rowsize;
+        for(int x = 0; x < width; x++, in += 4 * bytes_per_sample, out += layers * bytes_per_sample)
+          memcpy(out, in, layers * bytes_per_sample);
+        _tiff_predict_row(strip + (size_t)(y - y0) * rowsize, scratch + k * rowsize, width, layers, bpp,
+                          predictor);
+      }
+      packed_size[k] = strip_bound;
+      if(compress2(packed + k * strip_bound, &packed_size[k], strip, rowsize * rows, level) != Z_OK)
+        failed |= 1;
+    }
+
+    if(failed)
+    {
+      rc = 1;
+      break;
+    }
+
+    for(int k = 0; k < count; k++)
+    {
+      if(TIFFWriteRawStrip(tif, first + k, packed + k * strip_bound, packed_size[k]) == -1)
+      {
+        rc = 1;
+        break;
+      }
+    }
+  }
+
+  dt_show_times_f(&start, "[tiff]", "deflated %d strips (%.1f MB) at level %d", nstrips,
+                  (double)rowsize * height / (1024.0 * 1024.0), level);
+
+exit:
+  dt_free_align(raw);
+  dt_free_align(packed);
+  dt_free_align(scratch);
+  free(packed_size);
+  return rc;
+}
+
 int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const void *in_void,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, dt_dev_pixelpipe_t *pipe,
@@ -255,7 +377,20 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
     goto exit;
   }
 
-  if(d->bpp == 32)
+  if(d->compress > 0 && G_BYTE_ORDER == G_LITTLE_ENDIAN)
+  {
+    // the predictors work on the native byte order, which is only what ends up in our little endian file
+    // on little endian hosts. everyone else goes through libtiff below.
+    const int predictor = (d->compress == 2) ? ((d->bpp == 32) ? PREDICTOR_FLOATINGPOINT : PREDICTOR_HORIZONTAL)
+                                             : PREDICTOR_NONE;
+    if(_tiff_write_strips_deflate(tif, in_void, d->global.width, d->global.height, layers, d->bpp, predictor,
+                                  d->compresslevel))
+    {
+      rc = 1;
+      goto exit;
+    }
+  }
+  else if(d->bpp == 32)
   {
     for(int y = 0; y < d->global.height; y++)
     {
@@ -21,19 +21,34 @@
 #if defined(__SSE__)
 #include <xmmintrin.h>
 #endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(_WIN32)
+// common/dispatch.h pulls this in, too, but it must not end up in the extern "C" block below
+#include <immintrin.h>
+#endif
 
 extern "C" {
+#include "common/dispatch.h"
 #include "develop/imageop.h"
 #include "develop/imageop_math.h"
 
 // otherwise the name will be mangled and the linker won't be able to see the function ...
-void amaze_demosaic_RT(
-    dt_dev_pixelpipe_iop_t *piece,
+// the variants of the `amaze demosaic' kernel, registered in demosaic.c
+void amaze_demosaic_RT_plain(
+    const float *const in,
+    float *const out,
+    const dt_iop_roi_t *const roi_in,
+    const dt_iop_roi_t *const roi_out,
+    const uint32_t filters,
+    const float clip_pt);
+#ifdef DT_HAVE_TARGET_AVX2
+void amaze_demosaic_RT_avx2(
     const float *const in,
-    float *out,
+    float *const out,
     const dt_iop_roi_t *const roi_in,
     const dt_iop_roi_t *const roi_out,
-    const int filters);
+    const uint32_t filters,
+    const float clip_pt);
+#endif
 }
 
 #include <algorithm>
@@ -42,7 +57,15 @@ void amaze_demosaic_RT(
 #include <cstdlib>
 #include <cstring>
 
-static __inline float clampnan(const float x, const float m, const float M)
+// the tile kernel is instantiated for several tile sizes and instruction sets, all helpers need to be
+// inlined into it to get compiled for the instruction set of the caller
+#ifdef __GNUC__
+#define INLINE __inline __attribute__((always_inline))
+#else
+#define INLINE inline
+#endif
+
+static INLINE float clampnan(const float x, const float m, const float M)
 {
   float r;
 
@@ -59,7 +82,7 @@ static __inline float clampnan(const float x, const float m, const float M)
 }
 
 #ifndef __SSE2__
-static __inline float xmul2f(float d)
+static INLINE float xmul2f(float d)
 {
   union {
       float f;
@@ -74,7 +97,7 @@ static __inline float xmul2f(float d)
 }
 #endif
 
-static __inline float xdiv2f(float d)
+static INLINE float xdiv2f(float d)
 {
   union {
       float f;
@@ -88,7 +111,7 @@ static __inline float xdiv2f(float d)
   return x.f;
 }
 
-static __inline float xdivf(float d, int n)
+static INLINE float xdivf(float d, int n)
 {
   union {
       float f;
@@ -110,12 +133,6 @@ static __inline float xdivf(float d, int n)
 
 #ifdef __SSE2__
 
-#ifdef __GNUC__
-#define INLINE __inline
-#else
-#define INLINE inline
-#endif
-
 #ifdef __GNUC__
 #if((__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || __GNUC__ > 4) && (!defined(WIN32) || defined(__x86_64__))
 #define LVF(x) _mm_load_ps(&x)
@@ -262,13 +279,13 @@ static INLINE vfloat vdup(vfloat a)
 
 #endif // __SSE2__
 
-template <typename _Tp> static inline const _Tp SQR(_Tp x)
+template <typename _Tp> static INLINE const _Tp SQR(_Tp x)
 {
   //      return std::pow(x,2); Slower than:
   return (x * x);
 }
 
-template <typename _Tp> static inline const _Tp intp(const _Tp a, const _Tp b, const _Tp c)
+template <typename _Tp> static INLINE const _Tp intp(const _Tp a, const _Tp b, const _Tp c)
 {
   // calculate a * b + (1 - a) * c
   // following is valid:
@@ -277,12 +294,12 @@ template <typename _Tp> static inline const _Tp intp(const _Tp a, const _Tp b, c
   return a * (b - c) + c;
 }
 
-template <typename _Tp> static inline const _Tp LIM(const _Tp a, const _Tp b, const _Tp c)
+template <typename _Tp> static INLINE const _Tp LIM(const _Tp a, const _Tp b, const _Tp c)
 {
   return std::max(b, std::min(a, c));
 }
 
-template <typename _Tp> static inline const _Tp ULIM(const _Tp a, const _Tp b, const _Tp c)
+template <typename _Tp> static INLINE const _Tp ULIM(const _Tp a, const _Tp b, const _Tp c)
 {
   return ((b < c) ? LIM(a, b, c) : LIM(a, c, b));
 }
@@ -318,29 +335,44 @@ template <typename _Tp> static inline const _Tp ULIM(const _Tp a, const _Tp b, c
 ////////////////////////////////////////////////////////////////
 
 
-void amaze_demosaic_RT(dt_dev_pixelpipe_iop_t *piece, const float *const in,
-                       float *out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
-                       const int filters)
-{
-  int winx = roi_out->x;
-  int winy = roi_out->y;
-  int winw = roi_in->width;
-  int winh = roi_in->height;
-
-  const int width = winw, height = winh;
-  const float clip_pt = fminf(piece->pipe->dsc.processed_maximum[0],
-                              fminf(piece->pipe->dsc.processed_maximum[1], piece->pipe->dsc.processed_maximum[2]));
-  const float clip_pt8 = 0.8f * clip_pt;
-
 // this allows to pass AMAZETS to the code. On some machines larger AMAZETS is faster
 // If AMAZETS is undefined it will be set to 160, which is the fastest on modern x86/64 machines
-#ifndef AMAZETS
-#define AMAZETS 160
+// The output depends on the tile size at tile borders, so it must not depend on the machine we run on
+#ifdef AMAZETS
+#define AMAZE_TS_DEFAULT ((AMAZETS & 992) < 96 ? 96 : (AMAZETS & 992))
+#else
+#define AMAZE_TS_DEFAULT 160
 #endif
-  // Tile size; the image is processed in square tiles to lower memory requirements and facilitate
-  // multi-threading
-  // We assure that Tile size is a multiple of 32 in the range [96;992]
-  constexpr int ts = (AMAZETS & 992) < 96 ? 96 : (AMAZETS & 992);
+
+typedef struct
+{
+  float h;
+  float v;
+} s_hv;
+
+// size of the per thread working space of one tile, see the buffer layout in amaze_tile()
+static constexpr size_t amaze_arena_size(const int ts)
+{
+  return sizeof(float) * 14 * ts * ts + sizeof(char) * ts * (ts / 2) + 18 * 2 * 64;
+}
+
+// fma contraction in the avx2 variant changes some of the interpolation direction decisions, keep the
+// results of all variants identical
+#ifdef __GNUC__
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// Tile size; the image is processed in square tiles to lower memory requirements and facilitate
+// multi-threading. ts is a multiple of 32 in the range [96;992]. This processes the tile with its top left
+// corner at (top, left), data is the thread's working space of amaze_arena_size(ts) bytes.
+template <int ts>
+static INLINE void amaze_tile(char *const data, const float *const in, float *const out,
+                              const dt_iop_roi_t *const roi_out, const int width, const int height,
+                              const int winx, const int winy, const uint32_t filters, const float clip_pt,
+                              const float clip_pt8, const int top, const int left)
+{
+  static_assert(ts % 32 == 0 && ts >= 96 && ts <= 992, "invalid amaze tile size");
   constexpr int tsh = ts / 2; // half of Tile size
 
   // offset of R pixel within a Bayer quartet
@@ -399,24 +431,9 @@ void amaze_demosaic_RT(dt_dev_pixelpipe_iop_t *piece, const float *const in,
   // gaussian on quincunx grid
   constexpr float gquinc[4] = { 0.169917f, 0.108947f, 0.069855f, 0.0287182f };
 
-  typedef struct
-  {
-    float h;
-    float v;
-  } s_hv;
-
-#ifdef _OPENMP
-#pragma omp parallel
-#endif
-  {
-    //     int progresscounter = 0;
-
+  // the working space layout and the tile body below keep the indentation of the RawTherapee tile loop they
+  // were taken from, so the code can still be compared with and synced against upstream
     constexpr int cldf = 2; // factor to multiply cache line distance. 1 = 64 bytes, 2 = 128 bytes ...
-    // assign working space
-    char *buffer
-        = (char *)calloc(sizeof(float) * 14 * ts * ts + sizeof(char) * ts * tsh + 18 * cldf * 64 + 63, 1);
-    // aligned to 64 byte boundary
-    char *data = (char *)((uintptr_t(buffer) + uintptr_t(63)) / 64 * 64);
 
     // green values
     float *rgbgreen = (float(*))data;
@@ -467,16 +484,6 @@ void amaze_demosaic_RT(dt_dev_pixelpipe_iop_t *piece, const float *const in,
     unsigned char *nyquist2 = (unsigned char(*))cddiffsq;
     float *nyqutest = (float(*))((char *)nyquist + sizeof(unsigned char) * ts * tsh + cldf * 64); // 1
 
-// Main algorithm: Tile loop
-// use collapse(2) to collapse the 2 loops to one large loop, so there is better scaling
-#ifdef _OPENMP
-#pragma omp for SIMD() schedule(static) collapse(2) nowait
-#endif
-
-    for(int top = winy - 16; top < winy + height; top += ts - 32)
-    {
-      for(int left = winx - 16; left < winx + width; left += ts - 32)
-      {
         memset(&nyquist[3 * tsh], 0, sizeof(unsigned char) * (ts - 6) * tsh);
         // location of tile bottom edge
         int bottom = MIN(top + ts, winy + height + 16);
@@ -2377,13 +2384,96 @@ void amaze_demosaic_RT(dt_dev_pixelpipe_iop_t *piece, const float *const in,
               out[(row * roi_out->width + col) * 4 + 1] = clampnan(rgbgreen[indx], 0.0f, 1.0f);
           }
         }
-      }
-    } // end of main loop
+}
+
+#define AMAZE_ARGS                                                                                           \
+  const float *const in, float *const out, const dt_iop_roi_t *const roi_in,                                \
+      const dt_iop_roi_t *const roi_out, const uint32_t filters, const float clip_pt
 
-    // clean up
-    free(buffer);
+// every thread allocates and zeroes its working space once and reuses it for all the tiles it processes
+// a thread that cannot get its working space still takes part in the tile loop, but leaves its tiles alone
+template <int ts> static void amaze_tiles_plain(AMAZE_ARGS)
+{
+  const int winx = roi_out->x, winy = roi_out->y;
+  const int width = roi_in->width, height = roi_in->height;
+  const float clip_pt8 = 0.8f * clip_pt;
+
+#ifdef _OPENMP
+#pragma omp parallel default(none) \
+  dt_omp_firstprivate(in, out, roi_out, winx, winy, width, height, filters, clip_pt, clip_pt8) shared(stderr)
+#endif
+  {
+    char *const data = (char *)dt_alloc_align(64, amaze_arena_size(ts));
+    if(data)
+      memset(data, 0, amaze_arena_size(ts));
+    else
+      fprintf(stderr, "[amaze_demosaic_RT] error allocating memory, tiles of this thread are skipped\n");
+
+// Main algorithm: Tile loop
+// use collapse(2) to collapse the 2 loops to one large loop, so there is better scaling
+#ifdef _OPENMP
+#pragma omp for schedule(static) collapse(2) nowait
+#endif
+    for(int top = winy - 16; top < winy + height; top += ts - 32)
+      for(int left = winx - 16; left < winx + width; left += ts - 32)
+        if(data)
+          amaze_tile<ts>(data, in, out, roi_out, width, height, winx, winy, filters, clip_pt, clip_pt8, top, left);
+
+    dt_free_align(data);
+  }
+}
+
+#ifdef DT_HAVE_TARGET_AVX2
+template <int ts> DT_TARGET_AVX2 static void amaze_tiles_avx2(AMAZE_ARGS)
+{
+  const int winx = roi_out->x, winy = roi_out->y;
+  const int width = roi_in->width, height = roi_in->height;
+  const float clip_pt8 = 0.8f * clip_pt;
+
+#ifdef _OPENMP
+#pragma omp parallel default(none) \
+  dt_omp_firstprivate(in, out, roi_out, winx, winy, width, height, filters, clip_pt, clip_pt8) shared(stderr)
+#endif
+  {
+    char *const data = (char *)dt_alloc_align(64, amaze_arena_size(ts));
+    if(data)
+      memset(data, 0, amaze_arena_size(ts));
+    else
+      fprintf(stderr, "[amaze_demosaic_RT] error allocating memory, tiles of this thread are skipped\n");
+
+#ifdef _OPENMP
+#pragma omp for schedule(static) collapse(2) nowait
+#endif
+    for(int top = winy - 16; top < winy + height; top += ts - 32)
+      for(int left = winx - 16; left < winx + width; left += ts - 32)
+        if(data)
+          amaze_tile<ts>(data, in, out, roi_out, width, height, winx, winy, filters, clip_pt, clip_pt8, top, left);
+
+    dt_free_align(data);
   }
 }
+#endif
+
+#define AMAZE_DISPATCH(variant) variant<AMAZE_TS_DEFAULT>(in, out, roi_in, roi_out, filters, clip_pt)
+
+void amaze_demosaic_RT_plain(AMAZE_ARGS)
+{
+  AMAZE_DISPATCH(amaze_tiles_plain);
+}
+
+#ifdef DT_HAVE_TARGET_AVX2
+void amaze_demosaic_RT_avx2(AMAZE_ARGS)
+{
+  AMAZE_DISPATCH(amaze_tiles_avx2);
+}
+#endif
+
+#undef AMAZE_DISPATCH
+#undef AMAZE_ARGS
+
+#ifdef __GNUC__
+#pragma GCC pop_options
+#endif
 
 /*==================================================================================
  * end of raw therapee code
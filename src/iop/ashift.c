@@ -455,6 +455,12 @@ typedef struct dt_iop_ashift_data_t
   float cr;
   float ct;
   float cb;
+  // homographies of distort_(back)transform() for an input buffer of homograph_width x homograph_height,
+  // computed on first use after commit_params()
+  float homograph[3][3];
+  float ihomograph[3][3];
+  int homograph_width;
+  int homograph_height;
 } dt_iop_ashift_data_t;
 
 typedef struct dt_iop_ashift_global_data_t
@@ -879,16 +885,30 @@ static inline int isneutral(const dt_iop_ashift_data_t *data)
 }
 
 
+// masks and guides map their points through distort_(back)transform() on every redraw, so the homographies
+// are kept in the pipe data until the parameters or the buffer size change. callers are serialized by the
+// history mutex.
+static void _update_point_homographies(dt_iop_ashift_data_t *data, const int width, const int height)
+{
+  if(data->homograph_width == width && data->homograph_height == height) return;
+
+  homography((float *)data->homograph, data->rotation, data->lensshift_v, data->lensshift_h, data->shear,
+             data->f_length_kb, data->orthocorr, data->aspect, width, height, ASHIFT_HOMOGRAPH_FORWARD);
+  homography((float *)data->ihomograph, data->rotation, data->lensshift_v, data->lensshift_h, data->shear,
+             data->f_length_kb, data->orthocorr, data->aspect, width, height, ASHIFT_HOMOGRAPH_INVERTED);
+  data->homograph_width = width;
+  data->homograph_height = height;
+}
+
 int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *points, size_t points_count)
 {
-  const dt_iop_ashift_data_t *const data = (dt_iop_ashift_data_t *)piece->data;
+  dt_iop_ashift_data_t *const data = (dt_iop_ashift_data_t *)piece->data;
 
   // nothing to be done if parameters are set to neutral values
   if(isneutral(data)) return 1;
 
-  float homograph[3][3];
-  homography((float *)homograph, data->rotation, data->lensshift_v, data->lensshift_h, data->shear, data->f_length_kb,
-             data->orthocorr, data->aspect, piece->buf_in.width, piece->buf_in.height, ASHIFT_HOMOGRAPH_FORWARD);
+  _update_point_homographies(data, piece->buf_in.width, piece->buf_in.height);
+  const float(*const h)[3] = data->homograph;
 
   // clipping offset
   const float fullwidth = (float)piece->buf_out.width / (data->cr - data->cl);
@@ -896,19 +916,15 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
   const float cx = fullwidth * data->cl;
   const float cy = fullheight * data->ct;
 
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(cx, cy, points_count) \
-  shared(points, homograph) \
-  schedule(static)
-#endif
+  // a handful of flops per point, cheaper than waking up threads for any number of points a mask has.
+  // with the matrix in registers the loop vectorizes.
   for(size_t i = 0; i < points_count * 2; i += 2)
   {
-    float pi[3] = { points[i], points[i + 1], 1.0f };
-    float po[3];
-    mat3mulv(po, (float *)homograph, pi);
-    points[i] = po[0] / po[2] - cx;
-    points[i + 1] = po[1] / po[2] - cy;
+    const float x = points[i];
+    const float y = points[i + 1];
+    const float w = h[2][0] * x + h[2][1] * y + h[2][2];
+    points[i] = (h[0][0] * x + h[0][1] * y + h[0][2]) / w - cx;
+    points[i + 1] = (h[1][0] * x + h[1][1] * y + h[1][2]) / w - cy;
   }
 
   return 1;
@@ -918,14 +934,13 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
 int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *points,
                           size_t points_count)
 {
-  const dt_iop_ashift_data_t *const data = (dt_iop_ashift_data_t *)piece->data;
+  dt_iop_ashift_data_t *const data = (dt_iop_ashift_data_t *)piece->data;
 
   // nothing to be done if parameters are set to neutral values
   if(isneutral(data)) return 1;
 
-  float ihomograph[3][3];
-  homography((float *)ihomograph, data->rotation, data->lensshift_v, data->lensshift_h, data->shear, data->f_length_kb,
-             data->orthocorr, data->aspect, piece->buf_in.width, piece->buf_in.height, ASHIFT_HOMOGRAPH_INVERTED);
+  _update_point_homographies(data, piece->buf_in.width, piece->buf_in.height);
+  const float(*const ih)[3] = data->ihomograph;
 
   // clipping offset
   const float fullwidth = (float)piece->buf_out.width / (data->cr - data->cl);
@@ -933,19 +948,13 @@ int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   const float cx = fullwidth * data->cl;
   const float cy = fullheight * data->ct;
 
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(cx, cy) \
-  shared(points, points_count, ihomograph) \
-  schedule(static)
-#endif
   for(size_t i = 0; i < points_count * 2; i += 2)
   {
-    float pi[3] = { points[i] + cx, points[i + 1] + cy, 1.0f };
-    float po[3];
-    mat3mulv(po, (float *)ihomograph, pi);
-    points[i] = po[0] / po[2];
-    points[i + 1] = po[1] / po[2];
+    const float x = points[i] + cx;
+    const float y = points[i + 1] + cy;
+    const float w = ih[2][0] * x + ih[2][1] * y + ih[2][2];
+    points[i] = (ih[0][0] * x + ih[0][1] * y + ih[0][2]) / w;
+    points[i + 1] = (ih[1][0] * x + ih[1][1] * y + ih[1][2]) / w;
   }
 
   return 1;
@@ -3389,7 +3398,10 @@ static int call_distort_transform(dt_develop_t *dev, dt_dev_pixelpipe_t *pipe, s
   if(piece->module == self && /*piece->enabled && */  //see note below
      !(dev->gui_module && dev->gui_module->operation_tags_filter() & piece->module->operation_tags()))
   {
+    // like dt_dev_distort_transform_plus(), so that the pipe data doesn't change underneath
+    dt_pthread_mutex_lock(&dev->history_mutex);
     ret = piece->module->distort_transform(piece->module, piece, points, points_count);
+    dt_pthread_mutex_unlock(&dev->history_mutex);
   }
   return ret;
   //NOTE: piece->enabled is FALSE for exactly the first mouse_moved event following a button_pressed event
@@ -4407,6 +4419,9 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
     d->ct = p->ct;
     d->cb = p->cb;
   }
+
+  // recompute the homographies of distort_(back)transform() on next use
+  d->homograph_width = d->homograph_height = 0;
 }
 
 void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
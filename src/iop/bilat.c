@@ -261,6 +261,10 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
     tiling->factor = 2.0f + (float)local_laplacian_memory_use(width, height) / basebuffer;
     tiling->maxbuf
         = fmax(1.0f, (float)local_laplacian_singlebuffer_size(width, height) / basebuffer);
+    // only the cpu code path works in bands, opencl still allocates the full pyramids
+    tiling->factor_cl = 2.0f + (float)local_laplacian_memory_use_full(width, height) / basebuffer;
+    tiling->maxbuf_cl
+        = fmax(1.0f, (float)local_laplacian_singlebuffer_size_full(width, height) / basebuffer);
     tiling->overhead = 0;
     tiling->overlap = rad;
     tiling->xalign = 1;
@@ -121,6 +121,16 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
 
   const float scale = 1.0f / exp2f(-1.0f * (fmin(100.0f, data->strength + 1.0f) / 100.0f));
 
+  /* horizontal blur into memchannel lightness */
+  const int range = 2 * radius + 1;
+  const int hr = range / 2;
+
+  // all parameters go into the blurred lights, they are only reused as long as the input doesn't change,
+  // e.g. while the blend parameters are being edited
+  const float params[] = { scale, data->threshold, hr };
+  const uint64_t hash = dt_dev_pixelpipe_cache_filter_hash(piece, roi_in, "bloom", params, sizeof(params));
+  if(!dt_dev_pixelpipe_cache_filter_get(&piece->pipe->cache, hash, blurlightness, sizeof(float) * npixels))
+  {
 /* get the thresholded lights into buffer */
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
@@ -128,17 +138,15 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   dt_omp_sharedconst(data, blurlightness) \
   schedule(static)
 #endif
-  for(size_t k = 0; k < npixels; k++)
-  {
-    const float L = in[4*k] * scale;
-    blurlightness[k] = (L > data->threshold) ? L : 0.0f;
-  }
-
-  /* horizontal blur into memchannel lightness */
-  const int range = 2 * radius + 1;
-  const int hr = range / 2;
+    for(size_t k = 0; k < npixels; k++)
+    {
+      const float L = in[4*k] * scale;
+      blurlightness[k] = (L > data->threshold) ? L : 0.0f;
+    }
 
-  dt_box_mean(blurlightness, roi_out->height, roi_out->width, 1, hr, BOX_ITERATIONS);
+    dt_box_mean(blurlightness, roi_out->height, roi_out->width, 1, hr, BOX_ITERATIONS);
+    dt_dev_pixelpipe_cache_filter_put(&piece->pipe->cache, hash, blurlightness, sizeof(float) * npixels);
+  }
 
 /* screen blend lightness with original */
 #ifdef _OPENMP
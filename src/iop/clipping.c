@@ -254,6 +254,21 @@ typedef struct dt_iop_clipping_gui_data_t
   int old_width, old_height;
 } dt_iop_clipping_gui_data_t;
 
+// everything distort_transform() and distort_backtransform() need, taken from the data once modify_roi_out()
+// has run for the full input buffer
+typedef struct dt_iop_clipping_points_t
+{
+  int width, height;        // input buffer these are valid for, 0 after commit_params()
+  float m[4], inv_m[4];     // rot/mirror matrix and its inverse
+  float k_h, k_v;           // corrected keystone
+  float tx, ty;             // rotation center
+  float cix, ciy;           // crop window offset, enlargement included
+  uint32_t flip;
+  float k_space[4];         // keystone, scaled to the buffer
+  float kxa, kya;
+  float ma, mb, md, me, mg, mh;
+} dt_iop_clipping_points_t;
+
 typedef struct dt_iop_clipping_data_t
 {
   float angle;              // rotation angle
@@ -276,6 +291,7 @@ typedef struct dt_iop_clipping_data_t
   int k_apply;
   int crop_auto;
   float enlarge_x, enlarge_y;
+  dt_iop_clipping_points_t points; // cached for distort_(back)transform()
 } dt_iop_clipping_data_t;
 
 typedef struct dt_iop_clipping_global_data_t
@@ -435,8 +451,15 @@ static inline void transform(float *x, float *o, const float *m, const float t_h
 }
 
 
-int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *points, size_t points_count)
+// masks and guides map their points through distort_(back)transform() on every redraw. instead of running
+// modify_roi_out() twice per call, its results for the full input buffer are kept until the parameters or
+// the buffer size change. callers are serialized by the history mutex.
+static const dt_iop_clipping_points_t *get_points_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_clipping_data_t *d = (dt_iop_clipping_data_t *)piece->data;
+  dt_iop_clipping_points_t *t = &d->points;
+  if(t->width == piece->buf_in.width && t->height == piece->buf_in.height) return t;
+
   // as dt_iop_roi_t contain int values and not floats, we can have some rounding errors
   // as a workaround, we use a factor for preview pipes
   float factor = 1.0f;
@@ -448,17 +471,56 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
   roi_in.height = piece->buf_in.height * factor;
   self->modify_roi_out(self, piece, &roi_out, &roi_in);
 
-  dt_iop_clipping_data_t *d = (dt_iop_clipping_data_t *)piece->data;
+  for(int k = 0; k < 4; k++)
+  {
+    t->m[k] = d->m[k];
+    t->inv_m[k] = d->inv_m[k];
+  }
+  t->k_h = d->k_h;
+  t->k_v = d->k_v;
+  t->tx = d->tx / factor;
+  t->ty = d->ty / factor;
+  t->cix = (d->cix - d->enlarge_x) / factor;
+  t->ciy = (d->ciy - d->enlarge_y) / factor;
+  t->flip = d->flip;
 
   const float rx = piece->buf_in.width;
   const float ry = piece->buf_in.height;
 
-  float k_space[4] = { d->k_space[0] * rx, d->k_space[1] * ry, d->k_space[2] * rx, d->k_space[3] * ry };
-  const float kxa = d->kxa * rx, kxb = d->kxb * rx, kxc = d->kxc * rx, kxd = d->kxd * rx;
-  const float kya = d->kya * ry, kyb = d->kyb * ry, kyc = d->kyc * ry, kyd = d->kyd * ry;
-  float ma = 0, mb = 0, md = 0, me = 0, mg = 0, mh = 0;
+  t->k_space[0] = d->k_space[0] * rx;
+  t->k_space[1] = d->k_space[1] * ry;
+  t->k_space[2] = d->k_space[2] * rx;
+  t->k_space[3] = d->k_space[3] * ry;
+  t->kxa = d->kxa * rx;
+  t->kya = d->kya * ry;
   if(d->k_apply == 1)
-    keystone_get_matrix(k_space, kxa, kxb, kxc, kxd, kya, kyb, kyc, kyd, &ma, &mb, &md, &me, &mg, &mh);
+    keystone_get_matrix(t->k_space, t->kxa, d->kxb * rx, d->kxc * rx, d->kxd * rx, t->kya, d->kyb * ry,
+                        d->kyc * ry, d->kyd * ry, &t->ma, &t->mb, &t->md, &t->me, &t->mg, &t->mh);
+
+  // revert side-effects of the previous call to modify_roi_out
+  // TODO: this is just a quick hack. we need a major revamp of this module!
+  if(factor != 1.0f)
+  {
+    roi_in.width = piece->buf_in.width;
+    roi_in.height = piece->buf_in.height;
+    self->modify_roi_out(self, piece, &roi_out, &roi_in);
+  }
+
+  t->width = piece->buf_in.width;
+  t->height = piece->buf_in.height;
+  return t;
+}
+
+int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *points, size_t points_count)
+{
+  const dt_iop_clipping_data_t *const d = (dt_iop_clipping_data_t *)piece->data;
+  const dt_iop_clipping_points_t *const t = get_points_transform(self, piece);
+
+  float k_space[4] = { t->k_space[0], t->k_space[1], t->k_space[2], t->k_space[3] };
+  const int k_apply = d->k_apply;
+  // rotation center on the way back, swapped if the output buffer is flipped
+  const float fx = t->flip ? t->ty : t->tx;
+  const float fy = t->flip ? t->tx : t->ty;
 
   for(size_t i = 0; i < points_count * 2; i += 2)
   {
@@ -466,35 +528,15 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
     pi[0] = points[i];
     pi[1] = points[i + 1];
 
-    if(d->k_apply == 1) keystone_transform(pi, k_space, ma, mb, md, me, mg, mh, kxa, kya);
+    if(k_apply == 1) keystone_transform(pi, k_space, t->ma, t->mb, t->md, t->me, t->mg, t->mh, t->kxa, t->kya);
 
-    pi[0] -= d->tx / factor;
-    pi[1] -= d->ty / factor;
+    pi[0] -= t->tx;
+    pi[1] -= t->ty;
     // transform this point using matrix m
-    transform(pi, po, d->inv_m, d->k_h, d->k_v);
-
-    if(d->flip)
-    {
-      po[1] += d->tx / factor;
-      po[0] += d->ty / factor;
-    }
-    else
-    {
-      po[0] += d->tx / factor;
-      po[1] += d->ty / factor;
-    }
+    transform(pi, po, t->inv_m, t->k_h, t->k_v);
 
-    points[i] = po[0] - (d->cix - d->enlarge_x) / factor;
-    points[i + 1] = po[1] - (d->ciy - d->enlarge_y) / factor;
-  }
-
-  // revert side-effects of the previous call to modify_roi_out
-  // TODO: this is just a quick hack. we need a major revamp of this module!
-  if(factor != 1.0f)
-  {
-    roi_in.width = piece->buf_in.width;
-    roi_in.height = piece->buf_in.height;
-    self->modify_roi_out(self, piece, &roi_out, &roi_in);
+    points[i] = (po[0] + fx) - t->cix;
+    points[i + 1] = (po[1] + fy) - t->ciy;
   }
 
   return 1;
@@ -502,66 +544,31 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
 int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *points,
                           size_t points_count)
 {
-  // as dt_iop_roi_t contain int values and not floats, we can have some rounding errors
-  // as a workaround, we use a factor for preview pipes
-  float factor = 1.0f;
-  if((piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW) == DT_DEV_PIXELPIPE_PREVIEW) factor = 100.0f;
-  // we first need to be sure that all data values are computed
-  // this is done in modify_roi_out fct, so we create tmp roi
-  dt_iop_roi_t roi_out, roi_in;
-  roi_in.width = piece->buf_in.width * factor;
-  roi_in.height = piece->buf_in.height * factor;
-  self->modify_roi_out(self, piece, &roi_out, &roi_in);
+  const dt_iop_clipping_data_t *const d = (dt_iop_clipping_data_t *)piece->data;
+  const dt_iop_clipping_points_t *const t = get_points_transform(self, piece);
 
-  dt_iop_clipping_data_t *d = (dt_iop_clipping_data_t *)piece->data;
-
-  const float rx = piece->buf_in.width;
-  const float ry = piece->buf_in.height;
-
-  float k_space[4] = { d->k_space[0] * rx, d->k_space[1] * ry, d->k_space[2] * rx, d->k_space[3] * ry };
-  const float kxa = d->kxa * rx, kxb = d->kxb * rx, kxc = d->kxc * rx, kxd = d->kxd * rx;
-  const float kya = d->kya * ry, kyb = d->kyb * ry, kyc = d->kyc * ry, kyd = d->kyd * ry;
-  float ma, mb, md, me, mg, mh;
-  if(d->k_apply == 1)
-    keystone_get_matrix(k_space, kxa, kxb, kxc, kxd, kya, kyb, kyc, kyd, &ma, &mb, &md, &me, &mg, &mh);
+  float k_space[4] = { t->k_space[0], t->k_space[1], t->k_space[2], t->k_space[3] };
+  const int k_apply = d->k_apply;
+  const float fx = t->flip ? t->ty : t->tx;
+  const float fy = t->flip ? t->tx : t->ty;
 
   for(size_t i = 0; i < points_count * 2; i += 2)
   {
     float pi[2], po[2];
-    pi[0] = -(d->enlarge_x - d->cix) / factor + points[i];
-    pi[1] = -(d->enlarge_y - d->ciy) / factor + points[i + 1];
+    pi[0] = t->cix + points[i] - fx;
+    pi[1] = t->ciy + points[i + 1] - fy;
 
     // transform this point using matrix m
-    if(d->flip)
-    {
-      pi[1] -= d->tx / factor;
-      pi[0] -= d->ty / factor;
-    }
-    else
-    {
-      pi[0] -= d->tx / factor;
-      pi[1] -= d->ty / factor;
-    }
-
-    backtransform(pi, po, d->m, d->k_h, d->k_v);
+    backtransform(pi, po, t->m, t->k_h, t->k_v);
 
-    po[0] += d->tx / factor;
-    po[1] += d->ty / factor;
-    if(d->k_apply == 1) keystone_backtransform(po, k_space, ma, mb, md, me, mg, mh, kxa, kya);
+    po[0] += t->tx;
+    po[1] += t->ty;
+    if(k_apply == 1) keystone_backtransform(po, k_space, t->ma, t->mb, t->md, t->me, t->mg, t->mh, t->kxa, t->kya);
 
     points[i] = po[0];
     points[i + 1] = po[1];
   }
 
-  // revert side-effects of the previous call to modify_roi_out
-  // TODO: this is just a quick hack. we need a major revamp of this module!
-  if(factor != 1.0f)
-  {
-    roi_in.width = piece->buf_in.width;
-    roi_in.height = piece->buf_in.height;
-    self->modify_roi_out(self, piece, &roi_out, &roi_in);
-  }
-
   return 1;
 }
 
@@ -1151,6 +1158,7 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
   d->k_space[2] = d->k_space[3] = 0.6f;
   d->k_apply = 0;
   d->enlarge_x = d->enlarge_y = 0.0f;
+  d->points.width = d->points.height = 0;
   d->flip = 0;
   d->angle = M_PI / 180.0 * p->angle;
 
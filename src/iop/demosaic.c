@@ -19,6 +19,7 @@
 #include "bauhaus/bauhaus.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
+#include "common/dispatch.h"
 #include "common/interpolation.h"
 #include "common/opencl.h"
 #include "common/image_cache.h"
@@ -159,13 +160,25 @@ typedef struct dt_iop_demosaic_data_t
 } dt_iop_demosaic_data_t;
 
 // Implemented on amaze_demosaic_RT.cc
-void amaze_demosaic_RT(
-    dt_dev_pixelpipe_iop_t *piece,
+typedef void (*amaze_demosaic_RT_t)(const float *const in, float *const out, const dt_iop_roi_t *const roi_in,
+                                    const dt_iop_roi_t *const roi_out, const uint32_t filters,
+                                    const float clip_pt);
+void amaze_demosaic_RT_plain(
     const float *const in,
-    float *out,
+    float *const out,
     const dt_iop_roi_t *const roi_in,
     const dt_iop_roi_t *const roi_out,
-    const uint32_t filters);
+    const uint32_t filters,
+    const float clip_pt);
+#ifdef DT_HAVE_TARGET_AVX2
+void amaze_demosaic_RT_avx2(
+    const float *const in,
+    float *const out,
+    const dt_iop_roi_t *const roi_in,
+    const dt_iop_roi_t *const roi_out,
+    const uint32_t filters,
+    const float clip_pt);
+#endif
 
 
 const char *name()
@@ -520,38 +533,18 @@ static inline const short * hexmap(const int row, const int col, short (*const a
   return allhex[irow % 3][icol % 3];
 }
 
-/*
-   Frank Markesteijn's algorithm for Fuji X-Trans sensors
- */
-static void xtrans_markesteijn_interpolate(float *out, const float *const in,
-                                           const dt_iop_roi_t *const roi_out,
-                                           const dt_iop_roi_t *const roi_in,
-                                           const uint8_t (*const xtrans)[6], const int passes)
+/** Map a green hexagon around each non-green pixel and vice versa. These only depend on the CFA pattern,
+    so they are set up once per image and shared by all tiles. sgrow/sgcol is the offset in the sensor matrix
+    of the solitary green pixels. **/
+static void xtrans_hexmap_init(const uint8_t (*const xtrans)[6], short (*const allhex)[3][8],
+                               unsigned short *const sgrow, unsigned short *const sgcol)
 {
   static const short orth[12] = { 1, 0, 0, 1, -1, 0, 0, -1, 1, 0, 0, 1 },
                      patt[2][16] = { { 0, 1, 0, -1, 2, 0, -1, 0, 1, 1, 1, -1, 0, 0, 0, 0 },
-                                     { 0, 1, 0, -2, 1, 0, -2, 0, 1, 1, -2, -2, 1, -1, -1, 1 } },
-                     dir[4] = { 1, TS, TS + 1, TS - 1 };
-
-  short allhex[3][3][8];
-  // sgrow/sgcol is the offset in the sensor matrix of the solitary
-  // green pixels (initialized here only to avoid compiler warning)
-  unsigned short sgrow = 0, sgcol = 0;
-
-  const int width = roi_out->width;
-  const int height = roi_out->height;
-  const int ndir = 4 << (passes > 1);
-
-  const size_t buffer_size = (size_t)TS * TS * (ndir * 4 + 3) * sizeof(float);
-  //TODO: should this use dt_alloc_align_float or _perthread_float?
-  char *const all_buffers = (char *)dt_alloc_align(64, dt_get_num_threads() * buffer_size);
-  if(!all_buffers)
-  {
-    printf("[demosaic] not able to allocate Markesteijn buffers\n");
-    return;
-  }
+                                     { 0, 1, 0, -2, 1, 0, -2, 0, 1, 1, -2, -2, 1, -1, -1, 1 } };
 
-  /* Map a green hexagon around each non-green pixel and vice versa:    */
+  // initialized here only to avoid compiler warning
+  *sgrow = *sgcol = 0;
   for(int row = 0; row < 3; row++)
     for(int col = 0; col < 3; col++)
       for(int ng = 0, d = 0; d < 10; d += 2)
@@ -565,8 +558,8 @@ static void xtrans_markesteijn_interpolate(float *out, const float *const in,
         // directions, this is the solitary green pixel
         if(ng == 4)
         {
-          sgrow = row;
-          sgcol = col;
+          *sgrow = row;
+          *sgcol = col;
         }
         if(ng == g + 1)
           for(int c = 0; c < 8; c++)
@@ -577,6 +570,157 @@ static void xtrans_markesteijn_interpolate(float *out, const float *const in,
             allhex[row][col][c ^ (g * 2 & d)] = h + v * TS;
           }
       }
+}
+
+/** Build homogeneity maps from the derivatives. The direction planes are processed a row at a time, so that
+    the loops over the columns vectorize. **/
+static inline void xtrans_homogeneity_map(float (*const drv)[TS][TS], uint8_t (*const homo)[TS][TS],
+                                          const int ndir, const int pad_homo, const int mrow, const int mcol)
+{
+  memset(homo, 0, sizeof(uint8_t) * ndir * TS * TS);
+  for(int row = pad_homo; row < mrow - pad_homo; row++)
+  {
+    float tr[TS];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for(int col = pad_homo; col < mcol - pad_homo; col++) tr[col] = FLT_MAX;
+    for(int d = 0; d < ndir; d++)
+    {
+      const float *const drow = drv[d][row];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int col = pad_homo; col < mcol - pad_homo; col++) tr[col] = (tr[col] > drow[col]) ? drow[col] : tr[col];
+    }
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for(int col = pad_homo; col < mcol - pad_homo; col++) tr[col] *= 8;
+
+    for(int d = 0; d < ndir; d++)
+    {
+      const float *const above = drv[d][row - 1];
+      const float *const here = drv[d][row];
+      const float *const below = drv[d][row + 1];
+      uint8_t *const hrow = homo[d][row];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int col = pad_homo; col < mcol - pad_homo; col++)
+      {
+        int count = 0;
+        for(int h = -1; h <= 1; h++)
+          count += (above[col + h] <= tr[col]) + (here[col + h] <= tr[col]) + (below[col + h] <= tr[col]);
+        hrow[col] = count;
+      }
+    }
+  }
+}
+
+/** Build 5x5 sum of homogeneity maps for each pixel & direction, as vertical sums of 5 rows followed by a
+    horizontal sum over 5 columns. Columns left of pad_tile - 2 are not taken into account, and the 4 columns
+    left of pad_tile get the partial sums, too. **/
+static inline void xtrans_homogeneity_sum(uint8_t (*const homo)[TS][TS], uint8_t (*const homosum)[TS][TS],
+                                          const int ndir, const int pad_tile, const int mrow, const int mcol)
+{
+  for(int d = 0; d < ndir; d++)
+    for(int row = pad_tile; row < mrow - pad_tile; row++)
+    {
+      // at most 9 * 25 homogeneous pixels, this can't overflow
+      uint8_t colsum[TS] = { 0 };
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int col = pad_tile - 2; col < mcol - pad_tile + 2; col++)
+        colsum[col] = homo[d][row - 2][col] + homo[d][row - 1][col] + homo[d][row][col] + homo[d][row + 1][col]
+                      + homo[d][row + 2][col];
+      uint8_t *const hsum = homosum[d][row];
+      hsum[pad_tile - 5] = 0;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int col = pad_tile - 4; col < mcol - pad_tile; col++)
+        hsum[col] = colsum[col - 2] + colsum[col - 1] + colsum[col] + colsum[col + 1] + colsum[col + 2];
+    }
+}
+
+/** Average the most homogeneous directions of one row for the final result. Like the maps, this works on
+    whole rows one direction after the other, so that the loops over the columns vectorize. **/
+static inline void xtrans_homogeneity_average(float (*const avg)[3], float (*const rgb)[TS][TS][3],
+                                              uint8_t (*const homosum)[TS][TS], const int ndir, const int row,
+                                              const int pad_tile, const int mcol)
+{
+  uint8_t maxval[TS];
+  float sum[4][TS];
+  for(int col = pad_tile; col < mcol - pad_tile; col++)
+  {
+    maxval[col] = 0;
+    sum[0][col] = sum[1][col] = sum[2][col] = sum[3][col] = 0.0f;
+  }
+  for(int d = 0; d < ndir; d++)
+  {
+    const uint8_t *const hm = homosum[d][row];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for(int col = pad_tile; col < mcol - pad_tile; col++) maxval[col] = MAX(maxval[col], hm[col]);
+  }
+  for(int col = pad_tile; col < mcol - pad_tile; col++) maxval[col] -= maxval[col] >> 3;
+
+  for(int d = 0; d < ndir; d++)
+  {
+    const uint8_t *const hm = homosum[d][row];
+    // with 8 directions, only the more homogeneous one of each pair d, d ^ 4 takes part
+    const uint8_t *const pair = homosum[d ^ (ndir == 8 ? 4 : 0)][row];
+    const float(*const pix)[3] = rgb[d][row];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for(int col = pad_tile; col < mcol - pad_tile; col++)
+    {
+      const int h = (hm[col] < pair[col]) ? 0 : hm[col];
+      const gboolean use = h >= maxval[col];
+      // select rather than multiply, so an Inf or NaN in a direction we don't use can't spoil the sum
+      sum[0][col] += use ? pix[col][0] : 0.0f;
+      sum[1][col] += use ? pix[col][1] : 0.0f;
+      sum[2][col] += use ? pix[col][2] : 0.0f;
+      sum[3][col] += use ? 1.0f : 0.0f;
+    }
+  }
+  for(int col = pad_tile; col < mcol - pad_tile; col++)
+    for(int c = 0; c < 3; c++) avg[col][c] = sum[c][col] / sum[3][col];
+}
+
+/*
+   Frank Markesteijn's algorithm for Fuji X-Trans sensors
+ */
+static void xtrans_markesteijn_interpolate(float *out, const float *const in,
+                                           const dt_iop_roi_t *const roi_out,
+                                           const dt_iop_roi_t *const roi_in,
+                                           const uint8_t (*const xtrans)[6], const int passes)
+{
+  static const short dir[4] = { 1, TS, TS + 1, TS - 1 };
+
+  short allhex[3][3][8];
+  // sgrow/sgcol is the offset in the sensor matrix of the solitary
+  // green pixels
+  unsigned short sgrow, sgcol;
+
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  const int ndir = 4 << (passes > 1);
+
+  const size_t buffer_size = (size_t)TS * TS * (ndir * 4 + 3) * sizeof(float);
+  //TODO: should this use dt_alloc_align_float or _perthread_float?
+  char *const all_buffers = (char *)dt_alloc_align(64, dt_get_num_threads() * buffer_size);
+  if(!all_buffers)
+  {
+    printf("[demosaic] not able to allocate Markesteijn buffers\n");
+    return;
+  }
+
+  xtrans_hexmap_init(xtrans, allhex, &sgrow, &sgcol);
 
   // extra passes propagates out errors at edges, hence need more padding
   const int pad_tile = (passes == 1) ? 12 : 17;
@@ -924,67 +1068,20 @@ static void xtrans_markesteijn_interpolate(float *out, const float *const in,
       }
 
       /* Build homogeneity maps from the derivatives:                   */
-      memset(homo, 0, sizeof(uint8_t) * ndir * TS * TS);
       const int pad_homo = (passes == 1) ? 10 : 15;
-      for(int row = pad_homo; row < mrow - pad_homo; row++)
-        for(int col = pad_homo; col < mcol - pad_homo; col++)
-        {
-          float tr = FLT_MAX;
-          for(int d = 0; d < ndir; d++)
-            if(tr > drv[d][row][col]) tr = drv[d][row][col];
-          tr *= 8;
-          for(int d = 0; d < ndir; d++)
-            for(int v = -1; v <= 1; v++)
-              for(int h = -1; h <= 1; h++) homo[d][row][col] += ((drv[d][row + v][col + h] <= tr) ? 1 : 0);
-        }
+      xtrans_homogeneity_map(drv, homo, ndir, pad_homo, mrow, mcol);
 
       /* Build 5x5 sum of homogeneity maps for each pixel & direction */
-      for(int d = 0; d < ndir; d++)
-        for(int row = pad_tile; row < mrow - pad_tile; row++)
-        {
-          // start before first column where homo[d][row][col+2] != 0,
-          // so can know v5sum and homosum[d][row][col] will be 0
-          int col = pad_tile-5;
-          uint8_t v5sum[5] = { 0 };
-          homosum[d][row][col] = 0;
-          // calculate by rolling through column sums
-          for(col++; col < mcol - pad_tile; col++)
-          {
-            uint8_t colsum = 0;
-            for(int v = -2; v <= 2; v++) colsum += homo[d][row + v][col + 2];
-            homosum[d][row][col] = homosum[d][row][col - 1] - v5sum[col % 5] + colsum;
-            v5sum[col % 5] = colsum;
-          }
-        }
+      xtrans_homogeneity_sum(homo, homosum, ndir, pad_tile, mrow, mcol);
 
       /* Average the most homogeneous pixels for the final result:       */
       for(int row = pad_tile; row < mrow - pad_tile; row++)
+      {
+        float avg[TS][3];
+        xtrans_homogeneity_average(avg, rgb, homosum, ndir, row, pad_tile, mcol);
         for(int col = pad_tile; col < mcol - pad_tile; col++)
-        {
-          uint8_t hm[8] = { 0 };
-          uint8_t maxval = 0;
-          for(int d = 0; d < ndir; d++)
-          {
-            hm[d] = homosum[d][row][col];
-            maxval = (maxval < hm[d] ? hm[d] : maxval);
-          }
-          maxval -= maxval >> 3;
-          for(int d = 0; d < ndir - 4; d++)
-            if(hm[d] < hm[d + 4])
-              hm[d] = 0;
-            else if(hm[d] > hm[d + 4])
-              hm[d + 4] = 0;
-          float avg[4] = { 0.0f };
-          for(int d = 0; d < ndir; d++)
-            if(hm[d] >= maxval)
-            {
-              for(int c = 0; c < 3; c++) avg[c] += rgb[d][row][col][c];
-              avg[3]++;
-            }
-          for(int c = 0; c < 3; c++)
-            out[4 * (width * (row + top) + col + left) + c] =
-              avg[c]/avg[3];
-        }
+          for(int c = 0; c < 3; c++) out[4 * (width * (row + top) + col + left) + c] = avg[col][c];
+      }
     }
   }
   dt_free_align(all_buffers);
@@ -998,17 +1095,14 @@ static void xtrans_fdc_interpolate(struct dt_iop_module_t *self, float *out, con
                                    const uint8_t (*const xtrans)[6])
 {
 
-  static const short orth[12] = { 1, 0, 0, 1, -1, 0, 0, -1, 1, 0, 0, 1 },
-                     patt[2][16] = { { 0, 1, 0, -1, 2, 0, -1, 0, 1, 1, 1, -1, 0, 0, 0, 0 },
-                                     { 0, 1, 0, -2, 1, 0, -2, 0, 1, 1, -2, -2, 1, -1, -1, 1 } },
-                     dir[4] = { 1, TS, TS + 1, TS - 1 };
+  static const short dir[4] = { 1, TS, TS + 1, TS - 1 };
 
   static const float directionality[8] = { 1.0f, 0.0f, 0.5f, 0.5f, 1.0f, 0.0f, 0.5f, 0.5f };
 
   short allhex[3][3][8];
   // sgrow/sgcol is the offset in the sensor matrix of the solitary
-  // green pixels (initialized here only to avoid compiler warning)
-  unsigned short sgrow = 0, sgcol = 0;
+  // green pixels
+  unsigned short sgrow, sgcol;
 
   const int width = roi_out->width;
   const int height = roi_out->height;
@@ -1547,32 +1641,7 @@ static void xtrans_fdc_interpolate(struct dt_iop_module_t *self, float *out, con
     return;
   }
 
-  /* Map a green hexagon around each non-green pixel and vice versa:    */
-  for(int row = 0; row < 3; row++)
-    for(int col = 0; col < 3; col++)
-      for(int ng = 0, d = 0; d < 10; d += 2)
-      {
-        int g = FCxtrans(row, col, NULL, xtrans) == 1;
-        if(FCxtrans(row + orth[d], col + orth[d + 2], NULL, xtrans) == 1)
-          ng = 0;
-        else
-          ng++;
-        // if there are four non-green pixels adjacent in cardinal
-        // directions, this is the solitary green pixel
-        if(ng == 4)
-        {
-          sgrow = row;
-          sgcol = col;
-        }
-        if(ng == g + 1)
-          for(int c = 0; c < 8; c++)
-          {
-            int v = orth[d] * patt[g][c * 2] + orth[d + 1] * patt[g][c * 2 + 1];
-            int h = orth[d + 2] * patt[g][c * 2] + orth[d + 3] * patt[g][c * 2 + 1];
-            // offset within TSxTS buffer
-            allhex[row][col][c ^ (g * 2 & d)] = h + v * TS;
-          }
-      }
+  xtrans_hexmap_init(xtrans, allhex, &sgrow, &sgcol);
 
   // extra passes propagates out errors at edges, hence need more padding
   const int pad_tile = 13;
@@ -1919,42 +1988,33 @@ static void xtrans_fdc_interpolate(struct dt_iop_module_t *self, float *out, con
       }
 
       /* Build homogeneity maps from the derivatives:                   */
-      memset(homo, 0, sizeof(uint8_t) * ndir * TS * TS);
       const int pad_homo = 10;
-      for(int row = pad_homo; row < mrow - pad_homo; row++)
-        for(int col = pad_homo; col < mcol - pad_homo; col++)
-        {
-          float tr = FLT_MAX;
-          for(int d = 0; d < ndir; d++)
-            if(tr > drv[d][row][col]) tr = drv[d][row][col];
-          tr *= 8;
-          for(int d = 0; d < ndir; d++)
-            for(int v = -1; v <= 1; v++)
-              for(int h = -1; h <= 1; h++) homo[d][row][col] += ((drv[d][row + v][col + h] <= tr) ? 1 : 0);
-        }
+      xtrans_homogeneity_map(drv, homo, ndir, pad_homo, mrow, mcol);
 
       /* Build 5x5 sum of homogeneity maps for each pixel & direction */
-      for(int d = 0; d < ndir; d++)
-        for(int row = pad_tile; row < mrow - pad_tile; row++)
-        {
-          // start before first column where homo[d][row][col+2] != 0,
-          // so can know v5sum and homosum[d][row][col] will be 0
-          int col = pad_tile - 5;
-          uint8_t v5sum[5] = { 0 };
-          homosum[d][row][col] = 0;
-          // calculate by rolling through column sums
-          for(col++; col < mcol - pad_tile; col++)
-          {
-            uint8_t colsum = 0;
-            for(int v = -2; v <= 2; v++) colsum += homo[d][row + v][col + 2];
-            homosum[d][row][col] = homosum[d][row][col - 1] - v5sum[col % 5] + colsum;
-            v5sum[col % 5] = colsum;
-          }
-        }
+      xtrans_homogeneity_sum(homo, homosum, ndir, pad_tile, mrow, mcol);
 
       /* Calculate chroma values in fdc:       */
       const int pad_fdc = 6;
       for(int row = pad_fdc; row < mrow - pad_fdc; row++)
+      {
+        // convolve the whole row with the four filters first. the loop over the columns vectorizes, and every
+        // pixel still sums up the taps in the same order.
+        float complex conv[4][TS];
+        for(int k = 0; k < 4; k++)
+        {
+          for(int col = pad_fdc; col < mcol - pad_fdc; col++) conv[k][col] = 0.0f;
+          for(int fdc_row = 0; fdc_row < 13; fdc_row++)
+            for(int fdc_col = 0; fdc_col < 13; fdc_col++)
+            {
+              const float complex filt = harr[k][12 - fdc_row][12 - fdc_col];
+              const float *const src = i_src + TS * (row - 6 + fdc_row) + fdc_col - 6;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+              for(int col = pad_fdc; col < mcol - pad_fdc; col++) conv[k][col] += filt * src[col];
+            }
+        }
         for(int col = pad_fdc; col < mcol - pad_fdc; col++)
         {
           int myrow, mycol;
@@ -1975,18 +2035,7 @@ static void xtrans_fdc_interpolate(struct dt_iop_module_t *self, float *out, con
               dirsum += directionality[d];
             }
           float w = dirsum / (float)dircount;
-          int fdc_row, fdc_col;
-          float complex C2m, C5m, C7m, C10m;
-#define CONV_FILT(VAR, FILT)                                                                                      \
-  VAR = 0.0f + 0.0f * _Complex_I;                                                                                 \
-  for(fdc_row = 0, myrow = row - 6; fdc_row < 13; fdc_row++, myrow++)                                             \
-    for(fdc_col = 0, mycol = col - 6; fdc_col < 13; fdc_col++, mycol++)                                           \
-      VAR += FILT[12 - fdc_row][12 - fdc_col] * *(i_src + TS * myrow + mycol);
-          CONV_FILT(C2m, harr[0])
-          CONV_FILT(C5m, harr[1])
-          CONV_FILT(C7m, harr[2])
-          CONV_FILT(C10m, harr[3])
-#undef CONV_FILT
+          float complex C2m = conv[0][col], C5m = conv[1][col], C7m = conv[2][col], C10m = conv[3][col];
           // build the q vector components
           myrow = (row + rowoffset) % 6;
           mycol = (col + coloffset) % 6;
@@ -2024,6 +2073,7 @@ static void xtrans_fdc_interpolate(struct dt_iop_module_t *self, float *out, con
           uv[1] = (rgbpix[0] - y) * 0.67815f;
           for(int c = 0; c < 2; c++) *(fdc_chroma + c * TS * TS + row * TS + col) = uv[c];
         }
+      }
 
       /* Average the most homogeneous pixels for the final result:       */
       for(int row = pad_tile; row < mrow - pad_tile; row++)
@@ -2491,6 +2541,332 @@ static void passthrough_color(float *out, const float *const in, dt_iop_roi_t *c
   }
 }
 
+// ppg picks the interpolation direction by comparing sums of gradients, which are equal quite often (think
+// of clipped areas). fma contraction would break those ties differently than the plain code, so don't.
+#ifdef __GNUC__
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// green at a red or blue pixel of the first ppg pass
+static inline __attribute__((always_inline)) float ppg_green(const float *const p, const int w)
+{
+  const float pc = p[0];
+  // get stuff (hopefully from cache)
+  const float pym = p[-w * 1];
+  const float pym2 = p[-w * 2];
+  const float pym3 = p[-w * 3];
+  const float pyM = p[+w * 1];
+  const float pyM2 = p[+w * 2];
+  const float pyM3 = p[+w * 3];
+  const float pxm = p[-1];
+  const float pxm2 = p[-2];
+  const float pxm3 = p[-3];
+  const float pxM = p[+1];
+  const float pxM2 = p[+2];
+  const float pxM3 = p[+3];
+
+  const float guessx = (pxm + pc + pxM) * 2.0f - pxM2 - pxm2;
+  const float diffx = (fabsf(pxm2 - pc) + fabsf(pxM2 - pc) + fabsf(pxm - pxM)) * 3.0f
+                      + (fabsf(pxM3 - pxM) + fabsf(pxm3 - pxm)) * 2.0f;
+  const float guessy = (pym + pc + pyM) * 2.0f - pyM2 - pym2;
+  const float diffy = (fabsf(pym2 - pc) + fabsf(pyM2 - pc) + fabsf(pym - pyM)) * 3.0f
+                      + (fabsf(pyM3 - pyM) + fabsf(pym3 - pym)) * 2.0f;
+  // use guessy if diffx > diffy
+  const float gy = fmaxf(fminf(guessy * .25f, fmaxf(pym, pyM)), fminf(pym, pyM));
+  const float gx = fmaxf(fminf(guessx * .25f, fmaxf(pxm, pxM)), fminf(pxm, pxM));
+  return diffx > diffy ? gy : gx;
+}
+
+// first ppg pass for one row: interpolate green at red and blue pixels, or copy color.
+// pixels of the same color are two apart in a row.
+static inline __attribute__((always_inline)) void ppg_green_row(float *const out, const float *const in,
+                                                                const int j, const dt_iop_roi_t *const roi_out,
+                                                                const dt_iop_roi_t *const roi_in,
+                                                                const uint32_t filters)
+{
+  // offsets only where the buffer ends:
+  const int offx = 3, offX = 3;
+  const int w = roi_in->width;
+  float *const buf = out + (size_t)4 * roi_out->width * j;
+  const float *const buf_in = in + (size_t)w * (j + roi_out->y) + roi_out->x;
+  for(int start = offx; start < offx + 2; start++)
+  {
+    const int c = FC(j, start, filters);
+    for(int i = start; i < roi_out->width - offX; i += 2)
+    {
+      if(c & 1)
+        buf[4 * i + 1] = buf_in[i];
+      else
+      {
+        buf[4 * i + c] = buf_in[i];
+        buf[4 * i + 1] = ppg_green(buf_in + i, w);
+      }
+    }
+  }
+}
+
+#ifdef DT_HAVE_TARGET_AVX2
+// p[0], p[2], .., p[14]
+static inline __attribute__((always_inline)) DT_TARGET_AVX2 __m256 ppg_load_even_avx2(const float *const p)
+{
+  const __m256 s = _mm256_shuffle_ps(_mm256_loadu_ps(p), _mm256_loadu_ps(p + 8), _MM_SHUFFLE(2, 0, 2, 0));
+  return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(s), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+static inline __attribute__((always_inline)) DT_TARGET_AVX2 __m256 ppg_abs_avx2(const __m256 x)
+{
+  return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+}
+
+// same as ppg_green_row(), eight red or blue pixels at a time. the operations are done in the very same
+// order as in ppg_green(), so the results are identical.
+static inline __attribute__((always_inline)) DT_TARGET_AVX2 void ppg_green_row_avx2(
+    float *const out, const float *const in, const int j, const dt_iop_roi_t *const roi_out,
+    const dt_iop_roi_t *const roi_in, const uint32_t filters)
+{
+  const int offx = 3, offX = 3;
+  const int w = roi_in->width;
+  float *const buf = out + (size_t)4 * roi_out->width * j;
+  const float *const buf_in = in + (size_t)w * (j + roi_out->y) + roi_out->x;
+  const __m256 two = _mm256_set1_ps(2.0f);
+  const __m256 three = _mm256_set1_ps(3.0f);
+  const __m256 quarter = _mm256_set1_ps(.25f);
+  for(int start = offx; start < offx + 2; start++)
+  {
+    const int c = FC(j, start, filters);
+    int i = start;
+    if(c & 1)
+    {
+      for(; i < roi_out->width - offX; i += 2) buf[4 * i + 1] = buf_in[i];
+      continue;
+    }
+    // the last load reads up to p[18]
+    for(; i + 18 < roi_out->width - offX; i += 16)
+    {
+      const float *const p = buf_in + i;
+      const __m256 pc = ppg_load_even_avx2(p);
+      const __m256 pym = ppg_load_even_avx2(p - w * 1);
+      const __m256 pym2 = ppg_load_even_avx2(p - w * 2);
+      const __m256 pym3 = ppg_load_even_avx2(p - w * 3);
+      const __m256 pyM = ppg_load_even_avx2(p + w * 1);
+      const __m256 pyM2 = ppg_load_even_avx2(p + w * 2);
+      const __m256 pyM3 = ppg_load_even_avx2(p + w * 3);
+      const __m256 pxm = ppg_load_even_avx2(p - 1);
+      const __m256 pxm2 = ppg_load_even_avx2(p - 2);
+      const __m256 pxm3 = ppg_load_even_avx2(p - 3);
+      const __m256 pxM = ppg_load_even_avx2(p + 1);
+      const __m256 pxM2 = ppg_load_even_avx2(p + 2);
+      const __m256 pxM3 = ppg_load_even_avx2(p + 3);
+
+      const __m256 guessx = _mm256_sub_ps(
+          _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(pxm, pc), pxM), two), pxM2), pxm2);
+      const __m256 diffx = _mm256_add_ps(
+          _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(ppg_abs_avx2(_mm256_sub_ps(pxm2, pc)),
+                                                    ppg_abs_avx2(_mm256_sub_ps(pxM2, pc))),
+                                      ppg_abs_avx2(_mm256_sub_ps(pxm, pxM))),
+                        three),
+          _mm256_mul_ps(_mm256_add_ps(ppg_abs_avx2(_mm256_sub_ps(pxM3, pxM)),
+                                      ppg_abs_avx2(_mm256_sub_ps(pxm3, pxm))),
+                        two));
+      const __m256 guessy = _mm256_sub_ps(
+          _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(pym, pc), pyM), two), pyM2), pym2);
+      const __m256 diffy = _mm256_add_ps(
+          _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(ppg_abs_avx2(_mm256_sub_ps(pym2, pc)),
+                                                    ppg_abs_avx2(_mm256_sub_ps(pyM2, pc))),
+                                      ppg_abs_avx2(_mm256_sub_ps(pym, pyM))),
+                        three),
+          _mm256_mul_ps(_mm256_add_ps(ppg_abs_avx2(_mm256_sub_ps(pyM3, pyM)),
+                                      ppg_abs_avx2(_mm256_sub_ps(pym3, pym))),
+                        two));
+      const __m256 gy = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(guessy, quarter), _mm256_max_ps(pym, pyM)),
+                                      _mm256_min_ps(pym, pyM));
+      const __m256 gx = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(guessx, quarter), _mm256_max_ps(pxm, pxM)),
+                                      _mm256_min_ps(pxm, pxM));
+      const __m256 g = _mm256_blendv_ps(gx, gy, _mm256_cmp_ps(diffx, diffy, _CMP_GT_OQ));
+
+      float DT_ALIGNED_ARRAY vc[8], vg[8];
+      _mm256_store_ps(vc, pc);
+      _mm256_store_ps(vg, g);
+      for(int k = 0; k < 8; k++)
+      {
+        buf[4 * (i + 2 * k) + c] = vc[k];
+        buf[4 * (i + 2 * k) + 1] = vg[k];
+      }
+    }
+    for(; i < roi_out->width - offX; i += 2)
+    {
+      buf[4 * i + c] = buf_in[i];
+      buf[4 * i + 1] = ppg_green(buf_in + i, w);
+    }
+  }
+}
+#endif
+
+// second ppg pass for one row: interpolate red and blue. every pixel only writes the channels it
+// doesn't read from its neighbours, so the order doesn't matter.
+static inline __attribute__((always_inline)) void ppg_redblue_row(float *const out, const int j,
+                                                                  const dt_iop_roi_t *const roi_out,
+                                                                  const uint32_t filters)
+{
+  const int w4 = 4 * roi_out->width;
+  float *const buf = out + (size_t)w4 * j;
+  for(int start = 1; start < 3; start++)
+  {
+    const int c = FC(j, start, filters);
+    if(c & 1)
+    {
+      // calculate red and blue for green pixels from the 4-nbhood.
+      // cv is the color of the nbs at the top and bottom, the other one is left and right.
+      const int cv = FC(j, start + 1, filters) == 0 ? 2 : 0;
+      const int ch = 2 - cv;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int i = start; i < roi_out->width - 1; i += 2)
+      {
+        float *const color = buf + 4 * i;
+        const float *const nt = color - w4;
+        const float *const nb = color + w4;
+        const float *const nl = color - 4;
+        const float *const nr = color + 4;
+        color[cv] = (nt[cv] + nb[cv] + 2.0f * color[1] - nt[1] - nb[1]) * .5f;
+        color[ch] = (nl[ch] + nr[ch] + 2.0f * color[1] - nl[1] - nr[1]) * .5f;
+      }
+    }
+    else
+    {
+      // red pixel, fill blue, or blue pixel, fill red, from the 4-star-nbhood:
+      const int t = 2 - c;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int i = start; i < roi_out->width - 1; i += 2)
+      {
+        float *const color = buf + 4 * i;
+        const float *const ntl = color - 4 - w4;
+        const float *const ntr = color + 4 - w4;
+        const float *const nbl = color - 4 + w4;
+        const float *const nbr = color + 4 + w4;
+        const float diff1 = fabsf(ntl[t] - nbr[t]) + fabsf(ntl[1] - color[1]) + fabsf(nbr[1] - color[1]);
+        const float guess1 = ntl[t] + nbr[t] + 2.0f * color[1] - ntl[1] - nbr[1];
+        const float diff2 = fabsf(ntr[t] - nbl[t]) + fabsf(ntr[1] - color[1]) + fabsf(nbl[1] - color[1]);
+        const float guess2 = ntr[t] + nbl[t] + 2.0f * color[1] - ntr[1] - nbl[1];
+        color[t] = diff1 > diff2 ? guess2 * .5f : (diff1 < diff2 ? guess1 * .5f : (guess1 + guess2) * .25f);
+      }
+    }
+  }
+}
+
+// both ppg passes over the image, compiled once for the baseline and once for avx2. the parallel loops
+// have to live in the function carrying the target attribute, openmp outlines them before inlining.
+static void demosaic_ppg_rows_plain(float *const out, const float *const in, const dt_iop_roi_t *const roi_out,
+                                    const dt_iop_roi_t *const roi_in, const uint32_t filters)
+{
+  // for all pixels: interpolate green into float array, or copy color.
+#ifdef _OPENMP
+#pragma omp parallel for default(none) dt_omp_firstprivate(filters, out, in, roi_in, roi_out) schedule(static)
+#endif
+  for(int j = 3; j < roi_out->height - 3; j++) ppg_green_row(out, in, j, roi_out, roi_in, filters);
+
+  // for all pixels: interpolate colors into float array
+#ifdef _OPENMP
+#pragma omp parallel for default(none) dt_omp_firstprivate(filters, out, roi_out) schedule(static)
+#endif
+  for(int j = 1; j < roi_out->height - 1; j++) ppg_redblue_row(out, j, roi_out, filters);
+}
+
+#ifdef DT_HAVE_TARGET_AVX2
+static DT_TARGET_AVX2 void demosaic_ppg_rows_avx2(float *const out, const float *const in,
+                                                  const dt_iop_roi_t *const roi_out,
+                                                  const dt_iop_roi_t *const roi_in, const uint32_t filters)
+{
+#ifdef _OPENMP
+#pragma omp parallel for default(none) dt_omp_firstprivate(filters, out, in, roi_in, roi_out) schedule(static)
+#endif
+  for(int j = 3; j < roi_out->height - 3; j++) ppg_green_row_avx2(out, in, j, roi_out, roi_in, filters);
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) dt_omp_firstprivate(filters, out, roi_out) schedule(static)
+#endif
+  for(int j = 1; j < roi_out->height - 1; j++) ppg_redblue_row(out, j, roi_out, filters);
+}
+#endif
+
+#ifdef __GNUC__
+#pragma GCC pop_options
+#endif
+
+typedef void (*demosaic_ppg_rows_t)(float *const out, const float *const in, const dt_iop_roi_t *const roi_out,
+                                    const dt_iop_roi_t *const roi_in, const uint32_t filters);
+
+// a synthetic 12 mpix rggb mosaic for darktable-cputest
+static size_t demosaic_ppg_bench(const void *variant, float **out)
+{
+  const int width = 4000, height = 3000;
+  const uint32_t filters = 0x94949494;
+  const dt_iop_roi_t roi = { .x = 0, .y = 0, .width = width, .height = height, .scale = 1.0f };
+  float *const in = dt_alloc_align_float((size_t)width * height);
+  *out = dt_alloc_align_float((size_t)4 * width * height);
+  for(int row = 0; row < height; row++)
+    for(int col = 0; col < width; col++)
+      in[(size_t)row * width + col] = 0.5f + 0.4f * sinf(0.013f * col + 0.7f * FC(row, col, filters))
+                                             * cosf(0.021f * row - 0.003f * col);
+  memset(*out, 0, sizeof(float) * 4 * width * height);
+  ((demosaic_ppg_rows_t)variant)(*out, in, &roi, &roi, filters);
+  dt_free_align(in);
+  return (size_t)4 * width * height;
+}
+
+static dt_dispatch_kernel_t demosaic_ppg_kernel = {
+  .name = "ppg demosaic",
+  .variants = { [DT_ISA_SCALAR] = demosaic_ppg_rows_plain,
+#ifdef DT_HAVE_TARGET_AVX2
+                [DT_ISA_AVX2] = demosaic_ppg_rows_avx2,
+#endif
+              },
+  .bench = demosaic_ppg_bench,
+  .selected = demosaic_ppg_rows_plain
+};
+
+// a synthetic 12 mpix rggb mosaic for darktable-cputest
+static size_t amaze_demosaic_bench(const void *variant, float **out)
+{
+  const int width = 4000, height = 3000;
+  const uint32_t filters = 0x94949494;
+  const dt_iop_roi_t roi = { .x = 0, .y = 0, .width = width, .height = height, .scale = 1.0f };
+  float *const in = dt_alloc_align_float((size_t)width * height);
+  *out = dt_alloc_align_float((size_t)4 * width * height);
+  for(int row = 0; row < height; row++)
+    for(int col = 0; col < width; col++)
+      in[(size_t)row * width + col] = 0.5f + 0.4f * sinf(0.013f * col + 0.7f * FC(row, col, filters))
+                                             * cosf(0.021f * row - 0.003f * col);
+  memset(*out, 0, sizeof(float) * 4 * width * height);
+  ((amaze_demosaic_RT_t)variant)(in, *out, &roi, &roi, filters, 1.0f);
+  dt_free_align(in);
+  return (size_t)4 * width * height;
+}
+
+static dt_dispatch_kernel_t amaze_demosaic_kernel = {
+  .name = "amaze demosaic",
+  .variants = { [DT_ISA_SCALAR] = amaze_demosaic_RT_plain,
+#ifdef DT_HAVE_TARGET_AVX2
+                [DT_ISA_AVX2] = amaze_demosaic_RT_avx2,
+#endif
+              },
+  .bench = amaze_demosaic_bench,
+  .selected = amaze_demosaic_RT_plain
+};
+
+static void amaze_demosaic(dt_dev_pixelpipe_iop_t *piece, const float *const in, float *const out,
+                           const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                           const uint32_t filters)
+{
+  const float clip_pt = fminf(piece->pipe->dsc.processed_maximum[0],
+                              fminf(piece->pipe->dsc.processed_maximum[1], piece->pipe->dsc.processed_maximum[2]));
+  ((amaze_demosaic_RT_t)amaze_demosaic_kernel.selected)(in, out, roi_in, roi_out, filters, clip_pt);
+}
+
 /** 1:1 demosaic from in to out, in is full buf, out is translated/cropped (scale == 1.0!) */
 static void demosaic_ppg(float *const out, const float *const in, const dt_iop_roi_t *const roi_out,
                          const dt_iop_roi_t *const roi_in, const uint32_t filters, const float thrs)
@@ -2543,178 +2919,7 @@ static void demosaic_ppg(float *const out, const float *const in, const dt_iop_r
     pre_median(med_in, in, roi_in, filters, 1, thrs);
     input = med_in;
   }
-// for all pixels: interpolate green into float array, or copy color.
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(filters, out, roi_in, roi_out, offx, offy, offX, offY) \
-  shared(input) \
-  schedule(static)
-#endif
-  for(int j = offy; j < roi_out->height - offY; j++)
-  {
-    float *buf = out + (size_t)4 * roi_out->width * j + 4 * offx;
-    const float *buf_in = input + (size_t)roi_in->width * (j + roi_out->y) + offx + roi_out->x;
-    for(int i = offx; i < roi_out->width - offX; i++)
-    {
-      const int c = FC(j, i, filters);
-#if defined(__SSE__)
-      // prefetch what we need soon (load to cpu caches)
-      _mm_prefetch((char *)buf_in + 256, _MM_HINT_NTA); // TODO: try HINT_T0-3
-      _mm_prefetch((char *)buf_in + roi_in->width + 256, _MM_HINT_NTA);
-      _mm_prefetch((char *)buf_in + 2 * roi_in->width + 256, _MM_HINT_NTA);
-      _mm_prefetch((char *)buf_in + 3 * roi_in->width + 256, _MM_HINT_NTA);
-      _mm_prefetch((char *)buf_in - roi_in->width + 256, _MM_HINT_NTA);
-      _mm_prefetch((char *)buf_in - 2 * roi_in->width + 256, _MM_HINT_NTA);
-      _mm_prefetch((char *)buf_in - 3 * roi_in->width + 256, _MM_HINT_NTA);
-#endif
-
-#if defined(__SSE__)
-      __m128 col = _mm_load_ps(buf);
-      float *color = (float *)&col;
-#else
-      float color[4] = { buf[0], buf[1], buf[2], buf[3] };
-#endif
-      const float pc = buf_in[0];
-      // if(__builtin_expect(c == 0 || c == 2, 1))
-      if(c == 0 || c == 2)
-      {
-        color[c] = pc;
-        // get stuff (hopefully from cache)
-        const float pym = buf_in[-roi_in->width * 1];
-        const float pym2 = buf_in[-roi_in->width * 2];
-        const float pym3 = buf_in[-roi_in->width * 3];
-        const float pyM = buf_in[+roi_in->width * 1];
-        const float pyM2 = buf_in[+roi_in->width * 2];
-        const float pyM3 = buf_in[+roi_in->width * 3];
-        const float pxm = buf_in[-1];
-        const float pxm2 = buf_in[-2];
-        const float pxm3 = buf_in[-3];
-        const float pxM = buf_in[+1];
-        const float pxM2 = buf_in[+2];
-        const float pxM3 = buf_in[+3];
-
-        const float guessx = (pxm + pc + pxM) * 2.0f - pxM2 - pxm2;
-        const float diffx = (fabsf(pxm2 - pc) + fabsf(pxM2 - pc) + fabsf(pxm - pxM)) * 3.0f
-                            + (fabsf(pxM3 - pxM) + fabsf(pxm3 - pxm)) * 2.0f;
-        const float guessy = (pym + pc + pyM) * 2.0f - pyM2 - pym2;
-        const float diffy = (fabsf(pym2 - pc) + fabsf(pyM2 - pc) + fabsf(pym - pyM)) * 3.0f
-                            + (fabsf(pyM3 - pyM) + fabsf(pym3 - pym)) * 2.0f;
-        if(diffx > diffy)
-        {
-          // use guessy
-          const float m = fminf(pym, pyM);
-          const float M = fmaxf(pym, pyM);
-          color[1] = fmaxf(fminf(guessy * .25f, M), m);
-        }
-        else
-        {
-          const float m = fminf(pxm, pxM);
-          const float M = fmaxf(pxm, pxM);
-          color[1] = fmaxf(fminf(guessx * .25f, M), m);
-        }
-      }
-      else
-        color[1] = pc;
-
-      // write using MOVNTPS (write combine omitting caches)
-      // _mm_stream_ps(buf, col);
-      memcpy(buf, color, sizeof(float) * 4);
-      buf += 4;
-      buf_in++;
-    }
-  }
-// SFENCE (make sure stuff is stored now)
-// _mm_sfence();
-
-// for all pixels: interpolate colors into float array
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(filters, out, roi_out) \
-  schedule(static)
-#endif
-  for(int j = 1; j < roi_out->height - 1; j++)
-  {
-    float *buf = out + (size_t)4 * roi_out->width * j + 4;
-    for(int i = 1; i < roi_out->width - 1; i++)
-    {
-      // also prefetch direct nbs top/bottom
-#if defined(__SSE__)
-      _mm_prefetch((char *)buf + 256, _MM_HINT_NTA);
-      _mm_prefetch((char *)buf - roi_out->width * 4 * sizeof(float) + 256, _MM_HINT_NTA);
-      _mm_prefetch((char *)buf + roi_out->width * 4 * sizeof(float) + 256, _MM_HINT_NTA);
-#endif
-
-      const int c = FC(j, i, filters);
-#if defined(__SSE__)
-      __m128 col = _mm_load_ps(buf);
-      float *color = (float *)&col;
-#else
-      float color[4] = { buf[0], buf[1], buf[2], buf[3] };
-#endif
-      // fill all four pixels with correctly interpolated stuff: r/b for green1/2
-      // b for r and r for b
-      if(__builtin_expect(c & 1, 1)) // c == 1 || c == 3)
-      {
-        // calculate red and blue for green pixels:
-        // need 4-nbhood:
-        const float *nt = buf - 4 * roi_out->width;
-        const float *nb = buf + 4 * roi_out->width;
-        const float *nl = buf - 4;
-        const float *nr = buf + 4;
-        if(FC(j, i + 1, filters) == 0) // red nb in same row
-        {
-          color[2] = (nt[2] + nb[2] + 2.0f * color[1] - nt[1] - nb[1]) * .5f;
-          color[0] = (nl[0] + nr[0] + 2.0f * color[1] - nl[1] - nr[1]) * .5f;
-        }
-        else
-        {
-          // blue nb
-          color[0] = (nt[0] + nb[0] + 2.0f * color[1] - nt[1] - nb[1]) * .5f;
-          color[2] = (nl[2] + nr[2] + 2.0f * color[1] - nl[1] - nr[1]) * .5f;
-        }
-      }
-      else
-      {
-        // get 4-star-nbhood:
-        const float *ntl = buf - 4 - 4 * roi_out->width;
-        const float *ntr = buf + 4 - 4 * roi_out->width;
-        const float *nbl = buf - 4 + 4 * roi_out->width;
-        const float *nbr = buf + 4 + 4 * roi_out->width;
-
-        if(c == 0)
-        {
-          // red pixel, fill blue:
-          const float diff1 = fabsf(ntl[2] - nbr[2]) + fabsf(ntl[1] - color[1]) + fabsf(nbr[1] - color[1]);
-          const float guess1 = ntl[2] + nbr[2] + 2.0f * color[1] - ntl[1] - nbr[1];
-          const float diff2 = fabsf(ntr[2] - nbl[2]) + fabsf(ntr[1] - color[1]) + fabsf(nbl[1] - color[1]);
-          const float guess2 = ntr[2] + nbl[2] + 2.0f * color[1] - ntr[1] - nbl[1];
-          if(diff1 > diff2)
-            color[2] = guess2 * .5f;
-          else if(diff1 < diff2)
-            color[2] = guess1 * .5f;
-          else
-            color[2] = (guess1 + guess2) * .25f;
-        }
-        else // c == 2, blue pixel, fill red:
-        {
-          const float diff1 = fabsf(ntl[0] - nbr[0]) + fabsf(ntl[1] - color[1]) + fabsf(nbr[1] - color[1]);
-          const float guess1 = ntl[0] + nbr[0] + 2.0f * color[1] - ntl[1] - nbr[1];
-          const float diff2 = fabsf(ntr[0] - nbl[0]) + fabsf(ntr[1] - color[1]) + fabsf(nbl[1] - color[1]);
-          const float guess2 = ntr[0] + nbl[0] + 2.0f * color[1] - ntr[1] - nbl[1];
-          if(diff1 > diff2)
-            color[0] = guess2 * .5f;
-          else if(diff1 < diff2)
-            color[0] = guess1 * .5f;
-          else
-            color[0] = (guess1 + guess2) * .25f;
-        }
-      }
-      // _mm_stream_ps(buf, col);
-      memcpy(buf, color, sizeof(float) * 4);
-      buf += 4;
-    }
-  }
-  // _mm_sfence();
+  ((demosaic_ppg_rows_t)demosaic_ppg_kernel.selected)(out, input, roi_out, roi_in, filters);
   if(median) dt_free_align((float *)input);
 }
 
@@ -2977,7 +3182,7 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
         demosaic_ppg(tmp, in, &roo, &roi, piece->pipe->dsc.filters,
                      data->median_thrs); // wanted ppg or zoomed out a lot and quality is limited to 1
       else
-        amaze_demosaic_RT(piece, in, tmp, &roi, &roo, piece->pipe->dsc.filters);
+        amaze_demosaic(piece, in, tmp, &roi, &roo, piece->pipe->dsc.filters);
 
       if(!(img->flags & DT_IMAGE_4BAYER) && data->green_eq != DT_IOP_GREEN_EQ_NO) dt_free_align(in);
     }
@@ -4836,10 +5041,18 @@ void init_global(dt_iop_module_so_t *module)
   gd->kernel_markesteijn_zero = dt_opencl_create_kernel(markesteijn, "markesteijn_zero");
   gd->kernel_markesteijn_accu = dt_opencl_create_kernel(markesteijn, "markesteijn_accu");
   gd->kernel_markesteijn_final = dt_opencl_create_kernel(markesteijn, "markesteijn_final");
+
+  dt_dispatch_register(&demosaic_ppg_kernel);
+  dt_dispatch_register(&rcd_demosaic_kernel);
+  dt_dispatch_register(&amaze_demosaic_kernel);
 }
 
 void cleanup_global(dt_iop_module_so_t *module)
 {
+  dt_dispatch_unregister(&demosaic_ppg_kernel);
+  dt_dispatch_unregister(&rcd_demosaic_kernel);
+  dt_dispatch_unregister(&amaze_demosaic_kernel);
+
   dt_iop_demosaic_global_data_t *gd = (dt_iop_demosaic_global_data_t *)module->data;
   dt_opencl_free_kernel(gd->kernel_zoom_half_size);
   dt_opencl_free_kernel(gd->kernel_ppg_green);
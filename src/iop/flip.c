@@ -189,27 +189,35 @@ static void backtransform(const int32_t *x, int32_t *o, const dt_image_orientati
   }
 }
 
+// flipping an axis is x -> w - x, written as a multiply-add so that the loops below have no branches and
+// vectorize
 int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *points, size_t points_count)
 {
   // if (!self->enabled) return 2;
   const dt_iop_flip_data_t *d = (dt_iop_flip_data_t *)piece->data;
 
-  float x, y;
+  const float sx = (d->orientation & ORIENTATION_FLIP_X) ? -1.0f : 1.0f;
+  const float ox = (d->orientation & ORIENTATION_FLIP_X) ? piece->buf_in.width : 0.0f;
+  const float sy = (d->orientation & ORIENTATION_FLIP_Y) ? -1.0f : 1.0f;
+  const float oy = (d->orientation & ORIENTATION_FLIP_Y) ? piece->buf_in.height : 0.0f;
 
-  for(size_t i = 0; i < points_count * 2; i += 2)
+  if(d->orientation & ORIENTATION_SWAP_XY)
+  {
+    for(size_t i = 0; i < points_count * 2; i += 2)
+    {
+      const float x = sx * points[i] + ox;
+      const float y = sy * points[i + 1] + oy;
+      points[i] = y;
+      points[i + 1] = x;
+    }
+  }
+  else
   {
-    x = points[i];
-    y = points[i + 1];
-    if(d->orientation & ORIENTATION_FLIP_X) x = piece->buf_in.width - points[i];
-    if(d->orientation & ORIENTATION_FLIP_Y) y = piece->buf_in.height - points[i + 1];
-    if(d->orientation & ORIENTATION_SWAP_XY)
+    for(size_t i = 0; i < points_count * 2; i += 2)
     {
-      const float yy = y;
-      y = x;
-      x = yy;
+      points[i] = sx * points[i] + ox;
+      points[i + 1] = sy * points[i + 1] + oy;
     }
-    points[i] = x;
-    points[i + 1] = y;
   }
 
   return 1;
@@ -220,25 +228,28 @@ int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   // if (!self->enabled) return 2;
   const dt_iop_flip_data_t *d = (dt_iop_flip_data_t *)piece->data;
 
-  float x, y;
+  const float sx = (d->orientation & ORIENTATION_FLIP_X) ? -1.0f : 1.0f;
+  const float ox = (d->orientation & ORIENTATION_FLIP_X) ? piece->buf_in.width : 0.0f;
+  const float sy = (d->orientation & ORIENTATION_FLIP_Y) ? -1.0f : 1.0f;
+  const float oy = (d->orientation & ORIENTATION_FLIP_Y) ? piece->buf_in.height : 0.0f;
 
-  for(size_t i = 0; i < points_count * 2; i += 2)
+  if(d->orientation & ORIENTATION_SWAP_XY)
   {
-    if(d->orientation & ORIENTATION_SWAP_XY)
+    for(size_t i = 0; i < points_count * 2; i += 2)
     {
-      y = points[i];
-      x = points[i + 1];
+      const float x = points[i + 1];
+      const float y = points[i];
+      points[i] = sx * x + ox;
+      points[i + 1] = sy * y + oy;
     }
-    else
+  }
+  else
+  {
+    for(size_t i = 0; i < points_count * 2; i += 2)
     {
-      x = points[i];
-      y = points[i + 1];
+      points[i] = sx * points[i] + ox;
+      points[i + 1] = sy * points[i + 1] + oy;
     }
-    if(d->orientation & ORIENTATION_FLIP_X) x = piece->buf_in.width - x;
-    if(d->orientation & ORIENTATION_FLIP_Y) y = piece->buf_in.height - y;
-
-    points[i] = x;
-    points[i + 1] = y;
   }
 
   return 1;
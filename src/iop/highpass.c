@@ -284,10 +284,21 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   /* the blend code at the end assumes at least 4 channels, and we never get more than four */
   assert(piece->colors == ch);
 
+  const int rad = MAX_RADIUS * (fmin(100.0, data->sharpness + 1) / 100.0);
+  const int radius = MIN(MAX_RADIUS, ceilf(rad * roi_in->scale / piece->iscale));
+
+  /* horizontal blur out into out */
+  const int range = 2 * radius + 1;
+  const int hr = range / 2;
+
 /* create inverted image and then blur */
 /* since we use only the L channel, pack the values together instead of every fourth float */
 /* to reduce cache pressure and memory bandwidth during the blur operation */
   const size_t npixels = (size_t)roi_out->height * roi_out->width;
+  /* the blurred L channel only depends on the input and the sharpness, changing the contrast reuses it */
+  const uint64_t hash = dt_dev_pixelpipe_cache_filter_hash(piece, roi_in, "highpass", &hr, sizeof(hr));
+  if(!dt_dev_pixelpipe_cache_filter_get(&piece->pipe->cache, hash, out, sizeof(float) * npixels))
+  {
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
   dt_omp_firstprivate(npixels) \
@@ -295,17 +306,12 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   shared(out) \
   schedule(static)
 #endif
-  for(size_t k = 0; k < (size_t)npixels; k++)
-    out[k] = 100.0f - LCLIP(in[4 * k]); // only L in Lab space
+    for(size_t k = 0; k < (size_t)npixels; k++)
+      out[k] = 100.0f - LCLIP(in[4 * k]); // only L in Lab space
 
-  const int rad = MAX_RADIUS * (fmin(100.0, data->sharpness + 1) / 100.0);
-  const int radius = MIN(MAX_RADIUS, ceilf(rad * roi_in->scale / piece->iscale));
-
-  /* horizontal blur out into out */
-  const int range = 2 * radius + 1;
-  const int hr = range / 2;
-
-  dt_box_mean(out, roi_out->height, roi_out->width, 1, hr, BOX_ITERATIONS);
+    dt_box_mean(out, roi_out->height, roi_out->width, 1, hr, BOX_ITERATIONS);
+    dt_dev_pixelpipe_cache_filter_put(&piece->pipe->cache, hash, out, sizeof(float) * npixels);
+  }
 
   const float contrast_scale = ((data->contrast / 100.0) * 7.5);
   /* Blend the inverted blurred L channel with the original input.  Because we packed the L values */
@@ -211,7 +211,11 @@ int process_tiling_cl(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_
 
 /** this functions are used for distort iop
  * points is an array of float {x1,y1,x2,y2,...}
- * size is 2*points_count */
+ * size is 2*points_count
+ * they get called for single points (mouse events) as well as for whole mask shapes on every redraw, with
+ * the history locked. anything that doesn't depend on the points (matrices, lens models, ...) should be set
+ * up once per call at most, better kept in piece->data until the next commit_params(), and the per-point
+ * loop should be free of allocations and branches so that it vectorizes. */
 /** points before the iop is applied => point after processed */
 int distort_transform(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, float *points,
                       size_t points_count);
@@ -118,7 +118,8 @@ typedef struct dt_iop_lensfun_gui_data_t
 
 typedef struct dt_iop_lensfun_global_data_t
 {
-  lfDatabase *db;
+  lfDatabase *db; // loaded on first use, see _lensfun_db()
+  dt_pthread_mutex_t db_lock;
   int kernel_lens_distort_bilinear;
   int kernel_lens_distort_bicubic;
   int kernel_lens_distort_lanczos2;
@@ -126,6 +127,8 @@ typedef struct dt_iop_lensfun_global_data_t
   int kernel_lens_vignette;
 } dt_iop_lensfun_global_data_t;
 
+static lfDatabase *_lensfun_db(dt_iop_lensfun_global_data_t *gd);
+
 typedef struct dt_iop_lensfun_data_t
 {
   lfLens *lens;
@@ -140,6 +143,10 @@ typedef struct dt_iop_lensfun_data_t
   gboolean do_nan_checks;
   gboolean tca_override;
   lfLensCalibTCA custom_tca;
+  // modifier for distort_(back)transform() on the full input buffer, built on first use after commit_params()
+  lfModifier *point_modifier;
+  int point_modflags;
+  int point_width, point_height;
 } dt_iop_lensfun_data_t;
 
 
@@ -367,6 +374,25 @@ static lfModifier * get_modifier(int *mods_done, int w, int h, const dt_iop_lens
   return mod;
 }
 
+// the modifier for distort_transform() and distort_backtransform(). masks and guides map their points through
+// these on every redraw, so the modifier is kept in the pipe data until the parameters or the buffer size
+// change instead of being initialized for each call. callers are serialized by the history mutex.
+static const lfModifier *get_point_modifier(int *mods_done, const int w, const int h, dt_iop_lensfun_data_t *d)
+{
+  if(!d->point_modifier || d->point_width != w || d->point_height != h)
+  {
+    delete d->point_modifier;
+    dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
+    d->point_modifier = get_modifier(&d->point_modflags, w, h, d, LF_MODIFY_ALL);
+    dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+    d->point_width = w;
+    d->point_height = h;
+  }
+
+  *mods_done = d->point_modflags;
+  return d->point_modifier;
+}
+
 void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid, void *const ovoid,
              const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -863,13 +889,12 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
   dt_iop_lensfun_data_t *d = (dt_iop_lensfun_data_t *)piece->data;
   if(!d->lens || !d->lens->Maker || d->crop <= 0.0f) return 0;
 
-  const float orig_w = piece->buf_in.width, orig_h = piece->buf_in.height;
   int modflags;
-  const lfModifier *modifier = get_modifier(&modflags, orig_w, orig_h, d, LF_MODIFY_ALL);
+  const lfModifier *modifier = get_point_modifier(&modflags, piece->buf_in.width, piece->buf_in.height, d);
 
   if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
   {
-    float *buf = (float *)malloc(sizeof(float) * 2 * 3);
+    float buf[2 * 3];
     for(size_t i = 0; i < points_count * 2; i += 2)
     {
       float p1 = points[i];
@@ -889,10 +914,8 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
       points[i]     = p1;
       points[i + 1] = p2;
     }
-    free(buf);
   }
 
-  delete modifier;
   return 1;
 }
 
@@ -903,23 +926,20 @@ int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
 
   if(!d->lens || !d->lens->Maker || d->crop <= 0.0f) return 0;
 
-  const float orig_w = piece->buf_in.width, orig_h = piece->buf_in.height;
   int modflags;
-  const lfModifier *modifier = get_modifier(&modflags, orig_w, orig_h, d, LF_MODIFY_ALL);
+  const lfModifier *modifier = get_point_modifier(&modflags, piece->buf_in.width, piece->buf_in.height, d);
 
   if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
   {
-    float *buf = (float *)malloc(sizeof(float) * 2 * 3);
+    float buf[2 * 3];
     for(size_t i = 0; i < points_count * 2; i += 2)
     {
       modifier->ApplySubpixelGeometryDistortion(points[i], points[i + 1], 1, 1, buf);
       points[i] = buf[0];
       points[i + 1] = buf[3];
     }
-    free(buf);
   }
 
-  delete modifier;
   return 1;
 }
 
@@ -1111,7 +1131,7 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
   dt_iop_lensfun_data_t *d = (dt_iop_lensfun_data_t *)piece->data;
 
   dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->global_data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lensfun_db(gd);
   const lfCamera *camera = NULL;
   const lfCamera **cam = NULL;
 
@@ -1122,6 +1142,9 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
   }
   d->lens = new lfLens;
 
+  delete d->point_modifier;
+  d->point_modifier = NULL;
+
   if(p->camera[0])
   {
     dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
@@ -1213,24 +1236,14 @@ void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev
     delete d->lens;
     d->lens = NULL;
   }
+  delete d->point_modifier;
   free(piece->data);
   piece->data = NULL;
 }
 
-void init_global(dt_iop_module_so_t *module)
+static lfDatabase *_lensfun_db_load()
 {
-  const int program = 2; // basic.cl, from programs.conf
-  dt_iop_lensfun_global_data_t *gd
-      = (dt_iop_lensfun_global_data_t *)calloc(1, sizeof(dt_iop_lensfun_global_data_t));
-  module->data = gd;
-  gd->kernel_lens_distort_bilinear = dt_opencl_create_kernel(program, "lens_distort_bilinear");
-  gd->kernel_lens_distort_bicubic = dt_opencl_create_kernel(program, "lens_distort_bicubic");
-  gd->kernel_lens_distort_lanczos2 = dt_opencl_create_kernel(program, "lens_distort_lanczos2");
-  gd->kernel_lens_distort_lanczos3 = dt_opencl_create_kernel(program, "lens_distort_lanczos3");
-  gd->kernel_lens_vignette = dt_opencl_create_kernel(program, "lens_vignette");
-
   lfDatabase *dt_iop_lensfun_db = new lfDatabase;
-  gd->db = (lfDatabase *)dt_iop_lensfun_db;
 
 #if defined(__MACH__) || defined(__APPLE__)
 #else
@@ -1279,6 +1292,39 @@ void init_global(dt_iop_module_so_t *module)
 #endif
     g_free(path);
   }
+
+  return dt_iop_lensfun_db;
+}
+
+static lfDatabase *_lensfun_db(dt_iop_lensfun_global_data_t *gd)
+{
+  dt_pthread_mutex_lock(&gd->db_lock);
+  if(!gd->db)
+  {
+    dt_times_t start;
+    dt_get_times(&start);
+    gd->db = _lensfun_db_load();
+    dt_show_times(&start, "[iop_lens] loading lensfun database");
+  }
+  dt_pthread_mutex_unlock(&gd->db_lock);
+  return gd->db;
+}
+
+void init_global(dt_iop_module_so_t *module)
+{
+  const int program = 2; // basic.cl, from programs.conf
+  dt_iop_lensfun_global_data_t *gd
+      = (dt_iop_lensfun_global_data_t *)calloc(1, sizeof(dt_iop_lensfun_global_data_t));
+  module->data = gd;
+  gd->kernel_lens_distort_bilinear = dt_opencl_create_kernel(program, "lens_distort_bilinear");
+  gd->kernel_lens_distort_bicubic = dt_opencl_create_kernel(program, "lens_distort_bicubic");
+  gd->kernel_lens_distort_lanczos2 = dt_opencl_create_kernel(program, "lens_distort_lanczos2");
+  gd->kernel_lens_distort_lanczos3 = dt_opencl_create_kernel(program, "lens_distort_lanczos3");
+  gd->kernel_lens_vignette = dt_opencl_create_kernel(program, "lens_vignette");
+
+  // parsing the lensfun xml files takes a while, postpone it until a lens is looked up
+  gd->db = NULL;
+  dt_pthread_mutex_init(&gd->db_lock, NULL);
 }
 
 static float get_autoscale(dt_iop_module_t *self, dt_iop_lensfun_params_t *p, const lfCamera *camera);
@@ -1318,16 +1364,17 @@ void reload_defaults(dt_iop_module_t *module)
   {
     dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)module->global_data;
 
-    // just to be sure
-    if(!gd || !gd->db) return;
+    // just to be sure, without gui the global data only gets set up once the module is used in a pipe
+    lfDatabase *db = gd ? _lensfun_db(gd) : NULL;
+    if(!db) return;
 
     dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
-    const lfCamera **cam = gd->db->FindCamerasExt(img->exif_maker, img->exif_model, 0);
+    const lfCamera **cam = db->FindCamerasExt(img->exif_maker, img->exif_model, 0);
     dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
     if(cam)
     {
       dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
-      const lfLens **lens = gd->db->FindLenses(cam[0], NULL, d->lens, 0);
+      const lfLens **lens = db->FindLenses(cam[0], NULL, d->lens, 0);
       dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
 
       if(!lens && islower(cam[0]->Mount[0]))
@@ -1342,7 +1389,7 @@ void reload_defaults(dt_iop_module_t *module)
         g_strlcpy(d->lens, "", sizeof(d->lens));
 
         dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
-        lens = gd->db->FindLenses(cam[0], NULL, d->lens, 0);
+        lens = db->FindLenses(cam[0], NULL, d->lens, 0);
         dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
       }
 
@@ -1400,8 +1447,8 @@ void reload_defaults(dt_iop_module_t *module)
 void cleanup_global(dt_iop_module_so_t *module)
 {
   dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)module->data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
-  delete dt_iop_lensfun_db;
+  delete gd->db;
+  dt_pthread_mutex_destroy(&gd->db_lock);
 
   dt_opencl_free_kernel(gd->kernel_lens_distort_bilinear);
   dt_opencl_free_kernel(gd->kernel_lens_distort_bicubic);
@@ -1648,7 +1695,7 @@ static void camera_menusearch_clicked(GtkWidget *button, gpointer user_data)
 {
   dt_iop_module_t *self = (dt_iop_module_t *)user_data;
   dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->global_data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lensfun_db(gd);
   dt_iop_lensfun_gui_data_t *g = (dt_iop_lensfun_gui_data_t *)self->gui_data;
 
   (void)button;
@@ -1671,7 +1718,7 @@ static void camera_autosearch_clicked(GtkWidget *button, gpointer user_data)
 {
   dt_iop_module_t *self = (dt_iop_module_t *)user_data;
   dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->global_data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lensfun_db(gd);
   dt_iop_lensfun_gui_data_t *g = (dt_iop_lensfun_gui_data_t *)self->gui_data;
   char make[200], model[200];
   const gchar *txt = (const gchar *)((dt_iop_lensfun_params_t *)self->default_params)->camera;
@@ -2011,7 +2058,7 @@ static void lens_menusearch_clicked(GtkWidget *button, gpointer user_data)
 {
   dt_iop_module_t *self = (dt_iop_module_t *)user_data;
   dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->global_data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lensfun_db(gd);
   dt_iop_lensfun_gui_data_t *g = (dt_iop_lensfun_gui_data_t *)self->gui_data;
   const lfLens **lenslist;
 
@@ -2035,7 +2082,7 @@ static void lens_autosearch_clicked(GtkWidget *button, gpointer user_data)
 {
   dt_iop_module_t *self = (dt_iop_module_t *)user_data;
   dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->global_data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lensfun_db(gd);
   dt_iop_lensfun_gui_data_t *g = (dt_iop_lensfun_gui_data_t *)self->gui_data;
   const lfLens **lenslist;
   char model[200];
@@ -2108,7 +2155,7 @@ void gui_changed(dt_iop_module_t *self, GtkWidget *w, void *previous)
 static float get_autoscale(dt_iop_module_t *self, dt_iop_lensfun_params_t *p, const lfCamera *camera)
 {
   dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->global_data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lensfun_db(gd);
   float scale = 1.0;
   if(p->lens[0] != '\0')
   {
@@ -2412,7 +2459,7 @@ void gui_update(struct dt_iop_module_t *self)
   }
 
   dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->global_data;
-  lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
+  lfDatabase *dt_iop_lensfun_db = _lensfun_db(gd);
   // these are the wrong (untranslated) strings in general but that's ok, they will be overwritten further
   // down
   gtk_label_set_text(GTK_LABEL(gtk_bin_get_child(GTK_BIN(g->camera_model))), p->camera);
@@ -374,6 +374,7 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   const int width = roi_in->width;
   const int height = roi_in->height;
   const int ch = piece->colors;
+  const size_t bufsize = sizeof(float) * ch * width * height;
 
   const float radius = fmax(0.1f, data->radius);
   const float sigma = radius * roi_in->scale / piece->iscale;
@@ -391,10 +392,17 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
 
   if(data->lowpass_algo == LOWPASS_ALGO_GAUSSIAN)
   {
-    dt_gaussian_t *g = dt_gaussian_init(width, height, ch, Labmax, Labmin, sigma, order);
-    if(!g) return;
-    dt_gaussian_blur_4c(g, in, out);
-    dt_gaussian_free(g);
+    // the blur only depends on the input and these, moving the other sliders reuses it
+    const float params[] = { sigma, order, unbound };
+    const uint64_t hash = dt_dev_pixelpipe_cache_filter_hash(piece, roi_in, "gaussian", params, sizeof(params));
+    if(!dt_dev_pixelpipe_cache_filter_get(&piece->pipe->cache, hash, out, bufsize))
+    {
+      dt_gaussian_t *g = dt_gaussian_init(width, height, ch, Labmax, Labmin, sigma, order);
+      if(!g) return;
+      dt_gaussian_blur_4c(g, in, out);
+      dt_gaussian_free(g);
+      dt_dev_pixelpipe_cache_filter_put(&piece->pipe->cache, hash, out, bufsize);
+    }
   }
   else
   {
@@ -402,12 +410,18 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
     const float sigma_s = sigma;
     const float detail = -1.0f; // we want the bilateral base layer
 
-    dt_bilateral_t *b = dt_bilateral_init(width, height, sigma_s, sigma_r);
-    if(!b) return;
-    dt_bilateral_splat(b, in);
-    dt_bilateral_blur(b);
-    dt_bilateral_slice(b, in, out, detail);
-    dt_bilateral_free(b);
+    const float params[] = { sigma_s, sigma_r, detail };
+    const uint64_t hash = dt_dev_pixelpipe_cache_filter_hash(piece, roi_in, "bilateral", params, sizeof(params));
+    if(!dt_dev_pixelpipe_cache_filter_get(&piece->pipe->cache, hash, out, bufsize))
+    {
+      dt_bilateral_t *b = dt_bilateral_init(width, height, sigma_s, sigma_r);
+      if(!b) return;
+      dt_bilateral_splat(b, in);
+      dt_bilateral_blur(b);
+      dt_bilateral_slice(b, in, out, detail);
+      dt_bilateral_free(b);
+      dt_dev_pixelpipe_cache_filter_put(&piece->pipe->cache, hash, out, bufsize);
+    }
   }
 
   // some aliased pointers for compilers that don't yet understand operators on __m128
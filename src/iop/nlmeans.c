@@ -450,7 +450,8 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
 void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
                   void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
-  process_cpu(piece,ivoid,ovoid,roi_in,roi_out,nlmeans_denoise_sse2);
+  // picks the AVX2 variant when the cpu has it
+  process_cpu(piece,ivoid,ovoid,roi_in,roi_out,dt_nlmeans_denoise_selected());
   return;
 }
 #endif
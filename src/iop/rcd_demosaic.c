@@ -46,14 +46,17 @@
  #define RCD_TILESIZE 140
 #endif
 
-// Make sure we use -Ofast only in the rcd code section
+// Make sure we use -Ofast only in the rcd code section.
+// Reassociation and fma contraction differ between the sse and avx2 vectorization of the same loops, which
+// changed the avx2 output by up to 8e-6. Without them all variants give bit-identical results.
 #ifdef __GNUC__
   #pragma GCC push_options
-  #pragma GCC optimize ("-Ofast")
+  #pragma GCC optimize ("-Ofast", "fp-contract=off", "no-unsafe-math-optimizations")
 #endif
 
 #ifdef __GNUC__
-#define INLINE __inline
+// always inline, the helpers have to be compiled into the avx2 tile loop, too
+#define INLINE __inline __attribute__((always_inline))
 #else
 #define INLINE inline
 #endif
@@ -294,45 +297,314 @@ static void rcd_border_interpolate(float *out, const float *cfa, const int *cfar
   }
 }
 
-#ifdef _OPENMP
-  #pragma omp declare simd aligned(in, out)
-#endif
-static void rcd_demosaic(dt_dev_pixelpipe_iop_t *piece, float *const restrict out, const float *const restrict in, dt_iop_roi_t *const roi_out,
-                                   const dt_iop_roi_t *const roi_in, const uint32_t filters)
+// one tile of the demosaic, inlined into the plain and the avx2 tile loops below so that each of them gets
+// compiled (and auto-vectorized) for its own instruction set.
+static INLINE void rcd_tile(float *const restrict out, const float *const restrict in, const int width,
+                            const int height, const int *const cfarray, const float scaler, const float revscaler,
+                            const int tile_vertical, const int tile_horizontal, float *const restrict VH_Dir,
+                            float *const restrict PQ_Dir, float *const restrict cfa,
+                            float (*const restrict rgb)[RCD_TILESIZE * RCD_TILESIZE])
 {
-  const int width = roi_in->width;
-  const int height = roi_in->height;
+  // No overlapping use so re-use same buffer; also note we use divide-by-2 index for lower mem pressure
+  // this divide-by-2 also allows slightly faster sse2 specific code.
+  float *const lpf = PQ_Dir;
 
-  if((width < 16) || (height < 16))
+  const int rowStart = tile_vertical * RCD_TILEVALID;
+  const int rowEnd = MIN(rowStart + RCD_TILESIZE, height);
+
+  const int colStart = tile_horizontal * RCD_TILEVALID;
+  const int colEnd = MIN(colStart + RCD_TILESIZE, width);
+
+  const int tileRows = MIN(rowEnd - rowStart, RCD_TILESIZE);
+  const int tileCols = MIN(colEnd - colStart, RCD_TILESIZE);
+
+  // Step 0: fill data and make sure data are not negative.
+  for(int row = rowStart; row < rowEnd; row++)
   {
-    dt_control_log(_("[rcd_demosaic] too small area"));
-    return;
+    
+    int indx = (row - rowStart) * RCD_TILESIZE;
+    int in_indx = (row * width + colStart);
+    const int c0 = FCRCD(row, colStart);
+    const int c1 = FCRCD(row, colStart + 1);
+    int col = colStart;
+
+    for(; col < colEnd - 1; col+=2, indx+=2, in_indx+=2)
+    {
+      cfa[indx]   = rgb[c0][indx]   = safe_in(in[in_indx], revscaler);
+      cfa[indx+1] = rgb[c1][indx+1] = safe_in(in[in_indx+1], revscaler);
+    }
+    if(col < colEnd)
+    {
+      cfa[indx]   = rgb[c0][indx]   = safe_in(in[indx], revscaler);
+    }
   }
 
-  const float scaler = fmaxf(piece->pipe->dsc.processed_maximum[0], fmaxf(piece->pipe->dsc.processed_maximum[1], piece->pipe->dsc.processed_maximum[2]));
-  const float revscaler = 1.0f / scaler;
+  // STEP 1: Find vertical and horizontal interpolation directions
+  // Step 1.1: Calculate vertical and horizontal local discrimination
+  for(int row = 4; row < tileRows - 4; row++)
+  {
+    for(int col = 4, indx = row * RCD_TILESIZE + col; col < tileCols - 4; col++, indx++)
+    {
+      const float V_Stat = fmaxf(epssq,
+         -2.0f * (cfa[indx]) * (9.f * (cfa[indx - w1] + cfa[indx + w1] - cfa[indx - w3] - cfa[indx + w3] + 2.0f * (cfa[indx - w2] + cfa[indx + w2]) ) + cfa[indx - w4] + cfa[indx + w4] - 19.f * cfa[indx])
+        - 70.f * cfa[indx - w1] * cfa[indx + w1]
+        - 12.f * (cfa[indx - w1] * cfa[indx - w2] - cfa[indx - w1] * cfa[indx - w4] + cfa[indx + w1] * cfa[indx + w2] - cfa[indx + w1] * cfa[indx + w4] + cfa[indx - w2] * cfa[indx + w3] + cfa[indx + w2] * cfa[indx - w3])
+        + 24.f * (cfa[indx - w1] * cfa[indx + w2] + cfa[indx + w1] * cfa[indx - w2])
+        + 16.f * (cfa[indx - w1] * cfa[indx + w3] + cfa[indx + w1] * cfa[indx - w3])
+        - 6.f * (cfa[indx + w4] * (cfa[indx - w1] + cfa[indx + w3]) + cfa[indx - w4] * (cfa[indx + w1] + cfa[indx - w3]))
+        + 46.f * (cfa[indx - w1] * cfa[indx - w1] + cfa[indx + w1] * cfa[indx + w1])
+        - 38.f * (cfa[indx + w1] * cfa[indx + w3] + cfa[indx - w1] * cfa[indx - w3])
+        + 14.f * cfa[indx - w2] * cfa[indx + w2]
+        - 2.0f * ((cfa[indx - w2] - cfa[indx + w2]) * (cfa[indx - w4] - cfa[indx + w4]) - cfa[indx - w3] * cfa[indx + w3])
+        + 11.f * (cfa[indx - w2] * cfa[indx - w2] + cfa[indx + w2] * cfa[indx + w2])
+        + 10.f * (cfa[indx - w3] * cfa[indx - w3] + cfa[indx + w3] * cfa[indx + w3])
+        + cfa[indx - w4] * cfa[indx - w4]
+        + cfa[indx + w4] * cfa[indx + w4]
+        );
+
+      const float cfai = cfa[indx];
+      const float H_Stat = fmaxf(epssq,
+          -18.f * cfai * (cfa[indx -  1] + cfa[indx +  1] + 2.0f * (cfa[indx -  2] + cfa[indx +  2]) - cfa[indx -  3] - cfa[indx +  3])
+          - 2.0f * cfai * (cfa[indx -  4] + cfa[indx +  4] - 19.f * cfai)
+          - cfa[indx -  1] * (70.f * cfa[indx +  1] + 12.f * (cfa[indx -  2] - cfa[indx -  4] - 2.0f * cfa[indx +  2]) + 38.f * cfa[indx -  3] - 16.f * cfa[indx +  3] + 6.f * cfa[indx +  4] - 46.f * cfa[indx -  1])
+          + cfa[indx +  1] * (24.f * cfa[indx -  2] + 12.f * (cfa[indx +  4] - cfa[indx +  2]) + 16.f * cfa[indx -  3] - 38.f * cfa[indx +  3] -  6.f * cfa[indx -  4] + 46.f * cfa[indx +  1])
+          + cfa[indx -  2] * (14.f * cfa[indx +  2] - 12.f * cfa[indx +  3] - 2.0f * cfa[indx -  4] + 2.0f * cfa[indx +  4] + 11.f * cfa[indx -  2])
+          + cfa[indx +  2] * (-12.f * cfa[indx -  3] + 2.0f * (cfa[indx -  4] - cfa[indx +  4]) + 11.f * cfa[indx +  2])
+          + cfa[indx -  3] * (2.0f * cfa[indx +  3] - 6.f * cfa[indx -  4] + 10.f * cfa[indx -  3])
+          + cfa[indx +  3] * (-6.f * cfa[indx +  4] + 10.f * cfa[indx +  3])
+          + cfa[indx -  4] * cfa[indx -  4]
+          + cfa[indx +  4] * cfa[indx +  4]);
+      VH_Dir[indx] = V_Stat / (V_Stat + H_Stat);
+    }
+  }
 
-  const int cfarray[4] = {FC(roi_in->y, roi_in->x, filters), FC(roi_in->y, roi_in->x + 1, filters), FC(roi_in->y + 1, roi_in->x, filters), FC(roi_in->y + 1, roi_in->x + 1, filters)};
+  // STEP 2: Calculate the low pass filter
+  // Step 2.1: Low pass filter incorporating green, red and blue local samples from the raw data
+  // as an index>>1 access breaks proper vectorizing we use an extra index for the lpf results
+  for(int row = 2; row < tileRows - 2; row++)
+  {
+    for(int col = 2 + (FCRCD(row, 0) & 1), indx = row * RCD_TILESIZE + col, lp_indx = indx / 2; col < tileCols - 2; col += 2, indx +=2, lp_indx++)
+    {
+      lpf[lp_indx] = 0.25f * cfa[indx]
+                  + 0.125f * (cfa[indx - w1] + cfa[indx + w1] + cfa[indx - 1] + cfa[indx + 1])
+                 + 0.0625f * (cfa[indx - w1 - 1] + cfa[indx - w1 + 1] + cfa[indx + w1 - 1] + cfa[indx + w1 + 1]);
+    }
+  }
+
+  // STEP 3: Populate the green channel
+  // Step 3.1: Populate the green channel at blue and red CFA positions
+  for(int row = 4; row < tileRows - 4; row++)
+  {
+    int col = 4 + (FCRCD(row, 0) & 1);
+    int indx = row * RCD_TILESIZE + col;
+    int lp_indx = indx / 2;
+    // There has been quite some performance testing for the generic vs. SSE2 optimized loop, as the generated generic code (-O3)
+    // is not as fast as Ingos optmized code (~4% loss) we keep the SSE2 specific path.
+#ifdef __SSE2__
+    const vfloat zd5v = F2V(0.5f);
+    const vfloat zd25v = F2V(0.25f);
+    const vfloat epsv = F2V(eps);
+    for (; col < tileCols - 7; col += 8, indx += 8, lp_indx +=4)
+    {
+      // Cardinal gradients
+      const vfloat cfai = LC2VFU(&cfa[indx]);
+      const vfloat N_Grad = epsv + (vabsf(LC2VFU(&cfa[indx - w1]) - LC2VFU(&cfa[indx + w1])) + vabsf(cfai - LC2VFU(&cfa[indx - w2]))) + (vabsf(LC2VFU(&cfa[indx - w1]) - LC2VFU(&cfa[indx - w3])) + vabsf(LC2VFU(&cfa[indx - w2]) - LC2VFU(&cfa[indx - w4])));
+      const vfloat S_Grad = epsv + (vabsf(LC2VFU(&cfa[indx - w1]) - LC2VFU(&cfa[indx + w1])) + vabsf(cfai - LC2VFU(&cfa[indx + w2]))) + (vabsf(LC2VFU(&cfa[indx + w1]) - LC2VFU(&cfa[indx + w3])) + vabsf(LC2VFU(&cfa[indx + w2]) - LC2VFU(&cfa[indx + w4])));
+      const vfloat W_Grad = epsv + (vabsf(LC2VFU(&cfa[indx -  1]) - LC2VFU(&cfa[indx +  1])) + vabsf(cfai - LC2VFU(&cfa[indx -  2]))) + (vabsf(LC2VFU(&cfa[indx -  1]) - LC2VFU(&cfa[indx -  3])) + vabsf(LC2VFU(&cfa[indx -  2]) - LC2VFU(&cfa[indx -  4])));
+      const vfloat E_Grad = epsv + (vabsf(LC2VFU(&cfa[indx +  1]) - LC2VFU(&cfa[indx -  1])) + vabsf(cfai - LC2VFU(&cfa[indx +  2]))) + (vabsf(LC2VFU(&cfa[indx +  1]) - LC2VFU(&cfa[indx +  3])) + vabsf(LC2VFU(&cfa[indx +  2]) - LC2VFU(&cfa[indx +  4])));
+
+      // Cardinal pixel estimations
+      const vfloat lpfi = LVFU(lpf[lp_indx]);
+      const vfloat N_Est = LC2VFU(&cfa[indx - w1]) + (LC2VFU(&cfa[indx - w1]) * (lpfi - LVFU(lpf[lp_indx - w1])) / (epsv + lpfi + LVFU(lpf[lp_indx - w1])));
+      const vfloat S_Est = LC2VFU(&cfa[indx + w1]) + (LC2VFU(&cfa[indx + w1]) * (lpfi - LVFU(lpf[lp_indx + w1])) / (epsv + lpfi + LVFU(lpf[lp_indx + w1])));
+      const vfloat W_Est = LC2VFU(&cfa[indx -  1]) + (LC2VFU(&cfa[indx -  1]) * (lpfi - LVFU(lpf[lp_indx -  1])) / (epsv + lpfi + LVFU(lpf[lp_indx -  1])));
+      const vfloat E_Est = LC2VFU(&cfa[indx +  1]) + (LC2VFU(&cfa[indx +  1]) * (lpfi - LVFU(lpf[lp_indx +  1])) / (epsv + lpfi + LVFU(lpf[lp_indx +  1])));
+
+      // Vertical and horizontal estimations
+      const vfloat V_Est = (S_Grad * N_Est + N_Grad * S_Est) / (N_Grad + S_Grad);
+      const vfloat H_Est = (W_Grad * E_Est + E_Grad * W_Est) / (E_Grad + W_Grad);
+
+      // G@B and G@R interpolation
+      // Refined vertical and horizontal local discrimination
+      const vfloat VH_Central_Value = LC2VFU(&VH_Dir[indx]);
+      const vfloat VH_Neighbourhood_Value = zd25v * ((LC2VFU(&VH_Dir[indx - w1 - 1]) + LC2VFU(&VH_Dir[indx - w1 + 1])) + (LC2VFU(&VH_Dir[indx + w1 - 1]) + LC2VFU(&VH_Dir[indx + w1 + 1])));
+
+      const vfloat VH_Disc = vself(vmaskf_lt(vabsf(zd5v - VH_Central_Value), vabsf(zd5v - VH_Neighbourhood_Value)), VH_Neighbourhood_Value, VH_Central_Value);
+      const vfloat result = vintpf(VH_Disc, H_Est, V_Est);
+      STC2VFU(rgb[1][indx], result);
+    }
+#endif
+    for(; col < tileCols - 4; col += 2, indx +=2, lp_indx++)
+    {
+      const float cfai = cfa[indx];
+
+      // Cardinal gradients
+      const float N_Grad = eps + fabs(cfa[indx - w1] - cfa[indx + w1]) + fabs(cfai - cfa[indx - w2]) + fabs(cfa[indx - w1] - cfa[indx - w3]) + fabs(cfa[indx - w2] - cfa[indx - w4]);
+      const float S_Grad = eps + fabs(cfa[indx - w1] - cfa[indx + w1]) + fabs(cfai - cfa[indx + w2]) + fabs(cfa[indx + w1] - cfa[indx + w3]) + fabs(cfa[indx + w2] - cfa[indx + w4]);
+      const float W_Grad = eps + fabs(cfa[indx -  1] - cfa[indx +  1]) + fabs(cfai - cfa[indx -  2]) + fabs(cfa[indx -  1] - cfa[indx -  3]) + fabs(cfa[indx -  2] - cfa[indx -  4]);
+      const float E_Grad = eps + fabs(cfa[indx +  1] - cfa[indx -  1]) + fabs(cfai - cfa[indx +  2]) + fabs(cfa[indx +  1] - cfa[indx +  3]) + fabs(cfa[indx +  2] - cfa[indx +  4]);
+
+      const float lpfi = lpf[lp_indx];
+      // Cardinal pixel estimations
+      const float N_Est = cfa[indx - w1] + (cfa[indx - w1] * (lpfi - lpf[lp_indx - w1]) / (eps + lpfi + lpf[lp_indx - w1]));
+      const float S_Est = cfa[indx + w1] + (cfa[indx + w1] * (lpfi - lpf[lp_indx + w1]) / (eps + lpfi + lpf[lp_indx + w1]));
+      const float W_Est = cfa[indx -  1] + (cfa[indx -  1] * (lpfi - lpf[lp_indx -  1]) / (eps + lpfi + lpf[lp_indx -  1]));
+      const float E_Est = cfa[indx +  1] + (cfa[indx +  1] * (lpfi - lpf[lp_indx +  1]) / (eps + lpfi + lpf[lp_indx +  1]));
+
+      // Vertical and horizontal estimations
+      const float V_Est = (S_Grad * N_Est + N_Grad * S_Est) / (N_Grad + S_Grad);
+      const float H_Est = (W_Grad * E_Est + E_Grad * W_Est) / (E_Grad + W_Grad);
+
+      // G@B and G@R interpolation
+      // Refined vertical and horizontal local discrimination
+      const float VH_Central_Value = VH_Dir[indx];
+      const float VH_Neighbourhood_Value = 0.25f * (VH_Dir[indx - w1 - 1] + VH_Dir[indx - w1 + 1] + VH_Dir[indx + w1 - 1] + VH_Dir[indx + w1 + 1]);
+      const float VH_Disc = (fabs(0.5f - VH_Central_Value) < fabs(0.5f - VH_Neighbourhood_Value)) ? VH_Neighbourhood_Value : VH_Central_Value;
+
+      rgb[1][indx] = intp(VH_Disc, H_Est, V_Est);
+    }
+  }
 
+  // STEP 4: Populate the red and blue channels
+  // Step 4.1: Calculate P/Q diagonal local discrimination
+  for(int row = 4; row < tileRows - 4; row++)
+  {
+    for(int col = 4 + (FCRCD(row, 0) & 1), indx = row * RCD_TILESIZE + col, pqindx = indx / 2; col < tileCols - 4; col += 2, indx += 2, pqindx++)
+    {
+      const float cfai = cfa[indx];
+
+      float P_Stat = fmaxf(epssq, - 18.f * cfai * (cfa[indx - w1 - 1] + cfa[indx + w1 + 1] + 2.f * (cfa[indx - w2 - 2] + cfa[indx + w2 + 2]) - cfa[indx - w3 - 3] - cfa[indx + w3 + 3]) - 2.f * cfai * (cfa[indx - w4 - 4] + cfa[indx + w4 + 4] - 19.f * cfai) - cfa[indx - w1 - 1] * (70.f * cfa[indx + w1 + 1] - 12.f * cfa[indx - w2 - 2] + 24.f * cfa[indx + w2 + 2] - 38.f * cfa[indx - w3 - 3] + 16.f * cfa[indx + w3 + 3] + 12.f * cfa[indx - w4 - 4] - 6.f * cfa[indx + w4 + 4] + 46.f * cfa[indx - w1 - 1]) + cfa[indx + w1 + 1] * (24.f * cfa[indx - w2 - 2] - 12.f * cfa[indx + w2 + 2] + 16.f * cfa[indx - w3 - 3] - 38.f * cfa[indx + w3 + 3] - 6.f * cfa[indx - w4 - 4] + 12.f * cfa[indx + w4 + 4] + 46.f * cfa[indx + w1 + 1]) + cfa[indx - w2 - 2] * (14.f * cfa[indx + w2 + 2] - 12.f * cfa[indx + w3 + 3] - 2.f * (cfa[indx - w4 - 4] - cfa[indx + w4 + 4]) + 11.f * cfa[indx - w2 - 2]) - cfa[indx + w2 + 2] * (12.f * cfa[indx - w3 - 3] + 2.f * (cfa[indx - w4 - 4] - cfa[indx + w4 + 4]) + 11.f * cfa[indx + w2 + 2]) + cfa[indx - w3 - 3] * (2.f * cfa[indx + w3 + 3] - 6.f * cfa[indx - w4 - 4] + 10.f * cfa[indx - w3 - 3]) - cfa[indx + w3 + 3] * (6.f * cfa[indx + w4 + 4] + 10.f * cfa[indx + w3 + 3]) + cfa[indx - w4 - 4] * cfa[indx - w4 - 4] + cfa[indx + w4 + 4] * cfa[indx + w4 + 4]);
+      float Q_Stat = fmaxf(epssq, - 18.f * cfai * (cfa[indx + w1 - 1] + cfa[indx - w1 + 1] + 2.f * (cfa[indx + w2 - 2] + cfa[indx - w2 + 2]) - cfa[indx + w3 - 3] - cfa[indx - w3 + 3]) - 2.f * cfai * (cfa[indx + w4 - 4] + cfa[indx - w4 + 4] - 19.f * cfai) - cfa[indx + w1 - 1] * (70.f * cfa[indx - w1 + 1] - 12.f * cfa[indx + w2 - 2] + 24.f * cfa[indx - w2 + 2] - 38.f * cfa[indx + w3 - 3] + 16.f * cfa[indx - w3 + 3] + 12.f * cfa[indx + w4 - 4] - 6.f * cfa[indx - w4 + 4] + 46.f * cfa[indx + w1 - 1]) + cfa[indx - w1 + 1] * (24.f * cfa[indx + w2 - 2] - 12.f * cfa[indx - w2 + 2] + 16.f * cfa[indx + w3 - 3] - 38.f * cfa[indx - w3 + 3] - 6.f * cfa[indx + w4 - 4] + 12.f * cfa[indx - w4 + 4] + 46.f * cfa[indx - w1 + 1]) + cfa[indx + w2 - 2] * (14.f * cfa[indx - w2 + 2] - 12.f * cfa[indx - w3 + 3] - 2.f * (cfa[indx + w4 - 4] - cfa[indx - w4 + 4]) + 11.f * cfa[indx + w2 - 2]) - cfa[indx - w2 + 2] * (12.f * cfa[indx + w3 - 3] + 2.f * (cfa[indx + w4 - 4] - cfa[indx - w4 + 4]) + 11.f * cfa[indx - w2 + 2]) + cfa[indx + w3 - 3] * (2.f * cfa[indx - w3 + 3] - 6.f * cfa[indx + w4 - 4] + 10.f * cfa[indx + w3 - 3]) - cfa[indx - w3 + 3] * (6.f * cfa[indx - w4 + 4] + 10.f * cfa[indx - w3 + 3]) + cfa[indx + w4 - 4] * cfa[indx + w4 - 4] + cfa[indx - w4 + 4] * cfa[indx - w4 + 4]);
+
+      PQ_Dir[pqindx] = P_Stat / (P_Stat + Q_Stat);
+    }
+  }
+
+  // Step 4.2: Populate the red and blue channels at blue and red CFA positions
+  for(int row = 4; row < tileRows - 4; row++)
+  {
+    for(int col = 4 + (FCRCD(row, 0) & 1), indx = row * RCD_TILESIZE + col, c = 2 - FCRCD(row, col), pqindx = indx / 2, pqindx2 = (indx - w1 - 1) / 2, pqindx3 = (indx + w1 - 1) / 2; col < tileCols - 4; col += 2, indx += 2, pqindx++, pqindx2++, pqindx3++)
+    {
+      // Refined P/Q diagonal local discrimination
+      float PQ_Central_Value   = PQ_Dir[pqindx];
+      float PQ_Neighbourhood_Value = 0.25f * (PQ_Dir[pqindx2] + PQ_Dir[pqindx2 + 1] + PQ_Dir[pqindx3] + PQ_Dir[pqindx3 + 1]);
+
+      float PQ_Disc = (fabs(0.5f - PQ_Central_Value) < fabs(0.5f - PQ_Neighbourhood_Value)) ? PQ_Neighbourhood_Value : PQ_Central_Value;
+
+      // Diagonal gradients
+      float NW_Grad = eps + fabs(rgb[c][indx - w1 - 1] - rgb[c][indx + w1 + 1]) + fabs(rgb[c][indx - w1 - 1] - rgb[c][indx - w3 - 3]) + fabs(rgb[1][indx] - rgb[1][indx - w2 - 2]);
+      float NE_Grad = eps + fabs(rgb[c][indx - w1 + 1] - rgb[c][indx + w1 - 1]) + fabs(rgb[c][indx - w1 + 1] - rgb[c][indx - w3 + 3]) + fabs(rgb[1][indx] - rgb[1][indx - w2 + 2]);
+      float SW_Grad = eps + fabs(rgb[c][indx - w1 + 1] - rgb[c][indx + w1 - 1]) + fabs(rgb[c][indx + w1 - 1] - rgb[c][indx + w3 - 3]) + fabs(rgb[1][indx] - rgb[1][indx + w2 - 2]);
+      float SE_Grad = eps + fabs(rgb[c][indx - w1 - 1] - rgb[c][indx + w1 + 1]) + fabs(rgb[c][indx + w1 + 1] - rgb[c][indx + w3 + 3]) + fabs(rgb[1][indx] - rgb[1][indx + w2 + 2]);
+
+      // Diagonal colour differences
+      float NW_Est = rgb[c][indx - w1 - 1] - rgb[1][indx - w1 - 1];
+      float NE_Est = rgb[c][indx - w1 + 1] - rgb[1][indx - w1 + 1];
+      float SW_Est = rgb[c][indx + w1 - 1] - rgb[1][indx + w1 - 1];
+      float SE_Est = rgb[c][indx + w1 + 1] - rgb[1][indx + w1 + 1];
+
+      // P/Q estimations
+      float P_Est = (NW_Grad * SE_Est + SE_Grad * NW_Est) / (NW_Grad + SE_Grad);
+      float Q_Est = (NE_Grad * SW_Est + SW_Grad * NE_Est) / (NE_Grad + SW_Grad);
+
+      // R@B and B@R interpolation
+      rgb[c][indx] = rgb[1][indx] + intp(PQ_Disc, Q_Est, P_Est);
+    }
+  }
+
+  // Step 4.3: Populate the red and blue channels at green CFA positions
+  for(int row = 4; row < tileRows - 4; row++)
+  {
+    for(int col = 4 + (FCRCD(row, 1) & 1), indx = row * RCD_TILESIZE + col; col < tileCols - 4; col += 2, indx +=2)
+    {
+      // Refined vertical and horizontal local discrimination
+      const float VH_Central_Value = VH_Dir[indx];
+      const float VH_Neighbourhood_Value = 0.25f * (VH_Dir[indx - w1 - 1] + VH_Dir[indx - w1 + 1] + VH_Dir[indx + w1 - 1] + VH_Dir[indx + w1 + 1]);
+      const float VH_Disc = (fabs(0.5f - VH_Central_Value) < fabs(0.5f - VH_Neighbourhood_Value) ) ? VH_Neighbourhood_Value : VH_Central_Value;
+      const float rgb1 = rgb[1][indx];
+      const float N1 = eps + fabs(rgb1 - rgb[1][indx - w2]);
+      const float S1 = eps + fabs(rgb1 - rgb[1][indx + w2]);
+      const float W1 = eps + fabs(rgb1 - rgb[1][indx -  2]);
+      const float E1 = eps + fabs(rgb1 - rgb[1][indx +  2]);
+
+      const float rgb1mw1 = rgb[1][indx - w1];
+      const float rgb1pw1 = rgb[1][indx + w1];
+      const float rgb1m1 =  rgb[1][indx - 1];
+      const float rgb1p1 =  rgb[1][indx + 1];
+
+      for(int c = 0; c <= 2; c += 2)
+      {
+        const float rgbc_mw1 = rgb[c][indx - w1];
+        const float rgbc_pw1 = rgb[c][indx + w1];
+        const float rgbc_m1  = rgb[c][indx -  1];
+        const float rgbc_p1  = rgb[c][indx +  1];
+
+        // Cardinal gradients
+        const float N_Grad = N1 + fabs(rgbc_mw1 - rgbc_pw1) + fabs(rgbc_mw1 - rgb[c][indx - w3]);
+        const float S_Grad = S1 + fabs(rgbc_pw1 - rgbc_mw1) + fabs(rgbc_pw1 - rgb[c][indx + w3]);
+        const float W_Grad = W1 + fabs(rgbc_m1 - rgbc_p1) + fabs(rgbc_m1 - rgb[c][indx -  3]);
+        const float E_Grad = E1 + fabs(rgbc_p1 - rgbc_m1) + fabs(rgbc_p1 - rgb[c][indx +  3]);
+
+        // Cardinal colour differences
+        const float N_Est = rgbc_mw1 - rgb1mw1;
+        const float S_Est = rgbc_pw1 - rgb1pw1;
+        const float W_Est = rgbc_m1 - rgb1m1;
+        const float E_Est = rgbc_p1 - rgb1p1;
+
+        // Vertical and horizontal estimations
+        const float V_Est = (N_Grad * S_Est + S_Grad * N_Est) / (N_Grad + S_Grad);
+        const float H_Est = (E_Grad * W_Est + W_Grad * E_Est) / (E_Grad + W_Grad);
+
+        // R@G and B@G interpolation
+        rgb[c][indx] = rgb1 + intp(VH_Disc, V_Est, H_Est);
+      }
+    }
+  }
+  for(int row = rowStart + RCD_BORDER; row < rowEnd - RCD_BORDER; row++)
+  {
+    int col = colStart + RCD_BORDER;
+    int o_idx = (row * width + col) * 4;
+    int idx = (row - rowStart) * RCD_TILESIZE + col - colStart;
+    for(; col < colEnd - RCD_BORDER; col++, o_idx += 4, idx++)
+    {
+      out[o_idx]   = scaler * fmaxf(0.0f, rgb[0][idx]);
+      out[o_idx+1] = scaler * fmaxf(0.0f, rgb[1][idx]);
+      out[o_idx+2] = scaler * fmaxf(0.0f, rgb[2][idx]);
+      out[o_idx+3] = 0.0f;
+    }
+  }
+}
+
+// the tile loop. it's spelled out twice as openmp outlines the parallel region before inlining, so it has to
+// be part of the function carrying the target attribute.
+#define RCD_TILE_BUFFERS_ALLOC                                                                                   \
+  float *const VH_Dir = dt_alloc_align_float((size_t)RCD_TILESIZE * RCD_TILESIZE);                             \
+  memset(VH_Dir, 0, sizeof(*VH_Dir) * RCD_TILESIZE * RCD_TILESIZE);                                            \
+  float *const PQ_Dir = dt_alloc_align_float((size_t)RCD_TILESIZE * RCD_TILESIZE / 2);                         \
+  memset(PQ_Dir, 0, sizeof(*PQ_Dir) * (RCD_TILESIZE * RCD_TILESIZE / 2));                                      \
+  float *const cfa = dt_alloc_align_float((size_t)RCD_TILESIZE * RCD_TILESIZE);                                \
+  memset(cfa, 0, sizeof(*cfa) * RCD_TILESIZE * RCD_TILESIZE);                                                  \
+  float(*const rgb)[RCD_TILESIZE * RCD_TILESIZE] = (void *)dt_alloc_align_float((size_t)3 * RCD_TILESIZE * RCD_TILESIZE);
+
+#define RCD_TILE_BUFFERS_FREE                                                                                    \
+  dt_free_align(cfa);                                                                                          \
+  dt_free_align(rgb);                                                                                          \
+  dt_free_align(VH_Dir);                                                                                       \
+  dt_free_align(PQ_Dir);
+
+static void rcd_demosaic_tiles_plain(float *const restrict out, const float *const restrict in, const int width,
+                                     const int height, const int *const cfarray, const float scaler)
+{
+  const float revscaler = 1.0f / scaler;
   const int num_vertical = 1 + (height - 2 * RCD_BORDER -1) / RCD_TILEVALID;
   const int num_horizontal = 1 + (width - 2 * RCD_BORDER -1) / RCD_TILEVALID;
 
 #ifdef _OPENMP
   #pragma omp parallel \
-  dt_omp_firstprivate(width, height, cfarray, out, in, scaler, revscaler)
+  dt_omp_firstprivate(width, height, cfarray, out, in, scaler, revscaler, num_vertical, num_horizontal)
 #endif
-  { 
-    float *const VH_Dir = dt_alloc_align_float((size_t) RCD_TILESIZE * RCD_TILESIZE);
-    memset(VH_Dir, 0, sizeof(*VH_Dir) * RCD_TILESIZE * RCD_TILESIZE);
-    float *const PQ_Dir = dt_alloc_align_float((size_t) RCD_TILESIZE * RCD_TILESIZE / 2);
-    memset(PQ_Dir, 0, sizeof(*PQ_Dir) * (RCD_TILESIZE * RCD_TILESIZE / 2));
-    float *const cfa =    dt_alloc_align_float((size_t) RCD_TILESIZE * RCD_TILESIZE);
-    memset(cfa, 0, sizeof(*cfa) * RCD_TILESIZE * RCD_TILESIZE);
-    float (*const rgb)[RCD_TILESIZE * RCD_TILESIZE] = (void *)dt_alloc_align_float((size_t)3 * RCD_TILESIZE * RCD_TILESIZE);
-
-    // No overlapping use so re-use same buffer; also note we use divide-by-2 index for lower mem pressure
-    // this divide-by-2 also allows slightly faster sse2 specific code.
-    float *const lpf = PQ_Dir;
+  {
+    RCD_TILE_BUFFERS_ALLOC
 
     // There has been a discussion about the schedule strategy, at least on the tested machines the
     // dynamic scheduling seems to be slightly faster.
@@ -340,285 +612,100 @@ static void rcd_demosaic(dt_dev_pixelpipe_iop_t *piece, float *const restrict ou
   #pragma omp for schedule(simd:dynamic, 6) collapse(2) nowait
 #endif
     for(int tile_vertical = 0; tile_vertical < num_vertical; tile_vertical++)
-    {
       for(int tile_horizontal = 0; tile_horizontal < num_horizontal; tile_horizontal++)
-      {
-        const int rowStart = tile_vertical * RCD_TILEVALID;
-        const int rowEnd = MIN(rowStart + RCD_TILESIZE, height);
-
-        const int colStart = tile_horizontal * RCD_TILEVALID;
-        const int colEnd = MIN(colStart + RCD_TILESIZE, width);
-
-        const int tileRows = MIN(rowEnd - rowStart, RCD_TILESIZE);
-        const int tileCols = MIN(colEnd - colStart, RCD_TILESIZE);
+        rcd_tile(out, in, width, height, cfarray, scaler, revscaler, tile_vertical, tile_horizontal, VH_Dir,
+                 PQ_Dir, cfa, rgb);
 
-        // Step 0: fill data and make sure data are not negative.
-        for(int row = rowStart; row < rowEnd; row++)
-        {
-          
-          int indx = (row - rowStart) * RCD_TILESIZE;
-          int in_indx = (row * width + colStart);
-          const int c0 = FCRCD(row, colStart);
-          const int c1 = FCRCD(row, colStart + 1);
-          int col = colStart;
-
-          for(; col < colEnd - 1; col+=2, indx+=2, in_indx+=2)
-          {
-            cfa[indx]   = rgb[c0][indx]   = safe_in(in[in_indx], revscaler);
-            cfa[indx+1] = rgb[c1][indx+1] = safe_in(in[in_indx+1], revscaler);
-          }
-          if(col < colEnd)
-          {
-            cfa[indx]   = rgb[c0][indx]   = safe_in(in[indx], revscaler);
-          }
-        }
+    RCD_TILE_BUFFERS_FREE
+  }
+}
 
-        // STEP 1: Find vertical and horizontal interpolation directions
-        // Step 1.1: Calculate vertical and horizontal local discrimination
-        for(int row = 4; row < tileRows - 4; row++)
-        {
-          for(int col = 4, indx = row * RCD_TILESIZE + col; col < tileCols - 4; col++, indx++)
-          {
-            const float V_Stat = fmaxf(epssq,
-               -2.0f * (cfa[indx]) * (9.f * (cfa[indx - w1] + cfa[indx + w1] - cfa[indx - w3] - cfa[indx + w3] + 2.0f * (cfa[indx - w2] + cfa[indx + w2]) ) + cfa[indx - w4] + cfa[indx + w4] - 19.f * cfa[indx])
-              - 70.f * cfa[indx - w1] * cfa[indx + w1]
-              - 12.f * (cfa[indx - w1] * cfa[indx - w2] - cfa[indx - w1] * cfa[indx - w4] + cfa[indx + w1] * cfa[indx + w2] - cfa[indx + w1] * cfa[indx + w4] + cfa[indx - w2] * cfa[indx + w3] + cfa[indx + w2] * cfa[indx - w3])
-              + 24.f * (cfa[indx - w1] * cfa[indx + w2] + cfa[indx + w1] * cfa[indx - w2])
-              + 16.f * (cfa[indx - w1] * cfa[indx + w3] + cfa[indx + w1] * cfa[indx - w3])
-              - 6.f * (cfa[indx + w4] * (cfa[indx - w1] + cfa[indx + w3]) + cfa[indx - w4] * (cfa[indx + w1] + cfa[indx - w3]))
-              + 46.f * (cfa[indx - w1] * cfa[indx - w1] + cfa[indx + w1] * cfa[indx + w1])
-              - 38.f * (cfa[indx + w1] * cfa[indx + w3] + cfa[indx - w1] * cfa[indx - w3])
-              + 14.f * cfa[indx - w2] * cfa[indx + w2]
-              - 2.0f * ((cfa[indx - w2] - cfa[indx + w2]) * (cfa[indx - w4] - cfa[indx + w4]) - cfa[indx - w3] * cfa[indx + w3])
-              + 11.f * (cfa[indx - w2] * cfa[indx - w2] + cfa[indx + w2] * cfa[indx + w2])
-              + 10.f * (cfa[indx - w3] * cfa[indx - w3] + cfa[indx + w3] * cfa[indx + w3])
-              + cfa[indx - w4] * cfa[indx - w4]
-              + cfa[indx + w4] * cfa[indx + w4]
-              );
-
-            const float cfai = cfa[indx];
-            const float H_Stat = fmaxf(epssq,
-                -18.f * cfai * (cfa[indx -  1] + cfa[indx +  1] + 2.0f * (cfa[indx -  2] + cfa[indx +  2]) - cfa[indx -  3] - cfa[indx +  3])
-                - 2.0f * cfai * (cfa[indx -  4] + cfa[indx +  4] - 19.f * cfai)
-                - cfa[indx -  1] * (70.f * cfa[indx +  1] + 12.f * (cfa[indx -  2] - cfa[indx -  4] - 2.0f * cfa[indx +  2]) + 38.f * cfa[indx -  3] - 16.f * cfa[indx +  3] + 6.f * cfa[indx +  4] - 46.f * cfa[indx -  1])
-                + cfa[indx +  1] * (24.f * cfa[indx -  2] + 12.f * (cfa[indx +  4] - cfa[indx +  2]) + 16.f * cfa[indx -  3] - 38.f * cfa[indx +  3] -  6.f * cfa[indx -  4] + 46.f * cfa[indx +  1])
-                + cfa[indx -  2] * (14.f * cfa[indx +  2] - 12.f * cfa[indx +  3] - 2.0f * cfa[indx -  4] + 2.0f * cfa[indx +  4] + 11.f * cfa[indx -  2])
-                + cfa[indx +  2] * (-12.f * cfa[indx -  3] + 2.0f * (cfa[indx -  4] - cfa[indx +  4]) + 11.f * cfa[indx +  2])
-                + cfa[indx -  3] * (2.0f * cfa[indx +  3] - 6.f * cfa[indx -  4] + 10.f * cfa[indx -  3])
-                + cfa[indx +  3] * (-6.f * cfa[indx +  4] + 10.f * cfa[indx +  3])
-                + cfa[indx -  4] * cfa[indx -  4]
-                + cfa[indx +  4] * cfa[indx +  4]);
-            VH_Dir[indx] = V_Stat / (V_Stat + H_Stat);
-          }
-        }
+#ifdef DT_HAVE_TARGET_AVX2
+static DT_TARGET_AVX2 void rcd_demosaic_tiles_avx2(float *const restrict out, const float *const restrict in,
+                                                   const int width, const int height, const int *const cfarray,
+                                                   const float scaler)
+{
+  const float revscaler = 1.0f / scaler;
+  const int num_vertical = 1 + (height - 2 * RCD_BORDER -1) / RCD_TILEVALID;
+  const int num_horizontal = 1 + (width - 2 * RCD_BORDER -1) / RCD_TILEVALID;
 
-        // STEP 2: Calculate the low pass filter
-        // Step 2.1: Low pass filter incorporating green, red and blue local samples from the raw data
-        // as an index>>1 access breaks proper vectorizing we use an extra index for the lpf results
-        for(int row = 2; row < tileRows - 2; row++)
-        {
-          for(int col = 2 + (FCRCD(row, 0) & 1), indx = row * RCD_TILESIZE + col, lp_indx = indx / 2; col < tileCols - 2; col += 2, indx +=2, lp_indx++)
-          {
-            lpf[lp_indx] = 0.25f * cfa[indx]
-                        + 0.125f * (cfa[indx - w1] + cfa[indx + w1] + cfa[indx - 1] + cfa[indx + 1])
-                       + 0.0625f * (cfa[indx - w1 - 1] + cfa[indx - w1 + 1] + cfa[indx + w1 - 1] + cfa[indx + w1 + 1]);
-          }
-        }
+#ifdef _OPENMP
+  #pragma omp parallel \
+  dt_omp_firstprivate(width, height, cfarray, out, in, scaler, revscaler, num_vertical, num_horizontal)
+#endif
+  {
+    RCD_TILE_BUFFERS_ALLOC
 
-        // STEP 3: Populate the green channel
-        // Step 3.1: Populate the green channel at blue and red CFA positions
-        for(int row = 4; row < tileRows - 4; row++)
-        {
-          int col = 4 + (FCRCD(row, 0) & 1);
-          int indx = row * RCD_TILESIZE + col;
-          int lp_indx = indx / 2;
-          // There has been quite some performance testing for the generic vs. SSE2 optimized loop, as the generated generic code (-O3)
-          // is not as fast as Ingos optmized code (~4% loss) we keep the SSE2 specific path.
-#ifdef __SSE2__
-          const vfloat zd5v = F2V(0.5f);
-          const vfloat zd25v = F2V(0.25f);
-          const vfloat epsv = F2V(eps);
-          for (; col < tileCols - 7; col += 8, indx += 8, lp_indx +=4)
-          {
-            // Cardinal gradients
-            const vfloat cfai = LC2VFU(&cfa[indx]);
-            const vfloat N_Grad = epsv + (vabsf(LC2VFU(&cfa[indx - w1]) - LC2VFU(&cfa[indx + w1])) + vabsf(cfai - LC2VFU(&cfa[indx - w2]))) + (vabsf(LC2VFU(&cfa[indx - w1]) - LC2VFU(&cfa[indx - w3])) + vabsf(LC2VFU(&cfa[indx - w2]) - LC2VFU(&cfa[indx - w4])));
-            const vfloat S_Grad = epsv + (vabsf(LC2VFU(&cfa[indx - w1]) - LC2VFU(&cfa[indx + w1])) + vabsf(cfai - LC2VFU(&cfa[indx + w2]))) + (vabsf(LC2VFU(&cfa[indx + w1]) - LC2VFU(&cfa[indx + w3])) + vabsf(LC2VFU(&cfa[indx + w2]) - LC2VFU(&cfa[indx + w4])));
-            const vfloat W_Grad = epsv + (vabsf(LC2VFU(&cfa[indx -  1]) - LC2VFU(&cfa[indx +  1])) + vabsf(cfai - LC2VFU(&cfa[indx -  2]))) + (vabsf(LC2VFU(&cfa[indx -  1]) - LC2VFU(&cfa[indx -  3])) + vabsf(LC2VFU(&cfa[indx -  2]) - LC2VFU(&cfa[indx -  4])));
-            const vfloat E_Grad = epsv + (vabsf(LC2VFU(&cfa[indx +  1]) - LC2VFU(&cfa[indx -  1])) + vabsf(cfai - LC2VFU(&cfa[indx +  2]))) + (vabsf(LC2VFU(&cfa[indx +  1]) - LC2VFU(&cfa[indx +  3])) + vabsf(LC2VFU(&cfa[indx +  2]) - LC2VFU(&cfa[indx +  4])));
-
-            // Cardinal pixel estimations
-            const vfloat lpfi = LVFU(lpf[lp_indx]);
-            const vfloat N_Est = LC2VFU(&cfa[indx - w1]) + (LC2VFU(&cfa[indx - w1]) * (lpfi - LVFU(lpf[lp_indx - w1])) / (epsv + lpfi + LVFU(lpf[lp_indx - w1])));
-            const vfloat S_Est = LC2VFU(&cfa[indx + w1]) + (LC2VFU(&cfa[indx + w1]) * (lpfi - LVFU(lpf[lp_indx + w1])) / (epsv + lpfi + LVFU(lpf[lp_indx + w1])));
-            const vfloat W_Est = LC2VFU(&cfa[indx -  1]) + (LC2VFU(&cfa[indx -  1]) * (lpfi - LVFU(lpf[lp_indx -  1])) / (epsv + lpfi + LVFU(lpf[lp_indx -  1])));
-            const vfloat E_Est = LC2VFU(&cfa[indx +  1]) + (LC2VFU(&cfa[indx +  1]) * (lpfi - LVFU(lpf[lp_indx +  1])) / (epsv + lpfi + LVFU(lpf[lp_indx +  1])));
-
-            // Vertical and horizontal estimations
-            const vfloat V_Est = (S_Grad * N_Est + N_Grad * S_Est) / (N_Grad + S_Grad);
-            const vfloat H_Est = (W_Grad * E_Est + E_Grad * W_Est) / (E_Grad + W_Grad);
-
-            // G@B and G@R interpolation
-            // Refined vertical and horizontal local discrimination
-            const vfloat VH_Central_Value = LC2VFU(&VH_Dir[indx]);
-            const vfloat VH_Neighbourhood_Value = zd25v * ((LC2VFU(&VH_Dir[indx - w1 - 1]) + LC2VFU(&VH_Dir[indx - w1 + 1])) + (LC2VFU(&VH_Dir[indx + w1 - 1]) + LC2VFU(&VH_Dir[indx + w1 + 1])));
-
-            const vfloat VH_Disc = vself(vmaskf_lt(vabsf(zd5v - VH_Central_Value), vabsf(zd5v - VH_Neighbourhood_Value)), VH_Neighbourhood_Value, VH_Central_Value);
-            const vfloat result = vintpf(VH_Disc, H_Est, V_Est);
-            STC2VFU(rgb[1][indx], result);
-          }
+#ifdef _OPENMP
+  #pragma omp for schedule(simd:dynamic, 6) collapse(2) nowait
 #endif
-          for(; col < tileCols - 4; col += 2, indx +=2, lp_indx++)
-          {
-            const float cfai = cfa[indx];
-
-            // Cardinal gradients
-            const float N_Grad = eps + fabs(cfa[indx - w1] - cfa[indx + w1]) + fabs(cfai - cfa[indx - w2]) + fabs(cfa[indx - w1] - cfa[indx - w3]) + fabs(cfa[indx - w2] - cfa[indx - w4]);
-            const float S_Grad = eps + fabs(cfa[indx - w1] - cfa[indx + w1]) + fabs(cfai - cfa[indx + w2]) + fabs(cfa[indx + w1] - cfa[indx + w3]) + fabs(cfa[indx + w2] - cfa[indx + w4]);
-            const float W_Grad = eps + fabs(cfa[indx -  1] - cfa[indx +  1]) + fabs(cfai - cfa[indx -  2]) + fabs(cfa[indx -  1] - cfa[indx -  3]) + fabs(cfa[indx -  2] - cfa[indx -  4]);
-            const float E_Grad = eps + fabs(cfa[indx +  1] - cfa[indx -  1]) + fabs(cfai - cfa[indx +  2]) + fabs(cfa[indx +  1] - cfa[indx +  3]) + fabs(cfa[indx +  2] - cfa[indx +  4]);
-
-            const float lpfi = lpf[lp_indx];
-            // Cardinal pixel estimations
-            const float N_Est = cfa[indx - w1] + (cfa[indx - w1] * (lpfi - lpf[lp_indx - w1]) / (eps + lpfi + lpf[lp_indx - w1]));
-            const float S_Est = cfa[indx + w1] + (cfa[indx + w1] * (lpfi - lpf[lp_indx + w1]) / (eps + lpfi + lpf[lp_indx + w1]));
-            const float W_Est = cfa[indx -  1] + (cfa[indx -  1] * (lpfi - lpf[lp_indx -  1]) / (eps + lpfi + lpf[lp_indx -  1]));
-            const float E_Est = cfa[indx +  1] + (cfa[indx +  1] * (lpfi - lpf[lp_indx +  1]) / (eps + lpfi + lpf[lp_indx +  1]));
-
-            // Vertical and horizontal estimations
-            const float V_Est = (S_Grad * N_Est + N_Grad * S_Est) / (N_Grad + S_Grad);
-            const float H_Est = (W_Grad * E_Est + E_Grad * W_Est) / (E_Grad + W_Grad);
-
-            // G@B and G@R interpolation
-            // Refined vertical and horizontal local discrimination
-            const float VH_Central_Value = VH_Dir[indx];
-            const float VH_Neighbourhood_Value = 0.25f * (VH_Dir[indx - w1 - 1] + VH_Dir[indx - w1 + 1] + VH_Dir[indx + w1 - 1] + VH_Dir[indx + w1 + 1]);
-            const float VH_Disc = (fabs(0.5f - VH_Central_Value) < fabs(0.5f - VH_Neighbourhood_Value)) ? VH_Neighbourhood_Value : VH_Central_Value;
-
-            rgb[1][indx] = intp(VH_Disc, H_Est, V_Est);
-          }
-        }
+    for(int tile_vertical = 0; tile_vertical < num_vertical; tile_vertical++)
+      for(int tile_horizontal = 0; tile_horizontal < num_horizontal; tile_horizontal++)
+        rcd_tile(out, in, width, height, cfarray, scaler, revscaler, tile_vertical, tile_horizontal, VH_Dir,
+                 PQ_Dir, cfa, rgb);
 
-        // STEP 4: Populate the red and blue channels
-        // Step 4.1: Calculate P/Q diagonal local discrimination
-        for(int row = 4; row < tileRows - 4; row++)
-        {
-          for(int col = 4 + (FCRCD(row, 0) & 1), indx = row * RCD_TILESIZE + col, pqindx = indx / 2; col < tileCols - 4; col += 2, indx += 2, pqindx++)
-          {
-            const float cfai = cfa[indx];
+    RCD_TILE_BUFFERS_FREE
+  }
+}
+#endif
 
-            float P_Stat = fmaxf(epssq, - 18.f * cfai * (cfa[indx - w1 - 1] + cfa[indx + w1 + 1] + 2.f * (cfa[indx - w2 - 2] + cfa[indx + w2 + 2]) - cfa[indx - w3 - 3] - cfa[indx + w3 + 3]) - 2.f * cfai * (cfa[indx - w4 - 4] + cfa[indx + w4 + 4] - 19.f * cfai) - cfa[indx - w1 - 1] * (70.f * cfa[indx + w1 + 1] - 12.f * cfa[indx - w2 - 2] + 24.f * cfa[indx + w2 + 2] - 38.f * cfa[indx - w3 - 3] + 16.f * cfa[indx + w3 + 3] + 12.f * cfa[indx - w4 - 4] - 6.f * cfa[indx + w4 + 4] + 46.f * cfa[indx - w1 - 1]) + cfa[indx + w1 + 1] * (24.f * cfa[indx - w2 - 2] - 12.f * cfa[indx + w2 + 2] + 16.f * cfa[indx - w3 - 3] - 38.f * cfa[indx + w3 + 3] - 6.f * cfa[indx - w4 - 4] + 12.f * cfa[indx + w4 + 4] + 46.f * cfa[indx + w1 + 1]) + cfa[indx - w2 - 2] * (14.f * cfa[indx + w2 + 2] - 12.f * cfa[indx + w3 + 3] - 2.f * (cfa[indx - w4 - 4] - cfa[indx + w4 + 4]) + 11.f * cfa[indx - w2 - 2]) - cfa[indx + w2 + 2] * (12.f * cfa[indx - w3 - 3] + 2.f * (cfa[indx - w4 - 4] - cfa[indx + w4 + 4]) + 11.f * cfa[indx + w2 + 2]) + cfa[indx - w3 - 3] * (2.f * cfa[indx + w3 + 3] - 6.f * cfa[indx - w4 - 4] + 10.f * cfa[indx - w3 - 3]) - cfa[indx + w3 + 3] * (6.f * cfa[indx + w4 + 4] + 10.f * cfa[indx + w3 + 3]) + cfa[indx - w4 - 4] * cfa[indx - w4 - 4] + cfa[indx + w4 + 4] * cfa[indx + w4 + 4]);
-            float Q_Stat = fmaxf(epssq, - 18.f * cfai * (cfa[indx + w1 - 1] + cfa[indx - w1 + 1] + 2.f * (cfa[indx + w2 - 2] + cfa[indx - w2 + 2]) - cfa[indx + w3 - 3] - cfa[indx - w3 + 3]) - 2.f * cfai * (cfa[indx + w4 - 4] + cfa[indx - w4 + 4] - 19.f * cfai) - cfa[indx + w1 - 1] * (70.f * cfa[indx - w1 + 1] - 12.f * cfa[indx + w2 - 2] + 24.f * cfa[indx - w2 + 2] - 38.f * cfa[indx + w3 - 3] + 16.f * cfa[indx - w3 + 3] + 12.f * cfa[indx + w4 - 4] - 6.f * cfa[indx - w4 + 4] + 46.f * cfa[indx + w1 - 1]) + cfa[indx - w1 + 1] * (24.f * cfa[indx + w2 - 2] - 12.f * cfa[indx - w2 + 2] + 16.f * cfa[indx + w3 - 3] - 38.f * cfa[indx - w3 + 3] - 6.f * cfa[indx + w4 - 4] + 12.f * cfa[indx - w4 + 4] + 46.f * cfa[indx - w1 + 1]) + cfa[indx + w2 - 2] * (14.f * cfa[indx - w2 + 2] - 12.f * cfa[indx - w3 + 3] - 2.f * (cfa[indx + w4 - 4] - cfa[indx - w4 + 4]) + 11.f * cfa[indx + w2 - 2]) - cfa[indx - w2 + 2] * (12.f * cfa[indx + w3 - 3] + 2.f * (cfa[indx + w4 - 4] - cfa[indx - w4 + 4]) + 11.f * cfa[indx - w2 + 2]) + cfa[indx + w3 - 3] * (2.f * cfa[indx - w3 + 3] - 6.f * cfa[indx + w4 - 4] + 10.f * cfa[indx + w3 - 3]) - cfa[indx - w3 + 3] * (6.f * cfa[indx - w4 + 4] + 10.f * cfa[indx - w3 + 3]) + cfa[indx + w4 - 4] * cfa[indx + w4 - 4] + cfa[indx - w4 + 4] * cfa[indx - w4 + 4]);
+typedef void (*rcd_demosaic_tiles_t)(float *const restrict out, const float *const restrict in, const int width,
+                                     const int height, const int *const cfarray, const float scaler);
 
-            PQ_Dir[pqindx] = P_Stat / (P_Stat + Q_Stat);
-          }
-        }
+static size_t rcd_demosaic_bench(const void *variant, float **out);
 
-        // Step 4.2: Populate the red and blue channels at blue and red CFA positions
-        for(int row = 4; row < tileRows - 4; row++)
-        {
-          for(int col = 4 + (FCRCD(row, 0) & 1), indx = row * RCD_TILESIZE + col, c = 2 - FCRCD(row, col), pqindx = indx / 2, pqindx2 = (indx - w1 - 1) / 2, pqindx3 = (indx + w1 - 1) / 2; col < tileCols - 4; col += 2, indx += 2, pqindx++, pqindx2++, pqindx3++)
-          {
-            // Refined P/Q diagonal local discrimination
-            float PQ_Central_Value   = PQ_Dir[pqindx];
-            float PQ_Neighbourhood_Value = 0.25f * (PQ_Dir[pqindx2] + PQ_Dir[pqindx2 + 1] + PQ_Dir[pqindx3] + PQ_Dir[pqindx3 + 1]);
-
-            float PQ_Disc = (fabs(0.5f - PQ_Central_Value) < fabs(0.5f - PQ_Neighbourhood_Value)) ? PQ_Neighbourhood_Value : PQ_Central_Value;
-
-            // Diagonal gradients
-            float NW_Grad = eps + fabs(rgb[c][indx - w1 - 1] - rgb[c][indx + w1 + 1]) + fabs(rgb[c][indx - w1 - 1] - rgb[c][indx - w3 - 3]) + fabs(rgb[1][indx] - rgb[1][indx - w2 - 2]);
-            float NE_Grad = eps + fabs(rgb[c][indx - w1 + 1] - rgb[c][indx + w1 - 1]) + fabs(rgb[c][indx - w1 + 1] - rgb[c][indx - w3 + 3]) + fabs(rgb[1][indx] - rgb[1][indx - w2 + 2]);
-            float SW_Grad = eps + fabs(rgb[c][indx - w1 + 1] - rgb[c][indx + w1 - 1]) + fabs(rgb[c][indx + w1 - 1] - rgb[c][indx + w3 - 3]) + fabs(rgb[1][indx] - rgb[1][indx + w2 - 2]);
-            float SE_Grad = eps + fabs(rgb[c][indx - w1 - 1] - rgb[c][indx + w1 + 1]) + fabs(rgb[c][indx + w1 + 1] - rgb[c][indx + w3 + 3]) + fabs(rgb[1][indx] - rgb[1][indx + w2 + 2]);
-
-            // Diagonal colour differences
-            float NW_Est = rgb[c][indx - w1 - 1] - rgb[1][indx - w1 - 1];
-            float NE_Est = rgb[c][indx - w1 + 1] - rgb[1][indx - w1 + 1];
-            float SW_Est = rgb[c][indx + w1 - 1] - rgb[1][indx + w1 - 1];
-            float SE_Est = rgb[c][indx + w1 + 1] - rgb[1][indx + w1 + 1];
-
-            // P/Q estimations
-            float P_Est = (NW_Grad * SE_Est + SE_Grad * NW_Est) / (NW_Grad + SE_Grad);
-            float Q_Est = (NE_Grad * SW_Est + SW_Grad * NE_Est) / (NE_Grad + SW_Grad);
-
-            // R@B and B@R interpolation
-            rgb[c][indx] = rgb[1][indx] + intp(PQ_Disc, Q_Est, P_Est);
-          }
-        }
+static dt_dispatch_kernel_t rcd_demosaic_kernel = {
+  .name = "rcd demosaic",
+  .variants = { [DT_ISA_SCALAR] = rcd_demosaic_tiles_plain,
+#ifdef DT_HAVE_TARGET_AVX2
+                [DT_ISA_AVX2] = rcd_demosaic_tiles_avx2,
+#endif
+              },
+  .bench = rcd_demosaic_bench,
+  .selected = rcd_demosaic_tiles_plain
+};
 
-        // Step 4.3: Populate the red and blue channels at green CFA positions
-        for(int row = 4; row < tileRows - 4; row++)
-        {
-          for(int col = 4 + (FCRCD(row, 1) & 1), indx = row * RCD_TILESIZE + col; col < tileCols - 4; col += 2, indx +=2)
-          {
-            // Refined vertical and horizontal local discrimination
-            const float VH_Central_Value = VH_Dir[indx];
-            const float VH_Neighbourhood_Value = 0.25f * (VH_Dir[indx - w1 - 1] + VH_Dir[indx - w1 + 1] + VH_Dir[indx + w1 - 1] + VH_Dir[indx + w1 + 1]);
-            const float VH_Disc = (fabs(0.5f - VH_Central_Value) < fabs(0.5f - VH_Neighbourhood_Value) ) ? VH_Neighbourhood_Value : VH_Central_Value;
-            const float rgb1 = rgb[1][indx];
-            const float N1 = eps + fabs(rgb1 - rgb[1][indx - w2]);
-            const float S1 = eps + fabs(rgb1 - rgb[1][indx + w2]);
-            const float W1 = eps + fabs(rgb1 - rgb[1][indx -  2]);
-            const float E1 = eps + fabs(rgb1 - rgb[1][indx +  2]);
-
-            const float rgb1mw1 = rgb[1][indx - w1];
-            const float rgb1pw1 = rgb[1][indx + w1];
-            const float rgb1m1 =  rgb[1][indx - 1];
-            const float rgb1p1 =  rgb[1][indx + 1];
-
-            for(int c = 0; c <= 2; c += 2)
-            {
-              const float rgbc_mw1 = rgb[c][indx - w1];
-              const float rgbc_pw1 = rgb[c][indx + w1];
-              const float rgbc_m1  = rgb[c][indx -  1];
-              const float rgbc_p1  = rgb[c][indx +  1];
-
-              // Cardinal gradients
-              const float N_Grad = N1 + fabs(rgbc_mw1 - rgbc_pw1) + fabs(rgbc_mw1 - rgb[c][indx - w3]);
-              const float S_Grad = S1 + fabs(rgbc_pw1 - rgbc_mw1) + fabs(rgbc_pw1 - rgb[c][indx + w3]);
-              const float W_Grad = W1 + fabs(rgbc_m1 - rgbc_p1) + fabs(rgbc_m1 - rgb[c][indx -  3]);
-              const float E_Grad = E1 + fabs(rgbc_p1 - rgbc_m1) + fabs(rgbc_p1 - rgb[c][indx +  3]);
-
-              // Cardinal colour differences
-              const float N_Est = rgbc_mw1 - rgb1mw1;
-              const float S_Est = rgbc_pw1 - rgb1pw1;
-              const float W_Est = rgbc_m1 - rgb1m1;
-              const float E_Est = rgbc_p1 - rgb1p1;
-
-              // Vertical and horizontal estimations
-              const float V_Est = (N_Grad * S_Est + S_Grad * N_Est) / (N_Grad + S_Grad);
-              const float H_Est = (E_Grad * W_Est + W_Grad * E_Est) / (E_Grad + W_Grad);
-
-              // R@G and B@G interpolation
-              rgb[c][indx] = rgb1 + intp(VH_Disc, V_Est, H_Est);
-            }
-          }
-        }
-        for(int row = rowStart + RCD_BORDER; row < rowEnd - RCD_BORDER; row++)
-        {
-          int col = colStart + RCD_BORDER;
-          int o_idx = (row * width + col) * 4;
-          int idx = (row - rowStart) * RCD_TILESIZE + col - colStart;
-          for(; col < colEnd - RCD_BORDER; col++, o_idx += 4, idx++)
-          {
-            out[o_idx]   = scaler * fmaxf(0.0f, rgb[0][idx]);
-            out[o_idx+1] = scaler * fmaxf(0.0f, rgb[1][idx]);
-            out[o_idx+2] = scaler * fmaxf(0.0f, rgb[2][idx]);
-            out[o_idx+3] = 0.0f;
-          }
-        }
-      }
-    }
+static void rcd_demosaic(dt_dev_pixelpipe_iop_t *piece, float *const restrict out, const float *const restrict in, dt_iop_roi_t *const roi_out,
+                                   const dt_iop_roi_t *const roi_in, const uint32_t filters)
+{
+  const int width = roi_in->width;
+  const int height = roi_in->height;
 
-    dt_free_align(cfa);
-    dt_free_align(rgb);
-    dt_free_align(VH_Dir);
-    dt_free_align(PQ_Dir);
+  if((width < 16) || (height < 16))
+  {
+    dt_control_log(_("[rcd_demosaic] too small area"));
+    return;
   }
 
+  const float scaler = fmaxf(piece->pipe->dsc.processed_maximum[0], fmaxf(piece->pipe->dsc.processed_maximum[1], piece->pipe->dsc.processed_maximum[2]));
+
+  const int cfarray[4] = {FC(roi_in->y, roi_in->x, filters), FC(roi_in->y, roi_in->x + 1, filters), FC(roi_in->y + 1, roi_in->x, filters), FC(roi_in->y + 1, roi_in->x + 1, filters)};
+
+  ((rcd_demosaic_tiles_t)rcd_demosaic_kernel.selected)(out, in, width, height, cfarray, scaler);
+
   rcd_border_interpolate(out, in, cfarray, width, height, RCD_BORDER, scaler);
 }
 
+// a synthetic 12 mpix rggb mosaic for darktable-cputest
+static size_t rcd_demosaic_bench(const void *variant, float **out)
+{
+  const int width = 4000, height = 3000;
+  const int cfarray[4] = { 0, 1, 1, 2 };
+  float *const in = dt_alloc_align_float((size_t)width * height);
+  *out = dt_alloc_align_float((size_t)4 * width * height);
+  for(int row = 0; row < height; row++)
+    for(int col = 0; col < width; col++)
+      in[(size_t)row * width + col] = 0.5f + 0.4f * sinf(0.013f * col + 0.7f * FCRCD(row, col))
+                                             * cosf(0.021f * row - 0.003f * col);
+  memset(*out, 0, sizeof(float) * 4 * width * height);
+  ((rcd_demosaic_tiles_t)variant)(*out, in, width, height, cfarray, 1.0f);
+  dt_free_align(in);
+  return (size_t)4 * width * height;
+}
+
+#undef RCD_TILE_BUFFERS_ALLOC
+#undef RCD_TILE_BUFFERS_FREE
+
 #ifdef __GNUC__
   #pragma GCC pop_options
 #endif
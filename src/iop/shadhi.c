@@ -311,6 +311,7 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   const int width = roi_out->width;
   const int height = roi_out->height;
   const int ch = piece->colors;
+  const size_t bufsize = sizeof(float) * ch * width * height;
 
   const int order = data->order;
   const float radius = fmaxf(0.1f, data->radius);
@@ -340,10 +341,17 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
       for(int k = 0; k < 4; k++) Labmin[k] = -INFINITY;
     }
 
-    dt_gaussian_t *g = dt_gaussian_init(width, height, ch, Labmax, Labmin, sigma, order);
-    if(!g) return;
-    dt_gaussian_blur_4c(g, in, out);
-    dt_gaussian_free(g);
+    // the blur only depends on the input and these, moving the other sliders reuses it
+    const float params[] = { sigma, order, unbound_mask };
+    const uint64_t hash = dt_dev_pixelpipe_cache_filter_hash(piece, roi_in, "gaussian", params, sizeof(params));
+    if(!dt_dev_pixelpipe_cache_filter_get(&piece->pipe->cache, hash, out, bufsize))
+    {
+      dt_gaussian_t *g = dt_gaussian_init(width, height, ch, Labmax, Labmin, sigma, order);
+      if(!g) return;
+      dt_gaussian_blur_4c(g, in, out);
+      dt_gaussian_free(g);
+      dt_dev_pixelpipe_cache_filter_put(&piece->pipe->cache, hash, out, bufsize);
+    }
   }
   else
   {
@@ -351,12 +359,18 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
     const float sigma_s = sigma;
     const float detail = -1.0f; // we want the bilateral base layer
 
-    dt_bilateral_t *b = dt_bilateral_init(width, height, sigma_s, sigma_r);
-    if(!b) return;
-    dt_bilateral_splat(b, in);
-    dt_bilateral_blur(b);
-    dt_bilateral_slice(b, in, out, detail);
-    dt_bilateral_free(b);
+    const float params[] = { sigma_s, sigma_r, detail };
+    const uint64_t hash = dt_dev_pixelpipe_cache_filter_hash(piece, roi_in, "bilateral", params, sizeof(params));
+    if(!dt_dev_pixelpipe_cache_filter_get(&piece->pipe->cache, hash, out, bufsize))
+    {
+      dt_bilateral_t *b = dt_bilateral_init(width, height, sigma_s, sigma_r);
+      if(!b) return;
+      dt_bilateral_splat(b, in);
+      dt_bilateral_blur(b);
+      dt_bilateral_slice(b, in, out, detail);
+      dt_bilateral_free(b);
+      dt_dev_pixelpipe_cache_filter_put(&piece->pipe->cache, hash, out, bufsize);
+    }
   }
 
   const float max[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
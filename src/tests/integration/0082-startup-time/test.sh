@@ -0,0 +1,28 @@
+#!/bin/bash
+#
+# Check the startup time of darktable-cli. Without gui the global init of a module is deferred until its
+# first instance is created, so measure up to the first processed image, as reported by -d perf. It must
+# stay below STARTUP_LIMIT seconds.
+#
+
+CLI=${DARKTABLE_CLI:-darktable-cli}
+TEST_IMAGES=$PWD/images
+LIMIT=${STARTUP_LIMIT:-5}
+
+cd $(dirname $0)
+
+OUTPUT=$(mktemp -d)
+
+STARTUP=$($CLI --width 64 --height 64 \
+               --apply-custom-presets false \
+               "$TEST_IMAGES/mire1.cr2" ../0000-nop/nop.xmp $OUTPUT/output.png \
+               --core --disable-opencl -d perf 2>&1 |
+              sed -n 's/.*\[darktable-cli\] first image done \([0-9.]*\) seconds after start.*/\1/p')
+
+rm -rf $OUTPUT
+
+[ -z "$STARTUP" ] && echo "      no startup time reported" && exit 1
+
+echo "      first image done after ${STARTUP}s (limit ${LIMIT}s)"
+
+awk -v t=$STARTUP -v l=$LIMIT 'BEGIN { exit !(t < l) }'
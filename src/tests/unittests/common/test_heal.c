@@ -0,0 +1,151 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for common/heal.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+#include "../util/testimg.h"
+
+#include "common/heal.c"
+
+/*
+ * DEFINITIONS
+ */
+
+// the multigrid and the plain SOR solution both stop at a residual that
+// corresponds to less than 0.1/255:
+#define E 1e-3f
+
+// number of test masks, see gen_mask():
+#define SHAPES 4
+
+/*
+ * HELPER FUNCTIONS
+ */
+
+// masks with a single big blob, bands touching the image borders, two blobs
+// and an area too small for a coarse level:
+static void gen_mask(float *const mask, const int width, const int height,
+                     const int shape)
+{
+  for(int i = 0; i < height; i++)
+    for(int j = 0; j < width; j++)
+    {
+      int m = 0;
+      if(shape == 0)
+        m = (i - 100) * (i - 100) + (j - 120) * (j - 120) < 80 * 80;
+      else if(shape == 1)
+        m = abs(i - 100) < 20 || (j > 50 && j < 70);
+      else if(shape == 2)
+        m = (i - 50) * (i - 50) + (j - 60) * (j - 60) < 30 * 30
+            || (i - 140) * (i - 140) / 4 + (j - 170) * (j - 170) < 40 * 40;
+      else
+        m = (i - 30) * (i - 30) + (j - 50) * (j - 50) < 6 * 6;
+      mask[(size_t)i * width + j] = m ? 1.f : 0.f;
+    }
+}
+
+// the differences to heal, with one extra row: the solver reads the pixel
+// past the end of the image, which must stay zero
+static Testimg *gen_diff(const Testimg *const pattern)
+{
+  Testimg *ti = testimg_alloc(pattern->width, pattern->height + 1);
+  memcpy(ti->pixels, pattern->pixels,
+         sizeof(float) * 4 * pattern->width * pattern->height);
+  return ti;
+}
+
+static void compare_multigrid_to_sor(const int use_sse)
+{
+  const int width = 240, height = 200, ch = 4;
+  Testimg *const pattern = testimg_gen_pattern(width, height);
+  float *const mask = calloc((size_t)width * height, sizeof(float));
+
+  for(int shape = 0; shape < SHAPES; shape++)
+  {
+    gen_mask(mask, width, height, shape);
+    Testimg *const multigrid = gen_diff(pattern);
+    Testimg *const sor = gen_diff(pattern);
+
+    dt_heal_laplace_loop(multigrid->pixels, width, height, ch, mask, use_sse);
+
+    // the finest level alone, solved by SOR like before the multigrid solver
+    dt_heal_level_t level = { .width = width, .height = height,
+                              .pixels = sor->pixels, .mask = mask };
+    assert_true(dt_heal_laplace_setup(&level, ch));
+    dt_heal_laplace_sor(&level, ch, use_sse);
+    dt_heal_level_free(&level, FALSE);
+
+    const float max_err = testimg_max_abs_diff(multigrid, sor,
+                                               dt_heal_solved_channels(ch, use_sse));
+    TR_DEBUG("shape %d sse=%d: max error %e", shape, use_sse, max_err);
+    assert_float_equal(max_err, 0.f, E);
+
+    testimg_free(multigrid);
+    testimg_free(sor);
+  }
+
+  free(mask);
+  testimg_free(pattern);
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_multigrid_plain(void **state)
+{
+  compare_multigrid_to_sor(0);
+}
+
+static void test_multigrid_sse(void **state)
+{
+#if defined(__SSE__)
+  compare_multigrid_to_sor(1);
+#else
+  skip();
+#endif
+}
+
+
+/*
+ * MAIN FUNCTION
+ */
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_multigrid_plain),
+    cmocka_unit_test(test_multigrid_sse)
+  };
+
+  TR_DEBUG("epsilon = %e", E);
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,128 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for common/locallaplacian.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+#include "../util/testimg.h"
+
+#include "common/locallaplacian.h"
+
+/*
+ * DEFINITIONS
+ */
+
+// image sizes to test, the larger ones span several bands of rows:
+static const int sizes[][2] = {
+  { 4, 4 }, { 37, 5 }, { 64, 48 }, { 133, 517 }, { 517, 133 }, { 300, 301 }
+};
+
+/*
+ * HELPER FUNCTIONS
+ */
+
+static void compare_banded_to_full(const int use_sse2)
+{
+  for(int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+  {
+    const int wd = sizes[s][0], ht = sizes[s][1];
+    // Lab input, L in [0; 100]
+    Testimg *in = testimg_gen_pattern(wd, ht);
+    for_testimg_pixels_p_yx(in) p[0] *= 100.0f;
+    Testimg *banded = testimg_alloc(wd, ht);
+    Testimg *full = testimg_alloc(wd, ht);
+
+    // without boundary the fine levels are processed in bands
+    local_laplacian_internal(in->pixels, banded->pixels, wd, ht, 0.2f, 0.5f,
+                             0.5f, 0.3f, use_sse2, NULL);
+    // collecting the preview boundary always builds the full pyramids
+    local_laplacian_boundary_t b = { 0 };
+    b.mode = 1;
+    local_laplacian_internal(in->pixels, full->pixels, wd, ht, 0.2f, 0.5f,
+                             0.5f, 0.3f, use_sse2, &b);
+    local_laplacian_boundary_free(&b);
+
+    // the bands compute exactly the same as the full pyramids
+    const float max_err = testimg_max_abs_diff(banded, full, 3);
+    TR_DEBUG("%dx%d sse2=%d: max error %e", wd, ht, use_sse2, max_err);
+    assert_true(max_err == 0.0f);
+
+    testimg_free(in);
+    testimg_free(banded);
+    testimg_free(full);
+  }
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_banded_plain(void **state)
+{
+  compare_banded_to_full(0);
+}
+
+static void test_banded_sse2(void **state)
+{
+#if defined(__SSE2__)
+  compare_banded_to_full(1);
+#else
+  skip();
+#endif
+}
+
+static void test_memory_use(void **state)
+{
+  for(int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+  {
+    const int wd = sizes[s][0], ht = sizes[s][1];
+    assert_true(local_laplacian_memory_use(wd, ht)
+                <= local_laplacian_memory_use_full(wd, ht));
+    assert_true(local_laplacian_singlebuffer_size(wd, ht)
+                <= local_laplacian_memory_use(wd, ht));
+    assert_true(local_laplacian_singlebuffer_size_full(wd, ht)
+                <= local_laplacian_memory_use_full(wd, ht));
+  }
+}
+
+
+/*
+ * MAIN FUNCTION
+ */
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_banded_plain),
+    cmocka_unit_test(test_banded_sse2),
+    cmocka_unit_test(test_memory_use)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -216,6 +216,22 @@ Testimg *testimg_gen_rgb_space(const int width)
   return ti;
 }
 
+Testimg *testimg_gen_pattern(const int width, const int height)
+{
+  Testimg *ti = testimg_alloc(width, height);
+  ti->name = "pattern";
+
+  for_testimg_pixels_p_yx(ti)
+  {
+    for (int c = 0; c < 4; c += 1)
+    {
+      p[c] = 0.5f + 0.4f * sinf(0.013f * (c + 1) * x) * cosf(0.021f * y + c)
+             + 0.1f * ((x * 7 + y * 13 + c) % 17) / 17.0f;
+    }
+  }
+  return ti;
+}
+
 Testimg *testimg_gen_grey_max_dr()
 {
   const int width = 10;
@@ -278,3 +294,20 @@ Testimg *testimg_gen_grey_with_rgb_clipping(const int width)
   }
   return ti;
 }
+
+float testimg_max_abs_diff(const Testimg *const a, const Testimg *const b,
+  const int channels)
+{
+  float max_diff = 0.0f;
+  for_testimg_pixels_p_yx(a)
+  {
+    const float *q = get_pixel(b, x, y);
+    for (int c = 0; c < channels; c += 1)
+    {
+      const float diff = fabsf(p[c] - q[c]);
+      if (isnan(diff)) return diff;
+      if (diff > max_diff) max_diff = diff;
+    }
+  }
+  return max_diff;
+}
@@ -146,6 +146,15 @@ Testimg *testimg_gen_three_color_space(const int width);
 Testimg *testimg_gen_rgb_space(const int width);
 
 
+/*
+ * Structured image generation
+ */
+
+// create a deterministic pattern with structure on all scales in all 4
+// channels, smooth waves plus pixel sized steps (values in [0.1; 1.0[):
+Testimg *testimg_gen_pattern(const int width, const int height);
+
+
 /*
  * Bad and nonsense value image generation
  */
@@ -161,3 +170,13 @@ Testimg *testimg_gen_grey_max_dr_neg();
 // create 3 "grey'ish" gradients where in each one a color dominates and clips:
 // height: 3, y=0 => red clips, y=1 => green clips, y=2 => blue clips
 Testimg *testimg_gen_grey_with_rgb_clipping(const int width);
+
+
+/*
+ * Comparison
+ */
+
+// largest absolute difference between the first `channels` channels of two
+// test images of the same size (NaN if any of the values is NaN):
+float testimg_max_abs_diff(const Testimg *const a, const Testimg *const b,
+  const int channels);